@@ -28,6 +28,12 @@ CConfig::CConfig()
 	m_lAccelerationLimit	= 50;
 	m_lAltitudeLimit		= 10;
 	m_strIpAddress			= "192.168.1.1";
+	m_lMaxDisplayFps		= 30;
+	m_lPcRecordFormat		= PcRecord_Mp4;
+	m_lPreRecordTime		= 10;
+	m_lPreRecordMemory		= 16;
+	m_lPictureFormat		= PictureFormat_Png;
+	m_lBurstCount			= 1;
 }
 
 
@@ -424,6 +430,138 @@ const wxString& CConfig::GetIpAddress()
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+// Set the maximum number of images displayed per second (0 = no limit)
+//////////////////////////////////////////////////////////////////////////////
+void CConfig::SetMaxDisplayFps(long lMaxDisplayFps)
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	m_lMaxDisplayFps = lMaxDisplayFps;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the maximum number of images displayed per second
+//////////////////////////////////////////////////////////////////////////////
+long CConfig::GetMaxDisplayFps()
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	return m_lMaxDisplayFps;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the file format of the recording on pc (ePcRecordFormat)
+//////////////////////////////////////////////////////////////////////////////
+void CConfig::SetPcRecordFormat(long lPcRecordFormat)
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	m_lPcRecordFormat = lPcRecordFormat;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the file format of the recording on pc
+//////////////////////////////////////////////////////////////////////////////
+long CConfig::GetPcRecordFormat()
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	return m_lPcRecordFormat;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the seconds of video kept before a recording starts (0 = disabled)
+//////////////////////////////////////////////////////////////////////////////
+void CConfig::SetPreRecordTime(long lPreRecordTime)
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	m_lPreRecordTime = lPreRecordTime;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the seconds of video kept before a recording starts
+//////////////////////////////////////////////////////////////////////////////
+long CConfig::GetPreRecordTime()
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	return m_lPreRecordTime;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the memory used for the video kept before a recording (in MB)
+//////////////////////////////////////////////////////////////////////////////
+void CConfig::SetPreRecordMemory(long lPreRecordMemory)
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	m_lPreRecordMemory = lPreRecordMemory;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the memory used for the video kept before a recording (in MB)
+//////////////////////////////////////////////////////////////////////////////
+long CConfig::GetPreRecordMemory()
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	return m_lPreRecordMemory;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the file format of the screenshots (ePictureFormat)
+//////////////////////////////////////////////////////////////////////////////
+void CConfig::SetPictureFormat(long lPictureFormat)
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	m_lPictureFormat = lPictureFormat;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the file format of the screenshots
+//////////////////////////////////////////////////////////////////////////////
+long CConfig::GetPictureFormat()
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	return m_lPictureFormat;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the number of images taken by a screenshot
+//////////////////////////////////////////////////////////////////////////////
+void CConfig::SetBurstCount(long lBurstCount)
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	m_lBurstCount = lBurstCount;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the number of images taken by a screenshot
+//////////////////////////////////////////////////////////////////////////////
+long CConfig::GetBurstCount()
+{
+	wxCriticalSectionLocker LockConfig(m_CSConfig);
+
+	return m_lBurstCount;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 // Load the saved config
 //////////////////////////////////////////////////////////////////////////////
@@ -502,6 +640,32 @@ bool CConfig::LoadConfig()
 			// Get Ip address
 			m_strIpAddress = ConfigFile.GetLine(iLine++);
 
+			// Get display frame rate limit (missing in older files)
+			if(iLine < (int)ConfigFile.GetLineCount())
+			{
+				m_lMaxDisplayFps = ToLong(ConfigFile.GetLine(iLine++));
+			}
+
+			// Get file format of the recording on pc (missing in older files)
+			if(iLine < (int)ConfigFile.GetLineCount())
+			{
+				m_lPcRecordFormat = ToLong(ConfigFile.GetLine(iLine++));
+			}
+
+			// Get video kept before a recording (missing in older files)
+			if(iLine + 1 < (int)ConfigFile.GetLineCount())
+			{
+				m_lPreRecordTime = ToLong(ConfigFile.GetLine(iLine++));
+				m_lPreRecordMemory = ToLong(ConfigFile.GetLine(iLine++));
+			}
+
+			// Get screenshot format and burst (missing in older files)
+			if(iLine + 1 < (int)ConfigFile.GetLineCount())
+			{
+				m_lPictureFormat = ToLong(ConfigFile.GetLine(iLine++));
+				m_lBurstCount = ToLong(ConfigFile.GetLine(iLine++));
+			}
+
 			// Close the file
 			ConfigFile.Close();
 			
@@ -578,6 +742,16 @@ bool CConfig::SaveConfig()
 	ConfigFile.AddLine(ToString(m_lAltitudeLimit));
 	// Add Ip Adress
 	ConfigFile.AddLine(m_strIpAddress);
+	// Add display frame rate limit
+	ConfigFile.AddLine(ToString(m_lMaxDisplayFps));
+	// Add file format of the recording on pc
+	ConfigFile.AddLine(ToString(m_lPcRecordFormat));
+	// Add video kept before a recording
+	ConfigFile.AddLine(ToString(m_lPreRecordTime));
+	ConfigFile.AddLine(ToString(m_lPreRecordMemory));
+	// Add screenshot format and burst
+	ConfigFile.AddLine(ToString(m_lPictureFormat));
+	ConfigFile.AddLine(ToString(m_lBurstCount));
 
 	m_CSConfig.Leave();
 
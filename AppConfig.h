@@ -27,6 +27,21 @@ enum eVideoCodec
 	Codec_MP4_360P_H264_360P	= 0x88	// Not used
 };
 
+// An enum for the file format of the recording on pc
+enum ePcRecordFormat
+{
+	PcRecord_Avi				= 0,	// Decoded images encoded again (OpenCV)
+	PcRecord_Mp4				= 1,	// H.264 stream of the drone copied as it is
+	PcRecord_Mkv				= 2
+};
+
+// An enum for the file format of the screenshots
+enum ePictureFormat
+{
+	PictureFormat_Png			= 0,
+	PictureFormat_Jpeg			= 1
+};
+
 // Define a map
 WX_DECLARE_STRING_HASH_MAP( wxString, LanguageMap );
 
@@ -74,6 +89,18 @@ private:
 	long				m_lAltitudeLimit;
 	// Ip Address to use
 	wxString			m_strIpAddress;
+	// Maximum number of images displayed per second (0 = no limit)
+	long				m_lMaxDisplayFps;
+	// File format of the recording on pc (ePcRecordFormat)
+	long				m_lPcRecordFormat;
+	// Seconds of video kept before a recording starts (0 = disabled)
+	long				m_lPreRecordTime;
+	// Memory used to keep them (in MB)
+	long				m_lPreRecordMemory;
+	// File format of the screenshots (ePictureFormat)
+	long				m_lPictureFormat;
+	// Number of images taken by a screenshot (burst)
+	long				m_lBurstCount;
 
 	// Critical section to protect data
 	wxCriticalSection	m_CSConfig;
@@ -155,6 +182,26 @@ public:
 	// Ip Address
 	void SetIpAddress(const wxString &strIpAddress);
 	const wxString& GetIpAddress();
+
+	// Display frame rate limit
+	void SetMaxDisplayFps(long lMaxDisplayFps);
+	long GetMaxDisplayFps();
+
+	// File format of the recording on pc
+	void SetPcRecordFormat(long lPcRecordFormat);
+	long GetPcRecordFormat();
+
+	// Video kept before a recording starts
+	void SetPreRecordTime(long lPreRecordTime);
+	long GetPreRecordTime();
+	void SetPreRecordMemory(long lPreRecordMemory);
+	long GetPreRecordMemory();
+
+	// Screenshots
+	void SetPictureFormat(long lPictureFormat);
+	long GetPictureFormat();
+	void SetBurstCount(long lBurstCount);
+	long GetBurstCount();
 };
 
 #endif
\ No newline at end of file
@@ -2,15 +2,68 @@
 // Autopilot definition - Allows the drone to come back to landing point
 //////////////////////////////////////////////////////////////////////////////
 
+#include <chrono>
 #include "AutoPilot.h"
 #include "Utils.h"
 
 
+//////////////////////////////////////////////////////////////////////////////
+// Keep the vertical move of the pilot under the altitude limit
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Altitude and its limit (m), vertical move of the pilot
+// [RETURN] : Vertical move to send to the drone
+//////////////////////////////////////////////////////////////////////////////
+double LimitAltitudeMove(double dAltitude, double dMaxAltitude, double dVertical)
+{
+	if(dAltitude < dMaxAltitude)
+	{
+		return dVertical;
+	}
+
+	// Altitude has reach, or is over max altitude, bring the drone down
+	double dAltDiff = dAltitude - dMaxAltitude;
+	if(dAltDiff > 10.0f)
+	{
+		return -0.75f;	// Drone flying away ??
+	}
+	else if(dAltDiff > 5.0f)
+	{
+		return -0.5f;
+	}
+	return -0.20f;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 // Constructor
 //////////////////////////////////////////////////////////////////////////////
-CAutoPilot::CAutoPilot()
+CAutoPilot::CAutoPilot() :
+	m_PidHeading("Heading", HomeHeadingGains),
+	m_PidDistance("Distance", HomeDistanceGains),
+	m_PidAltitude("Altitude", HomeAltitudeGains)
 {
+	m_llLastUpdate				= 0;
+	m_uiLastDroneTime			= 0;
+	m_lPoseCount				= 0;
+	m_lPoseGapMax				= 0;
+	m_llPoseCostSum				= 0;
+	m_lPoseCostMax				= 0;
+	m_llPoseStatsTime			= 0;
+
+	m_uiPoseSequence			= 0;
+	m_dPoseX					= 0.0f;
+	m_dPoseY					= 0.0f;
+	m_dPoseDistance				= 0.0f;
+	m_dPoseAltitude				= 0.0f;
+	m_dPoseAccuracy				= 0.0f;
+	m_dPoseBias					= 0.0f;
+	m_dPoseRate					= 0.0f;
+	m_lPoseGapLast				= 0;
+	m_ulPoseGaps				= 0;
+	m_lPoseCostAvg				= 0;
+	m_lPoseCostLast				= 0;
+	m_ulPoseRejected			= 0;
+
 	ResetAutoPilot();
 }
 
@@ -26,16 +79,15 @@ CAutoPilot::~CAutoPilot()
 //////////////////////////////////////////////////////////////////////////////
 // Reset all values
 //////////////////////////////////////////////////////////////////////////////
-void CAutoPilot::ResetAutoPilot(wxLongLong llUpdateTime, bool bHasGps, double dStartLatitude, double dStartLongitude)
+void CAutoPilot::ResetAutoPilot(bool bHasGps, double dStartLatitude, double dStartLongitude)
 {
 	wxCriticalSectionLocker Lock(m_CSAutoPilot);
 
-	m_llLastUpdate				= llUpdateTime;
-
-	m_dLastVelocityForward		= 0.0f;
-	m_dLastVelocityLateral		= 0.0f;
-	m_dPositionX				= 0.0f;
-	m_dPositionY				= 0.0f;
+	// The position belongs to the navdata thread, it starts again from 0 with the next navdata
+	m_bHomeGps					= bHasGps;
+	m_dHomeLatitude				= dStartLatitude;
+	m_dHomeLongitude			= dStartLongitude;
+	m_bPoseReset				= true;
 	m_dDistance					= 0.0f;
 
 	m_dCurrentAltitude			= 0.0f;
@@ -73,11 +125,9 @@ void CAutoPilot::UpdateGps(double dLatitude, double dLongitude)
 
 //////////////////////////////////////////////////////////////////////////////
 // Update drone informations
-// Note: 
-//    - Velocity X is forward flying direction
-//    - Velocity Y is side flying direction
+// Note: the position is estimated by Integrate() on the navdata thread
 //////////////////////////////////////////////////////////////////////////////
-void CAutoPilot::Update(wxLongLong llUpdateTime, double dDroneAngle360, double dVelocityForward, double dVelocitySide, double dAltitude, bool bAutopilotIsOn)
+void CAutoPilot::Update(double dDroneAngle360, double dAltitude, bool bAutopilotIsOn)
 {
 	wxCriticalSectionLocker Lock(m_CSAutoPilot);
 
@@ -94,163 +144,241 @@ void CAutoPilot::Update(wxLongLong llUpdateTime, double dDroneAngle360, double d
 		m_dMaxAltitude = dAltitude;
 	}
 
-	// In case of GPS we only need to calculate the current distance, witout GPS we also need to estimate the new position
-	if(m_bHasGps)
+	// The distance comes from the estimated position (with or without gps)
+	sPose Pose;
+	GetPose(Pose);
+	m_dDistance = Pose.dDistance;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Estimate the position with one navdata
+// Note: called by the navdata thread for each navdata, whatever the frame rate
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Time of the drone (11 bits seconds, 21 bits microseconds, 0 if not sent),
+//        measurements of the navdata
+//////////////////////////////////////////////////////////////////////////////
+void CAutoPilot::Integrate(unsigned int uiDroneTime, const sEstimatorInput& Input)
+{
+	// Time of this navdata, the one of the drone if it sends it
+	wxLongLong llTime = wxGetUTCTimeUSec();
+	long lDiffTime = 0;
+	if( (0 != uiDroneTime) && (0 != m_uiLastDroneTime) && (uiDroneTime != m_uiLastDroneTime) )
 	{
-		// Convert to radian
-		double dA = m_dStartLatitude*dPIover180;
-		double dB = m_dCurrentLatitude*dPIover180;
-		double dC = m_dStartLongitude*dPIover180;
-		double dD = m_dCurrentLongitude*dPIover180;
-
-		// Calculate distance to drone in meters
-		m_dDistance = dEarthRadius*acos(cos(dA)*cos(dB)*cos(dC-dD)+sin(dA)*sin(dB));
+		long lSeconds = (long)(uiDroneTime >> 21) - (long)(m_uiLastDroneTime >> 21);
+		lDiffTime = lSeconds * 1000000L + (long)(uiDroneTime & 0x1FFFFF) - (long)(m_uiLastDroneTime & 0x1FFFFF);
 	}
-	else
+	else if(m_llLastUpdate != 0)
 	{
-		// Get the time difference since last update in microseconds
-		wxLongLong llDiffTime = llUpdateTime - m_llLastUpdate;
-
-		// Transform microseconds to seconds
-		double dTimeDiff = llDiffTime.ToDouble() * 0.000001f;
-
-		// Keep update time
-		m_llLastUpdate = llUpdateTime;
+		lDiffTime = (llTime - m_llLastUpdate).ToLong();
+	}
+	m_uiLastDroneTime = uiDroneTime;
+	m_llLastUpdate = llTime;
 
-		// Calculate angle over pi/180 to get value in radian
-		double dAngleOverPi = dDroneAngle360 * dPIover180;
+	// Home has been reset
+	if(m_bPoseReset.exchange(false))
+	{
+		m_Estimator.Reset(m_bHomeGps, m_dHomeLatitude, m_dHomeLongitude);
+	}
 
-		// Get vectors from current angle
-		double dVectorY = cos(dAngleOverPi);
-		double dVectorX = sin(dAngleOverPi);
+	// Do not predict over a lost link, the velocity is unknown there
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	if(lDiffTime > 0)
+	{
+		m_Estimator.Predict((lDiffTime < lPoseLostTime ? lDiffTime : lPoseLostTime) * 0.000001f);
+	}
+	m_Estimator.Correct(Input);
+	long lCost = (long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
 
-		// Average forward and lateral speed
-		double dForwardSpeed = (dVelocityForward+m_dLastVelocityForward)/2.0f;
-		double dLateralSpeed = (dVelocitySide+m_dLastVelocityLateral)/2.0f;
+	// Statistics of the navdata stream
+	if(lDiffTime > lPoseGapTime)
+	{
+		m_ulPoseGaps++;
+	}
+	if(lDiffTime > m_lPoseGapMax)
+	{
+		m_lPoseGapMax = lDiffTime;
+	}
+	if(lCost > m_lPoseCostMax)
+	{
+		m_lPoseCostMax = lCost;
+	}
+	m_llPoseCostSum += lCost;
+	m_lPoseCount++;
+	if(llTime - m_llPoseStatsTime >= 1000000)
+	{
+		if(m_llPoseStatsTime != 0)
+		{
+			m_dPoseRate = m_lPoseCount * 1000000.0f / (llTime - m_llPoseStatsTime).ToDouble();
+			m_lPoseGapLast = m_lPoseGapMax;
+			m_lPoseCostAvg = (long)(m_llPoseCostSum / m_lPoseCount);
+			m_lPoseCostLast = m_lPoseCostMax;
+		}
+		m_lPoseCount = 0;
+		m_lPoseGapMax = 0;
+		m_llPoseCostSum = 0;
+		m_lPoseCostMax = 0;
+		m_llPoseStatsTime = llTime;
+	}
+	m_ulPoseRejected = m_Estimator.GetRejected();
+
+	// Publish the new position, readers retry while the sequence is odd or has changed
+	m_uiPoseSequence.fetch_add(1, std::memory_order_acq_rel);
+	double dX = m_Estimator.GetState(EST_X);
+	double dY = m_Estimator.GetState(EST_Y);
+	m_dPoseX.store(dX, std::memory_order_relaxed);
+	m_dPoseY.store(dY, std::memory_order_relaxed);
+	m_dPoseDistance.store(sqrt((dX*dX) + (dY*dY)), std::memory_order_relaxed);
+	m_dPoseAltitude.store(m_Estimator.GetState(EST_Z), std::memory_order_relaxed);
+	m_dPoseAccuracy.store(m_Estimator.GetAccuracy(), std::memory_order_relaxed);
+	m_dPoseBias.store(m_Estimator.GetState(EST_BIAS)*d180overPI, std::memory_order_relaxed);
+	m_uiPoseSequence.fetch_add(1, std::memory_order_release);
+}
 
-		// Save current velocity
-		m_dLastVelocityForward = dVelocityForward;
-		m_dLastVelocityLateral = dVelocitySide;
 
-		// Direction * Speed * Time
-		m_dPositionY += dVectorY*dForwardSpeed*dTimeDiff;
-		m_dPositionX += dVectorX*dForwardSpeed*dTimeDiff;
+//////////////////////////////////////////////////////////////////////////////
+// Get the estimated position, without lock
+//////////////////////////////////////////////////////////////////////////////
+// [OUT] : Position in meters from home
+//////////////////////////////////////////////////////////////////////////////
+void CAutoPilot::GetPose(sPose& Pose)
+{
+	// Home has just been reset, the navdata thread has not seen it yet
+	if(m_bPoseReset)
+	{
+		Pose.dX = Pose.dY = Pose.dDistance = Pose.dAltitude = Pose.dAccuracy = Pose.dHeadingBias = 0.0f;
+		return;
+	}
 
-		// Add 90 to add also side moves
-		dAngleOverPi = (dDroneAngle360 + 90.0f) * dPIover180;
+	unsigned int uiSequence;
+	do
+	{
+		uiSequence = m_uiPoseSequence.load(std::memory_order_acquire);
+		Pose.dX = m_dPoseX.load(std::memory_order_relaxed);
+		Pose.dY = m_dPoseY.load(std::memory_order_relaxed);
+		Pose.dDistance = m_dPoseDistance.load(std::memory_order_relaxed);
+		Pose.dAltitude = m_dPoseAltitude.load(std::memory_order_relaxed);
+		Pose.dAccuracy = m_dPoseAccuracy.load(std::memory_order_relaxed);
+		Pose.dHeadingBias = m_dPoseBias.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	while( (uiSequence & 1) || (uiSequence != m_uiPoseSequence.load(std::memory_order_relaxed)) );
+}
 
-		// Do same calculation for dVelocityY !
-		dVectorY = cos(dAngleOverPi);
-		dVectorX = sin(dAngleOverPi);
-	
-		m_dPositionY += dVectorY*dLateralSpeed*dTimeDiff;
-		m_dPositionX += dVectorX*dLateralSpeed*dTimeDiff;
 
-		// Estimate the distance to the drone in meters
-		m_dDistance = sqrt((m_dPositionX*m_dPositionX) + (m_dPositionY*m_dPositionY));
-	}
+//////////////////////////////////////////////////////////////////////////////
+// Get the statistics of the dead-reckoning
+//////////////////////////////////////////////////////////////////////////////
+// [OUT] : Rate and gaps of the navdata
+//////////////////////////////////////////////////////////////////////////////
+void CAutoPilot::GetPoseStats(sPoseStats& Stats)
+{
+	Stats.dRate = m_dPoseRate;
+	Stats.lGapMax = m_lPoseGapLast;
+	Stats.ulGaps = m_ulPoseGaps;
+	Stats.lCostAvg = m_lPoseCostAvg;
+	Stats.lCostMax = m_lPoseCostLast;
+	Stats.ulRejected = m_ulPoseRejected;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////
-// Find out the way to go home
+// Read the gains of the return to home
+// Called when connecting and when the options are changed, so they can be tuned between two flights
 //////////////////////////////////////////////////////////////////////////////
-void CAutoPilot::ComputeWayToHome(double& dRotationSpeed, double& dMovementSpeed, double& dAltitudeSpeed)
+void CAutoPilot::LoadGains()
 {
-	wxCriticalSectionLocker Lock(m_CSAutoPilot);
+	const sPidGains* apDefaults[3] = { &HomeHeadingGains, &HomeDistanceGains, &HomeAltitudeGains };
+	const char* aszAxis[3] = { "Heading", "Distance", "Altitude" };
 
-	// Drone is less than 3 meters away
-	if(m_dDistance < 3.0f)
+	// The file is read without the lock, the control loop keeps running meanwhile
+	sPidGains aGains[3];
+	for(int i=0; i<3; i++)
 	{
-		// If the drone is high, bring him down
-		if(m_dCurrentAltitude > 3.0f)
-		{
-			dAltitudeSpeed = -0.25f;
-		}
-		else
-		{
-			dAltitudeSpeed = 0.0f;
-		}
-	
-		// The drone is very close, nothing more to do
-		if( m_dDistance < 1.0f )
-		{
-			dRotationSpeed = 0.0f;
-			dMovementSpeed = 0.0f;
-			return;
-		}
-	}
-	else
-	{
-		// The drone is still far away, so if the drone is lower than max altitude, let him go up
-		if(m_dCurrentAltitude < m_dMaxAltitude)
-		{
-			dAltitudeSpeed = 0.25f;
-		}
-		else if(m_dCurrentAltitude > (m_dMaxAltitude+1.5f))
+		aGains[i] = *apDefaults[i];
+		if(!LoadPidGains(aszAxis[i], aGains[i]))
 		{
-			// If the drone is too high (1.5 meters over max) bring him down
-			dAltitudeSpeed = -0.25f;
+			// Write the defaults, as a starting point for the tuning
+			SavePidGains(aszAxis[i], aGains[i]);
 		}
 	}
 
-	if(m_bHasGps)
-	{
-		// First, get the vector to home
-		double dVectY = m_dStartLatitude - m_dCurrentLatitude;
-		double dVectX = m_dStartLongitude - m_dCurrentLongitude;
+	SetGains(aGains[0], aGains[1], aGains[2]);
+}
 
-		// Get the absolute home angle, needed to go home
-		m_dCurrentHomeAngle = GetAngle360(atan2(dVectX, dVectY)*d180overPI);
-	}
-	else
+
+//////////////////////////////////////////////////////////////////////////////
+// Change the gains of the return to home (the state of the controllers is kept)
+//////////////////////////////////////////////////////////////////////////////
+void CAutoPilot::SetGains(const sPidGains& HeadingGains, const sPidGains& DistanceGains, const sPidGains& AltitudeGains)
+{
+	wxCriticalSectionLocker Lock(m_CSAutoPilot);
+	m_PidHeading.SetGains(HeadingGains);
+	m_PidDistance.SetGains(DistanceGains);
+	m_PidAltitude.SetGains(AltitudeGains);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Start the return to home
+//////////////////////////////////////////////////////////////////////////////
+void CAutoPilot::ResetWayToHome()
+{
+	wxCriticalSectionLocker Lock(m_CSAutoPilot);
+
+	m_PidHeading.Reset();
+	m_PidDistance.Reset();
+	m_PidAltitude.Reset();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Find out the way to go home
+// Note: the controllers have a state, only call it from the control loop
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Period of the control loop in seconds
+// [OUT] : Moves to send to the drone
+//////////////////////////////////////////////////////////////////////////////
+void CAutoPilot::ComputeWayToHome(double dTime, double& dRotationSpeed, double& dMovementSpeed, double& dAltitudeSpeed)
+{
+	// Position X.Y is the vector to the drone (gps is already fused in it), to get the vector to home, we need to invert the direction
+	// Warning : X position is first !!
+	sPose Pose;
+	GetPose(Pose);
+
+	wxCriticalSectionLocker Lock(m_CSAutoPilot);
+
+	// Far away, fly at the max altitude reached by the user, close to home come down to 3 meters
+	double dTargetAltitude = m_dMaxAltitude;
+	if( (m_dDistance < 3.0f) && (dTargetAltitude > 3.0f) )
 	{
-		// Position X.Y is the vector to the drone, to get the vector to home, we need to invert the direction
-		// Warning : X position is first !!
-		m_dCurrentHomeAngle = GetAngle360(atan2(-m_dPositionX, -m_dPositionY)*d180overPI);		
+		dTargetAltitude = 3.0f;
 	}
+	dAltitudeSpeed = m_PidAltitude.Update(dTargetAltitude, m_dCurrentAltitude, dTime);
+
+	// Look at home, with the heading of the drone corrected by the estimated bias
+	m_dCurrentHomeAngle = GetAngle360(atan2(-Pose.dX, -Pose.dY)*d180overPI);
+	dRotationSpeed = m_PidHeading.Update(m_dCurrentHomeAngle, GetAngle360(m_dCurrentAngleDrone-Pose.dHeadingBias), dTime);
 
-	// Find out if the drone is looking in the right direction
-	dRotationSpeed = GetAngle180(m_dCurrentHomeAngle-m_dCurrentAngleDrone);
+	// Distance is controlled as its opposite: the error is the distance, and the output a forward move
+	dMovementSpeed = m_PidDistance.Update(0.0f, -m_dDistance, dTime);
 
-	// Get the importance of rotation
-	double dRotValue = abs(dRotationSpeed);
-	if( dRotValue > 25.0f )
+	// Only go forward when looking at home, slower while the heading is not right
+	double dAngleError = fabs(m_PidHeading.GetError());
+	if(dAngleError > dHomeMaxAngle)
 	{
-		// The angle is higher than 25, stop the drone mouvement and turn it until he looks at the right direction
 		dMovementSpeed = 0.0f;
-		if(dRotationSpeed > 0.5f)
-		{
-			dRotationSpeed = 0.5f;
-		}
-		else if(dRotationSpeed < -0.5f)
-		{
-			dRotationSpeed = -0.5f;
-		}
 	}
 	else
 	{
-		// Get rotation speed to use, exple: 20/100 = 0.2, 5/100 = 0.05
-		dRotationSpeed = dRotationSpeed/100.0f;
-		// Get movement speed to use, exple: (30-20)/100 = 0.1, (30-5)/100 = 0.25;
-		dMovementSpeed = (30.0f - dRotValue)/100.0f;
+		dMovementSpeed *= cos(dAngleError*dPIover180);
 	}
 
-	// If the drone is close to landing point, avoid high speed
-	if( dMovementSpeed > 0.09f )
+	// The drone is very close, nothing more to do
+	if(m_dDistance < 1.0f)
 	{
-		if(m_dDistance < 2.0f)
-		{
-			dMovementSpeed = 0.05f;
-		}
-		else if(m_dDistance < 4.0f)
-		{
-			dMovementSpeed = 0.075f;
-		}
-		else if(m_dDistance < 6.0f)
-		{
-			dMovementSpeed = 0.1f;
-		}
+		dRotationSpeed = 0.0f;
+		dMovementSpeed = 0.0f;
 	}
 }
 
@@ -280,12 +408,16 @@ double CAutoPilot::GetDistance()
 //////////////////////////////////////////////////////////////////////////////
 double CAutoPilot::GetProperty(eDBGPROPERTY Property)
 {
+	// The position does not need the lock
+	sPose Pose;
+	GetPose(Pose);
+
 	wxCriticalSectionLocker Lock(m_CSAutoPilot);
 
 	switch(Property)
 	{
-		case DBG_POSITIONX:					return m_dPositionX;						break;
-		case DBG_POSITIONY:					return m_dPositionY;						break;
+		case DBG_POSITIONX:					return Pose.dX;								break;
+		case DBG_POSITIONY:					return Pose.dY;								break;
 		case DBG_ALTITUDE:					return m_dCurrentAltitude;					break;
 		case DBG_ALTITUDEMAX:				return m_dMaxAltitude;						break;
 		case DBG_CURRENTDRONEANGLE:			return m_dCurrentAngleDrone;				break;
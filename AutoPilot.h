@@ -8,6 +8,9 @@
 
 #include "wx/wx.h"
 #include <wx/thread.h>
+#include <atomic>
+#include "Estimator.h"
+#include "Pid.h"
 
 // Properties that can be displayed for debug informations
 enum eDBGPROPERTY
@@ -25,6 +28,46 @@ enum eDBGPROPERTY
 // Radius of the earth in meters
 const double dEarthRadius =  6372795.0f;
 
+// Navdata further apart than this are a gap (us), the estimator does not predict further than lPoseLostTime
+const long lPoseGapTime = 50000L;
+const long lPoseLostTime = 500000L;
+
+// Default gains of the return to home, see PID_GAINS_FILE
+// The forward move is capped at 0.25 (about 1.2 m/s) and proportional under about 1 m, the integral holds the drone against a light wind
+// Raise Max of Distance in PID_GAINS_FILE to come back against stronger winds (simBatch.run checks a cap, see SimBatch.cpp)
+//                                         Kp     Ki     Kd     Kff  Tau  Min    Max   IntMax StepMin Angle
+const sPidGains HomeHeadingGains	= { 0.01,  0.0,   0.002, 0.0, 0.1, -0.5,  0.5,  0.1,   20.0,   true  };	// Degrees to rotation
+const sPidGains HomeDistanceGains	= { 0.2,   0.05,  0.1,   0.0, 0.2,  0.0,  0.25, 0.25,  3.0,    false };	// Meters to forward move
+const sPidGains HomeAltitudeGains	= { 0.25,  0.02,  0.05,  0.0, 0.2, -0.25, 0.25, 0.1,   0.5,    false };	// Meters to vertical move
+
+// No forward move while the heading error is higher (degrees)
+const double dHomeMaxAngle = 25.0;
+
+// Vertical move of the pilot kept under the altitude limit (m), the drone is brought down above it
+double LimitAltitudeMove(double dAltitude, double dMaxAltitude, double dVertical);
+
+// Position estimated from the navdata, in meters from home
+struct sPose
+{
+	double	dX;
+	double	dY;
+	double	dDistance;
+	double	dAltitude;
+	double	dAccuracy;		// One sigma, horizontal
+	double	dHeadingBias;	// Degrees
+};
+
+// Statistics of the estimation
+struct sPoseStats
+{
+	double			dRate;		// Navdata integrated per second
+	long			lGapMax;	// Longest time between two navdata during the last second (us)
+	unsigned long	ulGaps;		// Number of times navdata were more than lPoseGapTime apart
+	long			lCostAvg;	// Time spent in the estimator per navdata during the last second (ns)
+	long			lCostMax;
+	unsigned long	ulRejected;	// Measurements rejected by the estimator since home
+};
+
 class CAutoPilot
 {
 public:
@@ -34,16 +77,31 @@ public:
 	~CAutoPilot();
 
 	// Reset all values
-	void ResetAutoPilot(wxLongLong llUpdateTime = 0, bool bHasGps = false, double dStartLatitude = 0.0f, double dStartLongitude = 0.0f);
+	void ResetAutoPilot(bool bHasGps = false, double dStartLatitude = 0.0f, double dStartLongitude = 0.0f);
 
 	// Update specific informations for GPS
 	void UpdateGps(double dLatitude, double dLongitude);
 
 	// Update drone informations
-	void Update(const wxLongLong llUpdateTime, double dDroneAngle360, double dVelocityForward, double dVelocitySide, double dAltitude, bool bAutopilotIsOn=false);	
+	void Update(double dDroneAngle360, double dAltitude, bool bAutopilotIsOn=false);
+
+	// Estimate the position with one navdata (called by the navdata thread for each navdata)
+	void Integrate(unsigned int uiDroneTime, const sEstimatorInput& Input);
+
+	// Estimated position and statistics, can be read from any thread without lock
+	void GetPose(sPose& Pose);
+	void GetPoseStats(sPoseStats& Stats);
 
-	// Find out the way to go home
-	void ComputeWayToHome(double& dRotationSpeed, double& dMovementSpeed, double& dAltitudeSpeed);	
+	// Read the gains of the return to home from PID_GAINS_FILE (file access, not from the control loop)
+	void LoadGains();
+	// Change the gains of the return to home
+	void SetGains(const sPidGains& HeadingGains, const sPidGains& DistanceGains, const sPidGains& AltitudeGains);
+
+	// Start the return to home (resets the controllers)
+	void ResetWayToHome();
+
+	// Find out the way to go home, called at the fixed period dTime (s) of the control loop
+	void ComputeWayToHome(double dTime, double& dRotationSpeed, double& dMovementSpeed, double& dAltitudeSpeed);
 
 	// Gps status
 	bool HasGps();
@@ -82,17 +140,46 @@ private:
 	// The flag to identify if a GPS is present or not
 	bool				m_bHasGps;
 
-// For RTH based on sensors	
-	// Last forward velocity
-	double				m_dLastVelocityForward;
-	// Last lateral velocity
-	double				m_dLastVelocityLateral;
-	// Position X in mm from starting point
-	double				m_dPositionX;
-	// Position Y in mm from starting point
-	double				m_dPositionY;
-	// Last update time in microseconds
+// Controllers of the return to home
+	CPid				m_PidHeading;
+	CPid				m_PidDistance;
+	CPid				m_PidAltitude;
+
+// Estimation of the position, only used by the navdata thread
+	// Filter fusing sensors and gps
+	CEstimator			m_Estimator;
+	// Time of the last navdata in microseconds
 	wxLongLong			m_llLastUpdate;
+	// Last time sent by the drone (0 = the drone does not send it)
+	unsigned int		m_uiLastDroneTime;
+	// Navdata counted for the statistics and start of the period
+	long				m_lPoseCount;
+	long				m_lPoseGapMax;
+	long long			m_llPoseCostSum;
+	long				m_lPoseCostMax;
+	wxLongLong			m_llPoseStatsTime;
+
+// Published pose (one writer, lock free readers)
+	// Odd while the navdata thread writes the values
+	std::atomic<unsigned int>	m_uiPoseSequence;
+	std::atomic<double>			m_dPoseX;
+	std::atomic<double>			m_dPoseY;
+	std::atomic<double>			m_dPoseDistance;
+	std::atomic<double>			m_dPoseAltitude;
+	std::atomic<double>			m_dPoseAccuracy;
+	std::atomic<double>			m_dPoseBias;
+	// Set by ResetAutoPilot() after the home coordinates, the navdata thread restarts from 0
+	std::atomic<bool>			m_bPoseReset;
+	std::atomic<bool>			m_bHomeGps;
+	std::atomic<double>			m_dHomeLatitude;
+	std::atomic<double>			m_dHomeLongitude;
+	// Statistics
+	std::atomic<double>			m_dPoseRate;
+	std::atomic<long>			m_lPoseGapLast;
+	std::atomic<unsigned long>	m_ulPoseGaps;
+	std::atomic<long>			m_lPoseCostAvg;
+	std::atomic<long>			m_lPoseCostLast;
+	std::atomic<unsigned long>	m_ulPoseRejected;
 
 // For RTH based on gps
 	// The latitude of the starting point (y)
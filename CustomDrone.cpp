@@ -10,6 +10,16 @@
 /////////////////////////////////////////////////////////////////////////////
 CCustomDrone::CCustomDrone():ARDrone()
 {
+	// Keep the configuration of each drone
+	setConfigCache("Data/Config");
+
+	// No error text yet
+	m_uiErrorState = 0;
+	m_bErrorTextValid = false;
+
+	m_pAutoPilot = NULL;
+	m_pGeofence = NULL;
+	m_pLatencyTrace = NULL;
 }
 
 
@@ -58,6 +68,14 @@ wxString CCustomDrone::GetErrorText()
 	unsigned int uiState =navdata.ardrone_state;
     if (mutexCommand) pthread_mutex_unlock(mutexNavdata);
 
+	// Same errors as the last call, no need to look for the text again
+	uiState &= (ARDRONE_MOTORS_MASK | ARDRONE_CUTOUT_MASK | ARDRONE_ANGLES_OUT_OF_RANGE | ARDRONE_ULTRASOUND_MASK |
+				ARDRONE_COM_LOST_MASK | ARDRONE_COM_WATCHDOG_MASK | ARDRONE_EMERGENCY_MASK | ARDRONE_USER_EL | ARDRONE_VBAT_LOW);
+	if(m_bErrorTextValid && (uiState == m_uiErrorState))
+	{
+		return m_strErrorText;
+	}
+
 	wxString strError = "";
 
 	// Get corresponding text
@@ -98,10 +116,23 @@ wxString CCustomDrone::GetErrorText()
 		strError = GetText("ErrorBattery");
 	}
 
+	m_uiErrorState = uiState;
+	m_strErrorText = strError;
+	m_bErrorTextValid = true;
+
 	return strError;
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+// Forget the last error text, the next call of GetErrorText() reads it again
+/////////////////////////////////////////////////////////////////////////////
+void CCustomDrone::ResetErrorText()
+{
+	m_bErrorTextValid = false;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Check if we have an usb key that we can use for record
 /////////////////////////////////////////////////////////////////////////////
@@ -224,32 +255,124 @@ void CCustomDrone::GetHorizontalVelocity(double& dX, double& dY)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+// Flight plan settings of the drone, values not set by the drone are left unchanged
+//////////////////////////////////////////////////////////////////////////////
+void CCustomDrone::GetFlightPlan(double& dRadius, double& dTime, double& dMaxDistance)
+{
+	// The configuration is refreshed by another thread
+	if (mutexCommand) pthread_mutex_lock(mutexCommand);
+	ARDRONE_CONFIG::FLIGHT_PLAN FlightPlan = config.flightplan;
+	if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+
+	if(FlightPlan.default_validation_radius > 0.0f)
+	{
+		dRadius = FlightPlan.default_validation_radius;
+	}
+	if(FlightPlan.default_validation_time > 0.0f)
+	{
+		dTime = FlightPlan.default_validation_time;
+	}
+	if(FlightPlan.max_distance_from_takeoff > 0)
+	{
+		dMaxDistance = FlightPlan.max_distance_from_takeoff;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the autopilot fed with every navdata
+//////////////////////////////////////////////////////////////////////////////
+void CCustomDrone::SetAutoPilot(CAutoPilot* pAutoPilot)
+{
+	m_pAutoPilot = pAutoPilot;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the geofence checked with every navdata
+//////////////////////////////////////////////////////////////////////////////
+void CCustomDrone::SetGeofence(CGeofence* pGeofence)
+{
+	m_pGeofence = pGeofence;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the trace of the input latency
+//////////////////////////////////////////////////////////////////////////////
+void CCustomDrone::SetLatencyTrace(CLatencyTrace* pLatencyTrace)
+{
+	m_pLatencyTrace = pLatencyTrace;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Called by the navdata thread for each navdata
+// The position is integrated at the rate of the navdata, not at the one of the control loop
+//////////////////////////////////////////////////////////////////////////////
+void CCustomDrone::navdataArrived(void)
+{
+	// First navdata showing a traced move
+	if(NULL != m_pLatencyTrace)
+	{
+		m_pLatencyTrace->NavdataArrived(navdata.demo.phi * 0.001, navdata.demo.theta * 0.001);
+	}
+
+	if(NULL == m_pAutoPilot)
+	{
+		return;
+	}
+
+	// Only this thread writes navdata, no need to lock (gps block only parsed with firmware 2.4)
+	sEstimatorInput Input;
+	NavdataToEstimatorInput(navdata, (version.major == 2) && (version.minor == 4), Input);
+
+	m_pAutoPilot->Integrate(navdata.time.time, Input);
+
+	// Check the new position, with the heading corrected by the estimated bias
+	if(NULL != m_pGeofence)
+	{
+		sPose Pose;
+		m_pAutoPilot->GetPose(Pose);
+		m_pGeofence->Update(Pose.dX, Pose.dY, Input.dYaw - Pose.dHeadingBias);
+	}
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 // Set video codec to use
 //////////////////////////////////////////////////////////////////////////////
 void CCustomDrone::SetVideoCodec(eVideoCodec VideoCodec)
 {
-	if (version.major == ARDRONE_VERSION_2) 
+	wxString strCodec = wxString::Format("%d", VideoCodec);
+
+	// Not connected yet, the codec will be sent on open() if needed
+	if(!mutexCommand)
 	{
-        // Finalize video
-        finalizeVideo();
+		storeConfig("video:video_codec", strCodec.ToAscii());
+		return;
+	}
 
-		if (mutexCommand) pthread_mutex_lock(mutexCommand);;
+	if (version.major == ARDRONE_VERSION_2) 
+	{
+		// The drone already streams with this codec, no need to restart the video
+		pthread_mutex_lock(mutexCommand);
+		int iCurrentCodec = config.video.video_codec;
+		pthread_mutex_unlock(mutexCommand);
+		if(iCurrentCodec == VideoCodec)
+		{
+			storeConfig("video:video_codec", strCodec.ToAscii());
+			return;
+		}
 
         // Output video with selected codec
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", seq++, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", seq++, VideoCodec);
-        
-		if (mutexCommand) pthread_mutex_unlock(mutexCommand);;
-		
-		msleep(100);
+		setConfig("video:video_codec", strCodec.ToAscii());
 
-        // Initialize video
-		if(0 == initVideo())
+        // Reopen the stream, the decoder and the buffers are kept if possible
+		if(0 == restartVideo())
 		{
-			DoLog("Failed to restart video after codec change, watchdog should catch this", MSG_ERROR);
-			// TODO: change watchdog way
-			//bNeedVideoRestart = true;
+			DoLog("Failed to restart video after codec change, reconnect to the drone", MSG_ERROR);
 		}
     }
 }
@@ -273,12 +396,8 @@ void CCustomDrone::SetMaxAltitude(long lMaxAltitude)
 
 	DoLog(wxString::Format("Set max altitude to %d m (%d mm)", lMaxAltitude/1000, lMaxAltitude));
 
-	if (mutexCommand) pthread_mutex_lock(mutexCommand);;
-	sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", seq++, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-	sockCommand.sendf("AT*CONFIG=%d,\"control:altitude_max\",\"%d\"\r",  seq++, lMaxAltitude);
-	if (mutexCommand) pthread_mutex_unlock(mutexCommand);;
-
-	msleep(100);
+	// Only sent if the drone holds another value
+	setConfig("control:altitude_max", wxString::Format("%d", lMaxAltitude).ToAscii());
 }
 
 
@@ -287,6 +406,12 @@ void CCustomDrone::SetMaxAltitude(long lMaxAltitude)
 /////////////////////////////////////////////////////////////////////////////
 void CCustomDrone::CustomMove(float fX, float fY, float fZ, float fR)
 {
+	// Stay in the geofence, whoever is flying
+	if(NULL != m_pGeofence)
+	{
+		m_pGeofence->Limit(fX, fY);
+	}
+
 	// Flight mode (0 = hovering)
 	int iMode = ( (fabs(fX) > 0.0) || (fabs(fY) > 0.0) );
 
@@ -296,6 +421,12 @@ void CCustomDrone::CustomMove(float fX, float fY, float fZ, float fR)
 	if (mutexCommand) pthread_mutex_lock(mutexCommand);;
 	sockCommand.sendf("AT*PCMD=%d,%d,%d,%d,%d,%d\r", seq++, iMode, *(int*)(&fX), *(int*)(&fY), *(int*)(&fZ), *(int*)(&fR));
 	if (mutexCommand) pthread_mutex_unlock(mutexCommand);;
+
+	// The command has left the socket
+	if(NULL != m_pLatencyTrace)
+	{
+		m_pLatencyTrace->CommandSent(fX, fY);
+	}
 }
 
 
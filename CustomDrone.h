@@ -7,6 +7,9 @@
 
 
 #include "AppConfig.h"	// Codecs also defined here
+#include "AutoPilot.h"
+#include "Geofence.h"
+#include "LatencyTrace.h"
 #include "ardrone/ardrone.h"
 
 // Our drone inherits from the default drone class
@@ -22,6 +25,8 @@ public:
 
 	// Get the error text of the drone
 	wxString GetErrorText();
+	// Forget the last error text (language change)
+	void ResetErrorText();
 
 	// Check if we have an usb key that we can use for record
 	bool HasUsbKey();
@@ -63,6 +68,33 @@ public:
 
 	// Get current gps angle. Note: The angle is only correct when the drone is moving !!
 	double GetGpsAngle();
+
+	// Flight plan settings of the drone (validation radius and time, maximum distance from take off)
+	void GetFlightPlan(double& dRadius, double& dTime, double& dMaxDistance);
+
+	// Autopilot fed with every navdata (set before connecting)
+	void SetAutoPilot(CAutoPilot* pAutoPilot);
+	// Geofence checked with each navdata and limiting the moves (set before connecting)
+	void SetGeofence(CGeofence* pGeofence);
+	// Trace of the input changes up to the drone, told of the moves sent and of the attitude (set before connecting)
+	void SetLatencyTrace(CLatencyTrace* pLatencyTrace);
+
+protected:
+	// Called by the navdata thread for each navdata
+	virtual void navdataArrived(void);
+
+private:
+	// Autopilot doing the dead-reckoning
+	CAutoPilot*		m_pAutoPilot;
+	// Geofence evaluated at the estimated position
+	CGeofence*		m_pGeofence;
+	// Input latency trace
+	CLatencyTrace*	m_pLatencyTrace;
+
+	// Error bits of the last GetErrorText() call and their text
+	unsigned int	m_uiErrorState;
+	bool			m_bErrorTextValid;
+	wxString		m_strErrorText;
 };
 
 #endif
\ No newline at end of file
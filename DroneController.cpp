@@ -4,10 +4,12 @@
 
 #include <wx/dcbuffer.h>
 #include <wx/tokenzr.h>
+#include <wx/filename.h>
 
 #include "DroneController.h"
 #include "Utils.h"
 #include "AppConfig.h"
+#include "Log.h"
 #include "AboutDialog.h"
 #include "ConfigDialog.h"
 #include "JoystickDialog.h"
@@ -38,7 +40,11 @@ enum
 	MENU_FULLSCREEN,
 	MENU_CAMERA,
 	MENU_HOME,
-	MENU_HOMERESET
+	MENU_HOMERESET,
+	MENU_MISSIONLOAD,
+	MENU_MISSIONSTART,
+	MENU_MISSIONPAUSE,
+	MENU_MISSIONABORT
 };
 
 
@@ -54,19 +60,8 @@ bool CMainApp::OnInit()
 		g_bDebug = true;
 	}
 
-	// Save up to 2 log files
-	if(wxFileExists("Data/Log/Errors2.log"))
-	{
-		wxRemoveFile("Data/Log/Errors2.log");
-	}
-	if(wxFileExists("Data/Log/Errors1.log"))
-	{
-		wxRenameFile("Data/Log/Errors1.log", "Data/Log/Errors2.log");
-	}
-	if(wxFileExists("Data/Log/Errors.log"))
-	{
-		wxRenameFile("Data/Log/Errors.log", "Data/Log/Errors1.log");
-	}
+	// Start the log (a new file is used on each start, up to 2 older ones are kept)
+	CLog::CreateSingleton()->SetMinLevel(g_bDebug ? MSG_DEBUG : MSG_INFO);
 
 	DoLog("--------------------------------------------------------------");	
 	DoLog(VersionString);
@@ -112,6 +107,8 @@ bool CMainApp::OnInit()
 
 	// Needed for PNG files (used for transparancy)
 	wxImage::AddHandler(new wxPNGHandler);
+	// Screenshots in JPEG
+	wxImage::AddHandler(new wxJPEGHandler);
 
 	CDroneController* pDroneApp = new CDroneController(VersionString);
 	if(NULL == pDroneApp)
@@ -138,6 +135,9 @@ bool CMainApp::OnInit()
 int CMainApp::OnExit()
 {
 	CConfig::KillSingleton();
+
+	// Write the last messages
+	CLog::KillSingleton();
 	return 0;
 }
 
@@ -166,6 +166,10 @@ BEGIN_EVENT_TABLE(CDroneController, wxFrame)
 	EVT_MENU(MENU_CAMERA, CDroneController::OnCamera)
 	EVT_MENU(MENU_HOME, CDroneController::OnHome)
 	EVT_MENU(MENU_HOMERESET, CDroneController::OnHomeReset)
+	EVT_MENU(MENU_MISSIONLOAD, CDroneController::OnMissionLoad)
+	EVT_MENU(MENU_MISSIONSTART, CDroneController::OnMissionStart)
+	EVT_MENU(MENU_MISSIONPAUSE, CDroneController::OnMissionPause)
+	EVT_MENU(MENU_MISSIONABORT, CDroneController::OnMissionAbort)
 #ifdef wxHAS_POWER_EVENTS
 	EVT_POWER_SUSPENDING(CDroneController::OnSleep)
 #endif
@@ -221,6 +225,13 @@ CDroneController::CDroneController(const wxString& title) : wxFrame(NULL, wxID_A
 	pSubMenuConfig->Append( MENU_JOYSTICK, GetText("ConfigJoy") );
 	pSubMenuConfig->Append( MENU_IPADDRESS, GetText("ConfigIp") );
 
+	// Create the mission sub menu
+	wxMenu *pSubMenuMission = new wxMenu;
+	pSubMenuMission->Append( MENU_MISSIONLOAD, GetText("MissionLoad") );
+	pSubMenuMission->Append( MENU_MISSIONSTART, GetText("MissionStart") );
+	pSubMenuMission->Append( MENU_MISSIONPAUSE, GetText("MissionPause") );
+	pSubMenuMission->Append( MENU_MISSIONABORT, GetText("MissionAbort") );
+
 	// Create the sub menu
 	wxMenu *pSubMenuAbout = new wxMenu;
 	pSubMenuAbout->Append( MENU_ABOUT, GetText("About") );
@@ -228,6 +239,7 @@ CDroneController::CDroneController(const wxString& title) : wxFrame(NULL, wxID_A
     m_pMenu = new wxMenuBar(wxBORDER_NONE);
     m_pMenu->Append( pSubMenuMain, GetText("Main") );
 	m_pMenu->Append( pSubMenuConfig, GetText("Config") );
+	m_pMenu->Append( pSubMenuMission, GetText("Mission") );
 	m_pMenu->Append( pSubMenuAbout, "?" );
 
     SetMenuBar( m_pMenu );
@@ -290,9 +302,6 @@ CDroneController::CDroneController(const wxString& title) : wxFrame(NULL, wxID_A
 	// Set the unit text to the current unit set in config
 	SetUnitText();
 
-	// OpenCv video writer
-	m_pVideoWriter		= NULL;
-
 	if(!GetPngFromRessource("PngWifiGreen", m_WifiGreenBitmap))
 	{
 		DoLog("Failed to load the green wifi image", MSG_ERROR);
@@ -336,11 +345,35 @@ CDroneController::CDroneController(const wxString& title) : wxFrame(NULL, wxID_A
 		DoLog("Failed to load the Home image", MSG_ERROR);
 	}
 
-	// Init time
-	m_llNextFrameTime = 0;
-
 	// Init mouse movement
 	m_ucKeepAwake = 0;
+
+	// Init link statistics
+	memset(&m_LinkStats, 0, sizeof(m_LinkStats));
+
+	// Init control loop
+	m_pControlThread	= NULL;
+	m_lControlLateMax	= 0;
+	m_lControlLateAvg	= 0;
+	m_lControlDuration	= 0;
+	m_ulControlOverruns	= 0;
+	m_ulTracedChanges	= 0;
+
+	// Init rendering
+	m_ulFrameCount		= 0;
+	m_ulCapturedFrame	= 0;
+	m_iBurstLeft		= 0;
+	m_bHudDirty			= true;
+	m_lMinRenderTime	= 0;
+	m_lDisplayFps		= 0;
+	m_lDecodedFps		= 0;
+
+	// Init HUD layers
+	m_bHudStaticDirty	= true;
+	m_lTimeFrameLayer	= 0;
+	m_lTimeHudLayer		= 0;
+	m_lTimeDebugLayer	= 0;
+	m_lDebugTextTime	= -lDebugTextPeriod;
 	
 	// Pause watch as we want to count only flying time
 	m_WatchFlyingTime.Pause();
@@ -381,13 +414,22 @@ CDroneController::CDroneController(const wxString& title) : wxFrame(NULL, wxID_A
 /////////////////////////////////////////////////////////////////////////////
 CDroneController::~CDroneController()
 {
-	DoLog("Cleaning Main Frame instance");
+	DoLogDebug("Cleaning Main Frame instance");
 
-	// Stop the worker thread
+	// Stop the control thread, then the render thread
+	if(NULL != m_pControlThread)
+	{
+		m_pControlThread->Delete();
+		delete m_pControlThread;
+		m_pControlThread = NULL;
+	}
 	if(NULL != m_thread)
 	{
 		m_thread->Delete();
 	}
+
+	// Write the last pictures
+	m_PictureWriter.Stop();
 	
 	// Disconnect size events
 	m_pPanel->Disconnect(wxEVT_SIZE, wxSizeEventHandler( CDroneController::OnResize ), NULL, this);
@@ -415,7 +457,7 @@ CDroneController::~CDroneController()
 /////////////////////////////////////////////////////////////////////////////
 bool CDroneController::DoInit()
 {
-	DoLog("Initialize main frame");
+	DoLogDebug("Initialize main frame");
 
 	// Calculate positions
 	int X=0,Y=0;
@@ -439,10 +481,24 @@ bool CDroneController::DoInit()
 		return false;	
 	}
 
+	// The pictures are written by their own thread
+	m_PictureWriter.Start();
+
+	// Create and start the control thread
+	m_pControlThread = new CControlThread(this);
+	if(m_pControlThread->Run() != wxTHREAD_NO_ERROR)
+	{
+		DoLog("Failed to start the control thread !", MSG_ERROR);
+		DoMessage(GetText("AppLoadFailed"), MSG_ERROR);
+		delete m_pControlThread;
+		m_pControlThread = NULL;
+		return false;
+	}
+
 	// Init the timer
 	m_Timer.SetOwner(this, TIMER_UPDATE);
 
-	DoLog("Main frame initialized");
+	DoLogDebug("Main frame initialized");
 
 	return true;
 }
@@ -501,6 +557,17 @@ bool CDroneController::Connect()
 		// Reset all keys
 		m_Input.ResetFlag((eKey)0xFFFF);
 
+		// Desired configurations, only the ones that differ are sent while connecting
+		m_Drone.SetVideoCodec(CConfig::GetSingleton()->GetVideoCodec());
+		m_Drone.SetMaxAltitude(CConfig::GetSingleton()->GetAltitudeLimit());
+
+		// Dead-reckoning at the rate of the navdata, the gains of the return to home may have been tuned
+		m_AutoPilot.LoadGains();
+		m_Drone.SetAutoPilot(&m_AutoPilot);
+		LoadGeofence(true);
+		m_Drone.SetGeofence(&m_Geofence);
+		m_Drone.SetLatencyTrace(&m_LatencyTrace);
+
 		// Init the drone and connect to it
 		if(!m_Drone.open(CConfig::GetSingleton()->GetIpAddress().ToAscii()))
 		{
@@ -513,9 +580,6 @@ bool CDroneController::Connect()
 			return false;
 		}
 
-		// Send max altitude to the drone
-		m_Drone.SetMaxAltitude(CConfig::GetSingleton()->GetAltitudeLimit());
-
 		// Set the flag to connected
 		SetStatus(STATE_CONNECTEDTODRONE);
 
@@ -556,6 +620,12 @@ bool CDroneController::Connect()
 		}
 		*/
 
+		// Statistics of the link start from 0 on each connection
+		m_Drone.getLinkStats(&m_LinkStats);
+
+		// Keep the last seconds of video for the next recording
+		m_Drone.setPreRecord(CConfig::GetSingleton()->GetPreRecordTime(), (size_t)CConfig::GetSingleton()->GetPreRecordMemory() * 1024 * 1024);
+
 		// Start the timer
 		if(!m_Timer.Start(2000))
 		{
@@ -605,6 +675,9 @@ bool CDroneController::Disconnect()
 		// Close connection to the drone
 		m_Drone.close();
 
+		// Delays of the input of this connection
+		m_LatencyTrace.Export(LATENCY_FILE);
+
 		// Reset the status bar text
 		m_pStatusBar->SetStatusText("", 1);
 		m_pStatusBar->SetStatusText("", 2);
@@ -677,6 +750,93 @@ void CDroneController::StopRecord()
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+// Switch between windowed and fullscreen
+// Note: asked by the control thread, run by the GUI thread
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::ToggleFullScreen()
+{
+	// Switch status
+	if(HasStatus(STATE_FULLSCREEN))
+	{
+		/*if(CConfig::GetSingleton()->UseLowRes())
+		{
+			m_ScreenManager.ResetResolution();
+		}*/
+		ResetStatus(STATE_FULLSCREEN);
+	}
+	else
+	{
+		/*if(CConfig::GetSingleton()->UseLowRes())
+		{
+			m_ScreenManager.SetLowResolution();
+		}*/
+		SetStatus(STATE_FULLSCREEN);
+	}
+	
+	// Apply changes
+	ShowFullScreen(HasStatus(STATE_FULLSCREEN));
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Start or stop recording
+// Note: asked by the control thread, run by the GUI thread
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::ToggleRecord()
+{
+	// Disconnected meanwhile
+	if(!HasStatus(STATE_CONNECTEDTODRONE))
+	{
+		return;
+	}
+
+	// Note: Recording flags are already managed in the called functions
+	if(HasStatus(STATE_RECORDING))
+	{
+		StopRecord();
+	}
+	else
+	{
+		StartRecord();
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Write the delays of the input
+// Note: asked by the control thread, run by the GUI thread
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::ExportLatency()
+{
+	m_LatencyTrace.Export(LATENCY_FILE);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Load the geofence if its file has changed (or always)
+// Note: file access, not from the control thread
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::LoadGeofence(bool bForce)
+{
+	wxFileName FenceFile(GEOFENCE_FILE);
+	wxDateTime FileTime;
+	if(FenceFile.FileExists())
+	{
+		FileTime = FenceFile.GetModificationTime();
+	}
+
+	// Same file (or still no file)
+	if( !bForce && (FileTime.IsValid() == m_GeofenceTime.IsValid()) && (!FileTime.IsValid() || (FileTime == m_GeofenceTime)) )
+	{
+		return;
+	}
+
+	m_GeofenceTime = FileTime;
+	m_Geofence.Load(GEOFENCE_FILE);
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Connect to the drone
 /////////////////////////////////////////////////////////////////////////////
@@ -750,6 +910,42 @@ void CDroneController::OnTimerUpdate(wxTimerEvent& WXUNUSED(event))
 	{
 		DoLog("Failed to update wifi signal !", MSG_ERROR);
 	}*/
+
+	// Log dropouts of the link, the drone reconnects the failed channels itself
+	if(HasStatus(STATE_CONNECTEDTODRONE))
+	{
+		ARDRONE_LINK_STATS Stats;
+		m_Drone.getLinkStats(&Stats);
+
+		if(Stats.navdataLosses != m_LinkStats.navdataLosses)
+		{
+			DoLog(wxString::Format("Navdata link lost (%d times since connection)", Stats.navdataLosses), MSG_WARNING);
+		}
+		if(Stats.videoLosses != m_LinkStats.videoLosses)
+		{
+			DoLog(wxString::Format("Video link lost, reconnecting (%d times since connection)", Stats.videoLosses), MSG_WARNING);
+		}
+		if(Stats.lastReconnectTime != m_LinkStats.lastReconnectTime)
+		{
+			DoLog(wxString::Format("Link back after %.2f s (longest dropout %.2f s)", Stats.lastReconnectTime, Stats.maxReconnectTime));
+		}
+
+		m_LinkStats = Stats;
+
+		// The zones of the geofence can be edited while connected
+		LoadGeofence(false);
+
+		// The copy of the stream stops by itself when the file cannot be written
+		if(HasStatus(STATE_RECORDINGONPC) && !m_Recorder.IsRecording() && !m_Drone.isStreamRecording())
+		{
+			DoLog("The video stream could not be written, recording on pc stopped", MSG_ERROR);
+			StopPCRecording();
+			if(!HasStatus(STATE_RECORDINGONUSB))
+			{
+				ResetStatus(STATE_RECORDING);
+			}
+		}
+	}
 	
 	// Play sound if authorized
 	if( CConfig::GetSingleton()->HasSoundFlag() )
@@ -839,13 +1035,26 @@ void CDroneController::OnConfig(wxCommandEvent& WXUNUSED(event))
 		m_HudPen	= wxPen(m_HudColor, CConfig::GetSingleton()->GetHudLineSize());
 		m_HudBrush	= wxBrush(m_HudColor, wxBRUSHSTYLE_TRANSPARENT);
 
+		// Style, color or line size may have changed
+		m_bHudStaticDirty = true;
+		m_bHudDirty = true;
+
 		m_CSDrawing.Leave();
+
+		// The gains of the return to home may have been tuned meanwhile
+		m_AutoPilot.LoadGains();
 		
 		if(HasStatus(STATE_CONNECTEDTODRONE))
 		{
 			// Send max altitude to the drone
 			m_Drone.SetMaxAltitude(CConfig::GetSingleton()->GetAltitudeLimit());
 
+			// Size of the video kept before a recording (the copy of the stream uses it when it starts)
+			if(!HasStatus(STATE_RECORDINGONPC))
+			{
+				m_Drone.setPreRecord(CConfig::GetSingleton()->GetPreRecordTime(), (size_t)CConfig::GetSingleton()->GetPreRecordMemory() * 1024 * 1024);
+			}
+
 			// If recording is active, don't send the new codec to the drone:
 			// - Pc  : Opencv expect a fixed image size for recording 
 			// - Usb : Sending another codec will disable recording
@@ -1069,7 +1278,78 @@ void CDroneController::OnHomeReset(wxCommandEvent& WXUNUSED(event))
 		m_Drone.GetGpsPosition(dLat, dLon);
 	}
 
-	m_AutoPilot.ResetAutoPilot(m_Watch.TimeInMicro(), bHasGps, dLat, dLon);
+	m_AutoPilot.ResetAutoPilot(bHasGps, dLat, dLon);
+	m_Geofence.SetHome(bHasGps, dLat, dLon);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Load a mission file
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::OnMissionLoad(wxCommandEvent& WXUNUSED(event))
+{
+	if(m_Mission.IsActive())
+	{
+		DoLog("A mission is running, abort it before loading another one", MSG_WARNING);
+		return;
+	}
+
+	wxFileDialog Dialog(this, GetText("MissionLoad"), MISSION_DIR, wxEmptyString, "*.txt", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+	if(wxID_OK != Dialog.ShowModal())
+	{
+		return;
+	}
+
+	// The flight plan of the drone gives the default tolerance, hold time and maximum distance
+	double dTolerance = dMissionTolerance;
+	double dHoldTime = 0.0f;
+	double dMaxDistance = 0.0f;
+	if(HasStatus(STATE_CONNECTEDTODRONE))
+	{
+		m_Drone.GetFlightPlan(dTolerance, dHoldTime, dMaxDistance);
+	}
+
+	m_Mission.Load(Dialog.GetPath(), dTolerance, dHoldTime, dMaxDistance, m_dMaxAltitude);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Start the loaded mission
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::OnMissionStart(wxCommandEvent& WXUNUSED(event))
+{
+	if( !HasStatus(STATE_CONNECTEDTODRONE) || m_Drone.onGround() )
+	{
+		DoLog("The drone must fly to start a mission", MSG_WARNING);
+		return;
+	}
+
+	if(m_Mission.Start())
+	{
+		// The mission replaces the return to home
+		ResetStatus(STATE_RETURNHOMEACTIVE);
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Pause or resume the mission
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::OnMissionPause(wxCommandEvent& WXUNUSED(event))
+{
+	if(!m_Mission.Pause())
+	{
+		m_Mission.Resume();
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Abort the mission, the drone hovers
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::OnMissionAbort(wxCommandEvent& WXUNUSED(event))
+{
+	m_Mission.Abort();
 }
 
 
@@ -1098,6 +1378,10 @@ void CDroneController::SetLimits()
 
 	// Set altitude limit to the helper object
 	m_dMaxAltitude = (double)CConfig::GetSingleton()->GetAltitudeLimit();
+
+	// Minimum time between two displayed images
+	long lMaxFps = CConfig::GetSingleton()->GetMaxDisplayFps();
+	m_lMinRenderTime = (lMaxFps > 0) ? (1000 / lMaxFps) : 0;
 }
 
 
@@ -1110,6 +1394,18 @@ void CDroneController::ComputePositions(int iPanelWidth, int iPanelHeight)
 
 	m_iPanelWidth = iPanelWidth;
 	m_iPanelHeight = iPanelHeight;
+	m_bHudDirty = true;
+	m_bHudStaticDirty = true;
+
+	// Image displayed in the panel, the wxImage uses the buffer of the scaler
+	if(m_FrameScaler.SetDestination(m_iPanelWidth, m_iPanelHeight))
+	{
+		m_Image.SetData(m_FrameScaler.GetData(), m_iPanelWidth, m_iPanelHeight, true);
+	}
+	else
+	{
+		m_Image.Destroy();
+	}
 
 	// Screen middle
 	m_iMiddleX = m_iPanelWidth / 2;
@@ -1141,244 +1437,348 @@ void CDroneController::ComputePositions(int iPanelWidth, int iPanelHeight)
 
 
 /////////////////////////////////////////////////////////////////////////////
-// The code executed by the thread (main loop)
+// The code executed by the thread (render loop)
 /////////////////////////////////////////////////////////////////////////////
 wxThread::ExitCode CDroneController::Entry()
 {
+	long			lLastRender		= 0;
+	long			lRendered		= 0;
+	long			lLastSecond		= m_Watch.Time();
+	unsigned long	ulLastSecondFrame	= m_Drone.getFrameCount();
+
 	while(!m_thread->TestDestroy())
 	{
-		// Update the key status
-		m_Input.Update(m_Watch.Time());
+		long lNow = m_Watch.Time();
+		long lElapsed = lNow - lLastRender;
 
-		// Only if drone is connected
-		if(HasStatus(STATE_CONNECTEDTODRONE))
+		// Draw when a new image has been decoded or the HUD changed, navdata values are refreshed at least every 100 ms
+		unsigned long ulFrame = m_Drone.getFrameCount();
+		bool bNewFrame = (ulFrame != m_ulFrameCount);
+		if( (bNewFrame || m_bHudDirty || (lElapsed >= 100)) && (lElapsed >= m_lMinRenderTime) )
+		{
+			m_bHudDirty = false;
+			m_ulFrameCount = ulFrame;
+			DoRender(bNewFrame);
+			lLastRender = lNow;
+			lRendered++;
+		}
+		// Images that are not displayed are still recorded and captured (burst at the decoding rate)
+		else if(bNewFrame && (ulFrame != m_ulCapturedFrame) && (HasStatus(STATE_RECORDINGONPC) || (m_iBurstLeft > 0) || m_Input.HasFlag(KEY_SCREENSHOT)))
 		{
-			// Check if an update is needed
-			if(m_Input.IsUpdateNeeded())
+			long long llFrameTime = 0;
+			unsigned long ulImage = m_Drone.getFrameCount(&llFrameTime);
+			IplImage* pImg = m_Drone.getImage();
+			if( (NULL != pImg) && (0 < pImg->width) && (0 < pImg->height) )
 			{
-				// Emergency has been pressed
-				if(m_Input.HasFlag(KEY_EMERGENCY))
-				{
-					m_Drone.emergency();
-					m_Input.ResetFlag(KEY_EMERGENCY);
-					DoLog("Emergency mode enabled !");
-				}
+				CaptureFrame(pImg, ulImage, llFrameTime);
+			}
+		}
 
-				// Toggle cameras
-				if(m_Input.HasFlag(KEY_CAMERA))
-				{
-					m_Drone.setCamera(++m_iCameraMode%4);
-					m_Input.ResetFlag(KEY_CAMERA);
-				}
+		// Displayed and decoded images per second
+		if(lNow - lLastSecond >= 1000)
+		{
+			m_lDisplayFps = (lRendered * 1000) / (lNow - lLastSecond);
+			m_lDecodedFps = (long)((ulFrame - ulLastSecondFrame) * 1000) / (lNow - lLastSecond);
+			lRendered = 0;
+			lLastSecond = lNow;
+			ulLastSecondFrame = ulFrame;
+		}
 
-				// Enable/disable return to home
-				if(m_Input.HasFlag(KEY_RETURNHOME))
-				{
-					if(HasStatus(STATE_RETURNHOMEACTIVE))
-					{
-						ResetStatus(STATE_RETURNHOMEACTIVE);
-						DoLog("Return to home disabled");
-					}
-					else
-					{
-						SetStatus(STATE_RETURNHOMEACTIVE);
-						DoLog("Return to home enabled");
-					}
-					m_Input.ResetFlag(KEY_RETURNHOME);
-				}
+		// Let the system responsive
+		msleep(1);
+	}
 
-				// Land and take off
-				if(m_Input.HasFlag(KEY_TAKEOFF))
-				{
-					if(m_Drone.onGround())
-					{
-						DoLog("The drone will take off");
+	DoLogDebug("Main frame thread stopped");
 
-						double	dLat		= 0.0f;
-						double	dLon		= 0.0f;
-						bool	bHasGps		= m_Drone.HasGps();
+	return NULL;
+}
 
-						if(bHasGps)
-						{
-							m_Drone.GetGpsPosition(dLat, dLon);								
-						}
 
-						// This is our new home, sweet home..
-						m_AutoPilot.ResetAutoPilot(m_Watch.TimeInMicro(), bHasGps, dLat, dLon);
+/////////////////////////////////////////////////////////////////////////////
+// The code executed by the control thread
+/////////////////////////////////////////////////////////////////////////////
+wxThread::ExitCode CControlThread::Entry()
+{
+	return m_pOwner->ControlEntry(this);
+}
 
-						m_Drone.takeoff();
 
-						// Start counting flying time
-						m_WatchFlyingTime.Resume();
-						m_bFlyingTimeWachActive = true;
-					}
-					else
-					{
-						DoLog("The drone will land");
+/////////////////////////////////////////////////////////////////////////////
+// The control loop, one step every lControlPeriod
+// Note: a slow redraw does not delay the commands anymore
+/////////////////////////////////////////////////////////////////////////////
+wxThread::ExitCode CDroneController::ControlEntry(wxThread* pThread)
+{
+	wxLongLong llDeadline = m_Watch.TimeInMicro();
+
+	while(!pThread->TestDestroy())
+	{
+		// Delay of this step over its deadline
+		wxLongLong llStart = m_Watch.TimeInMicro();
+		long lLate = (llStart - llDeadline).ToLong();
+		if(lLate > m_lControlLateMax)
+		{
+			m_lControlLateMax = lLate;
+		}
+		long lLateAvg = m_lControlLateAvg;
+		m_lControlLateAvg = lLateAvg + (lLate - lLateAvg) / 16;
 
-						// Stop counting flying time
-						m_WatchFlyingTime.Pause();
-						m_bFlyingTimeWachActive = false;
+		ControlStep();
 
-						m_Drone.landing();
-					}
-					m_Input.ResetFlag(KEY_TAKEOFF);
-				}				
-					
-				if(m_Input.HasFlag(KEY_TRIM))
+		// Wait for the next deadline
+		llDeadline += lControlPeriod;
+		wxLongLong llEnd = m_Watch.TimeInMicro();
+		m_lControlDuration = (llEnd - llStart).ToLong();
+		if(llEnd >= llDeadline)
+		{
+			// Too late, don't try to catch up the missed steps
+			m_ulControlOverruns++;
+			llDeadline = llEnd;
+		}
+		else
+		{
+			wxMicroSleep((llDeadline - llEnd).ToULong());
+		}
+	}
+
+	DoLogDebug("Control thread stopped");
+
+	return NULL;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// The pilot moves one of the sticks/keys
+/////////////////////////////////////////////////////////////////////////////
+bool CDroneController::IsPilotMoving()
+{
+	sInputState State;
+	m_Input.GetState(State);
+
+	return (fabs(State.adDirections[IDX_FORWARD]) > dPilotOverride) || (fabs(State.adDirections[IDX_SIDE]) > dPilotOverride)
+		|| (fabs(State.adDirections[IDX_TURN]) > dPilotOverride) || (fabs(State.adDirections[IDX_ALTITUDE]) > dPilotOverride);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// One step of the control loop: input, autopilot and commands
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::ControlStep()
+{
+	// Update the key status
+	m_Input.Update(m_Watch.TimeInMicro());
+
+	// Only if drone is connected
+	if(HasStatus(STATE_CONNECTEDTODRONE))
+	{
+		// Check if an update is needed
+		if(m_Input.IsUpdateNeeded())
+		{
+			// Emergency has been pressed
+			if(m_Input.TakeFlag(KEY_EMERGENCY))
+			{
+				m_Drone.emergency();
+				m_Mission.Abort();
+				DoLog("Emergency mode enabled !");
+			}
+
+			// Toggle cameras
+			if(m_Input.TakeFlag(KEY_CAMERA))
+			{
+				m_Drone.setCamera(++m_iCameraMode%4);
+			}
+
+			// Enable/disable return to home
+			if(m_Input.TakeFlag(KEY_RETURNHOME))
+			{
+				// A running mission is aborted, the drone comes back home
+				if(m_Mission.IsActive())
 				{
-					if(m_Drone.onGround())
-					{
-						DoLog("Trim will be started");
-						// If drone is on ground, do a trim
-						m_Drone.Trim();
-					}
-					else
-					{
-						DoLog("Calibration will be started");
-						// If drone is flying, start calibration
-						m_Drone.Calibrate();
-					}
-					m_Input.ResetFlag(KEY_TRIM);
+					m_Mission.Abort();
 				}
 
-				// View has been toggled between windowed and fullscreen
-				if(m_Input.HasFlag(KEY_FULLSCREEN))
+				if(HasStatus(STATE_RETURNHOMEACTIVE))
 				{
-					// Switch status
-					if(HasStatus(STATE_FULLSCREEN))
-					{
-						/*if(CConfig::GetSingleton()->UseLowRes())
-						{
-							m_ScreenManager.ResetResolution();
-						}*/
-						ResetStatus(STATE_FULLSCREEN);
-					}
-					else
-					{
-						/*if(CConfig::GetSingleton()->UseLowRes())
-						{
-							m_ScreenManager.SetLowResolution();
-						}*/
-						SetStatus(STATE_FULLSCREEN);
-					}
-					
-					// Apply changes and reset key flag
-					this->ShowFullScreen(HasStatus(STATE_FULLSCREEN));
-					m_Input.ResetFlag(KEY_FULLSCREEN);
+					ResetStatus(STATE_RETURNHOMEACTIVE);
+					DoLog("Return to home disabled");
+				}
+				else
+				{
+					m_AutoPilot.ResetWayToHome();
+					SetStatus(STATE_RETURNHOMEACTIVE);
+					DoLog("Return to home enabled");
 				}
+			}
 
-				// Toggle recording
-				if(m_Input.HasFlag(KEY_RECORD))
+			// Land and take off
+			if(m_Input.TakeFlag(KEY_TAKEOFF))
+			{
+				if(m_Drone.onGround())
 				{
-					// Note: Recording flags are already managed in the called functions
-					if(HasStatus(STATE_RECORDING))
-					{
-						StopRecord();
-					}
-					else
+					DoLog("The drone will take off");
+
+					double	dLat		= 0.0f;
+					double	dLon		= 0.0f;
+					bool	bHasGps		= m_Drone.HasGps();
+
+					if(bHasGps)
 					{
-						StartRecord();
+						m_Drone.GetGpsPosition(dLat, dLon);								
 					}
-					m_Input.ResetFlag(KEY_RECORD);
+
+					// This is our new home, sweet home..
+					m_AutoPilot.ResetAutoPilot(bHasGps, dLat, dLon);
+
+					// The zones of the geofence are placed from home
+					m_Geofence.SetHome(bHasGps, dLat, dLon);
+
+					m_Drone.takeoff();
+
+					// Start counting flying time
+					m_WatchFlyingTime.Resume();
+					m_bFlyingTimeWachActive = true;
 				}
-			}
-			
-			if( m_Drone.onGround() )
-			{
-				// Drone on ground, check if FlyingTime watch still running (unexpected "landing"...)
-				if(m_bFlyingTimeWachActive)
+				else
 				{
-					DoLog("Flying timer active while drone on ground, timer will be stopped", MSG_WARNING);
+					DoLog("The drone will land");
+
+					// Stop counting flying time
 					m_WatchFlyingTime.Pause();
 					m_bFlyingTimeWachActive = false;
-				}
-			}
-			else // Move the drone if he is flying
-			{				
-				bool bIsAutopilotOn = HasStatus(STATE_RETURNHOMEACTIVE);
-				
-				double dVelX		= 0.0f;
-				double dVelY		= 0.0f;
-				double dLat			= 0.0f;
-				double dLon			= 0.0f;
-				double dAlt			= m_Drone.getAltitude();
-				
-				m_Drone.GetHorizontalVelocity(dVelX, dVelY);
 
-				// Update the gps informations if available
-				if(m_AutoPilot.HasGps())
-				{
-					m_Drone.GetGpsPosition(dLat, dLon);
+					m_Mission.Abort();
+					m_Drone.landing();
 
-					m_AutoPilot.UpdateGps(dLat, dLon);
+					// Delays of the input of this flight, the file is written by the GUI thread
+					CallAfter(&CDroneController::ExportLatency);
 				}
-
-				// Update the autopilot with the new drone info
-				m_AutoPilot.Update(m_Watch.TimeInMicro(), m_Drone.getYawDeg(), dVelX, dVelY, dAlt, bIsAutopilotOn);
-
-				if(bIsAutopilotOn)
+			}				
+				
+			if(m_Input.TakeFlag(KEY_TRIM))
+			{
+				if(m_Drone.onGround())
 				{
-					double dRotation	= 0.0f;
-					double dSpeed		= 0.0f;
-					double dAltitude	= 0.0f;
-					
-					// Return to home is active, compute the way to home
-					m_AutoPilot.ComputeWayToHome(dRotation, dSpeed, dAltitude);
-
-					// Transmit values to drone
-					m_Drone.CustomMove(0.0f, (float)dSpeed, (float)dAltitude, (float)dRotation);
+					DoLog("Trim will be started");
+					// If drone is on ground, do a trim
+					m_Drone.Trim();
 				}
 				else
 				{
-					double dAltVector = 0.0f;
+					DoLog("Calibration will be started");
+					// If drone is flying, start calibration
+					m_Drone.Calibrate();
+				}
+			}
 
-					// Check altitude limit
-					if(dAlt < m_dMaxAltitude)
-					{
-						 dAltVector = m_Input.GetDirectionValue(IDX_ALTITUDE);
-					}
-					else
-					{
-						// Altitude has reach, or is over max altitude, bring the drone down
-						double dAltDiff = dAlt - m_dMaxAltitude;
-						if(dAltDiff > 10.0f)
-						{
-							dAltVector = -0.75f;	// Drone flying away ??
-						}
-						else if(dAltDiff > 5.0f)
-						{
-							dAltVector = -0.5f;
-						}
-						else
-						{
-							dAltVector = -0.20f;
-						}
-					}
+			// View has been toggled between windowed and fullscreen (window calls are for the GUI thread)
+			if(m_Input.TakeFlag(KEY_FULLSCREEN))
+			{
+				CallAfter(&CDroneController::ToggleFullScreen);
+			}
 
-					// Move the drone
-					m_Drone.CustomMove(m_Input.GetDirectionValue(IDX_SIDE), m_Input.GetDirectionValue(IDX_FORWARD), dAltVector, m_Input.GetDirectionValue(IDX_TURN));
-				}
+			// Toggle recording (the recorders are started and stopped by the GUI thread)
+			if(m_Input.TakeFlag(KEY_RECORD))
+			{
+				CallAfter(&CDroneController::ToggleRecord);
 			}
 		}
+		
+		if( m_Drone.onGround() )
+		{
+			// Drone on ground, check if FlyingTime watch still running (unexpected "landing"...)
+			if(m_bFlyingTimeWachActive)
+			{
+				DoLog("Flying timer active while drone on ground, timer will be stopped", MSG_WARNING);
+				m_WatchFlyingTime.Pause();
+				m_bFlyingTimeWachActive = false;
+			}
 
-		// Draw the new image
-		DoRender();
+			// No mission on ground
+			m_Mission.Abort();
+		}
+		else // Move the drone if he is flying
+		{				
+			bool bIsAutopilotOn = HasStatus(STATE_RETURNHOMEACTIVE);
+			
+			double dLat			= 0.0f;
+			double dLon			= 0.0f;
+			double dAlt			= m_Drone.getAltitude();
 
-		// Let the system responsive
-		msleep(1);
-	}
+			// Update the gps informations if available
+			if(m_AutoPilot.HasGps())
+			{
+				m_Drone.GetGpsPosition(dLat, dLon);
+
+				m_AutoPilot.UpdateGps(dLat, dLon);
+			}
 
-	DoLog("Main frame thread stopped");
+			// Update the autopilot with the new drone info (the position is integrated by the navdata thread)
+			m_AutoPilot.Update(m_Drone.getYawDeg(), dAlt, bIsAutopilotOn);
 
-	return NULL;
+			if(bIsAutopilotOn)
+			{
+				double dRotation	= 0.0f;
+				double dSpeed		= 0.0f;
+				double dAltitude	= 0.0f;
+				
+				// Return to home is active, compute the way to home
+				m_AutoPilot.ComputeWayToHome(lControlPeriod * 0.000001f, dRotation, dSpeed, dAltitude);
+
+				// Transmit values to drone
+				m_Drone.CustomMove(0.0f, (float)dSpeed, (float)dAltitude, (float)dRotation);
+			}
+			else if(m_Mission.IsActive() && !IsPilotMoving())
+			{
+				// Position of the estimator, heading corrected by its bias
+				sPose Pose;
+				m_AutoPilot.GetPose(Pose);
+
+				sMissionInput MissionInput;
+				MissionInput.dX = Pose.dX;
+				MissionInput.dY = Pose.dY;
+				MissionInput.dAltitude = dAlt;
+				MissionInput.dHeading = m_Drone.getYawDeg() - Pose.dHeadingBias;
+
+				// One step per control period, a paused mission hovers
+				sMissionMove Move;
+				m_Mission.Step(MissionInput, lControlPeriod * 0.000001f, Move);
+
+				// Keep the altitude limit, the drone is brought down above it
+				Move.fVertical = (float)LimitAltitudeMove(dAlt, m_dMaxAltitude, Move.fVertical);
+				m_Drone.CustomMove(Move.fSide, Move.fForward, Move.fVertical, Move.fRotation);
+			}
+			else
+			{
+				// The pilot takes over a running mission
+				m_Mission.Pause();
+
+				// All directions of the same update
+				sInputState InputState;
+				m_Input.GetState(InputState);
+
+				// Trace a new change of the input up to the drone
+				if(InputState.ulChanges != m_ulTracedChanges)
+				{
+					m_ulTracedChanges = InputState.ulChanges;
+					m_LatencyTrace.Start(InputState.llChange, InputState.llUpdate);
+				}
+
+				// Check altitude limit
+				double dAltVector = LimitAltitudeMove(dAlt, m_dMaxAltitude, InputState.adDirections[IDX_ALTITUDE]);
+
+				// Move the drone
+				m_Drone.CustomMove(InputState.adDirections[IDX_SIDE], InputState.adDirections[IDX_FORWARD], dAltVector, InputState.adDirections[IDX_TURN]);
+			}
+		}
+	}
 }
 
 
 /////////////////////////////////////////////////////////////////////////////
 // Draw the main panel with camera capture
+// bNewFrame: the video thread has decoded a new image since the last call
 /////////////////////////////////////////////////////////////////////////////
-bool CDroneController::DoRender()
+bool CDroneController::DoRender(bool bNewFrame)
 {	
 	// Client device context -> Draw on the panel
 	wxClientDC DC(m_pPanel);
@@ -1408,97 +1808,44 @@ bool CDroneController::DoRender()
 
 	if(HasStatus(STATE_CONNECTEDTODRONE))
 	{
-		// If we have no image, display only navdata info
-		bool bHasImage = true;
+		wxLongLong llStart = m_Watch.TimeInMicro();
 
-		// Get an image
-		IplImage* pImg = m_Drone.getImage();
-		if( (NULL == pImg) || (0 >= pImg->width) || (0 >= pImg->height) )
+		// The static layer of the HUD changed (size, style or color), it is part of the image
+		bool bStaticChanged = false;
+		if(m_bHudStaticDirty)
 		{
-			// Could not access to an image
-			bHasImage = false;
+			wxCriticalSectionLocker Lock(m_CSDrawing);
+			BuildHUDStatic();
+			bStaticChanged = true;
 		}
 
-		if(bHasImage)
+		// Convert the image only when a new one has been decoded or the panel has been resized
+		if(bNewFrame || bStaticChanged || !m_FrameBitmap.IsOk() || (m_FrameBitmap.GetWidth() != m_iPanelWidth) || (m_FrameBitmap.GetHeight() != m_iPanelHeight))
 		{
-			// Only needed for recording on pc
-			if(HasStatus(STATE_RECORDINGONPC))
-			{
-				// We want to record a frame every 40 ms, so check if this time is elapsed
-				wxLongLong llCurrentTime = m_Watch.TimeInMicro();
-
-				if( llCurrentTime >  m_llNextFrameTime)
-				{
-					// Target frame time reached, compute next frame time
-					wxLongLong llDiffTime = llCurrentTime-m_llNextFrameTime;
-
-					// In case of big difference don't calculate the target time, as it would be a time in the passt
-					if(llDiffTime > 39000)
-					{
-						// Add 20 ms to current time
-						m_llNextFrameTime = llCurrentTime + 20000;
-					}
-					else
-					{
-						// Next frame time = current time + expected 40 ms - time over expected time (difference time)
-						m_llNextFrameTime = llCurrentTime + 40000 - llDiffTime;
-					}
-
-					m_CSVideo.Enter();
-
-					// Check if the writer still exit, as it may have been destroyed while waiting for critical section
-					if(NULL != m_pVideoWriter)
-					{
-						cvWriteFrame(m_pVideoWriter, pImg);
-					}
-			
-					m_CSVideo.Leave();
-				}
-			}
-
-			// Convert colors from BGR (opencv) to RGB (wxwidgets)
-			cvCvtColor((CvArr*)pImg, (CvArr*)pImg, CV_BGR2RGB);	
-
-			// Set new data to the wxImage
-			m_Image.SetData((unsigned char*)pImg->imageData, pImg->width, pImg->height, true);
-
-			if(!m_Image.IsOk())
-			{
-				DoLog("Could not transform drone image to wxImage !", MSG_ERROR);
-				return false;
-			}
-
-			// Screenshot requested, save current image to file as .png
-			if(m_Input.HasFlag(KEY_SCREENSHOT))
-			{
-				m_Input.ResetFlag(KEY_SCREENSHOT);
-
-                time_t rawtime;
-                struct tm * timeinfo;
-				time ( &rawtime );
-                timeinfo = localtime ( &rawtime );
-				if(!m_Image.SaveFile(wxString::Format("Media/Pictures/Pic_%s.png", asctime (timeinfo)), wxBITMAP_TYPE_PNG))
-				{
-					DoLog("Failed to take screenshot", MSG_ERROR);
-				}
-			}
+			UpdateFrame();
+		}
 
-			// Set the bitmap to the panel
-			if( (m_iPanelWidth != pImg->width) || (m_iPanelHeight != pImg->height) )
-			{
-				BufferedDC.DrawBitmap(wxBitmap(m_Image.Scale(m_iPanelWidth, m_iPanelHeight)), 0, 0);
-			}
-			else
-			{
-				BufferedDC.DrawBitmap(wxBitmap(m_Image), 0, 0);
-			}
+		// Image and static HUD in one blit
+		BufferedDC.SetPen(m_HudPen);
+		BufferedDC.SetBrush(m_HudBrush);
+		if(m_FrameBitmap.IsOk())
+		{
+			BufferedDC.DrawBitmap(m_FrameBitmap, 0, 0);
 		}
 		else
 		{
 			// Clear the DC before status and other informations are displayed
 			BufferedDC.Clear();
+
+			// No image to carry the static layer, draw it
+			wxCriticalSectionLocker Lock(m_CSDrawing);
+			BufferedDC.SetFont(FontBold12);
+			BufferedDC.SetTextForeground(m_HudColor);
+			DrawHUDStatic(BufferedDC);
 		}
 
+		wxLongLong llFrame = m_Watch.TimeInMicro();
+
 		// In all cases, draw status informations
 		DrawStatus(BufferedDC);
 
@@ -1510,19 +1857,30 @@ bool CDroneController::DoRender()
 		{
 			DrawHUD2(BufferedDC);
 		}
-		DrawDebugInfo(BufferedDC);
 
 		// Check if the drone has an error status
 		if(m_Drone.HasError())
 		{
-			// Set big font, red color and display the message
-			BufferedDC.SetFont(FontBold18);
-			BufferedDC.SetTextForeground(ColorRed);
-			BufferedDC.DrawLabel(m_Drone.GetErrorText(), m_ErrorRect, wxALIGN_CENTRE);
+			// Big font, red color
+			m_ErrorText.Set(m_Drone.GetErrorText(), FontBold18, ColorRed);
+			m_ErrorText.DrawCentered(BufferedDC, m_ErrorRect);
 		}
+
+		wxLongLong llHud = m_Watch.TimeInMicro();
+
+		BufferedDC.SetTextForeground(m_HudColor);
+		DrawDebugInfo(BufferedDC);
+
+		// Time spent in each layer
+		m_lTimeFrameLayer	= (llFrame - llStart).ToLong();
+		m_lTimeHudLayer		= (llHud - llFrame).ToLong();
+		m_lTimeDebugLayer	= (m_Watch.TimeInMicro() - llHud).ToLong();
 	}
 	else
 	{
+		// The last image must not be shown on the next connection
+		m_FrameBitmap = wxNullBitmap;
+
 		BufferedDC.Clear();
 		BufferedDC.SetFont(FontBold12);
 		BufferedDC.SetTextForeground(ColorBlack);
@@ -1537,6 +1895,81 @@ bool CDroneController::DoRender()
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+// Convert the current image of the drone into the bitmap to display
+/////////////////////////////////////////////////////////////////////////////
+bool CDroneController::UpdateFrame()
+{
+	// Get an image and the time it has arrived
+	long long llFrameTime = 0;
+	unsigned long ulFrame = m_Drone.getFrameCount(&llFrameTime);
+	IplImage* pImg = m_Drone.getImage();
+	if( (NULL == pImg) || (0 >= pImg->width) || (0 >= pImg->height) )
+	{
+		// Could not access to an image, display only navdata info
+		m_FrameBitmap = wxNullBitmap;
+		return false;
+	}
+
+	// Recording and screenshots
+	CaptureFrame(pImg, ulFrame, llFrameTime);
+
+	// The buffers belong to the panel size, they are reallocated by ComputePositions()
+	wxCriticalSectionLocker Lock(m_CSDrawing);
+
+	// Convert colors from BGR (opencv) to RGB (wxwidgets) and scale to the panel in one pass
+	// Note: the image of the drone is only read, it is also used for recording
+	if(!m_Image.IsOk() || !m_FrameScaler.Convert((unsigned char*)pImg->imageData, pImg->width, pImg->height, pImg->widthStep))
+	{
+		DoLog("Could not transform drone image to wxImage !", MSG_ERROR);
+		m_FrameBitmap = wxNullBitmap;
+		return false;
+	}
+
+	// Add the static layer of the HUD
+	ApplyHUDStatic(m_FrameScaler.GetData());
+
+	m_FrameBitmap = wxBitmap(m_Image);
+
+	return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Give a new image of the drone to the recorder and the picture writer
+// Both have their own thread, only the copy of the image is done here
+/////////////////////////////////////////////////////////////////////////////
+// [IN] : The image, its number and arrival time (us)
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::CaptureFrame(IplImage* pImg, unsigned long ulFrame, long long llFrameTime)
+{
+	// Each decoded image only once (UpdateFrame() is also called after a resize)
+	if(ulFrame == m_ulCapturedFrame)
+	{
+		return;
+	}
+	m_ulCapturedFrame = ulFrame;
+
+	// Recording on pc
+	if(HasStatus(STATE_RECORDINGONPC))
+	{
+		m_Recorder.Push(pImg, llFrameTime);
+	}
+
+	// Screenshot requested, start a burst (1 image by default, in the size of the drone image)
+	if(m_Input.TakeFlag(KEY_SCREENSHOT))
+	{
+		m_iBurstLeft = wxMax(1, CConfig::GetSingleton()->GetBurstCount());
+	}
+
+	if(m_iBurstLeft > 0)
+	{
+		m_iBurstLeft--;
+		m_PictureWriter.Push((unsigned char*)pImg->imageData, pImg->width, pImg->height, pImg->widthStep, PictureFormat_Jpeg == CConfig::GetSingleton()->GetPictureFormat());
+	}
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Draw status informations (battery, wifi...)
 /////////////////////////////////////////////////////////////////////////////
@@ -1544,36 +1977,33 @@ void CDroneController::DrawStatus(wxDC& dc)
 {
 	wxCriticalSectionLocker Lock(m_CSDrawing);
 
-	// Init font, pen and brush
-	dc.SetFont(FontBold12);
-	dc.SetPen(m_HudPen);
-	dc.SetBrush(m_HudBrush);
-
 	// Battery status (sounds handled in timer)
 	int iBat = m_Drone.getBatteryPercentage();
 	wxBitmap* pBat = NULL;
+	wxColour BatColour;
 
 	if(iBat > iBatWarning)
 	{
-		dc.SetTextForeground(ColorGreen);
+		BatColour = ColorGreen;
 		pBat = &m_BatteryGreenBitmap;
 	}
 	else if(iBat < iBatCritical)
 	{
-		dc.SetTextForeground(ColorRed);
+		BatColour = ColorRed;
 		pBat = &m_BatteryRedBitmap;
 	}
 	else if(iBat < iBatDanger)
 	{
-		dc.SetTextForeground(ColorOrange);
+		BatColour = ColorOrange;
 		pBat = &m_BatteryOrangeBitmap;
 	}
 	else
 	{
-		dc.SetTextForeground(ColorYellow);
+		BatColour = ColorYellow;
 		pBat = &m_BatteryYellowBitmap;
 	}
-	dc.DrawLabel(wxString::Format("%d %%", iBat), *pBat, m_BatteryRect, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL);
+	m_BatteryText.Set(wxString::Format("%d %%", iBat), FontBold12, BatColour);
+	DrawStatusLabel(dc, m_BatteryText, *pBat, m_BatteryRect);
 
     // TODO: wifi signal
 	// Wifi signal quality (sounds handled in Timer update)
@@ -1606,32 +2036,155 @@ void CDroneController::DrawStatus(wxDC& dc)
 	if(HasStatus(STATE_RECORDING))
 	{
 		// Check if recording to pc or to the usb stick into the drone
-		dc.SetTextForeground(ColorRed);
 		if(HasStatus(STATE_RECORDINGONPC) && HasStatus(STATE_RECORDINGONUSB))
 		{
-			dc.DrawLabel("USB+PC", m_RecordBitmap, m_RecordRect, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL);
+			m_RecordText.Set("USB+PC", FontBold12, ColorRed);
 		}
 		else if(HasStatus(STATE_RECORDINGONPC))
 		{
-			dc.DrawLabel("PC", m_RecordBitmap, m_RecordRect, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL);
+			m_RecordText.Set("PC", FontBold12, ColorRed);
 		}
 		else
 		{
-			dc.DrawLabel("USB", m_RecordBitmap, m_RecordRect, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL);
+			m_RecordText.Set("USB", FontBold12, ColorRed);
 		}
+		DrawStatusLabel(dc, m_RecordText, m_RecordBitmap, m_RecordRect);
 	}
 
 	if(HasStatus(STATE_RETURNHOMEACTIVE))
 	{						
 		if(m_AutoPilot.HasGps())
 		{
-			dc.SetTextForeground(ColorGreen);
-			dc.DrawLabel("ON [GPS])", m_HomeBitmap, m_HomeRect, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL);
+			m_HomeText.Set("ON [GPS])", FontBold12, ColorGreen);
+		}
+		else
+		{
+			m_HomeText.Set("ON", FontBold12, ColorOrange);
+		}
+		DrawStatusLabel(dc, m_HomeText, m_HomeBitmap, m_HomeRect);
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Draw an icon followed by its text, vertically centered in a rectangle
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::DrawStatusLabel(wxDC& dc, CHudText& Text, const wxBitmap& Icon, const wxRect& Rect)
+{
+	int iTextX = Rect.x;
+
+	if(Icon.IsOk())
+	{
+		dc.DrawBitmap(Icon, Rect.x, Rect.y + (Rect.height - Icon.GetHeight()) / 2, true);
+		iTextX += Icon.GetWidth() + 4;
+	}
+
+	Text.DrawCentered(dc, wxRect(iTextX, Rect.y, Text.GetWidth(), Rect.height));
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Draw the parts of the HUD which only change with the size or the style
+// Note: the caller holds m_CSDrawing and has set the pen, brush and font
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::DrawHUDStatic(wxDC& dc)
+{
+	if(CConfig::GetSingleton()->GetHudStyle() == 1)
+	{
+		// Draw central panel
+		dc.DrawCircle(m_iMiddleX, m_iMiddleY, m_iRadius);
+
+		// Draw speed and altitude captions
+		dc.DrawLabel("Spd.", m_SpeedInfoTextRect, wxALIGN_CENTRE);
+		dc.DrawLabel("Alt.", m_AltInfoTextRect, wxALIGN_CENTRE);
+	}
+	else
+	{
+		// Draw central cross
+		dc.DrawLine(m_iMiddleX-30, m_iMiddleY, m_iMiddleX+30, m_iMiddleY);
+		dc.DrawLine(m_iMiddleX, m_iMiddleY-10, m_iMiddleX, m_iMiddleY+10);
+
+		// Draw vertical line on left and right
+		dc.DrawLine(m_iMiddleX-m_iRadius, m_iMiddleY-m_iRadius, m_iMiddleX-m_iRadius, m_iMiddleY+m_iRadius);
+		dc.DrawLine(m_iMiddleX+m_iRadius, m_iMiddleY-m_iRadius, m_iMiddleX+m_iRadius, m_iMiddleY+m_iRadius);
+	}
+
+	// Frames of the speed, altitude and direction info
+	dc.DrawRectangle(m_SpeedInfoRect);
+	dc.DrawRectangle(m_AltInfoRect);
+	dc.DrawRectangle(m_DirInfoRect);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Render the static layer of the HUD into a list of pixels
+// Note: the caller holds m_CSDrawing
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::BuildHUDStatic()
+{
+	m_HudStaticPixels.clear();
+	m_bHudStaticDirty = false;
+
+	if( (0 >= m_iPanelWidth) || (0 >= m_iPanelHeight) )
+	{
+		return;
+	}
+
+	// Draw in white on black
+	wxBitmap Bitmap(m_iPanelWidth, m_iPanelHeight, 24);
+	wxMemoryDC dc(Bitmap);
+	dc.SetBackground(*wxBLACK_BRUSH);
+	dc.Clear();
+	dc.SetPen(wxPen(*wxWHITE, m_HudPen.GetWidth()));
+	dc.SetBrush(*wxTRANSPARENT_BRUSH);
+	dc.SetFont(FontBold12);
+	dc.SetTextForeground(*wxWHITE);
+	DrawHUDStatic(dc);
+	dc.SelectObject(wxNullBitmap);
+
+	// Keep the drawn pixels, the grey level is the coverage of the anti-aliased edges
+	wxImage Image = Bitmap.ConvertToImage();
+	const unsigned char* pucData = Image.GetData();
+	int iSize = m_iPanelWidth * m_iPanelHeight * 3;
+	for(int i = 0; i < iSize; i += 3)
+	{
+		if(pucData[i] > 0)
+		{
+			sHudPixel Pixel;
+			Pixel.iOffset = i;
+			Pixel.ucAlpha = pucData[i];
+			m_HudStaticPixels.push_back(Pixel);
+		}
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Draw the static layer of the HUD into a RGB image of the panel size
+// Note: the caller holds m_CSDrawing
+/////////////////////////////////////////////////////////////////////////////
+void CDroneController::ApplyHUDStatic(unsigned char* pucData)
+{
+	unsigned char ucRed = m_HudColor.Red();
+	unsigned char ucGreen = m_HudColor.Green();
+	unsigned char ucBlue = m_HudColor.Blue();
+
+	for(size_t i = 0; i < m_HudStaticPixels.size(); i++)
+	{
+		const sHudPixel& Pixel = m_HudStaticPixels[i];
+		unsigned char* pucPixel = pucData + Pixel.iOffset;
+		if(255 == Pixel.ucAlpha)
+		{
+			pucPixel[0] = ucRed;
+			pucPixel[1] = ucGreen;
+			pucPixel[2] = ucBlue;
 		}
 		else
 		{
-			dc.SetTextForeground(ColorOrange);
-			dc.DrawLabel("ON", m_HomeBitmap, m_HomeRect, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL);
+			// Edge of a line or of a text, blended with the image
+			pucPixel[0] = (unsigned char)(pucPixel[0] + ((ucRed - pucPixel[0]) * Pixel.ucAlpha) / 255);
+			pucPixel[1] = (unsigned char)(pucPixel[1] + ((ucGreen - pucPixel[1]) * Pixel.ucAlpha) / 255);
+			pucPixel[2] = (unsigned char)(pucPixel[2] + ((ucBlue - pucPixel[2]) * Pixel.ucAlpha) / 255);
 		}
 	}
 }
@@ -1639,6 +2192,7 @@ void CDroneController::DrawStatus(wxDC& dc)
 
 /////////////////////////////////////////////////////////////////////////////
 // Draw the basic version of the HUD, and all screen informations
+// Note: the static part is already in the image (see ApplyHUDStatic)
 /////////////////////////////////////////////////////////////////////////////
 void CDroneController::DrawHUD1(wxDC& dc)
 {
@@ -1655,25 +2209,13 @@ void CDroneController::DrawHUD1(wxDC& dc)
 	
 	wxCriticalSectionLocker Lock(m_CSDrawing);
 
-	// Set color for other elements
-	dc.SetTextForeground(m_HudColor);
-
-	// Draw central panel
-	dc.DrawCircle(m_iMiddleX, m_iMiddleY, m_iRadius);
-
-	// Draw speed info
-	dc.DrawLabel(wxString::Format("Spd."), m_SpeedInfoTextRect, wxALIGN_CENTRE);
-	dc.DrawRectangle(m_SpeedInfoRect);
-	dc.DrawLabel(wxString::Format(m_strSpeed, dSpeed), m_SpeedInfoRect, wxALIGN_CENTRE);
-
-	// Draw altitude info
-	dc.DrawLabel(wxString::Format("Alt."), m_AltInfoTextRect, wxALIGN_CENTRE);
-	dc.DrawRectangle(m_AltInfoRect);
-	dc.DrawLabel(wxString::Format(m_strAltitude, dAltitude), m_AltInfoRect, wxALIGN_CENTRE);
-
-	// Draw direction info
-	dc.DrawRectangle(m_DirInfoRect);
-	dc.DrawLabel(wxString::Format("%03.0f", m_Drone.getYawDeg()), m_DirInfoRect, wxALIGN_CENTRE);
+	// Draw speed, altitude and direction info, the texts are only rendered when the values change
+	m_SpeedText.Set(wxString::Format(m_strSpeed, dSpeed), FontBold12, m_HudColor);
+	m_SpeedText.DrawCentered(dc, m_SpeedInfoRect);
+	m_AltText.Set(wxString::Format(m_strAltitude, dAltitude), FontBold12, m_HudColor);
+	m_AltText.DrawCentered(dc, m_AltInfoRect);
+	m_DirText.Set(wxString::Format("%03.0f", m_Drone.getYawDeg()), FontBold12, m_HudColor);
+	m_DirText.DrawCentered(dc, m_DirInfoRect);
 
 	// Draw the artificial horizon
 	double	dPitch	= m_Drone.getPitchDeg();
@@ -1693,6 +2235,7 @@ void CDroneController::DrawHUD1(wxDC& dc)
 
 /////////////////////////////////////////////////////////////////////////////
 // Draw the advanced version of the HUD, and all screen informations
+// Note: the static part is already in the image (see ApplyHUDStatic)
 /////////////////////////////////////////////////////////////////////////////
 void CDroneController::DrawHUD2(wxDC& dc)
 {
@@ -1709,28 +2252,13 @@ void CDroneController::DrawHUD2(wxDC& dc)
 	
 	wxCriticalSectionLocker Lock(m_CSDrawing);
 
-	// Set color for other elements
-	dc.SetTextForeground(m_HudColor);
-
-	// Draw central cross
-	dc.DrawLine(m_iMiddleX-30, m_iMiddleY, m_iMiddleX+30, m_iMiddleY);
-	dc.DrawLine(m_iMiddleX, m_iMiddleY-10, m_iMiddleX, m_iMiddleY+10);
-
-	// Draw vertical line on left and right
-	dc.DrawLine(m_iMiddleX-m_iRadius, m_iMiddleY-m_iRadius, m_iMiddleX-m_iRadius, m_iMiddleY+m_iRadius);
-	dc.DrawLine(m_iMiddleX+m_iRadius, m_iMiddleY-m_iRadius, m_iMiddleX+m_iRadius, m_iMiddleY+m_iRadius);
-
-	// Draw speed info
-	dc.DrawRectangle(m_SpeedInfoRect);
-	dc.DrawLabel(wxString::Format(m_strSpeed, dSpeed), m_SpeedInfoRect, wxALIGN_CENTRE);
-
-	// Draw altitude info
-	dc.DrawRectangle(m_AltInfoRect);
-	dc.DrawLabel(wxString::Format(m_strAltitude, dAltitude), m_AltInfoRect, wxALIGN_CENTRE);
-
-	// Draw direction info
-	dc.DrawRectangle(m_DirInfoRect);
-	dc.DrawLabel(wxString::Format("%03.0f", m_Drone.getYawDeg()), m_DirInfoRect, wxALIGN_CENTRE);
+	// Draw speed, altitude and direction info, the texts are only rendered when the values change
+	m_SpeedText.Set(wxString::Format(m_strSpeed, dSpeed), FontBold12, m_HudColor);
+	m_SpeedText.DrawCentered(dc, m_SpeedInfoRect);
+	m_AltText.Set(wxString::Format(m_strAltitude, dAltitude), FontBold12, m_HudColor);
+	m_AltText.DrawCentered(dc, m_AltInfoRect);
+	m_DirText.Set(wxString::Format("%03.0f", m_Drone.getYawDeg()), FontBold12, m_HudColor);
+	m_DirText.DrawCentered(dc, m_DirInfoRect);
 		
 	int		iPitch	= (int)m_Drone.getPitchDeg();
 	double	dRoll	= m_Drone.getRollDeg();
@@ -1748,14 +2276,15 @@ void CDroneController::DrawHUD2(wxDC& dc)
 	int iX = 0;
 	int iY = 0;
 
-	// Draw 5 lines with level info
+	// Draw 5 lines with level info, the labels are rendered again when the value or the angle (1 degree) change
 	for(int i=-2; i<3; i++)
 	{
 		iX = m_iMiddleX-(iVectY*i);
 		iY = iStartY+(iVectX*i);
 
 		dc.DrawLine( iX - iVectX, iY - iVectY, iX + iVectX, iY + iVectY );
-		dc.DrawRotatedText(wxString::Format("%d", iPitch-iPitchDiff-(i*10)), iX - iVectX, iY - iVectY, dRoll);
+		m_LadderText[i+2].Set(wxString::Format("%d", iPitch-iPitchDiff-(i*10)), FontBold12, m_HudColor, (int)floor(dRoll + 0.5));
+		m_LadderText[i+2].Draw(dc, iX - iVectX, iY - iVectY);
 	}
 }
 
@@ -1769,47 +2298,104 @@ void CDroneController::DrawDebugInfo(wxDC& dc)
 
 	dc.SetFont(FontNormal10);
 
-	// Get the estimated distance between the drone and starting point
-	double Distance = m_AutoPilot.GetDistance();
-
-	if(CConfig::GetSingleton()->HasUSUnit())
+	// The values change on each frame, render the text only a few times per second
+	long lTime = m_Watch.Time();
+	if((lTime - m_lDebugTextTime >= lDebugTextPeriod) || (lTime < m_lDebugTextTime))
 	{
-		Distance = Distance * dMetertoFeet;
-	}
+		m_lDebugTextTime = lTime;
+
+		// Get the estimated distance between the drone and starting point
+		double Distance = m_AutoPilot.GetDistance();
 
-	// Get total flying time for the current battery
-	long lFlightTimeInSeconds = m_WatchFlyingTime.Time()/1000;
-	long lSec = lFlightTimeInSeconds%60;
-	long lMin = (lFlightTimeInSeconds-lSec)/60;
+		if(CConfig::GetSingleton()->HasUSUnit())
+		{
+			Distance = Distance * dMetertoFeet;
+		}
+
+		// Get total flying time for the current battery
+		long lFlightTimeInSeconds = m_WatchFlyingTime.Time()/1000;
+		long lSec = lFlightTimeInSeconds%60;
+		long lMin = (lFlightTimeInSeconds-lSec)/60;
+
+		// Input of the last update of the control loop
+		sInputState InputState;
+		m_Input.GetState(InputState);
 
-	// Debug information : Distance, minutes flying, seconds flying, forward vector, side vector, turning vector, altitude vector
-	wxString str = wxString::Format(m_strDebug, Distance, lMin, lSec, m_Input.GetDirectionValue(IDX_FORWARD), m_Input.GetDirectionValue(IDX_SIDE), m_Input.GetDirectionValue(IDX_TURN), m_Input.GetDirectionValue(IDX_ALTITUDE));
-	dc.DrawLabel(str, m_DebugRect, wxALIGN_CENTRE);
+		// Debug information : Distance, minutes flying, seconds flying, forward vector, side vector, turning vector, altitude vector
+		wxString str = wxString::Format(m_strDebug, Distance, lMin, lSec, InputState.adDirections[IDX_FORWARD], InputState.adDirections[IDX_SIDE], InputState.adDirections[IDX_TURN], InputState.adDirections[IDX_ALTITUDE]);
+		m_DebugText.Set(str, FontNormal10, dc.GetTextForeground());
+	}
+	m_DebugText.DrawCentered(dc, m_DebugRect);
 
 	// If global debug flag is active display all informations
 	if(g_bDebug)
 	{
-		double dMoveRotation	= 0.0f;
-		double dMoveSpeed		= 0.0f;
-		double dMoveAltitude	= 0.0f;
-
-		m_AutoPilot.ComputeWayToHome(dMoveRotation, dMoveSpeed, dMoveAltitude);
-	
-		int PosX = m_iPanelWidth - 160;
-		int PosY = m_iPanelHeight - 250;
-
-		dc.DrawText(wxString::Format("DroneAng  %.2f", m_Drone.getYawDeg()), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("GpsAngle  %.2f", m_Drone.GetGpsAngle()), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("Ang2Home  %.2f", m_AutoPilot.GetProperty(DBG_HOMEANGLE)), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("Distance  %.2f", m_AutoPilot.GetDistance()), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("MaxAlt    %.2f", m_AutoPilot.GetProperty(DBG_ALTITUDEMAX)), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("PositionX %.2f", m_AutoPilot.GetProperty(DBG_POSITIONX)), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("PositionY %.2f", m_AutoPilot.GetProperty(DBG_POSITIONY)), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("Latitude  %.2f", m_AutoPilot.GetProperty(DBG_CURRENTLATITUDE)), PosX, PosY); PosY+=20;
-		dc.DrawText(wxString::Format("Longitude %.2f", m_AutoPilot.GetProperty(DBG_CURRENTLONGITUDE)), PosX, PosY); PosY+=20;
+		std::vector<wxString> Lines;
+
+		Lines.push_back(wxString::Format("DroneAng  %.2f", m_Drone.getYawDeg()));
+		Lines.push_back(wxString::Format("GpsAngle  %.2f", m_Drone.GetGpsAngle()));
+		Lines.push_back(wxString::Format("Ang2Home  %.2f", m_AutoPilot.GetProperty(DBG_HOMEANGLE)));
+		Lines.push_back(wxString::Format("Distance  %.2f", m_AutoPilot.GetDistance()));
+		Lines.push_back(wxString::Format("MaxAlt    %.2f", m_AutoPilot.GetProperty(DBG_ALTITUDEMAX)));
+		Lines.push_back(wxString::Format("PositionX %.2f", m_AutoPilot.GetProperty(DBG_POSITIONX)));
+		Lines.push_back(wxString::Format("PositionY %.2f", m_AutoPilot.GetProperty(DBG_POSITIONY)));
+		sPoseStats PoseStats;
+		m_AutoPilot.GetPoseStats(PoseStats);
+		Lines.push_back(wxString::Format("DeadRck   %.0f/%ld/%lu", PoseStats.dRate, PoseStats.lGapMax / 1000, PoseStats.ulGaps));
+		Lines.push_back(wxString::Format("Ekf       %ld/%ld/%lu", PoseStats.lCostAvg, PoseStats.lCostMax, PoseStats.ulRejected));
+		Lines.push_back(wxString::Format("Mission   %d %d/%d", (int)m_Mission.GetState(), m_Mission.GetWaypoint()+1, m_Mission.GetWaypointCount()));
+		sFenceState FenceState;
+		m_Geofence.GetState(FenceState);
+		Lines.push_back(wxString::Format("Fence     %.1f/%lu/%ld", FenceState.bEnabled ? FenceState.dDistance : 0.0, FenceState.ulBreaches, FenceState.lCost));
+		Lines.push_back(wxString::Format("Latitude  %.2f", m_AutoPilot.GetProperty(DBG_CURRENTLATITUDE)));
+		Lines.push_back(wxString::Format("Longitude %.2f", m_AutoPilot.GetProperty(DBG_CURRENTLONGITUDE)));
+
+		// Link supervision
+		ARDRONE_LINK_STATS Stats;
+		m_Drone.getLinkStats(&Stats);
+		Lines.push_back(wxString::Format("Link      %d", m_Drone.getLinkState()));
+		Lines.push_back(wxString::Format("NavAge    %.2f", Stats.navdataAge));
+		Lines.push_back(wxString::Format("VidAge    %.2f", Stats.videoAge));
+		Lines.push_back(wxString::Format("Drops     %d/%d", Stats.navdataLosses, Stats.videoLosses));
+		Lines.push_back(wxString::Format("Reconnect %.2f", Stats.lastReconnectTime));
+
+		// Control loop (us)
+		Lines.push_back(wxString::Format("CtrlLate  %ld/%ld", m_lControlLateAvg.load(), m_lControlLateMax.load()));
+		Lines.push_back(wxString::Format("CtrlStep  %ld", m_lControlDuration.load()));
+		Lines.push_back(wxString::Format("Overruns  %lu", m_ulControlOverruns.load()));
+		Lines.push_back(wxString::Format("JoyLag    %ld/%ld", InputState.lJoystickLatency, InputState.lJoystickLatencyMax));
+
+		// Input latency percentiles (ms, p50/p95/p99): stimulus to update, update to command sent, command to attitude
+		sLatencyStats LatencyStats;
+		m_LatencyTrace.GetStats(LatencyStats);
+		Lines.push_back(wxString::Format("LatIn     %.1f/%.1f/%.1f", LatencyStats.alP50[LATENCY_INPUT] / 1000.0, LatencyStats.alP95[LATENCY_INPUT] / 1000.0, LatencyStats.alP99[LATENCY_INPUT] / 1000.0));
+		Lines.push_back(wxString::Format("LatCmd    %.1f/%.1f/%.1f", LatencyStats.alP50[LATENCY_COMMAND] / 1000.0, LatencyStats.alP95[LATENCY_COMMAND] / 1000.0, LatencyStats.alP99[LATENCY_COMMAND] / 1000.0));
+		Lines.push_back(wxString::Format("LatAtt    %.0f/%.0f/%.0f", LatencyStats.alP50[LATENCY_RESPONSE] / 1000.0, LatencyStats.alP95[LATENCY_RESPONSE] / 1000.0, LatencyStats.alP99[LATENCY_RESPONSE] / 1000.0));
+
+		// Images per second, displayed / decoded
+		Lines.push_back(wxString::Format("Fps       %ld/%ld", m_lDisplayFps, m_lDecodedFps));
+
+		// Recording on pc, frames queued / dropped / written
+		sRecordStats RecordStats;
+		m_Recorder.GetStats(RecordStats);
+		Lines.push_back(wxString::Format("Record    %lu/%lu/%lu", RecordStats.ulQueued, RecordStats.ulDropped, RecordStats.ulWritten));
+
+		// Render time of the layers (us), image + static HUD / dynamic HUD / debug
+		Lines.push_back(wxString::Format("Layers    %ld/%ld/%ld", m_lTimeFrameLayer, m_lTimeHudLayer, m_lTimeDebugLayer));
+
+		// Bottom right, under the FPS, in more columns to the left if the panel is too short
+		int iRows = wxMax(1, (m_iPanelHeight - 40) / 20);
+		int iColumns = ((int)Lines.size() + iRows - 1) / iRows;
+		int iTop = wxMax(30, m_iPanelHeight - 10 - wxMin((int)Lines.size(), iRows) * 20);
+		for(int i=0; i<(int)Lines.size(); i++)
+		{
+			int PosX = m_iPanelWidth - 160 * (iColumns - i / iRows);
+			int PosY = iTop + (i % iRows) * 20;
+			dc.DrawText(Lines[i], PosX, PosY);
+		}
 	}
 	
-	dc.DrawText(wxString::Format("FPS: %d", m_Input.GetFPS()), m_iPanelWidth-70, 10);
+	dc.DrawText(wxString::Format("FPS: %ld", InputState.lFps), m_iPanelWidth-70, 10);
 }
 
 
@@ -1848,6 +2434,7 @@ bool CDroneController::HasStatus(eAppState AppStatus)
 void CDroneController::SetStatus(eAppState AppStatus)
 {
 	m_usAppState |= AppStatus;
+	m_bHudDirty = true;
 }
 
 
@@ -1857,6 +2444,7 @@ void CDroneController::SetStatus(eAppState AppStatus)
 void CDroneController::ResetStatus(eAppState AppStatus)
 {
 	m_usAppState &= ~AppStatus;
+	m_bHudDirty = true;
 }
 
 
@@ -1874,6 +2462,9 @@ bool CDroneController::RefreshGUIText()
 	// Refresh input (only usefull for French)
 	m_Input.RefreshLayout();
 
+	// Error texts are kept by the drone
+	m_Drone.ResetErrorText();
+
 	// Refresh menu title
 	m_pMenu->SetMenuLabel(0, GetText("Main"));
 	m_pMenu->SetMenuLabel(1, GetText("Config"));	
@@ -1885,6 +2476,10 @@ bool CDroneController::RefreshGUIText()
 	m_pMenu->SetLabel(MENU_KEYBOARD, GetText("ConfigKey"));
 	m_pMenu->SetLabel(MENU_JOYSTICK, GetText("ConfigJoy"));
 	m_pMenu->SetLabel(MENU_IPADDRESS, GetText("ConfigIp"));
+	m_pMenu->SetLabel(MENU_MISSIONLOAD, GetText("MissionLoad"));
+	m_pMenu->SetLabel(MENU_MISSIONSTART, GetText("MissionStart"));
+	m_pMenu->SetLabel(MENU_MISSIONPAUSE, GetText("MissionPause"));
+	m_pMenu->SetLabel(MENU_MISSIONABORT, GetText("MissionAbort"));
 	m_pMenu->SetLabel(MENU_ABOUT, GetText("About"));
 	
 	// Refresh toolbar text
@@ -1946,63 +2541,30 @@ void CDroneController::StartPCRecording()
 
 	// Start recording on local pc
 	char filename[256];
+	wxString strName = GetTimeStampName();
 
-	time_t rawtime;
-    struct tm * timeinfo;
-    time ( &rawtime );
-    timeinfo = localtime ( &rawtime );
+	// The H.264 stream of the drone 2.0 is copied to the file without decoding
+	long lFormat = CConfig::GetSingleton()->GetPcRecordFormat();
+	if( (PcRecord_Avi != lFormat) && (ARDRONE_VERSION_2 == m_Drone.getVersion()) )
+	{
+		sprintf(filename, "Media/Movies/Mov_%s.%s", (const char*)strName.mb_str(), (PcRecord_Mkv == lFormat) ? "mkv" : "mp4");
+		if(m_Drone.startStreamRecord(filename))
+		{
+			SetStatus(STATE_RECORDINGONPC);
+			return;
+		}
 
-	sprintf(filename, "Media/Movies/Mov_%s.avi", asctime (timeinfo));
+		DoLog("Failed to copy the video stream, try to record decoded images", MSG_WARNING);
+	}
 
-	// Init the next frame target time (current time + 40 ms)
-	m_llNextFrameTime = m_Watch.TimeInMicro() + 40000;
+	sprintf(filename, "Media/Movies/Mov_%s.avi", (const char*)strName.mb_str());
 
 	// Get the image size send by the drone
 	IplImage* pImg = m_Drone.getImage();
 	if(NULL != pImg)
 	{
-		// Record at 25 fps (an image every 40 ms)
-		double dFps = 25.0f;
-
-		// Try different codecs for video writer
-		DoLog("Try to load H264 codec");				
-		m_pVideoWriter = cvCreateVideoWriter(filename, CV_FOURCC('H','2','6','4'), dFps, cvGetSize(pImg));				
-		if(NULL == m_pVideoWriter)
-		{
-			DoLog("Failed to load H264 codec, try to load Xvid codec");
-			m_pVideoWriter = cvCreateVideoWriter(filename, CV_FOURCC('X','V','I','D'), dFps, cvGetSize(pImg));		
-		}
-		if(NULL == m_pVideoWriter)
-		{					
-			DoLog("Failed to load Xvid codec, try to load MP4.2 codec");
-			m_pVideoWriter = cvCreateVideoWriter(filename, CV_FOURCC('M','P','4','2'), dFps, cvGetSize(pImg));	
-		}				
-		if(NULL == m_pVideoWriter)
-		{
-			DoLog("Failed to load MP4.2 codec, try to load divx 5 codec");
-			m_pVideoWriter = cvCreateVideoWriter(filename, CV_FOURCC('D','X','5','0'), dFps, cvGetSize(pImg));	
-		}
-		if(NULL == m_pVideoWriter)
-		{
-			DoLog("Failed to loadDivx 5 codec, try to load DivX codec");					
-			m_pVideoWriter = cvCreateVideoWriter(filename, CV_FOURCC('D','I','V','X'), dFps, cvGetSize(pImg));
-		}
-		if(NULL == m_pVideoWriter)
-		{
-			DoLog("Failed to load DivX codec, try to load H263 codec");
-			m_pVideoWriter = cvCreateVideoWriter(filename, CV_FOURCC('U','2','6','3'), dFps, cvGetSize(pImg));	
-		}
-		if(NULL == m_pVideoWriter)
-		{
-			DoLog("Failed to load H263 codec, try to load RGB avi file mode (Hard disk consuming)");
-			m_pVideoWriter = cvCreateVideoWriter(filename, CV_FOURCC('D','I','B',' '), dFps, cvGetSize(pImg));	
-		}
-
-		if(NULL == m_pVideoWriter)
-		{
-			DoLog("Could not enable codec, recording on pc aborted !", MSG_ERROR);
-		}
-		else
+		// The recorder has its own thread for the codec
+		if(m_Recorder.Start(filename, cvGetSize(pImg)))
 		{
 			SetStatus(STATE_RECORDINGONPC);
 		}
@@ -2021,13 +2583,10 @@ void CDroneController::StopPCRecording()
 {
 	DoLog("Stop recording on pc");
 
-	// Save the video
-	m_CSVideo.Enter();
-	cvReleaseVideoWriter(&m_pVideoWriter);
-	m_pVideoWriter = NULL;
-	m_CSVideo.Leave();
-
+	// No more frames, then save the video
 	ResetStatus(STATE_RECORDINGONPC);
+	m_Drone.stopStreamRecord();
+	m_Recorder.Stop();
 }
 
 
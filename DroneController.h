@@ -13,6 +13,8 @@
 // To simulate mouse move
 #include <wx/uiaction.h>
 #include <time.h>
+#include <vector>
+#include <atomic>
 
 // Test: try to veto sleep
 #ifdef wxHAS_POWER_EVENTS
@@ -24,6 +26,13 @@
 //#include "ScreenManager.h"
 //#include "WifiManager.h"
 #include "AutoPilot.h"
+#include "Mission.h"
+#include "Geofence.h"
+#include "LatencyTrace.h"
+#include "FrameScaler.h"
+#include "HudText.h"
+#include "VideoRecorder.h"
+#include "PictureWriter.h"
 #include "Ressources.h"
 
 // Global flag, if debug informations should be displayed
@@ -41,6 +50,22 @@ enum eAppState
 	STATE_RETURNHOMEACTIVE	= 0x0020,
 };
 
+// Period of the control loop (input, autopilot and commands) in microseconds
+const long lControlPeriod = 10000L;
+
+// Direction value from which the pilot takes over a mission
+const double dPilotOverride = 0.1;
+
+// Shortest time between two renders of the debug text (ms), its values change on each frame
+const long lDebugTextPeriod = 250L;
+
+// Pixel of the static layer of the HUD: offset in the panel image and coverage (anti-aliasing)
+struct sHudPixel
+{
+	int				iOffset;
+	unsigned char	ucAlpha;
+};
+
 ////////////////////////////////////////////////////////////////////////////
 // Application entry point
 /////////////////////////////////////////////////////////////////////////////
@@ -52,11 +77,31 @@ public:
 };
 
 
+class CDroneController;
+
+/////////////////////////////////////////////////////////////////////////////
+// Thread running the control loop of the main frame at a fixed rate
+/////////////////////////////////////////////////////////////////////////////
+class CControlThread : public wxThread
+{
+public:
+	CControlThread(CDroneController* pOwner) : wxThread(wxTHREAD_JOINABLE), m_pOwner(pOwner) {}
+
+protected:
+	wxThread::ExitCode Entry();
+
+private:
+	CDroneController*	m_pOwner;
+};
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Class for the main frame of the application
 /////////////////////////////////////////////////////////////////////////////
 class CDroneController: public wxFrame, public wxThreadHelper
 {
+	friend class CControlThread;
+
 public:
     CDroneController(const wxString& title);
     virtual	~CDroneController();
@@ -79,6 +124,15 @@ protected:
 	void StartRecord();
 	void StopRecord();
 
+	// Toggles asked by the control thread, run by the GUI thread (CallAfter)
+	void ToggleFullScreen();
+	void ToggleRecord();
+	// Write the delays of the input, asked by the control thread at landing
+	void ExportLatency();
+
+	// Load the geofence if its file has changed (or always)
+	void LoadGeofence(bool bForce);
+
 	// Update states
 	void OnTimerUpdate(wxTimerEvent& WXUNUSED(event));
 
@@ -99,6 +153,10 @@ protected:
 	void OnCamera(wxCommandEvent& WXUNUSED(event));
 	void OnHome(wxCommandEvent& WXUNUSED(event));
 	void OnHomeReset(wxCommandEvent& WXUNUSED(event));
+	void OnMissionLoad(wxCommandEvent& WXUNUSED(event));
+	void OnMissionStart(wxCommandEvent& WXUNUSED(event));
+	void OnMissionPause(wxCommandEvent& WXUNUSED(event));
+	void OnMissionAbort(wxCommandEvent& WXUNUSED(event));
 	void OnConnect(wxCommandEvent& WXUNUSED(event));
 	void OnDisconnect(wxCommandEvent& WXUNUSED(event));
 #ifdef wxHAS_POWER_EVENTS
@@ -110,12 +168,30 @@ private:
 	void SetLimits();
 	// Compute new positions of the graphical items after a resize event
 	void ComputePositions(int iPanelWidth, int iPanelHeight);
-	// The code executed by the thread (main loop)
+	// The code executed by the thread (render loop)
 	wxThread::ExitCode	Entry();
+	// The code executed by the control thread (fixed rate loop)
+	wxThread::ExitCode	ControlEntry(wxThread* pThread);
+	// One period of the control loop: input, autopilot and commands
+	void				ControlStep();
+	// The pilot moves one of the sticks/keys (takes over the mission)
+	bool				IsPilotMoving();
 	// Draw the main panel with camera capture
-	bool				DoRender();
+	bool				DoRender(bool bNewFrame);
+	// Convert the current image of the drone into the bitmap to display
+	bool				UpdateFrame();
+	// Give a new image to the recorder and the picture writer
+	void				CaptureFrame(IplImage* pImg, unsigned long ulFrame, long long llFrameTime);
 	// Draw status informations (battery, wifi...)
 	void				DrawStatus(wxDC& dc);
+	// Draw an icon followed by its text
+	void				DrawStatusLabel(wxDC& dc, CHudText& Text, const wxBitmap& Icon, const wxRect& Rect);
+	// Draw the parts of the HUD which only change with the size or the style
+	void				DrawHUDStatic(wxDC& dc);
+	// Render the static layer of the HUD into a list of pixels
+	void				BuildHUDStatic();
+	// Draw the static layer of the HUD into a RGB image of the panel size
+	void				ApplyHUDStatic(unsigned char* pucData);
 	// Draw the basic version of the HUD, and all screen informations
 	void				DrawHUD1(wxDC& dc);
 	// Draw the advanced version of the HUD, and all screen informations
@@ -143,8 +219,41 @@ private:
 // NOTE (23.08.2014, Version 1.5.4) class CDroneController have now a lot of members,
 // a refactoring should be done to keep the overview.
 private:
-	// The displayed image
+	// The displayed image (RGB, panel size)
 	wxImage				m_Image;
+	// Converts the drone image into m_Image
+	CFrameScaler		m_FrameScaler;
+	// The displayed image, converted and scaled to the panel size
+	wxBitmap			m_FrameBitmap;
+	// Frame count of the drone at the last render
+	unsigned long		m_ulFrameCount;
+	// Set when the HUD has to be drawn again without a new image (state change, resize...)
+	volatile bool		m_bHudDirty;
+	// Minimum time between two renders (ms), from the display frame rate limit
+	long				m_lMinRenderTime;
+	// Images displayed and decoded during the last second
+	long				m_lDisplayFps;
+	long				m_lDecodedFps;
+
+	// Static layer of the HUD: its pixels in the panel image
+	std::vector<sHudPixel>	m_HudStaticPixels;
+	// Set when the static layer has to be rendered again (resize, style or color change)
+	volatile bool		m_bHudStaticDirty;
+	// Texts of the dynamic layer, only rendered again when they change
+	CHudText			m_BatteryText;
+	CHudText			m_RecordText;
+	CHudText			m_HomeText;
+	CHudText			m_SpeedText;
+	CHudText			m_AltText;
+	CHudText			m_DirText;
+	CHudText			m_LadderText[5];
+	CHudText			m_ErrorText;
+	CHudText			m_DebugText;
+	long				m_lDebugTextTime;
+	// Render time of the layers (us)
+	long				m_lTimeFrameLayer;
+	long				m_lTimeHudLayer;
+	long				m_lTimeDebugLayer;
 	// Bitmap use as buffer for wxBufferedDC
 	wxBitmap			m_BufferBitmap;
 	// The main panel where we draw to
@@ -167,6 +276,8 @@ private:
 	wxUIActionSimulator	m_ActionSimulator;
 	// To alternate mouse direction - One time to the left, ane time to the right
 	unsigned char		m_ucKeepAwake;
+	// Link statistics at the last timer update, to log new dropouts
+	ARDRONE_LINK_STATS	m_LinkStats;
 
 	// Sounds to play (one beep and multiple beeps)
 	wxSound*			m_pBeep;
@@ -230,10 +341,21 @@ private:
 	wxBrush				m_HudBrush;
 	wxCriticalSection	m_CSDrawing;
 
-	// Recording on file
-	CvVideoWriter*		m_pVideoWriter;		// The writer
-	wxCriticalSection	m_CSVideo;			// The critical section	
-	wxLongLong			m_llNextFrameTime;	// Target time where we have to record the next frame
+	// Recording on file, encoded by its own thread
+	CVideoRecorder		m_Recorder;
+
+	// Screenshots, written by their own thread
+	CPictureWriter		m_PictureWriter;
+	int					m_iBurstLeft;		// Images left to capture in the current burst
+	unsigned long		m_ulCapturedFrame;	// Number of the last image given to the recorder and the writer
+
+	// The thread running the control loop
+	CControlThread*		m_pControlThread;
+	// Statistics of the control loop (us), written by the control thread and read by the render loop
+	std::atomic<long>			m_lControlLateMax;		// Maximum delay of a period start over its deadline
+	std::atomic<long>			m_lControlLateAvg;		// Average delay
+	std::atomic<long>			m_lControlDuration;		// Duration of the last step
+	std::atomic<unsigned long>	m_ulControlOverruns;	// Steps longer than the period
 
 	// The watch used for time measurement
 	wxStopWatch			m_Watch;
@@ -244,6 +366,14 @@ private:
 
 	// The autopilot used for ReturnToHome functionnality
 	CAutoPilot			m_AutoPilot;
+	// Waypoints flown with the position of the autopilot
+	CMission			m_Mission;
+	// Horizontal limits of the flight
+	CGeofence			m_Geofence;
+	wxDateTime			m_GeofenceTime;			// Modification of the loaded file
+	// Delays from the input changes to the drone
+	CLatencyTrace		m_LatencyTrace;
+	unsigned long		m_ulTracedChanges;		// Last change of the input given to the trace
 
 	// Manages screen resolution
 	//CScreenManager		m_ScreenManager;
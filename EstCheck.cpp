@@ -0,0 +1,372 @@
+//////////////////////////////////////////////////////////////////////////////
+// Benchmark and replay accuracy check of the estimator
+//////////////////////////////////////////////////////////////////////////////
+// Usage: estCheck.run [-n updates] [-e maximum error] [flight.nav ...]
+// The benchmark times one Predict() + Correct() of CEstimator, as done by
+// CAutoPilot::Integrate() for each navdata, on a simulated flight.
+// Each navdata track written next to a recording (ARDrone::startStreamRecord)
+// is then replayed twice: with its GPS fixes, and without them (dead
+// reckoning). Both estimated tracks are compared with the GPS fixes, which
+// have their own error of a few meters. With a maximum error (m), fails
+// (exit code 1) when the mean error of the dead reckoning is above it.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <wx/init.h>
+#include "Utils.h"
+#include "Log.h"
+#include "AutoPilot.h"	// Radius of the earth
+#include "Estimator.h"
+#include "Simulator.h"
+#include "ardrone/ardrone.h"
+
+// Period of the navdata (s), as sent by the drone
+const double dCheckNavdataPeriod	= 0.005;
+// Length of the simulated flight of the benchmark (s)
+const double dCheckFlightTime		= 60.0;
+// Default number of updates of the benchmark
+const long lCheckUpdates			= 1000000L;
+
+// Errors of an estimated track against the GPS fixes of the recording
+struct sReplayResult
+{
+	long	lSamples;
+	long	lFixes;
+	double	dDuration;		// s
+	double	dErrorMean;		// m
+	double	dErrorMax;		// m
+	double	dErrorLast;		// m
+	double	dCostAvg;		// ns per update
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Measurements of a simulated flight: take off, moves, with wind and noises
+//////////////////////////////////////////////////////////////////////////////
+// [OUT] : Measurements of each navdata
+//////////////////////////////////////////////////////////////////////////////
+static void SimulateFlight(std::vector<sEstimatorInput>& Inputs)
+{
+	sSimConfig Config;
+	CSimulator::GetDefaultConfig(Config);
+	Config.dWindX			= 1.5;
+	Config.dWindY			= -1.0;
+	Config.dGust			= 0.5;
+	Config.dHeadingBias		= 10.0;
+	Config.dNoiseVelocity	= 0.05;
+	Config.dNoiseAltitude	= 0.02;
+	Config.dNoiseHeading	= 2.0;
+	Config.dNoiseGps		= 1.5;
+	Config.bGps				= true;
+	Config.dHomeLatitude	= 45.1885;
+	Config.dHomeLongitude	= 5.7245;
+
+	CSimulator Simulator;
+	Simulator.Reset(Config);
+	Simulator.Takeoff();
+
+	ARDRONE_NAVDATA Navdata;
+	while(Simulator.GetTime() < dCheckFlightTime)
+	{
+		// Climb, then a square of 5 s legs while turning slowly
+		double dTime = Simulator.GetTime();
+		int iLeg = (int)(dTime / 5.0) % 4;
+		float fRoll = (1 == iLeg) ? 0.5f : ((3 == iLeg) ? -0.5f : 0.0f);
+		float fPitch = (0 == iLeg) ? -0.5f : ((2 == iLeg) ? 0.5f : 0.0f);
+		Simulator.Pcmd(1, fRoll, fPitch, (dTime < 5.0) ? 1.0f : 0.0f, 0.1f);
+		Simulator.Step(dCheckNavdataPeriod);
+
+		Simulator.GetNavdata(Navdata);
+		sEstimatorInput Input;
+		NavdataToEstimatorInput(Navdata, true, Input);
+		Inputs.push_back(Input);
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Cost of one update of the estimator
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Number of updates
+//////////////////////////////////////////////////////////////////////////////
+static void Benchmark(long lUpdates)
+{
+	std::vector<sEstimatorInput> Inputs;
+	SimulateFlight(Inputs);
+	if(Inputs.empty() || (lUpdates <= 0))
+	{
+		return;
+	}
+
+	// Total time, the flight is replayed from home as many times as needed
+	CEstimator Estimator;
+	double dCheck = 0.0;
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	for(long l=0; l<lUpdates; l++)
+	{
+		size_t i = l % Inputs.size();
+		if(0 == i)
+		{
+			Estimator.Reset(true, 45.1885, 5.7245);
+		}
+		Estimator.Predict(dCheckNavdataPeriod);
+		Estimator.Correct(Inputs[i]);
+		dCheck += Estimator.GetState(EST_X);
+	}
+	double dTotal = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+	// Distribution over one flight, each update timed alone (the clock adds its own cost)
+	std::vector<long> Costs;
+	Costs.reserve(Inputs.size());
+	Estimator.Reset(true, 45.1885, 5.7245);
+	for(size_t i=0; i<Inputs.size(); i++)
+	{
+		std::chrono::steady_clock::time_point Begin = std::chrono::steady_clock::now();
+		Estimator.Predict(dCheckNavdataPeriod);
+		Estimator.Correct(Inputs[i]);
+		Costs.push_back((long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Begin).count());
+	}
+	std::sort(Costs.begin(), Costs.end());
+
+	double dAvg = dTotal * 1000000000.0 / lUpdates;
+	printf("Benchmark:       %ld updates in %.3f s (checksum %.1f)\n", lUpdates, dTotal, dCheck);
+	printf("Update cost:     %.0f ns average, %ld/%ld/%ld ns p50/p99/max\n", dAvg, Costs[Costs.size() / 2], Costs[(Costs.size() * 99) / 100], Costs.back());
+	printf("Navdata budget:  %.3f %% of the %.0f ms period\n", dAvg * 100.0 / (dCheckNavdataPeriod * 1000000000.0), dCheckNavdataPeriod * 1000.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Read a navdata track written next to a recording
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : File name
+// [OUT] : Samples of the file
+// [RETURN] : false if the file is not a navdata track
+//////////////////////////////////////////////////////////////////////////////
+static bool ReadTrack(const char* pcFileName, std::vector<ARDRONE_RECORD_NAV>& Samples)
+{
+	FILE* pFile = fopen(pcFileName, "rb");
+	if(NULL == pFile)
+	{
+		return false;
+	}
+
+	// Magic, size of a sample and time base of the video
+	char acMagic[8];
+	uint32_t auiInfo[3];
+	if( (1 != fread(acMagic, sizeof(acMagic), 1, pFile)) || (0 != memcmp(acMagic, ARDRONE_RECORD_NAV_MAGIC, sizeof(acMagic)))
+		|| (1 != fread(auiInfo, sizeof(auiInfo), 1, pFile)) || (auiInfo[0] < sizeof(ARDRONE_RECORD_NAV)) )
+	{
+		fclose(pFile);
+		return false;
+	}
+
+	// Newer samples may be longer, only the known part is used
+	std::vector<unsigned char> Buffer(auiInfo[0]);
+	while(1 == fread(&Buffer[0], Buffer.size(), 1, pFile))
+	{
+		ARDRONE_RECORD_NAV Sample;
+		memcpy(&Sample, &Buffer[0], sizeof(Sample));
+		Samples.push_back(Sample);
+	}
+	fclose(pFile);
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Measurements of a sample, through the navdata so the conversion is the one of the drone
+// Note: the track has no magnetometer and no pressure, the altitude is used as ultrasound
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Sample, number of the last GPS fix (changes with the coordinates), use its GPS
+// [OUT] : Measurements for Correct()
+//////////////////////////////////////////////////////////////////////////////
+static void SampleToEstimatorInput(const ARDRONE_RECORD_NAV& Sample, unsigned int uiGpsFrame, bool bUseGps, sEstimatorInput& Input)
+{
+	ARDRONE_NAVDATA Navdata;
+	memset(&Navdata, 0, sizeof(Navdata));
+
+	// The signs of the sample are the ones of the getters of ARDrone
+	Navdata.ardrone_state = Sample.state;
+	Navdata.demo.psi = -Sample.yaw * 1000.0f;
+	Navdata.demo.vx = Sample.vx * 1000.0f;
+	Navdata.demo.vy = -Sample.vy * 1000.0f;
+	Navdata.demo.altitude = (int)(Sample.altitude * 1000.0f);
+	Navdata.altitude.tag = ARDRONE_NAVDATA_ALTITUDE_TAG;
+	Navdata.altitude.altitude_raw = Navdata.demo.altitude;
+
+	if(bUseGps && ((0.0 != Sample.latitude) || (0.0 != Sample.longitude)))
+	{
+		Navdata.gps.gps_plugged = 1;
+		Navdata.gps.data_available = 1;
+		Navdata.gps.last_frame_timestamp = uiGpsFrame;
+		Navdata.gps.lat = Sample.latitude;
+		Navdata.gps.lon = Sample.longitude;
+	}
+
+	NavdataToEstimatorInput(Navdata, true, Input);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Replay a track and compare the estimated position with its GPS fixes
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Samples, fuse the GPS or not
+// [OUT] : Errors
+// [RETURN] : false if the track has no GPS fix to compare with
+//////////////////////////////////////////////////////////////////////////////
+static bool ReplayTrack(const std::vector<ARDRONE_RECORD_NAV>& Samples, bool bUseGps, sReplayResult& Result)
+{
+	memset(&Result, 0, sizeof(Result));
+
+	// The first fix is the origin of both tracks
+	size_t First = 0;
+	while( (First < Samples.size()) && (0.0 == Samples[First].latitude) && (0.0 == Samples[First].longitude) )
+	{
+		First++;
+	}
+	if(First >= Samples.size())
+	{
+		return false;
+	}
+	double dOriginLatitude = Samples[First].latitude;
+	double dOriginLongitude = Samples[First].longitude;
+	double dOriginCos = cos(dOriginLatitude*dPIover180);
+
+	CEstimator Estimator;
+	Estimator.Reset(true, dOriginLatitude, dOriginLongitude);
+
+	unsigned int uiGpsFrame = 0;
+	double dLastLatitude = 0.0;
+	double dLastLongitude = 0.0;
+	double dErrorSum = 0.0;
+	long long llCost = 0;
+	for(size_t i=First; i<Samples.size(); i++)
+	{
+		const ARDRONE_RECORD_NAV& Sample = Samples[i];
+
+		// A new fix has other coordinates
+		bool bNewFix = ((Sample.latitude != dLastLatitude) || (Sample.longitude != dLastLongitude)) && ((0.0 != Sample.latitude) || (0.0 != Sample.longitude));
+		if(bNewFix)
+		{
+			uiGpsFrame++;
+			dLastLatitude = Sample.latitude;
+			dLastLongitude = Sample.longitude;
+		}
+
+		sEstimatorInput Input;
+		SampleToEstimatorInput(Sample, uiGpsFrame, bUseGps, Input);
+
+		// As CAutoPilot::Integrate(): no prediction over a lost link
+		long lDiffTime = (i > First) ? (long)(Sample.time - Samples[i-1].time) : 0;
+		std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		if(lDiffTime > 0)
+		{
+			Estimator.Predict((lDiffTime < lPoseLostTime ? lDiffTime : lPoseLostTime) * 0.000001f);
+		}
+		Estimator.Correct(Input);
+		llCost += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+		Result.lSamples++;
+
+		// Compare with each fix
+		if(bNewFix)
+		{
+			double dX = (Sample.longitude - dOriginLongitude)*dPIover180*dEarthRadius*dOriginCos;
+			double dY = (Sample.latitude - dOriginLatitude)*dPIover180*dEarthRadius;
+			double dDiffX = Estimator.GetState(EST_X) - dX;
+			double dDiffY = Estimator.GetState(EST_Y) - dY;
+			double dError = sqrt(dDiffX*dDiffX + dDiffY*dDiffY);
+			dErrorSum += dError;
+			if(dError > Result.dErrorMax)
+			{
+				Result.dErrorMax = dError;
+			}
+			Result.dErrorLast = dError;
+			Result.lFixes++;
+		}
+	}
+
+	Result.dDuration = (Samples.back().time - Samples[First].time) * 0.000001;
+	Result.dErrorMean = (Result.lFixes > 0) ? dErrorSum / Result.lFixes : 0.0;
+	Result.dCostAvg = (Result.lSamples > 0) ? (double)llCost / Result.lSamples : 0.0;
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Entry point
+//////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	wxInitializer Initializer;
+	if(!Initializer.IsOk())
+	{
+		fprintf(stderr, "Failed to initialize wxWidgets\n");
+		return 2;
+	}
+
+	long lUpdates = lCheckUpdates;
+	double dErrorMax = 0.0;
+	std::vector<const char*> Files;
+	for(int i=1; i<argc; i++)
+	{
+		if(!strcmp(argv[i], "-n") && (i+1 < argc))
+		{
+			lUpdates = strtol(argv[++i], NULL, 10);
+		}
+		else if(!strcmp(argv[i], "-e") && (i+1 < argc))
+		{
+			dErrorMax = strtod(argv[++i], NULL);
+		}
+		else
+		{
+			Files.push_back(argv[i]);
+		}
+	}
+
+	// Only keep the problems
+	CLog::CreateSingleton()->SetMinLevel(MSG_WARNING);
+
+	Benchmark(lUpdates);
+
+	int iResult = 0;
+	for(size_t f=0; f<Files.size(); f++)
+	{
+		std::vector<ARDRONE_RECORD_NAV> Samples;
+		if(!ReadTrack(Files[f], Samples))
+		{
+			printf("%s: not a navdata track\n", Files[f]);
+			iResult = 2;
+			continue;
+		}
+
+		sReplayResult Fused;
+		sReplayResult Reckoning;
+		if(!ReplayTrack(Samples, true, Fused) || !ReplayTrack(Samples, false, Reckoning))
+		{
+			printf("%s: %lu samples without GPS fix, nothing to compare with\n", Files[f], (unsigned long)Samples.size());
+			continue;
+		}
+
+		printf("%s: %ld samples, %ld fixes, %.1f s\n", Files[f], Fused.lSamples, Fused.lFixes, Fused.dDuration);
+		printf("  With GPS:       %.2f m mean, %.2f m max, %.2f m at the end\n", Fused.dErrorMean, Fused.dErrorMax, Fused.dErrorLast);
+		printf("  Dead reckoning: %.2f m mean, %.2f m max, %.2f m at the end\n", Reckoning.dErrorMean, Reckoning.dErrorMax, Reckoning.dErrorLast);
+		printf("  Update cost:    %.0f ns average\n", Fused.dCostAvg);
+
+		if( (dErrorMax > 0.0) && (Reckoning.dErrorMean > dErrorMax) )
+		{
+			iResult = 1;
+		}
+	}
+
+	CLog::KillSingleton();
+
+	return iResult;
+}
@@ -0,0 +1,368 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CEstimator
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include "Utils.h"
+#include "AutoPilot.h"	// Radius of the earth
+#include "Estimator.h"
+#include "ardrone/ardrone.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Measurements of a navdata
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Navdata, gps block valid or not
+// [OUT] : Measurements for Correct()
+//////////////////////////////////////////////////////////////////////////////
+void NavdataToEstimatorInput(const ARDRONE_NAVDATA& Navdata, bool bHasGpsBlock, sEstimatorInput& Input)
+{
+	Input.bFlying = (0 != (Navdata.ardrone_state & ARDRONE_FLY_MASK));
+	Input.dYaw = Navdata.demo.psi * 0.001f;
+	if(Input.dYaw < 0.0f)
+	{
+		Input.dYaw += 360.0f;
+	}
+	Input.dVelocityForward = (double)Navdata.demo.vx * 0.001f;
+	Input.dVelocitySide = (double)Navdata.demo.vy * 0.001f;
+
+	// Heading of the magnetometer alone, once calibrated
+	Input.bHasMagneto = (0 != Navdata.magneto.tag) && (0 != Navdata.magneto.magneto_calibration_ok);
+	Input.dMagnetoHeading = Navdata.magneto.heading_unwrapped;
+
+	// Raw ultrasound (mm) and altitude of the pressure filter (taken as meters, rejected by the filter otherwise)
+	Input.bHasSonar = (0 != Navdata.altitude.tag) && !Navdata.kalman_pressure.flag_rejet_US;
+	Input.dSonarAltitude = Navdata.altitude.altitude_raw * 0.001f;
+	Input.bHasPressure = (0 != Navdata.kalman_pressure.tag);
+	Input.dPressureAltitude = Navdata.kalman_pressure.est_z;
+
+	Input.bHasGps = bHasGpsBlock && (0 != Navdata.gps.gps_plugged) && (0 != Navdata.gps.data_available);
+	Input.uiGpsFrame = Navdata.gps.last_frame_timestamp;
+	Input.dLatitude = Navdata.gps.lat;
+	Input.dLongitude = Navdata.gps.lon;
+	Input.dGpsAccuracy = (Navdata.gps.pos_accur_c0 > Navdata.gps.pos_accur_c1) ? Navdata.gps.pos_accur_c0 : Navdata.gps.pos_accur_c1;
+	Input.dGpsHdop = Navdata.gps.hdop;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Constructor
+//////////////////////////////////////////////////////////////////////////////
+CEstimator::CEstimator()
+{
+	Reset();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor
+//////////////////////////////////////////////////////////////////////////////
+CEstimator::~CEstimator()
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Start again from home
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : GPS coordinates of home, if known
+//////////////////////////////////////////////////////////////////////////////
+void CEstimator::Reset(bool bHasHome, double dHomeLatitude, double dHomeLongitude)
+{
+	for(int i=0; i<EST_COUNT; i++)
+	{
+		m_dState[i] = 0.0;
+		for(int j=0; j<EST_COUNT; j++)
+		{
+			m_dCovariance[i][j] = 0.0;
+		}
+	}
+
+	// Home is known exactly, the rest is not
+	m_dCovariance[EST_VX][EST_VX]		= 1.0;
+	m_dCovariance[EST_VY][EST_VY]		= 1.0;
+	m_dCovariance[EST_BIAS][EST_BIAS]	= dEstSigmaMagneto*dEstSigmaMagneto;
+	m_dCovariance[EST_Z][EST_Z]			= 1.0;
+	m_dCovariance[EST_VZ][EST_VZ]		= 1.0;
+
+	// Without the coordinates of home, the first fix will give the reference
+	m_bHasOrigin = bHasHome;
+	m_dOriginLatitude = dHomeLatitude;
+	m_dOriginLongitude = dHomeLongitude;
+	m_dOriginCos = cos(dHomeLatitude*dPIover180);
+	m_dOriginX = 0.0;
+	m_dOriginY = 0.0;
+	m_uiLastGpsFrame = 0;
+
+	m_bHasPressureOffset = false;
+	m_dPressureOffset = 0.0;
+
+	m_ulRejected = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Move the state forward (constant velocity)
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Time since the last prediction in seconds
+//////////////////////////////////////////////////////////////////////////////
+void CEstimator::Predict(double dTime)
+{
+	if(dTime <= 0.0)
+	{
+		return;
+	}
+
+	// Each position moves with its velocity
+	static const int aiPairs[3][2] = { {EST_X, EST_VX}, {EST_Y, EST_VY}, {EST_Z, EST_VZ} };
+
+	for(int k=0; k<3; k++)
+	{
+		m_dState[aiPairs[k][0]] += m_dState[aiPairs[k][1]]*dTime;
+	}
+
+	// P = F.P.Ft, F being the identity plus the time on the position/velocity pairs
+	for(int k=0; k<3; k++)
+	{
+		int p = aiPairs[k][0];
+		int v = aiPairs[k][1];
+		for(int j=0; j<EST_COUNT; j++)
+		{
+			m_dCovariance[p][j] += m_dCovariance[v][j]*dTime;
+		}
+	}
+	for(int k=0; k<3; k++)
+	{
+		int p = aiPairs[k][0];
+		int v = aiPairs[k][1];
+		for(int i=0; i<EST_COUNT; i++)
+		{
+			m_dCovariance[i][p] += m_dCovariance[i][v]*dTime;
+		}
+	}
+
+	// P += Q
+	m_dCovariance[EST_X][EST_X]			+= dEstNoisePosition*dTime;
+	m_dCovariance[EST_Y][EST_Y]			+= dEstNoisePosition*dTime;
+	m_dCovariance[EST_VX][EST_VX]		+= dEstNoiseVelocity*dTime;
+	m_dCovariance[EST_VY][EST_VY]		+= dEstNoiseVelocity*dTime;
+	m_dCovariance[EST_BIAS][EST_BIAS]	+= dEstNoiseBias*dTime;
+	m_dCovariance[EST_VZ][EST_VZ]		+= dEstNoiseVertical*dTime;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Correct the state with the measurements of one navdata
+// Note: the measurements are uncorrelated, they are applied one by one
+//////////////////////////////////////////////////////////////////////////////
+void CEstimator::Correct(const sEstimatorInput& Input)
+{
+	double adH[EST_COUNT];
+
+	// Velocities are given in the frame of the drone, rotated by the true heading
+	// Forward = sin(h).vx + cos(h).vy, Side = cos(h).vx - sin(h).vy
+	double dForward = Input.bFlying ? Input.dVelocityForward : 0.0;
+	double dSide = Input.bFlying ? Input.dVelocitySide : 0.0;
+	double dSigma = Input.bFlying ? dEstSigmaVelocity : dEstSigmaGround;
+	for(int k=0; k<2; k++)
+	{
+		double dHeading = Input.dYaw*dPIover180 - m_dState[EST_BIAS];
+		double dSin = sin(dHeading);
+		double dCos = cos(dHeading);
+		double dPredForward = dSin*m_dState[EST_VX] + dCos*m_dState[EST_VY];
+		double dPredSide = dCos*m_dState[EST_VX] - dSin*m_dState[EST_VY];
+
+		for(int i=0; i<EST_COUNT; i++)
+		{
+			adH[i] = 0.0;
+		}
+		if(0 == k)
+		{
+			adH[EST_VX] = dSin;
+			adH[EST_VY] = dCos;
+			adH[EST_BIAS] = -dPredSide;
+			Update(adH, dForward - dPredForward, dSigma*dSigma, false);
+		}
+		else
+		{
+			adH[EST_VX] = dCos;
+			adH[EST_VY] = -dSin;
+			adH[EST_BIAS] = dPredForward;
+			Update(adH, dSide - dPredSide, dSigma*dSigma, false);
+		}
+	}
+
+	// Magnetometer gives the true heading
+	if(Input.bHasMagneto)
+	{
+		for(int i=0; i<EST_COUNT; i++)
+		{
+			adH[i] = 0.0;
+		}
+		adH[EST_BIAS] = -1.0;
+		double dInnovation = WrapPi((Input.dMagnetoHeading - Input.dYaw)*dPIover180 + m_dState[EST_BIAS]);
+		Update(adH, dInnovation, dEstSigmaMagneto*dEstSigmaMagneto, true);
+	}
+
+	// Altitudes
+	for(int i=0; i<EST_COUNT; i++)
+	{
+		adH[i] = 0.0;
+	}
+	adH[EST_Z] = 1.0;
+	if(Input.bHasSonar && (Input.dSonarAltitude < dEstSonarMax))
+	{
+		Update(adH, Input.dSonarAltitude - m_dState[EST_Z], dEstSigmaSonar*dEstSigmaSonar, true);
+	}
+	if(Input.bHasPressure)
+	{
+		if(!m_bHasPressureOffset)
+		{
+			m_dPressureOffset = Input.dPressureAltitude - m_dState[EST_Z];
+			m_bHasPressureOffset = true;
+		}
+		Update(adH, Input.dPressureAltitude - m_dPressureOffset - m_dState[EST_Z], dEstSigmaPressure*dEstSigmaPressure, true);
+	}
+
+	// GPS, once per fix
+	if(Input.bHasGps && (Input.uiGpsFrame != m_uiLastGpsFrame))
+	{
+		m_uiLastGpsFrame = Input.uiGpsFrame;
+
+		// The first fix is where we are now
+		if(!m_bHasOrigin)
+		{
+			m_bHasOrigin = true;
+			m_dOriginLatitude = Input.dLatitude;
+			m_dOriginLongitude = Input.dLongitude;
+			m_dOriginCos = cos(Input.dLatitude*dPIover180);
+			m_dOriginX = m_dState[EST_X];
+			m_dOriginY = m_dState[EST_Y];
+		}
+
+		// Local projection, good enough for the distances a drone flies
+		double dX = m_dOriginX + (Input.dLongitude - m_dOriginLongitude)*dPIover180*dEarthRadius*m_dOriginCos;
+		double dY = m_dOriginY + (Input.dLatitude - m_dOriginLatitude)*dPIover180*dEarthRadius;
+
+		double dSigmaGps = Input.dGpsAccuracy;
+		if(dSigmaGps <= 0.0)
+		{
+			dSigmaGps = (Input.dGpsHdop > 0.0) ? Input.dGpsHdop*dEstGpsUere : 10.0*dEstGpsUere;
+		}
+		if(dSigmaGps < dEstSigmaGpsMin)
+		{
+			dSigmaGps = dEstSigmaGpsMin;
+		}
+
+		for(int i=0; i<EST_COUNT; i++)
+		{
+			adH[i] = 0.0;
+		}
+		adH[EST_X] = 1.0;
+		Update(adH, dX - m_dState[EST_X], dSigmaGps*dSigmaGps, true);
+		adH[EST_X] = 0.0;
+		adH[EST_Y] = 1.0;
+		Update(adH, dY - m_dState[EST_Y], dSigmaGps*dSigmaGps, true);
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Correct with one scalar measurement
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Jacobian row, innovation (measured - predicted), variance of the
+//        measurement, gate the innovation or not
+// [RETURN] : false if the measurement has been rejected
+//////////////////////////////////////////////////////////////////////////////
+bool CEstimator::Update(const double* pdH, double dInnovation, double dVariance, bool bGate)
+{
+	// P.Ht, which is also (H.P)t as P is symmetric
+	double adPH[EST_COUNT];
+	double dS = dVariance;
+	for(int i=0; i<EST_COUNT; i++)
+	{
+		adPH[i] = 0.0;
+		for(int j=0; j<EST_COUNT; j++)
+		{
+			adPH[i] += m_dCovariance[i][j]*pdH[j];
+		}
+		dS += pdH[i]*adPH[i];
+	}
+
+	if(dS <= 0.0)
+	{
+		return false;
+	}
+	if(bGate && (dInnovation*dInnovation > dEstGate*dEstGate*dS))
+	{
+		m_ulRejected++;
+		return false;
+	}
+
+	// K = P.Ht/S, x += K.y, P -= K.H.P
+	for(int i=0; i<EST_COUNT; i++)
+	{
+		double dGain = adPH[i]/dS;
+		m_dState[i] += dGain*dInnovation;
+		for(int j=0; j<EST_COUNT; j++)
+		{
+			m_dCovariance[i][j] -= dGain*adPH[j];
+		}
+	}
+
+	// Keep P symmetric against rounding errors
+	for(int i=0; i<EST_COUNT; i++)
+	{
+		for(int j=i+1; j<EST_COUNT; j++)
+		{
+			double dValue = (m_dCovariance[i][j] + m_dCovariance[j][i])*0.5;
+			m_dCovariance[i][j] = dValue;
+			m_dCovariance[j][i] = dValue;
+		}
+	}
+
+	m_dState[EST_BIAS] = WrapPi(m_dState[EST_BIAS]);
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get one of the estimated values
+//////////////////////////////////////////////////////////////////////////////
+double CEstimator::GetState(eEstimatorState State) const
+{
+	return m_dState[State];
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Horizontal accuracy (one sigma, m)
+//////////////////////////////////////////////////////////////////////////////
+double CEstimator::GetAccuracy() const
+{
+	return sqrt(m_dCovariance[EST_X][EST_X] + m_dCovariance[EST_Y][EST_Y]);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Measurements rejected by the gate since the last reset
+//////////////////////////////////////////////////////////////////////////////
+unsigned long CEstimator::GetRejected() const
+{
+	return m_ulRejected;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get an angle between -pi and pi
+//////////////////////////////////////////////////////////////////////////////
+double CEstimator::WrapPi(double dAngle)
+{
+	dAngle = fmod(dAngle + M_PI, 2.0*M_PI);
+	if(dAngle < 0.0)
+	{
+		dAngle += 2.0*M_PI;
+	}
+	return dAngle - M_PI;
+}
@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CEstimator
+//////////////////////////////////////////////////////////////////////////////
+// Extended Kalman filter estimating the position of the drone from home.
+// Fuses the velocities, the heading, the magnetometer, the altitudes
+// (ultrasound and pressure) and the GPS of each navdata.
+// The matrices have a fixed size and nothing is allocated: one instance
+// runs on the navdata thread at the rate of the navdata.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_ESTIMATOR__
+#define __HEADER_ESTIMATOR__
+
+// States of the filter
+enum eEstimatorState
+{
+	EST_X = 0,		// Position east of home (m)
+	EST_Y,			// Position north of home (m)
+	EST_VX,			// Velocity east (m/s)
+	EST_VY,			// Velocity north (m/s)
+	EST_BIAS,		// Heading bias: drone heading - true heading (rad)
+	EST_Z,			// Altitude (m)
+	EST_VZ,			// Vertical velocity (m/s)
+	EST_COUNT
+};
+
+// Process noises (variance per second)
+const double dEstNoisePosition	= 0.01;
+const double dEstNoiseVelocity	= 1.0;
+const double dEstNoiseBias		= 0.0001;
+const double dEstNoiseVertical	= 0.5;
+
+// Measurement noises (standard deviations)
+const double dEstSigmaVelocity	= 0.15;		// m/s
+const double dEstSigmaGround	= 0.02;		// m/s, not flying = not moving
+const double dEstSigmaMagneto	= 0.17;		// rad (10 degrees)
+const double dEstSigmaSonar		= 0.05;		// m
+const double dEstSigmaPressure	= 1.5;		// m
+const double dEstSigmaGpsMin	= 1.5;		// m, best accuracy given to a GPS fix
+const double dEstGpsUere		= 5.0;		// m, error of a GPS fix per unit of hdop
+
+// Innovations further than this number of sigmas are rejected
+const double dEstGate			= 5.0;
+
+// Ultrasound altitude is only valid below this altitude (m)
+const double dEstSonarMax		= 5.0;
+
+// Measurements of one navdata
+struct sEstimatorInput
+{
+	bool			bFlying;			// Not flying = not moving
+	double			dYaw;				// Heading of the drone (degrees)
+	double			dVelocityForward;	// m/s
+	double			dVelocitySide;		// m/s
+
+	bool			bHasMagneto;
+	double			dMagnetoHeading;	// Heading of the magnetometer only (degrees)
+
+	bool			bHasSonar;
+	double			dSonarAltitude;		// m
+	bool			bHasPressure;
+	double			dPressureAltitude;	// m, relative to an unknown reference
+
+	bool			bHasGps;
+	unsigned int	uiGpsFrame;			// Changes with each new fix
+	double			dLatitude;
+	double			dLongitude;
+	double			dGpsAccuracy;		// m (0 = unknown)
+	double			dGpsHdop;
+};
+
+// Measurements of a navdata (the gps block is only valid with firmware 2.4)
+struct ARDRONE_NAVDATA;
+void NavdataToEstimatorInput(const ARDRONE_NAVDATA& Navdata, bool bHasGpsBlock, sEstimatorInput& Input);
+
+// Describe the estimator class
+class CEstimator
+{
+public:
+	// Constructor
+	CEstimator();
+	// Destructor
+	~CEstimator();
+
+	// Start again from home, optionally with the GPS coordinates of home
+	void Reset(bool bHasHome = false, double dHomeLatitude = 0.0, double dHomeLongitude = 0.0);
+
+	// Move the state forward by dTime seconds
+	void Predict(double dTime);
+
+	// Correct the state with the measurements of one navdata
+	void Correct(const sEstimatorInput& Input);
+
+	// Estimated values
+	double GetState(eEstimatorState State) const;
+	// Horizontal accuracy (one sigma, m)
+	double GetAccuracy() const;
+
+	// Measurements rejected by the gate since the last reset
+	unsigned long GetRejected() const;
+
+private:
+	// Correct with one scalar measurement: H is the jacobian row
+	// Returns false if the innovation is rejected by the gate
+	bool Update(const double* pdH, double dInnovation, double dVariance, bool bGate);
+
+	// Get an angle between -pi and pi
+	static double WrapPi(double dAngle);
+
+private:
+	// State and its covariance
+	double			m_dState[EST_COUNT];
+	double			m_dCovariance[EST_COUNT][EST_COUNT];
+
+	// Reference of the GPS: the position of (m_dOriginLatitude, m_dOriginLongitude)
+	bool			m_bHasOrigin;
+	double			m_dOriginLatitude;
+	double			m_dOriginLongitude;
+	double			m_dOriginCos;
+	double			m_dOriginX;
+	double			m_dOriginY;
+	unsigned int	m_uiLastGpsFrame;
+
+	// Pressure altitude = altitude - offset, learnt at the first pressure
+	bool			m_bHasPressureOffset;
+	double			m_dPressureOffset;
+
+	unsigned long	m_ulRejected;
+};
+
+#endif
@@ -0,0 +1,206 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CFrameScaler
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <opencv2/opencv.hpp>
+
+#include "FrameScaler.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default constructor of CFrameScaler
+//////////////////////////////////////////////////////////////////////////////
+CFrameScaler::CFrameScaler()
+{
+	m_pucData		= NULL;
+	m_iDstWidth		= 0;
+	m_iDstHeight	= 0;
+	m_iSrcWidth		= 0;
+	m_iSrcHeight	= 0;
+	m_piX0			= NULL;
+	m_piX1			= NULL;
+	m_piWX			= NULL;
+	m_piY0			= NULL;
+	m_piY1			= NULL;
+	m_piWY			= NULL;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default destructor of CFrameScaler
+//////////////////////////////////////////////////////////////////////////////
+CFrameScaler::~CFrameScaler()
+{
+	Release();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Free the buffers
+//////////////////////////////////////////////////////////////////////////////
+void CFrameScaler::Release()
+{
+	free(m_pucData);
+	free(m_piX0);
+	free(m_piX1);
+	free(m_piWX);
+	free(m_piY0);
+	free(m_piY1);
+	free(m_piWY);
+
+	m_pucData = NULL;
+	m_piX0 = m_piX1 = m_piWX = NULL;
+	m_piY0 = m_piY1 = m_piWY = NULL;
+	m_iDstWidth = m_iDstHeight = 0;
+	m_iSrcWidth = m_iSrcHeight = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the size of the destination
+//////////////////////////////////////////////////////////////////////////////
+// [IN]		: Size of the destination (panel)
+// [RETURN]	: true on success, false if the memory could not be allocated
+//////////////////////////////////////////////////////////////////////////////
+bool CFrameScaler::SetDestination(int iWidth, int iHeight)
+{
+	if( (iWidth == m_iDstWidth) && (iHeight == m_iDstHeight) )
+	{
+		return (NULL != m_pucData);
+	}
+
+	Release();
+
+	if( (0 >= iWidth) || (0 >= iHeight) )
+	{
+		return false;
+	}
+
+	m_pucData	= (unsigned char*)malloc(iWidth * iHeight * 3);
+	m_piX0		= (int*)malloc(iWidth * sizeof(int));
+	m_piX1		= (int*)malloc(iWidth * sizeof(int));
+	m_piWX		= (int*)malloc(iWidth * sizeof(int));
+	m_piY0		= (int*)malloc(iHeight * sizeof(int));
+	m_piY1		= (int*)malloc(iHeight * sizeof(int));
+	m_piWY		= (int*)malloc(iHeight * sizeof(int));
+
+	if( !m_pucData || !m_piX0 || !m_piX1 || !m_piWX || !m_piY0 || !m_piY1 || !m_piWY )
+	{
+		Release();
+		return false;
+	}
+
+	m_iDstWidth = iWidth;
+	m_iDstHeight = iHeight;
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Fill the tables for a new source size
+//////////////////////////////////////////////////////////////////////////////
+void CFrameScaler::ComputeTables(int iSrcWidth, int iSrcHeight)
+{
+	// Pixel centers are aligned, positions out of the source are clamped
+	double dScaleX = (double)iSrcWidth / (double)m_iDstWidth;
+	for(int x = 0; x < m_iDstWidth; x++)
+	{
+		double dX = (x + 0.5) * dScaleX - 0.5;
+		if(dX < 0.0) dX = 0.0;
+		int iX = (int)dX;
+		if(iX > iSrcWidth - 1) iX = iSrcWidth - 1;
+
+		m_piX0[x] = iX * 3;
+		m_piX1[x] = ((iX < iSrcWidth - 1) ? iX + 1 : iX) * 3;
+		m_piWX[x] = (int)((dX - iX) * 256.0);
+	}
+
+	double dScaleY = (double)iSrcHeight / (double)m_iDstHeight;
+	for(int y = 0; y < m_iDstHeight; y++)
+	{
+		double dY = (y + 0.5) * dScaleY - 0.5;
+		if(dY < 0.0) dY = 0.0;
+		int iY = (int)dY;
+		if(iY > iSrcHeight - 1) iY = iSrcHeight - 1;
+
+		m_piY0[y] = iY;
+		m_piY1[y] = (iY < iSrcHeight - 1) ? iY + 1 : iY;
+		m_piWY[y] = (int)((dY - iY) * 256.0);
+	}
+
+	m_iSrcWidth = iSrcWidth;
+	m_iSrcHeight = iSrcHeight;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Convert a BGR image into the destination
+//////////////////////////////////////////////////////////////////////////////
+// [IN]		: Source image (BGR), its size and the bytes per line
+// [RETURN]	: true on success
+//////////////////////////////////////////////////////////////////////////////
+bool CFrameScaler::Convert(const unsigned char* pucSrc, int iSrcWidth, int iSrcHeight, int iSrcStep)
+{
+	if( (NULL == m_pucData) || (NULL == pucSrc) || (0 >= iSrcWidth) || (0 >= iSrcHeight) )
+	{
+		return false;
+	}
+
+	// Same size, only swap the colors
+	if( (iSrcWidth == m_iDstWidth) && (iSrcHeight == m_iDstHeight) )
+	{
+		ToRGB(pucSrc, iSrcWidth, iSrcHeight, iSrcStep, m_pucData);
+		return true;
+	}
+
+	if( (iSrcWidth != m_iSrcWidth) || (iSrcHeight != m_iSrcHeight) )
+	{
+		ComputeTables(iSrcWidth, iSrcHeight);
+	}
+
+	// Bilinear interpolation in fixed point, the channels are written in reverse order
+	unsigned char* pucDst = m_pucData;
+	for(int y = 0; y < m_iDstHeight; y++)
+	{
+		const unsigned char* pucRow0 = pucSrc + m_piY0[y] * iSrcStep;
+		const unsigned char* pucRow1 = pucSrc + m_piY1[y] * iSrcStep;
+		const int iWY1 = m_piWY[y];
+		const int iWY0 = 256 - iWY1;
+
+		for(int x = 0; x < m_iDstWidth; x++)
+		{
+			const unsigned char* p00 = pucRow0 + m_piX0[x];
+			const unsigned char* p01 = pucRow0 + m_piX1[x];
+			const unsigned char* p10 = pucRow1 + m_piX0[x];
+			const unsigned char* p11 = pucRow1 + m_piX1[x];
+			const int iWX1 = m_piWX[x];
+			const int iWX0 = 256 - iWX1;
+
+			for(int c = 0; c < 3; c++)
+			{
+				int iTop	= p00[c] * iWX0 + p01[c] * iWX1;
+				int iBottom	= p10[c] * iWX0 + p11[c] * iWX1;
+				pucDst[2 - c] = (unsigned char)((iTop * iWY0 + iBottom * iWY1 + 32768) >> 16);
+			}
+			pucDst += 3;
+		}
+	}
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Swap BGR to RGB without resizing (uses the vectorized code of OpenCV)
+//////////////////////////////////////////////////////////////////////////////
+// [IN]		: Source image (BGR), its size and the bytes per line
+// [OUT]	: Destination (RGB, no padding)
+//////////////////////////////////////////////////////////////////////////////
+/*static*/ void CFrameScaler::ToRGB(const unsigned char* pucSrc, int iWidth, int iHeight, int iSrcStep, unsigned char* pucDst)
+{
+	cv::Mat Src(iHeight, iWidth, CV_8UC3, (void*)pucSrc, iSrcStep);
+	cv::Mat Dst(iHeight, iWidth, CV_8UC3, pucDst);
+	cv::cvtColor(Src, Dst, cv::COLOR_BGR2RGB);
+}
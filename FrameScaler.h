@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CFrameScaler
+//////////////////////////////////////////////////////////////////////////////
+// Converts the BGR image of the drone into a RGB image of the panel size,
+// swapping the colors and resizing in the same pass
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_FRAMESCALER__
+#define __HEADER_FRAMESCALER__
+
+// Describe the scaler class
+class CFrameScaler
+{
+private:
+	// Destination image (RGB, 3 bytes per pixel, no padding)
+	unsigned char*	m_pucData;
+	int				m_iDstWidth;
+	int				m_iDstHeight;
+
+	// Source size the tables have been computed for
+	int				m_iSrcWidth;
+	int				m_iSrcHeight;
+
+	// Bilinear tables, one entry per destination column and row
+	// Offsets are in bytes for columns and in lines for rows, weights in 1/256
+	int*			m_piX0;
+	int*			m_piX1;
+	int*			m_piWX;
+	int*			m_piY0;
+	int*			m_piY1;
+	int*			m_piWY;
+
+	// Free the buffers
+	void Release();
+	// Fill the tables for a new source size
+	void ComputeTables(int iSrcWidth, int iSrcHeight);
+
+public:
+	CFrameScaler();
+	~CFrameScaler();
+
+	// Set the size of the destination, buffers are only reallocated here
+	bool SetDestination(int iWidth, int iHeight);
+
+	// Convert a BGR image into the destination
+	bool Convert(const unsigned char* pucSrc, int iSrcWidth, int iSrcHeight, int iSrcStep);
+
+	// Access the destination image
+	unsigned char* GetData() { return m_pucData; }
+	int GetWidth() { return m_iDstWidth; }
+	int GetHeight() { return m_iDstHeight; }
+
+	// Swap BGR to RGB without resizing
+	static void ToRGB(const unsigned char* pucSrc, int iWidth, int iHeight, int iSrcStep, unsigned char* pucDst);
+};
+
+#endif
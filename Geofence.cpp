@@ -0,0 +1,666 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CGeofence
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <float.h>
+#include <chrono>
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+#include "Utils.h"
+#include "AutoPilot.h"	// Radius of the earth
+#include "Geofence.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Limit a move between -1 and 1
+//////////////////////////////////////////////////////////////////////////////
+static float ClampMove(double dMove)
+{
+	if(dMove > 1.0)
+	{
+		return 1.0f;
+	}
+	if(dMove < -1.0)
+	{
+		return -1.0f;
+	}
+	return (float)dMove;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Distance from a point to a segment
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Point, ends of the segment
+// [OUT] : Closest point of the segment
+// [RETURN] : Distance
+//////////////////////////////////////////////////////////////////////////////
+static double SegmentDistance(double dX, double dY, double dX1, double dY1, double dX2, double dY2, double& dNearX, double& dNearY)
+{
+	double dDx = dX2 - dX1;
+	double dDy = dY2 - dY1;
+	double dLength = dDx*dDx + dDy*dDy;
+	double dT = (dLength > 0.0) ? ((dX - dX1)*dDx + (dY - dY1)*dDy) / dLength : 0.0;
+	if(dT < 0.0)
+	{
+		dT = 0.0;
+	}
+	else if(dT > 1.0)
+	{
+		dT = 1.0;
+	}
+	dNearX = dX1 + dT*dDx;
+	dNearY = dY1 + dT*dDy;
+	return sqrt((dX - dNearX)*(dX - dNearX) + (dY - dNearY)*(dY - dNearY));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Check if a segment touches a box (Liang-Barsky clipping)
+//////////////////////////////////////////////////////////////////////////////
+static bool SegmentTouchesBox(double dX1, double dY1, double dX2, double dY2, double dMinX, double dMinY, double dMaxX, double dMaxY)
+{
+	double adP[4] = { -(dX2 - dX1), dX2 - dX1, -(dY2 - dY1), dY2 - dY1 };
+	double adQ[4] = { dX1 - dMinX, dMaxX - dX1, dY1 - dMinY, dMaxY - dY1 };
+	double dIn = 0.0;
+	double dOut = 1.0;
+
+	for(int i=0; i<4; i++)
+	{
+		if(0.0 == adP[i])
+		{
+			if(adQ[i] < 0.0)
+			{
+				return false;
+			}
+			continue;
+		}
+		double dT = adQ[i] / adP[i];
+		if(adP[i] < 0.0)
+		{
+			if(dT > dIn)
+			{
+				dIn = dT;
+			}
+		}
+		else if(dT < dOut)
+		{
+			dOut = dT;
+		}
+	}
+
+	return (dIn <= dOut);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Constructor
+//////////////////////////////////////////////////////////////////////////////
+CGeofence::CGeofence()
+{
+	m_State.bEnabled = false;
+	m_State.bBreach = false;
+	m_State.dDistance = 0.0;
+	m_State.dNormalX = 0.0;
+	m_State.dNormalY = 0.0;
+	m_State.iZone = 0;
+	m_State.ulBreaches = 0;
+	m_State.lCost = 0;
+	m_dHeading = 0.0;
+	m_llBreachTime = 0;
+	m_bHomeSet = false;
+	m_bHomeGps = false;
+	m_dHomeLatitude = 0.0;
+	m_dHomeLongitude = 0.0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor
+//////////////////////////////////////////////////////////////////////////////
+CGeofence::~CGeofence()
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Load the zones
+// One zone per line: keepin|keepout circle [gps] x y radius
+//                    keepin|keepout polygon [gps] x1 y1 x2 y2 x3 y3 ...
+// x is east and y north of home in meters, with "gps" they are replaced by
+// latitude and longitude in degrees (the radius stays in meters)
+// Lines beginning with "//", "#" or ";" are comments
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : File
+// [RETURN] : true if a geofence has been loaded
+//////////////////////////////////////////////////////////////////////////////
+bool CGeofence::Load(const wxString& strFile)
+{
+	std::vector<sZone> Zones;
+	wxTextFile FenceFile(strFile);
+
+	if(!FenceFile.Exists())
+	{
+		DoLog(wxString("No geofence, file not found ") + strFile);
+	}
+	else if(!FenceFile.Open())
+	{
+		DoLog(wxString("Failed to open geofence file ") + strFile, MSG_ERROR);
+	}
+	else
+	{
+		for(size_t lPos = 0; lPos < FenceFile.GetLineCount(); lPos++)
+		{
+			wxString strTmp = FenceFile.GetLine(lPos);
+			strTmp.Trim(false);
+			strTmp.Trim(true);
+
+			// Ignore empty strings or commented strings
+			if( strTmp.IsEmpty() || (strTmp.Left(1) == ";") || (strTmp.Left(1) == "#") || (strTmp.Left(2) == "//") )
+			{
+				continue;
+			}
+
+			sZone Zone;
+			Zone.iLine = (int)lPos+1;
+			Zone.bPlaced = false;
+			Zone.dRadius = 0.0;
+
+			wxStringTokenizer Tokenizer(strTmp, " \t,");
+			wxString strType = Tokenizer.GetNextToken().Lower();
+			wxString strShape = Tokenizer.GetNextToken().Lower();
+			bool bValid = ( (strType == "keepin") || (strType == "keepout") ) && ( (strShape == "circle") || (strShape == "polygon") );
+			Zone.Type = (strType == "keepin") ? FENCE_KEEPIN : FENCE_KEEPOUT;
+			Zone.bCircle = (strShape == "circle");
+			Zone.bGps = false;
+
+			// Coordinates, latitude first for gps
+			std::vector<double> adValues;
+			while(bValid && Tokenizer.HasMoreTokens())
+			{
+				wxString strValue = Tokenizer.GetNextToken();
+				double dValue = 0.0;
+				if( adValues.empty() && !Zone.bGps && (strValue.Lower() == "gps") )
+				{
+					Zone.bGps = true;
+				}
+				else if(strValue.ToCDouble(&dValue))
+				{
+					adValues.push_back(dValue);
+				}
+				else
+				{
+					bValid = false;
+				}
+			}
+
+			if(Zone.bCircle)
+			{
+				bValid = bValid && (3 == adValues.size()) && (adValues[2] > 0.0);
+			}
+			else
+			{
+				bValid = bValid && (adValues.size() >= 6) && (0 == (adValues.size() % 2)) && ((int)adValues.size() <= 2*iFenceMaxVertices);
+			}
+			if(!bValid)
+			{
+				DoLog(wxString::Format("Geofence file %s, line %d: invalid zone", strFile, Zone.iLine), MSG_ERROR);
+				Zones.clear();
+				break;
+			}
+
+			for(size_t i = 0; i + 1 < adValues.size(); i += 2)
+			{
+				Zone.adRawX.push_back(Zone.bGps ? adValues[i+1] : adValues[i]);
+				Zone.adRawY.push_back(Zone.bGps ? adValues[i] : adValues[i+1]);
+			}
+			if(Zone.bCircle)
+			{
+				Zone.dRadius = adValues[2];
+			}
+
+			if((int)Zones.size() >= iFenceMaxZones)
+			{
+				DoLog(wxString::Format("Geofence file %s: more than %d zones", strFile, iFenceMaxZones), MSG_ERROR);
+				Zones.clear();
+				break;
+			}
+			Zones.push_back(Zone);
+		}
+	}
+
+	wxCriticalSectionLocker Lock(m_CSGeofence);
+
+	m_Zones.swap(Zones);
+	m_State.bEnabled = false;
+	m_State.bBreach = false;
+
+	if(!m_Zones.empty())
+	{
+		DoLog(wxString::Format("Geofence loaded, %d zones", (int)m_Zones.size()));
+	}
+
+	// Changed during a flight, the new zones are used at once
+	if(m_bHomeSet)
+	{
+		PlaceZones();
+	}
+
+	return !m_Zones.empty();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set home and place the zones from it
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : GPS coordinates of home, if known
+//////////////////////////////////////////////////////////////////////////////
+void CGeofence::SetHome(bool bHasGps, double dHomeLatitude, double dHomeLongitude)
+{
+	wxCriticalSectionLocker Lock(m_CSGeofence);
+
+	m_bHomeSet = true;
+	m_bHomeGps = bHasGps;
+	m_dHomeLatitude = dHomeLatitude;
+	m_dHomeLongitude = dHomeLongitude;
+	PlaceZones();
+
+	m_State.bEnabled = false;
+	m_State.bBreach = false;
+	m_State.ulBreaches = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Place the zones from the last home and build their index
+// Note: the lock is held by the caller
+//////////////////////////////////////////////////////////////////////////////
+void CGeofence::PlaceZones()
+{
+	double dCos = cos(m_dHomeLatitude*dPIover180);
+
+	for(size_t i = 0; i < m_Zones.size(); i++)
+	{
+		sZone& Zone = m_Zones[i];
+
+		Zone.bPlaced = !Zone.bGps || m_bHomeGps;
+		if(!Zone.bPlaced)
+		{
+			DoLog(wxString::Format("Geofence zone of line %d ignored, the position of home is unknown", Zone.iLine), MSG_WARNING);
+			continue;
+		}
+
+		Zone.adX.resize(Zone.adRawX.size());
+		Zone.adY.resize(Zone.adRawY.size());
+		for(size_t j = 0; j < Zone.adRawX.size(); j++)
+		{
+			if(Zone.bGps)
+			{
+				Zone.adX[j] = (Zone.adRawX[j] - m_dHomeLongitude)*dPIover180*dEarthRadius*dCos;
+				Zone.adY[j] = (Zone.adRawY[j] - m_dHomeLatitude)*dPIover180*dEarthRadius;
+			}
+			else
+			{
+				Zone.adX[j] = Zone.adRawX[j];
+				Zone.adY[j] = Zone.adRawY[j];
+			}
+		}
+
+		if(!Zone.bCircle)
+		{
+			BuildIndex(Zone);
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Evaluate the estimated position
+// Note: called by the navdata thread for each navdata
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Position from home (m), true heading (degrees)
+//////////////////////////////////////////////////////////////////////////////
+void CGeofence::Update(double dX, double dY, double dHeading)
+{
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	wxCriticalSectionLocker Lock(m_CSGeofence);
+
+	m_dHeading = dHeading;
+
+	// The closest boundary of all zones
+	bool bEnabled = false;
+	double dDistance = DBL_MAX;
+	double dNormalX = 0.0;
+	double dNormalY = 0.0;
+	int iZone = 0;
+	for(size_t i = 0; i < m_Zones.size(); i++)
+	{
+		if(!m_Zones[i].bPlaced)
+		{
+			continue;
+		}
+
+		double dZoneNormalX = 0.0;
+		double dZoneNormalY = 0.0;
+		double dZoneDistance = Evaluate(m_Zones[i], dX, dY, dZoneNormalX, dZoneNormalY);
+		if(dZoneDistance < dDistance)
+		{
+			dDistance = dZoneDistance;
+			dNormalX = dZoneNormalX;
+			dNormalY = dZoneNormalY;
+			iZone = m_Zones[i].iLine;
+		}
+		bEnabled = true;
+	}
+
+	m_State.bEnabled = bEnabled;
+	if(!bEnabled)
+	{
+		return;
+	}
+
+	m_State.dDistance = dDistance;
+	m_State.dNormalX = dNormalX;
+	m_State.dNormalY = dNormalY;
+	m_State.iZone = iZone;
+
+	// Breach events, the drone has to come back a little before the next one
+	if(!m_State.bBreach && (dDistance < 0.0))
+	{
+		m_State.bBreach = true;
+		m_State.ulBreaches++;
+		m_llBreachTime = wxGetUTCTimeUSec();
+		DoLog(wxString::Format("Geofence breached: zone of line %d, %.1f m beyond at (%.1f, %.1f)", iZone, -dDistance, dX, dY), MSG_WARNING);
+	}
+	else if(m_State.bBreach && (dDistance > dFenceHysteresis))
+	{
+		m_State.bBreach = false;
+		DoLog(wxString::Format("Back inside the geofence after %.1f s", (wxGetUTCTimeUSec() - m_llBreachTime).ToDouble() * 0.000001f), MSG_WARNING);
+	}
+
+	m_State.lCost = (long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Limit a move
+// Near a boundary, the part of the move toward it is reduced with the
+// distance left, beyond it is replaced by a move back to the allowed area
+//////////////////////////////////////////////////////////////////////////////
+// [IN/OUT] : Side and forward moves
+//////////////////////////////////////////////////////////////////////////////
+void CGeofence::Limit(float& fSide, float& fForward)
+{
+	wxCriticalSectionLocker Lock(m_CSGeofence);
+
+	if( !m_State.bEnabled || (!m_State.bBreach && (m_State.dDistance >= dFenceMargin)) )
+	{
+		return;
+	}
+
+	// Move in the frame of the ground
+	double dSin = sin(m_dHeading*dPIover180);
+	double dCos = cos(m_dHeading*dPIover180);
+	double dMoveX = dSin*fForward + dCos*fSide;
+	double dMoveY = dCos*fForward - dSin*fSide;
+
+	double dToward = -(dMoveX*m_State.dNormalX + dMoveY*m_State.dNormalY);
+	if(dToward > 0.0)
+	{
+		double dKeep = ( (m_State.dDistance > 0.0) && !m_State.bBreach ) ? m_State.dDistance / dFenceMargin : 0.0;
+		dMoveX += m_State.dNormalX * dToward * (1.0 - dKeep);
+		dMoveY += m_State.dNormalY * dToward * (1.0 - dKeep);
+	}
+	if(m_State.bBreach)
+	{
+		dMoveX += m_State.dNormalX * dFenceReturnMove;
+		dMoveY += m_State.dNormalY * dFenceReturnMove;
+	}
+
+	fForward = ClampMove(dSin*dMoveX + dCos*dMoveY);
+	fSide = ClampMove(dCos*dMoveX - dSin*dMoveY);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Status
+//////////////////////////////////////////////////////////////////////////////
+void CGeofence::GetState(sFenceState& State)
+{
+	wxCriticalSectionLocker Lock(m_CSGeofence);
+	State = m_State;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Build the index of a polygon
+// Each cell lists the edges touching it (distance), each row the edges
+// crossing it (inside or not)
+//////////////////////////////////////////////////////////////////////////////
+void CGeofence::BuildIndex(sZone& Zone)
+{
+	int iCount = (int)Zone.adX.size();
+
+	double dMaxX = Zone.adX[0];
+	double dMaxY = Zone.adY[0];
+	Zone.dMinX = Zone.adX[0];
+	Zone.dMinY = Zone.adY[0];
+	for(int i = 1; i < iCount; i++)
+	{
+		Zone.dMinX = wxMin(Zone.dMinX, Zone.adX[i]);
+		Zone.dMinY = wxMin(Zone.dMinY, Zone.adY[i]);
+		dMaxX = wxMax(dMaxX, Zone.adX[i]);
+		dMaxY = wxMax(dMaxY, Zone.adY[i]);
+	}
+
+	Zone.dCell = dFenceCellSize;
+	while(ceil((dMaxX - Zone.dMinX) / Zone.dCell) * ceil((dMaxY - Zone.dMinY) / Zone.dCell) > iFenceMaxCells)
+	{
+		Zone.dCell *= 2.0;
+	}
+	Zone.iCols = wxMax(1, (int)ceil((dMaxX - Zone.dMinX) / Zone.dCell));
+	Zone.iRows = wxMax(1, (int)ceil((dMaxY - Zone.dMinY) / Zone.dCell));
+
+	std::vector< std::vector<int> > Cells(Zone.iCols * Zone.iRows);
+	std::vector< std::vector<int> > Rows(Zone.iRows);
+	for(int i = 0; i < iCount; i++)
+	{
+		int j = (i + 1) % iCount;
+		double dX1 = Zone.adX[i];
+		double dY1 = Zone.adY[i];
+		double dX2 = Zone.adX[j];
+		double dY2 = Zone.adY[j];
+
+		int iCol1 = wxMin(Zone.iCols - 1, (int)((wxMin(dX1, dX2) - Zone.dMinX) / Zone.dCell));
+		int iCol2 = wxMin(Zone.iCols - 1, (int)((wxMax(dX1, dX2) - Zone.dMinX) / Zone.dCell));
+		int iRow1 = wxMin(Zone.iRows - 1, (int)((wxMin(dY1, dY2) - Zone.dMinY) / Zone.dCell));
+		int iRow2 = wxMin(Zone.iRows - 1, (int)((wxMax(dY1, dY2) - Zone.dMinY) / Zone.dCell));
+		for(int iRow = iRow1; iRow <= iRow2; iRow++)
+		{
+			Rows[iRow].push_back(i);
+			for(int iCol = iCol1; iCol <= iCol2; iCol++)
+			{
+				double dCellX = Zone.dMinX + iCol * Zone.dCell;
+				double dCellY = Zone.dMinY + iRow * Zone.dCell;
+				if(SegmentTouchesBox(dX1, dY1, dX2, dY2, dCellX, dCellY, dCellX + Zone.dCell, dCellY + Zone.dCell))
+				{
+					Cells[iRow * Zone.iCols + iCol].push_back(i);
+				}
+			}
+		}
+	}
+
+	// Flat lists
+	Zone.aiCellFirst.assign(1, 0);
+	Zone.aiCellEdges.clear();
+	for(size_t i = 0; i < Cells.size(); i++)
+	{
+		Zone.aiCellEdges.insert(Zone.aiCellEdges.end(), Cells[i].begin(), Cells[i].end());
+		Zone.aiCellFirst.push_back((int)Zone.aiCellEdges.size());
+	}
+	Zone.aiRowFirst.assign(1, 0);
+	Zone.aiRowEdges.clear();
+	for(size_t i = 0; i < Rows.size(); i++)
+	{
+		Zone.aiRowEdges.insert(Zone.aiRowEdges.end(), Rows[i].begin(), Rows[i].end());
+		Zone.aiRowFirst.push_back((int)Zone.aiRowEdges.size());
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Signed distance to a zone
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Zone, position (m)
+// [OUT] : Direction from the closest boundary toward the allowed side
+// [RETURN] : Distance to the closest boundary, > 0 on the allowed side
+//////////////////////////////////////////////////////////////////////////////
+double CGeofence::Evaluate(const sZone& Zone, double dX, double dY, double& dNormalX, double& dNormalY)
+{
+	double dDistance = 0.0;
+	double dAwayX = 0.0;
+	double dAwayY = 1.0;
+	bool bInside = false;
+	bool bAllowed = false;
+
+	if(Zone.bCircle)
+	{
+		double dDx = dX - Zone.adX[0];
+		double dDy = dY - Zone.adY[0];
+		double dCenter = sqrt(dDx*dDx + dDy*dDy);
+		bInside = (dCenter < Zone.dRadius);
+		bAllowed = (FENCE_KEEPIN == Zone.Type) ? bInside : !bInside;
+		dDistance = wxMin(fabs(Zone.dRadius - dCenter), bAllowed ? dFenceRange : DBL_MAX);
+		if(dCenter > 0.0)
+		{
+			// Away from the boundary, toward the outside when outside
+			dAwayX = (bInside ? -dDx : dDx) / dCenter;
+			dAwayY = (bInside ? -dDy : dDy) / dCenter;
+		}
+	}
+	else
+	{
+		double dNearX = dX;
+		double dNearY = dY;
+		bInside = IsInside(Zone, dX, dY);
+		bAllowed = (FENCE_KEEPIN == Zone.Type) ? bInside : !bInside;
+
+		// Far from the boundaries, their direction does not matter on the allowed side
+		dDistance = DistanceToEdges(Zone, dX, dY, bAllowed ? dFenceRange : DBL_MAX, dNearX, dNearY);
+		if( (dDistance > 0.0) && (dDistance < dFenceRange || !bAllowed) )
+		{
+			dAwayX = (dX - dNearX) / dDistance;
+			dAwayY = (dY - dNearY) / dDistance;
+		}
+	}
+
+	// Allowed side: inside a keep in zone, outside a keep out one
+	dNormalX = bAllowed ? dAwayX : -dAwayX;
+	dNormalY = bAllowed ? dAwayY : -dAwayY;
+
+	return bAllowed ? dDistance : -dDistance;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Check if a point is inside a polygon (crossings of the ray toward east,
+// only with the edges of its row)
+//////////////////////////////////////////////////////////////////////////////
+bool CGeofence::IsInside(const sZone& Zone, double dX, double dY)
+{
+	if( (dX < Zone.dMinX) || (dY < Zone.dMinY) || (dX > Zone.dMinX + Zone.iCols * Zone.dCell) || (dY > Zone.dMinY + Zone.iRows * Zone.dCell) )
+	{
+		return false;
+	}
+
+	int iRow = wxMin(Zone.iRows - 1, (int)((dY - Zone.dMinY) / Zone.dCell));
+	int iCount = (int)Zone.adX.size();
+	bool bInside = false;
+	for(int k = Zone.aiRowFirst[iRow]; k < Zone.aiRowFirst[iRow + 1]; k++)
+	{
+		int i = Zone.aiRowEdges[k];
+		int j = (i + 1) % iCount;
+		if( (Zone.adY[i] > dY) != (Zone.adY[j] > dY) )
+		{
+			double dCrossX = Zone.adX[i] + (dY - Zone.adY[i]) * (Zone.adX[j] - Zone.adX[i]) / (Zone.adY[j] - Zone.adY[i]);
+			if(dX < dCrossX)
+			{
+				bInside = !bInside;
+			}
+		}
+	}
+
+	return bInside;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Distance from a point to the edges of a polygon
+// The cells are searched by rings around the point (or its projection on the
+// grid), until the next ring cannot hold a closer edge or is out of range
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Zone, position (m), maximum distance searched
+// [OUT] : Closest point of the edges (unchanged if out of range)
+// [RETURN] : Distance, dRange if out of range
+//////////////////////////////////////////////////////////////////////////////
+double CGeofence::DistanceToEdges(const sZone& Zone, double dX, double dY, double dRange, double& dNearX, double& dNearY)
+{
+	int iCount = (int)Zone.adX.size();
+
+	// A point outside the grid starts from the cell of its projection on the grid
+	int iCol = (int)floor((dX - Zone.dMinX) / Zone.dCell);
+	int iRow = (int)floor((dY - Zone.dMinY) / Zone.dCell);
+	iCol = wxMax(0, wxMin(Zone.iCols - 1, iCol));
+	iRow = wxMax(0, wxMin(Zone.iRows - 1, iRow));
+
+	double dBest = dRange;
+	int iRingMax = wxMax(Zone.iCols, Zone.iRows);
+	for(int iRing = 0; iRing <= iRingMax; iRing++)
+	{
+		for(int r = iRow - iRing; r <= iRow + iRing; r++)
+		{
+			if( (r < 0) || (r >= Zone.iRows) )
+			{
+				continue;
+			}
+
+			// Full first and last rows of the ring, only both ends for the others
+			int iStep = ( (r == iRow - iRing) || (r == iRow + iRing) ) ? 1 : 2*iRing;
+			for(int c = iCol - iRing; c <= iCol + iRing; c += iStep)
+			{
+				if( (c < 0) || (c >= Zone.iCols) )
+				{
+					continue;
+				}
+
+				int iCell = r * Zone.iCols + c;
+				for(int k = Zone.aiCellFirst[iCell]; k < Zone.aiCellFirst[iCell + 1]; k++)
+				{
+					int i = Zone.aiCellEdges[k];
+					int j = (i + 1) % iCount;
+					double dEdgeX = 0.0;
+					double dEdgeY = 0.0;
+					double dDistance = SegmentDistance(dX, dY, Zone.adX[i], Zone.adY[i], Zone.adX[j], Zone.adY[j], dEdgeX, dEdgeY);
+					if(dDistance < dBest)
+					{
+						dBest = dDistance;
+						dNearX = dEdgeX;
+						dNearY = dEdgeY;
+					}
+				}
+			}
+		}
+
+		// The cells of the next ring are at least iRing cells away from the start cell, so from the projection.
+		// Outside the grid, the point is even further: the grid is convex and holds all the edges, so any
+		// point of it is closer to the projection than to the point
+		if(dBest <= iRing * Zone.dCell)
+		{
+			break;
+		}
+	}
+
+	return dBest;
+}
@@ -0,0 +1,135 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CGeofence
+//////////////////////////////////////////////////////////////////////////////
+// Horizontal limits of the flight: circles and polygons the drone must stay
+// in (keep in) or out of (keep out), in meters from home or in gps
+// coordinates. Each polygon is indexed by a grid, so that the distance to the
+// closest boundary of the estimated position costs a few microseconds at the
+// rate of the navdata. The moves of the drone are then limited near and
+// beyond the boundaries.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_GEOFENCE__
+#define __HEADER_GEOFENCE__
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <vector>
+
+// Zones of the geofence, loaded when connecting and when the file changes
+#define GEOFENCE_FILE				"Data/Config/Geofence.txt"
+
+// Limits of the file
+const int iFenceMaxZones			= 32;
+const int iFenceMaxVertices			= 1024;
+
+// Size of the cells of the index (m), larger if a polygon would need more than iFenceMaxCells
+const double dFenceCellSize			= 5.0;
+const int iFenceMaxCells			= 16384;
+
+// On the allowed side, boundaries are only searched up to this distance (m)
+const double dFenceRange			= 50.0;
+
+// Moves toward a boundary are slowed down closer than this (m)
+const double dFenceMargin			= 5.0;
+// Move bringing the drone back once the boundary is crossed, until it is dFenceHysteresis (m) back inside
+const double dFenceReturnMove		= 0.2;
+const double dFenceHysteresis		= 0.5;
+
+// Type of a zone
+enum eFenceType
+{
+	FENCE_KEEPIN = 0,		// The drone must stay inside
+	FENCE_KEEPOUT			// The drone must stay outside
+};
+
+// State of the geofence at the last estimated position
+struct sFenceState
+{
+	bool			bEnabled;		// At least one zone
+	bool			bBreach;		// The drone is in a forbidden area
+	double			dDistance;		// To the closest boundary (m, up to dFenceRange), < 0 in a forbidden area
+	double			dNormalX;		// Direction away from this boundary, toward the allowed area (east, north)
+	double			dNormalY;
+	int				iZone;			// Zone of this boundary (line of the file)
+	unsigned long	ulBreaches;		// Since the take off
+	long			lCost;			// Time of the last evaluation (ns)
+};
+
+// Describe the geofence class
+class CGeofence
+{
+public:
+	// Constructor
+	CGeofence();
+	// Destructor
+	~CGeofence();
+
+	// Load the zones, a missing file means no geofence (placed at once if home is already set)
+	bool Load(const wxString& strFile);
+
+	// Place the zones from home (gps zones are ignored without the coordinates of home), at each take off
+	void SetHome(bool bHasGps, double dHomeLatitude, double dHomeLongitude);
+
+	// Evaluate the estimated position (called by the navdata thread)
+	void Update(double dX, double dY, double dHeading);
+
+	// Limit a move (same meaning as the parameters of CustomMove)
+	void Limit(float& fSide, float& fForward);
+
+	// Status
+	void GetState(sFenceState& State);
+
+private:
+	// A zone, with the index of its polygon
+	struct sZone
+	{
+		eFenceType			Type;
+		bool				bCircle;
+		bool				bGps;
+		int					iLine;
+		bool				bPlaced;		// Local coordinates computed
+		// Coordinates read (meters or latitude/longitude), for a circle center then radius
+		std::vector<double>	adRawX;
+		std::vector<double>	adRawY;
+		double				dRadius;
+		// Local coordinates (m east and north of home)
+		std::vector<double>	adX;
+		std::vector<double>	adY;
+		// Grid of the polygon: edges touching each cell and edges crossing each row (first index of each list, then the lists)
+		double				dMinX;
+		double				dMinY;
+		double				dCell;
+		int					iCols;
+		int					iRows;
+		std::vector<int>	aiCellFirst;
+		std::vector<int>	aiCellEdges;
+		std::vector<int>	aiRowFirst;
+		std::vector<int>	aiRowEdges;
+	};
+
+	// Place the zones from the last home (the lock is held)
+	void PlaceZones();
+	// Build the index of a polygon
+	static void BuildIndex(sZone& Zone);
+	// Signed distance to a zone, > 0 on the allowed side, and direction toward the allowed side
+	static double Evaluate(const sZone& Zone, double dX, double dY, double& dNormalX, double& dNormalY);
+	static bool IsInside(const sZone& Zone, double dX, double dY);
+	static double DistanceToEdges(const sZone& Zone, double dX, double dY, double dRange, double& dNearX, double& dNearY);
+
+private:
+	// Protects everything, the navdata thread evaluates while the control thread limits
+	wxCriticalSection		m_CSGeofence;
+
+	std::vector<sZone>		m_Zones;
+	sFenceState				m_State;
+	// Last home, for the zones loaded after it
+	bool					m_bHomeSet;
+	bool					m_bHomeGps;
+	double					m_dHomeLatitude;
+	double					m_dHomeLongitude;
+	double					m_dHeading;
+	wxLongLong				m_llBreachTime;
+};
+
+#endif
@@ -0,0 +1,155 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CHudText
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#include "HudText.h"
+#include "Utils.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default constructor of CHudText
+//////////////////////////////////////////////////////////////////////////////
+CHudText::CHudText()
+{
+	m_iAngle	= 0;
+	m_iOriginX	= 0;
+	m_iOriginY	= 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Set the text to display
+//////////////////////////////////////////////////////////////////////////////
+// [IN]		: Text, font, color and angle (degrees, counter clockwise)
+// [RETURN]	: true if the bitmap has been rendered again
+//////////////////////////////////////////////////////////////////////////////
+bool CHudText::Set(const wxString& strText, const wxFont& Font, const wxColour& Colour, int iAngle)
+{
+	if( m_Bitmap.IsOk() && (strText == m_strText) && (iAngle == m_iAngle) && (Colour == m_Colour) && (Font == m_Font) )
+	{
+		return false;
+	}
+
+	m_strText	= strText;
+	m_Font		= Font;
+	m_Colour	= Colour;
+	m_iAngle	= iAngle;
+
+	Render();
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Force the next Set() to render the bitmap
+//////////////////////////////////////////////////////////////////////////////
+void CHudText::Invalidate()
+{
+	m_Bitmap = wxNullBitmap;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Render the bitmap
+//////////////////////////////////////////////////////////////////////////////
+void CHudText::Render()
+{
+	m_Bitmap = wxNullBitmap;
+
+	if(m_strText.IsEmpty())
+	{
+		return;
+	}
+
+	// Size of the text
+	wxMemoryDC dc;
+	dc.SetFont(m_Font);
+	wxCoord Width = 0, Height = 0;
+	dc.GetTextExtent(m_strText, &Width, &Height);
+
+	// Bounding box of the rotated text, the y axis points down
+	double dCos = cos(m_iAngle * dPIover180);
+	double dSin = sin(m_iAngle * dPIover180);
+	double adX[4] = { 0.0, Width * dCos, Height * dSin, Width * dCos + Height * dSin };
+	double adY[4] = { 0.0, -Width * dSin, Height * dCos, Height * dCos - Width * dSin };
+	double dMinX = 0.0, dMaxX = 0.0, dMinY = 0.0, dMaxY = 0.0;
+	for(int i = 1; i < 4; i++)
+	{
+		dMinX = wxMin(dMinX, adX[i]);
+		dMaxX = wxMax(dMaxX, adX[i]);
+		dMinY = wxMin(dMinY, adY[i]);
+		dMaxY = wxMax(dMaxY, adY[i]);
+	}
+
+	m_iOriginX = (int)ceil(-dMinX) + 1;
+	m_iOriginY = (int)ceil(-dMinY) + 1;
+	int iWidth = (int)ceil(dMaxX - dMinX) + 2;
+	int iHeight = (int)ceil(dMaxY - dMinY) + 2;
+
+	// Draw white text on black, the grey level becomes the alpha channel
+	wxBitmap Bitmap(iWidth, iHeight, 24);
+	dc.SelectObject(Bitmap);
+	dc.SetBackground(*wxBLACK_BRUSH);
+	dc.Clear();
+	dc.SetTextForeground(*wxWHITE);
+	if(0 == m_iAngle)
+	{
+		dc.DrawText(m_strText, m_iOriginX, m_iOriginY);
+	}
+	else
+	{
+		dc.DrawRotatedText(m_strText, m_iOriginX, m_iOriginY, m_iAngle);
+	}
+	dc.SelectObject(wxNullBitmap);
+
+	wxImage Image = Bitmap.ConvertToImage();
+	Image.SetAlpha();
+	unsigned char* pucData = Image.GetData();
+	unsigned char* pucAlpha = Image.GetAlpha();
+	for(int i = 0; i < iWidth * iHeight; i++)
+	{
+		pucAlpha[i] = wxMax(pucData[0], wxMax(pucData[1], pucData[2]));
+		pucData[0] = m_Colour.Red();
+		pucData[1] = m_Colour.Green();
+		pucData[2] = m_Colour.Blue();
+		pucData += 3;
+	}
+
+	m_Bitmap = wxBitmap(Image, 32);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Draw centered in a rectangle
+//////////////////////////////////////////////////////////////////////////////
+void CHudText::DrawCentered(wxDC& dc, const wxRect& Rect)
+{
+	if(m_Bitmap.IsOk())
+	{
+		dc.DrawBitmap(m_Bitmap, Rect.x + (Rect.width - m_Bitmap.GetWidth()) / 2, Rect.y + (Rect.height - m_Bitmap.GetHeight()) / 2, true);
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Draw with the text origin at a position
+//////////////////////////////////////////////////////////////////////////////
+void CHudText::Draw(wxDC& dc, int iX, int iY)
+{
+	if(m_Bitmap.IsOk())
+	{
+		dc.DrawBitmap(m_Bitmap, iX - m_iOriginX, iY - m_iOriginY, true);
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Width of the text
+//////////////////////////////////////////////////////////////////////////////
+int CHudText::GetWidth()
+{
+	return m_Bitmap.IsOk() ? m_Bitmap.GetWidth() : 0;
+}
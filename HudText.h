@@ -0,0 +1,49 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CHudText
+//////////////////////////////////////////////////////////////////////////////
+// A text of the HUD rendered once into a transparent bitmap, the bitmap is
+// only rendered again when the text, the font, the color or the angle change
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_HUDTEXT__
+#define __HEADER_HUDTEXT__
+
+// Includes
+#include <wx/wx.h>
+
+// Describe the text class
+class CHudText
+{
+private:
+	// What is rendered
+	wxString		m_strText;
+	wxFont			m_Font;
+	wxColour		m_Colour;
+	int				m_iAngle;
+
+	// The rendered text, with alpha
+	wxBitmap		m_Bitmap;
+	// Position of the text origin (top left before rotation) in the bitmap
+	int				m_iOriginX;
+	int				m_iOriginY;
+
+	// Render the bitmap
+	void Render();
+
+public:
+	CHudText();
+
+	// Set the text to display, returns true if the bitmap had to be rendered again
+	bool Set(const wxString& strText, const wxFont& Font, const wxColour& Colour, int iAngle = 0);
+	// Force the next Set() to render the bitmap
+	void Invalidate();
+
+	// Draw centered in a rectangle
+	void DrawCentered(wxDC& dc, const wxRect& Rect);
+	// Draw with the text origin at a position (like wxDC::DrawRotatedText)
+	void Draw(wxDC& dc, int iX, int iY);
+	// Width of the text
+	int GetWidth();
+};
+
+#endif
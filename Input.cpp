@@ -2,6 +2,8 @@
 // Manage input : Handles all key states and joystick positions
 /////////////////////////////////////////////////////////////////////////////
 
+#include <math.h>
+#include <string.h>
 #include <wx/textfile.h>
 
 #include "Input.h"
@@ -20,7 +22,8 @@ CInput::CInput()
 	// FPS
 	m_lFps				= 0;
 	// Start timer
-	m_lTime				= 0;
+	m_llTime			= 0;
+	m_lStepRemainder	= 0;
 
 	// Max values
 	m_dMaxSpeed			= 0.5f;
@@ -45,8 +48,35 @@ CInput::CInput()
 	m_iRecord			= -1;
 	m_iScreenshot		= -1;
 	
+	// Nothing published yet
+	m_uiSequence		= 0;
+	for(int i=0; i<4; i++)
+	{
+		m_adPublishedDirections[i] = 0.0f;
+	}
+	m_lPublishedFps			= 0;
+	m_lPublishedLatency		= 0;
+	m_lPublishedLatencyMax	= 0;
+	m_ulPublishedChanges	= 0;
+	m_llPublishedChange		= 0;
+	m_llPublishedUpdate		= 0;
+
 	// Init joystick
 	m_pJoystick			= NULL;
+	memset(&m_JoystickState, 0, sizeof(m_JoystickState));
+	m_lJoystickLatency		= 0;
+	m_lJoystickLatencyMax	= 0;
+	m_lJoystickLatencyPeak	= 0;
+	m_llJoystickLatencyTime	= 0;
+	for(int i=0; i<4; i++)
+	{
+		m_adChangeReference[i] = 0.0f;
+		m_aiKeyState[i] = 0;
+		m_allKeyTime[i] = 0;
+	}
+	m_ulChanges				= 0;
+	m_llChange				= 0;
+	m_llUpdate				= 0;
 	int iJoysticks = wxJoystick::GetNumberJoysticks();
 	if(iJoysticks > 0)
 	{
@@ -66,6 +96,18 @@ CInput::CInput()
 	m_Directions[IDX_FORWARD].SetKeys(WXK_DOWN, WXK_UP);
 	m_Directions[IDX_SIDE].SetKeys(WXK_LEFT, WXK_RIGHT);
 
+	// Response curves of the sticks, in the order of eDirection
+	const char* aszDirections[4] = { "Forward", "Side", "Turn", "Altitude" };
+	for(int i=0; i<4; i++)
+	{
+		sInputCurve Curve = m_Directions[i].GetCurve();
+		if(LoadInputCurve(aszDirections[i], Curve))
+		{
+			m_Directions[i].SetCurve(Curve);
+			DoLog(wxString::Format("Curve of %s: expo %.2f, dead zone %.2f, rate %.2f%s", aszDirections[i], Curve.dExpo, Curve.dDeadZone, Curve.dRate, Curve.bRescale ? ", rescaled" : ""));
+		}
+	}
+
 	// Call refresh layout, which will set the right keys for altitude and yaw
 	// depending on current language
 	RefreshLayout();
@@ -105,32 +147,55 @@ void CInput::SetLimits(double dSpeedLimit, double dAccelerationLimit)
 // Refresh key states
 // Return true if a function key (Emergency, Land...) has been pressed
 /////////////////////////////////////////////////////////////////////////////
-void CInput::Update(long lTimeNew)
+void CInput::Update(const wxLongLong& llTimeNew)
 {
 
 	wxCriticalSectionLocker Lock(m_CSInput);
 
-	long lTimediff	= lTimeNew-m_lTime;
+	long lTimediff	= (m_llTime == 0) ? 0 : (llTimeNew - m_llTime).ToLong();
+	m_llTime = llTimeNew;
 
-	// Avoid division by zero
-	if(0 == lTimediff)
+	// calculate FPS
+	if(lTimediff > 0)
 	{
-		lTimediff = 1;
+		m_lFps = 1000000/lTimediff;
 	}
 
-	// calculate FPS
-	m_lFps = 1000/lTimediff;
+	// Number of fixed steps to integrate (Drone movement speed should not depend on computer performance)
+	// After a long stall the missed steps are dropped instead of jumping
+	m_lStepRemainder += wxMax(lTimediff, 0L);
+	int iSteps = (int)(m_lStepRemainder / lInputStep);
+	m_lStepRemainder -= iSteps * lInputStep;
+	iSteps = wxMin(iSteps, iInputMaxSteps);
+
+	double dAcceleration = (lInputStep / 1000000.0f) * m_dMaxAcceleration;
+	double dDecceleration = (lInputStep / 1000000.0f) * m_dMaxDecceleration;
 
-	// Calculate multiplicator (Drone movement speed should not depend on computer performance)
-	double dDeltaTime =((double)lTimediff)/1000.0f;
-	m_lTime = lTimeNew;
+	// Read all axes and buttons of the joystick at once
+	long long llNow = wxGetUTCTimeUSec().GetValue();
+	bool bNewReport = false;
+	if(NULL != m_pJoystick)
+	{
+		unsigned long ulReports = m_JoystickState.ulReports;
+		m_pJoystick->GetState(m_JoystickState);
 
-	double dAcceleration = dDeltaTime * m_dMaxAcceleration;
-	double dDecceleration = dDeltaTime * m_dMaxDecceleration;
+		// Delay between a new report of the joystick and its use (max per second)
+		bNewReport = (ulReports != m_JoystickState.ulReports);
+		if(bNewReport)
+		{
+			m_lJoystickLatency = (long)(llNow - m_JoystickState.llTime);
+			m_lJoystickLatencyPeak = wxMax(m_lJoystickLatencyPeak, m_lJoystickLatency);
+			if(llNow - m_llJoystickLatencyTime >= 1000000)
+			{
+				m_lJoystickLatencyMax = m_lJoystickLatencyPeak;
+				m_lJoystickLatencyPeak = 0;
+				m_llJoystickLatencyTime = llNow;
+			}
+		}
+	}
 
 	// *Note*: Special keys have a double check, so if the user press a key, the action will only be done
 	// one time, even if the key stay pressed down.
-    DoLog("On Input update 1");
 	// Emergency
 	if( wxGetKeyState(m_kEmergency) || IsJoystickButtonPressed(KEY_EMERGENCY) )
 	{
@@ -144,7 +209,6 @@ void CInput::Update(long lTimeNew)
 	{
 		ResetKey(KEY_EMERGENCY);
 	}
-	DoLog("On Input update 4");
 	// Fullscreen
 	if( wxGetKeyState(m_kFullscreen) || IsJoystickButtonPressed(KEY_FULLSCREEN) )
 	{
@@ -232,8 +296,93 @@ void CInput::Update(long lTimeNew)
 	// Refresh the values of all axes
 	for(int i=0; i<4; i++)
 	{
-		m_Directions[i].UpdateDirection(dAcceleration, dDecceleration, m_dMaxSpeed);
+		m_Directions[i].UpdateDirection(m_JoystickState, iSteps, dAcceleration, dDecceleration, m_dMaxSpeed);
 	}
+
+	// The keys are ramped: their change starts at the first update they are pressed (or released)
+	for(int i=0; i<4; i++)
+	{
+		int iKeyState = m_Directions[i].GetKeyState();
+		if(iKeyState != m_aiKeyState[i])
+		{
+			m_aiKeyState[i] = iKeyState;
+			m_allKeyTime[i] = llNow;
+		}
+	}
+
+	// A change of the directions starts at the keys, at the report of the joystick, or now
+	bool bChanged = false;
+	long long llKeyTime = 0;
+	for(int i=0; i<4; i++)
+	{
+		if(fabs(m_Directions[i].GetVectorValue() - m_adChangeReference[i]) >= dInputChange)
+		{
+			bChanged = true;
+			if( (0 != m_allKeyTime[i]) && ((0 == llKeyTime) || (m_allKeyTime[i] < llKeyTime)) )
+			{
+				llKeyTime = m_allKeyTime[i];
+			}
+		}
+	}
+	if(bChanged)
+	{
+		for(int i=0; i<4; i++)
+		{
+			m_adChangeReference[i] = m_Directions[i].GetVectorValue();
+			m_allKeyTime[i] = 0;
+		}
+		m_ulChanges++;
+		m_llChange = (0 != llKeyTime) ? llKeyTime : (bNewReport ? m_JoystickState.llTime : llNow);
+	}
+	m_llUpdate = llNow;
+
+	Publish();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Publish the state of an update
+// Note: only called by Update()
+/////////////////////////////////////////////////////////////////////////////
+void CInput::Publish()
+{
+	m_uiSequence.fetch_add(1, std::memory_order_acq_rel);
+	for(int i=0; i<4; i++)
+	{
+		m_adPublishedDirections[i].store(m_Directions[i].GetVectorValue(), std::memory_order_relaxed);
+	}
+	m_lPublishedFps.store(m_lFps, std::memory_order_relaxed);
+	m_lPublishedLatency.store(m_lJoystickLatency, std::memory_order_relaxed);
+	m_lPublishedLatencyMax.store(m_lJoystickLatencyMax, std::memory_order_relaxed);
+	m_ulPublishedChanges.store(m_ulChanges, std::memory_order_relaxed);
+	m_llPublishedChange.store(m_llChange, std::memory_order_relaxed);
+	m_llPublishedUpdate.store(m_llUpdate, std::memory_order_relaxed);
+	m_uiSequence.fetch_add(1, std::memory_order_release);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Get the state of the last update, without lock
+/////////////////////////////////////////////////////////////////////////////
+void CInput::GetState(sInputState& State)
+{
+	unsigned int uiSequence = 0;
+	do
+	{
+		uiSequence = m_uiSequence.load(std::memory_order_acquire);
+		for(int i=0; i<4; i++)
+		{
+			State.adDirections[i] = m_adPublishedDirections[i].load(std::memory_order_relaxed);
+		}
+		State.lFps = m_lPublishedFps.load(std::memory_order_relaxed);
+		State.lJoystickLatency = m_lPublishedLatency.load(std::memory_order_relaxed);
+		State.lJoystickLatencyMax = m_lPublishedLatencyMax.load(std::memory_order_relaxed);
+		State.ulChanges = m_ulPublishedChanges.load(std::memory_order_relaxed);
+		State.llChange = m_llPublishedChange.load(std::memory_order_relaxed);
+		State.llUpdate = m_llPublishedUpdate.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	while( (uiSequence & 1) || (uiSequence != m_uiSequence.load(std::memory_order_relaxed)) );
 }
 
 
@@ -242,9 +391,7 @@ void CInput::Update(long lTimeNew)
 /////////////////////////////////////////////////////////////////////////////
 bool CInput::IsUpdateNeeded()
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	return (0 != m_usFlagStatus);
+	return (0 != m_usFlagStatus.load(std::memory_order_acquire));
 }
 
 
@@ -288,7 +435,7 @@ bool CInput::IsJoystickButtonPressed(eKey Key)
 		{
 			if(m_iEmergency > -1)
 			{
-				bPressed = m_pJoystick->GetButtonState((unsigned int)m_iEmergency);
+				bPressed = CJoystick::IsPressed(m_JoystickState, m_iEmergency);
 			}
 		}
 		break;
@@ -297,7 +444,7 @@ bool CInput::IsJoystickButtonPressed(eKey Key)
 		{
 			if(m_iFullscreen > -1)
 			{
-				bPressed = m_pJoystick->GetButtonState((unsigned int)m_iFullscreen);
+				bPressed = CJoystick::IsPressed(m_JoystickState, m_iFullscreen);
 			}
 		}
 		break;
@@ -306,7 +453,7 @@ bool CInput::IsJoystickButtonPressed(eKey Key)
 		{
 			if(m_iCamera > -1)
 			{
-				bPressed = m_pJoystick->GetButtonState((unsigned int)m_iCamera);
+				bPressed = CJoystick::IsPressed(m_JoystickState, m_iCamera);
 			}
 		}
 		break;
@@ -315,7 +462,7 @@ bool CInput::IsJoystickButtonPressed(eKey Key)
 		{
 			if(m_iTakeOff > -1)
 			{
-				bPressed = m_pJoystick->GetButtonState((unsigned int)m_iTakeOff);
+				bPressed = CJoystick::IsPressed(m_JoystickState, m_iTakeOff);
 			}
 		}
 		break;
@@ -324,7 +471,7 @@ bool CInput::IsJoystickButtonPressed(eKey Key)
 		{
 			if(m_iRecord > -1)
 			{
-				bPressed = m_pJoystick->GetButtonState((unsigned int)m_iRecord);
+				bPressed = CJoystick::IsPressed(m_JoystickState, m_iRecord);
 			}
 		}
 		break;
@@ -333,7 +480,7 @@ bool CInput::IsJoystickButtonPressed(eKey Key)
 		{
 			if(m_iScreenshot > -1)
 			{
-				bPressed = m_pJoystick->GetButtonState((unsigned int)m_iScreenshot);
+				bPressed = CJoystick::IsPressed(m_JoystickState, m_iScreenshot);
 			}
 		}
 		break;
@@ -342,7 +489,7 @@ bool CInput::IsJoystickButtonPressed(eKey Key)
 		{
 			if(m_iReturnHome > -1)
 			{
-				bPressed = m_pJoystick->GetButtonState((unsigned int)m_iReturnHome);
+				bPressed = CJoystick::IsPressed(m_JoystickState, m_iReturnHome);
 			}
 		}
 		break;
@@ -591,12 +738,11 @@ void CInput::RefreshLayout()
 
 /////////////////////////////////////////////////////////////////////////////
 // Get the current vector af a specific axe
+// Note: use GetState() to read several directions of the same update
 /////////////////////////////////////////////////////////////////////////////
-const double& CInput::GetDirectionValue(eDirection Direction)
+double CInput::GetDirectionValue(eDirection Direction)
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	return m_Directions[Direction].GetVectorValue();
+	return m_adPublishedDirections[Direction].load(std::memory_order_acquire);
 }
 
 
@@ -605,9 +751,7 @@ const double& CInput::GetDirectionValue(eDirection Direction)
 /////////////////////////////////////////////////////////////////////////////
 long CInput::GetFPS()
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	return m_lFps;
+	return m_lPublishedFps.load(std::memory_order_acquire);
 }
 
 
@@ -616,9 +760,7 @@ long CInput::GetFPS()
 /////////////////////////////////////////////////////////////////////////////
 void CInput::SetKey(eKey Key)
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	m_usKeyStatus |= Key;
+	m_usKeyStatus.fetch_or((unsigned short)Key, std::memory_order_acq_rel);
 }
 
 
@@ -627,9 +769,7 @@ void CInput::SetKey(eKey Key)
 /////////////////////////////////////////////////////////////////////////////
 void CInput::ResetKey(eKey Key)
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	m_usKeyStatus &= ~Key;
+	m_usKeyStatus.fetch_and((unsigned short)~Key, std::memory_order_acq_rel);
 }
 
 
@@ -638,9 +778,7 @@ void CInput::ResetKey(eKey Key)
 /////////////////////////////////////////////////////////////////////////////
 bool CInput::IsPressed(eKey Key)
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	return ((m_usKeyStatus & Key) == Key);
+	return ((m_usKeyStatus.load(std::memory_order_acquire) & Key) == Key);
 }
 
 
@@ -649,9 +787,7 @@ bool CInput::IsPressed(eKey Key)
 /////////////////////////////////////////////////////////////////////////////
 void CInput::SetFlag(eKey Key)
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	m_usFlagStatus |= Key;
+	m_usFlagStatus.fetch_or((unsigned short)Key, std::memory_order_acq_rel);
 }
 
 
@@ -660,9 +796,7 @@ void CInput::SetFlag(eKey Key)
 /////////////////////////////////////////////////////////////////////////////
 void CInput::ResetFlag(eKey Key)
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
-
-	m_usFlagStatus &= ~Key;
+	m_usFlagStatus.fetch_and((unsigned short)~Key, std::memory_order_acq_rel);
 }
 
 
@@ -671,9 +805,16 @@ void CInput::ResetFlag(eKey Key)
 /////////////////////////////////////////////////////////////////////////////
 bool CInput::HasFlag(eKey Key)
 {
-	wxCriticalSectionLocker Lock(m_CSInput);
+	return ((m_usFlagStatus.load(std::memory_order_acquire) & Key) == Key);
+}
+
 
-	return ((m_usFlagStatus & Key) == Key);
+/////////////////////////////////////////////////////////////////////////////
+// Check and reset a flag at once (the action is done by one thread only)
+/////////////////////////////////////////////////////////////////////////////
+bool CInput::TakeFlag(eKey Key)
+{
+	return ((m_usFlagStatus.fetch_and((unsigned short)~Key, std::memory_order_acq_rel) & Key) == Key);
 }
 
 
@@ -7,8 +7,15 @@
 
 
 #include <wx/wx.h>
+#include <atomic>
 #include "InputDirection.h"
 
+// Fixed timestep of the keys integration (us), and max steps done by an update
+const long lInputStep			= 10000L;
+const int iInputMaxSteps		= 10;
+// Move of a direction counted as a change of the input (traced up to the drone)
+const double dInputChange		= 0.05;
+
 // Enum for observed keys
 enum eKey
 {
@@ -40,6 +47,20 @@ enum eInputFileType
 	FILE_JOYSTICK	= 2,
 };
 
+// Snapshot of the input, published once per update
+struct sInputState
+{
+	double	adDirections[4];		// Vectors, in the order of eDirection
+	long	lFps;
+	long	lJoystickLatency;		// Delay between a report of the joystick and its use (us)
+	long	lJoystickLatencyMax;	// Max of the last second
+	unsigned long	ulChanges;		// Number of changes of the directions
+	long long		llChange;		// Time of the last change: joystick report, or update the keys were pressed (us, UTC)
+	long long		llUpdate;		// Time of the update (us, UTC)
+};
+
+// Update() is called by the control loop, the other threads read the published
+// state and the flags without lock. m_CSInput only protects the configuration.
 class CInput
 {
 public:
@@ -50,8 +71,8 @@ public:
 	// Set speed and acceleration limits
 	void SetLimits(double dSpeedLimit, double dAccelerationLimit);
 
-	// Refresh key states
-	void Update(long lTimeNew);
+	// Refresh key states (time in us)
+	void Update(const wxLongLong& llTimeNew);
 	// Check if an update is needed
 	bool IsUpdateNeeded();
 
@@ -70,8 +91,10 @@ public:
 	// As long keybord input has not been saved we need to adapt keyboard layout
 	void RefreshLayout();
 
+	// Get the state of the last update
+	void GetState(sInputState& State);
 	// Get the current vector for a specific direction
-	const double& GetDirectionValue(eDirection Direction);
+	double GetDirectionValue(eDirection Direction);
 
 	// Get current FPS
 	long GetFPS();	
@@ -89,6 +112,8 @@ public:
 	void ResetFlag(eKey Key);
 	// Check for flag
 	bool HasFlag(eKey Key);
+	// Check and reset a flag at once
+	bool TakeFlag(eKey Key);
 
 	// Set the joystick axe to use to control the direction
 	bool SetJoystickControl(eDirection Direction, eJoystickAxis JoystickAxeToUse, bool bIsInverted);
@@ -113,10 +138,13 @@ private:
 	// Get a value as string
 	wxString GetValueAsString(int iValue);
 
+	// Publish the state of an update
+	void Publish();
+
 	// Current key status (pressed or not)
-	unsigned short		m_usKeyStatus;
+	std::atomic<unsigned short>	m_usKeyStatus;
 	// Current flags (operation done or not)
-	unsigned short		m_usFlagStatus;
+	std::atomic<unsigned short>	m_usFlagStatus;
 
 	// Max speed (The drone accept speeds from -1.0 to 1.0)
 	double				m_dMaxSpeed;
@@ -127,11 +155,28 @@ private:
 
 	// Last FPS
 	long				m_lFps;	
-	// Last time
-	long				m_lTime;
+	// Last time (us)
+	wxLongLong			m_llTime;
+	// Time not integrated yet, less than a step (us)
+	long				m_lStepRemainder;
 
 	// Joystick controller
 	CJoystick*			m_pJoystick;
+	// State of the joystick, read once per update
+	sJoystickState		m_JoystickState;
+	// Delay between a report of the joystick and its use (us, last one, max of the last second)
+	long				m_lJoystickLatency;
+	long				m_lJoystickLatencyMax;
+	long				m_lJoystickLatencyPeak;
+	long long			m_llJoystickLatencyTime;
+	// Changes of the directions: directions at the last change, count, times of the last change and update
+	double				m_adChangeReference[4];
+	// Keys of each direction at the last update, and time they were pressed or released (0 = already given to a change)
+	int					m_aiKeyState[4];
+	long long			m_allKeyTime[4];
+	unsigned long		m_ulChanges;
+	long long			m_llChange;
+	long long			m_llUpdate;
 	// Controls of all axes
 	CInputDirection		m_Directions[4];
 
@@ -153,7 +198,17 @@ private:
 	int					m_iScreenshot;
 	int					m_iReturnHome;
 
-	// Critical section to protect data (set from one thread, read from another)
+	// Published state (one writer, lock free readers), odd while Update() writes it
+	std::atomic<unsigned int>	m_uiSequence;
+	std::atomic<double>			m_adPublishedDirections[4];
+	std::atomic<long>			m_lPublishedFps;
+	std::atomic<long>			m_lPublishedLatency;
+	std::atomic<long>			m_lPublishedLatencyMax;
+	std::atomic<unsigned long>	m_ulPublishedChanges;
+	std::atomic<long long>		m_llPublishedChange;
+	std::atomic<long long>		m_llPublishedUpdate;
+
+	// Critical section to protect the configuration (set from one thread, read from another)
 	wxCriticalSection	m_CSInput;
 };
 
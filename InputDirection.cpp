@@ -2,15 +2,78 @@
 // Manage one input direction
 /////////////////////////////////////////////////////////////////////////////
 
+#include <math.h>
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+
 #include "InputDirection.h"
 
 
+//////////////////////////////////////////////////////////////////////////////
+// Load the curve of a direction
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Name of the direction
+// [OUT] : Curve, unchanged if not found
+// [RETURN] : true if the curve has been found and is valid
+//////////////////////////////////////////////////////////////////////////////
+bool LoadInputCurve(const wxString& strDirection, sInputCurve& Curve)
+{
+	wxTextFile CurvesFile(INPUT_CURVES_FILE);
+
+	if(!CurvesFile.Exists() || !CurvesFile.Open())
+	{
+		return false;
+	}
+
+	for(size_t lPos = 0; lPos < CurvesFile.GetLineCount(); lPos++)
+	{
+		wxString strTmp = CurvesFile.GetLine(lPos);
+		strTmp.Trim(false);
+
+		// Ignore commented strings and other directions
+		if( (strTmp.Left(1) == ";") || (strTmp.Left(2) == "//") || (strTmp.BeforeFirst('=').Trim() != strDirection) )
+		{
+			continue;
+		}
+
+		double adValues[4];
+		int iCount = 0;
+		wxStringTokenizer Tokenizer(strTmp.AfterFirst('='), " \t");
+		while( Tokenizer.HasMoreTokens() && (iCount < 4) )
+		{
+			if(!Tokenizer.GetNextToken().ToCDouble(&adValues[iCount]))
+			{
+				break;
+			}
+			iCount++;
+		}
+
+		// The rescale flag is optional (0 by default)
+		if( (iCount < 3) || (adValues[0] < 0.0) || (adValues[0] > 1.0) || (adValues[1] < 0.0) || (adValues[1] >= 1.0) || (adValues[2] <= 0.0) ||
+			((iCount == 4) && (adValues[3] != 0.0) && (adValues[3] != 1.0)) )
+		{
+			DoLog(wxString::Format("Invalid curve for %s in %s, line %d", strDirection, INPUT_CURVES_FILE, (int)lPos+1), MSG_ERROR);
+			return false;
+		}
+
+		Curve.dExpo = adValues[0];
+		Curve.dDeadZone = adValues[1];
+		Curve.dRate = adValues[2];
+		Curve.bRescale = (iCount == 4) && (adValues[3] != 0.0);
+		return true;
+	}
+
+	return false;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Construction
 /////////////////////////////////////////////////////////////////////////////
 CInputDirection::CInputDirection()
 {
 	m_dVectorValue		= 0.0f;
+	m_iKeyState			= 0;
 
 	m_KeyDown			= WXK_NONE;
 	m_KeyUp				= WXK_NONE;
@@ -21,8 +84,15 @@ CInputDirection::CInputDirection()
 	m_dJoystickMin		= 0.0f;
 	m_dJoystickMax		= 0.0f;
 	m_dJoystickMiddle	= 0.0f;
-	m_dDeadZoneMin		= 0.0f;
-	m_dDeadZoneMax		= 0.0f;
+	m_dJoystickHalfRange	= 0.0f;
+
+	// Linear, 5% of dead zone, the stick position is used as it is out of it
+	sInputCurve Curve;
+	Curve.dExpo		= 0.0f;
+	Curve.dDeadZone	= 0.05f;
+	Curve.dRate		= 1.0f;
+	Curve.bRescale	= false;
+	SetCurve(Curve);
 }
 
 
@@ -67,62 +137,52 @@ void CInputDirection::SetJoystick(const eJoystickAxis& AxeToUse, CJoystick* pJoy
 		m_bInverted	= bIsInverted;
 		
 		// Get min and max value of the joystick
-		switch(m_Axe)
-		{
-			case AXIS_X:
-			{
-				m_dJoystickMin = (double)m_pJoystick->GetXMin();
-				m_dJoystickMax = (double)m_pJoystick->GetXMax();
-			}
-			break;
-
-			case AXIS_Y:
-			{
-				m_dJoystickMin = (double)m_pJoystick->GetYMin();
-				m_dJoystickMax = (double)m_pJoystick->GetYMax();
-			}
-			break;
-
-			case AXIS_RUDDER:
-			{
-				m_dJoystickMin = (double)m_pJoystick->GetRudderMin();
-				m_dJoystickMax = (double)m_pJoystick->GetRudderMax();
-			}
-			break;
+		int iMin = 0;
+		int iMax = 0;
+		m_pJoystick->GetAxisRange(m_Axe, iMin, iMax);
+		m_dJoystickMin = (double)iMin;
+		m_dJoystickMax = (double)iMax;
+
+		// Get middle position and half range of the joystick
+		m_dJoystickMiddle = (m_dJoystickMax + m_dJoystickMin)/2.0f;
+		m_dJoystickHalfRange = (m_dJoystickMax - m_dJoystickMin)/2.0f;
+	}
+}
 
-			case AXIS_U:
-			{
-				m_dJoystickMin = (double)m_pJoystick->GetUMin();
-				m_dJoystickMax = (double)m_pJoystick->GetUMax();
-			}
-			break;
 
-			case AXIS_V:
-			{
-				m_dJoystickMin = (double)m_pJoystick->GetVMin();
-				m_dJoystickMax = (double)m_pJoystick->GetVMax();
-			}
-			break;
+/////////////////////////////////////////////////////////////////////////////
+// Set the response curve of the stick
+// The curve is tabulated here, once, the updates only interpolate the table
+// Note: the dead zone is tested by the updates, so the output can jump at its edge
+/////////////////////////////////////////////////////////////////////////////
+void CInputDirection::SetCurve(const sInputCurve& Curve)
+{
+	m_Curve = Curve;
 
-			case AXIS_Z:
-			{
-				m_dJoystickMin = (double)m_pJoystick->GetZMin();
-				m_dJoystickMax = (double)m_pJoystick->GetZMax();
-			}
-			break;
+	for(int i=0; i<=iCurvePoints; i++)
+	{
+		double dValue = (double)i / (double)iCurvePoints;
 
-			default:
-				break;
+		// Rescaled: from 0 at the edge of the dead zone to 1
+		if(m_Curve.bRescale)
+		{
+			dValue = wxMax(dValue - m_Curve.dDeadZone, 0.0) / (1.0f - m_Curve.dDeadZone);
 		}
+		dValue = (1.0f - m_Curve.dExpo) * dValue + m_Curve.dExpo * dValue * dValue * dValue;
+		dValue = wxMin(dValue * m_Curve.dRate, 1.0);
 
-		// Get middle position of the joystick
-		m_dJoystickMiddle = (m_dJoystickMax - m_dJoystickMin)/2.0f;
-		// Get a dead zone range (5% of middle position)
-		double dDeadZone = m_dJoystickMiddle * 0.05f;
-		// Set min and max value for the dead zone
-		m_dDeadZoneMin = m_dJoystickMiddle - dDeadZone;
-		m_dDeadZoneMax = m_dJoystickMiddle + dDeadZone;
+		m_adCurve[i] = dValue;
 	}
+	m_adCurve[iCurvePoints + 1] = m_adCurve[iCurvePoints];
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Get the response curve of the stick
+/////////////////////////////////////////////////////////////////////////////
+const sInputCurve& CInputDirection::GetCurve()
+{
+	return m_Curve;
 }
 
 
@@ -164,77 +224,63 @@ bool CInputDirection::GetJoystickInvertedFlag()
 
 /////////////////////////////////////////////////////////////////////////////
 // Update values
+// The stick is read through its curve, the keys accelerate the value and it
+// goes back to 0 at the given rates per step, so the response does not depend
+// on how often the update is called
 /////////////////////////////////////////////////////////////////////////////
-void CInputDirection::UpdateDirection(const double& dAcceleration, const double& dDecceleration, const double& dMaxSpeed)
+void CInputDirection::UpdateDirection(const sJoystickState& JoystickState, int iSteps, const double& dAcceleration, const double& dDecceleration, const double& dMaxSpeed)
 {
-	bool bUseKeyboard = true;
-	bool bLetValueGoDown = true;
-
 	// If a joystick is set, check if it is currently in use
-	if(m_Axe != AXIS_NONE)
+	if( (m_Axe != AXIS_NONE) && (m_dJoystickHalfRange > 0.0f) )
 	{
-		double dValue = (double)m_pJoystick->GetRawValue(m_Axe);
-		
-		// Joystick is in use if the value is out of the dead zone
-		if( (dValue > m_dDeadZoneMax) || (dValue < m_dDeadZoneMin) )
-		{
-			bUseKeyboard = false;
-			bLetValueGoDown = false;
+		double dStick = ((double)JoystickState.aiAxes[CJoystick::GetAxisSlot(m_Axe)] - m_dJoystickMiddle) / m_dJoystickHalfRange;
 
-			dValue = (dValue-m_dJoystickMiddle)/m_dJoystickMiddle;
+		// Inverted axe
+		if(m_bInverted)
+		{
+			dStick = -1.0f * dStick;
+		}
 
-			// Inverted axe
-			if(m_bInverted)
-			{
-				dValue = -1.0f * dValue;
-			}
+		// Joystick is in use if the value is out of the dead zone
+		if(fabs(dStick) > m_Curve.dDeadZone)
+		{
+			// Position in the lookup table
+			double dPosition = wxMin(fabs(dStick), 1.0) * (double)iCurvePoints;
+			int iPoint = (int)dPosition;
+			double dValue = m_adCurve[iPoint] + (m_adCurve[iPoint + 1] - m_adCurve[iPoint]) * (dPosition - (double)iPoint);
 
 			// Reduce to max speed
-			m_dVectorValue = dValue * dMaxSpeed;
+			m_dVectorValue = ((dStick < 0.0f) ? -dValue : dValue) * dMaxSpeed;
+			m_iKeyState = 0;
+			return;
 		}
 	}
 
 	// Joystick is not present, not used for this axe or has not move, so check now for keys
-	if(bUseKeyboard)
+	bool bUp = wxGetKeyState(m_KeyUp);
+	bool bDown = !bUp && wxGetKeyState(m_KeyDown);
+	m_iKeyState = bUp ? 1 : (bDown ? -1 : 0);
+
+	for(int i=0; i<iSteps; i++)
 	{
-		// Vector up key pressed
-		if(wxGetKeyState(m_KeyUp))
+		if(bUp)
 		{
-			bLetValueGoDown = false;
-			if(m_dVectorValue < dMaxSpeed)
-			{				
-				m_dVectorValue += dAcceleration;
-			}
+			// Vector up key pressed
+			m_dVectorValue = wxMin(m_dVectorValue + dAcceleration, dMaxSpeed);
 		}
-		// Vector down key pressed
-		else if(wxGetKeyState(m_KeyDown))
+		else if(bDown)
 		{
-			bLetValueGoDown = false;
-			if(m_dVectorValue > -dMaxSpeed)
-			{
-				m_dVectorValue -= dAcceleration;
-			}
+			// Vector down key pressed
+			m_dVectorValue = wxMax(m_dVectorValue - dAcceleration, -dMaxSpeed);
 		}
-	}
-
-	// For this axe, the joystick and the keyboard are not used, so let the value go down
-	if(bLetValueGoDown)
-	{
-		if(m_dVectorValue != 0.0f)
+		else if(m_dVectorValue > 0.0f)
 		{
-			if(m_dVectorValue <= -0.01f)
-			{
-				m_dVectorValue += dDecceleration;
-			}
-			else if(m_dVectorValue >= 0.01f)
-			{
-				m_dVectorValue -= dDecceleration;
-			}
-			else
-			{
-				// Between -0,01 and 0,01 set the vector to 0, otherwise it may never be 0 because of rounding
-				m_dVectorValue = 0.0f;
-			}
+			// Let the value go down, up to 0 exactly
+			m_dVectorValue = wxMax(m_dVectorValue - dDecceleration, 0.0);
+		}
+		else if(m_dVectorValue < 0.0f)
+		{
+			m_dVectorValue = wxMin(m_dVectorValue + dDecceleration, 0.0);
 		}
 	}
 }
@@ -246,4 +292,13 @@ void CInputDirection::UpdateDirection(const double& dAcceleration, const double&
 const double& CInputDirection::GetVectorValue()
 {
 	return m_dVectorValue;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Get the key pressed at the last update (1 up, -1 down, 0 none)
+/////////////////////////////////////////////////////////////////////////////
+int CInputDirection::GetKeyState()
+{
+	return m_iKeyState;
 }
\ No newline at end of file
@@ -9,6 +9,25 @@
 #include <wx/wx.h>
 #include "Joystick.h"
 
+// File of the response curves of the sticks
+#define INPUT_CURVES_FILE			"Data/Config/Curves.ini"
+
+// Points of the lookup table of a curve (over 0..1 of the stick)
+const int iCurvePoints				= 256;
+
+// Response curve of a stick
+struct sInputCurve
+{
+	double	dExpo;			// 0 = linear, 1 = cubic
+	double	dDeadZone;		// Part of the half range ignored around the middle (0..1)
+	double	dRate;			// Output at full stick (part of the max speed, clipped to 1)
+	bool	bRescale;		// Out of the dead zone, start from 0 (true) or from the stick position (false, as without curve)
+};
+
+// Load the curve of a direction from INPUT_CURVES_FILE, the given curve is kept if missing
+// Format of a line: Direction=expo deadzone rate [rescale]
+bool LoadInputCurve(const wxString& strDirection, sInputCurve& Curve);
+
 
 class CInputDirection
 {
@@ -26,20 +45,28 @@ public:
 	wxKeyCode GetKeyUp();
 	wxKeyCode GetKeyDown();
 
+	// Set the response curve of the stick
+	void SetCurve(const sInputCurve& Curve);
+	const sInputCurve& GetCurve();
+
 	// Get joystick axe
 	eJoystickAxis GetJoystickAxe();
 	// Get the joystick inverted flag
 	bool GetJoystickInvertedFlag();
 
-	// Update values
-	void UpdateDirection(const double& dAcceleration, const double& dDecceleration, const double& dMaxSpeed);
+	// Update values, the keys are integrated over iSteps steps of the fixed timestep
+	void UpdateDirection(const sJoystickState& JoystickState, int iSteps, const double& dAcceleration, const double& dDecceleration, const double& dMaxSpeed);
 
 	// Get current vector value
 	const double& GetVectorValue();
+	// Key pressed at the last update: 1 up, -1 down, 0 none (or the joystick is used)
+	int GetKeyState();
 
 private:
 	// Current vector value
 	double			m_dVectorValue;
+	// Key pressed at the last update
+	int				m_iKeyState;
 
 	// The key to set the value down
 	wxKeyCode		m_KeyDown;
@@ -57,9 +84,12 @@ private:
 	double			m_dJoystickMax;
 	// Middle value of the joystick axe
 	double			m_dJoystickMiddle;
-	// Value of the "dead zone"
-	double			m_dDeadZoneMin;
-	double			m_dDeadZoneMax;
+	// Half of the range of the joystick axe
+	double			m_dJoystickHalfRange;
+
+	// Response curve, and its lookup table (last point repeated for the interpolation)
+	sInputCurve		m_Curve;
+	double			m_adCurve[iCurvePoints + 2];
 };
 
 #endif
\ No newline at end of file
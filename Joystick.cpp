@@ -5,6 +5,28 @@
 #include "Joystick.h"
 #include "Utils.h"
 
+#ifdef __LINUX__
+#include <linux/input.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+// Test a bit of an evdev bit array
+#define EVDEV_BIT(array, bit)	((array[(bit)/8] >> ((bit)%8)) & 1)
+
+// Time of an event with the headers older than the 64 bits time_t on 32 bits systems
+#ifndef input_event_sec
+#define input_event_sec		time.tv_sec
+#define input_event_usec	time.tv_usec
+#endif
+
+// Axes of wxJoystick, in the order of its axis numbers
+static const eJoystickAxis aWxAxes[iJoystickAxes] = { AXIS_X, AXIS_Y, AXIS_Z, AXIS_RUDDER, AXIS_U, AXIS_V };
+#endif
+
 
 /////////////////////////////////////////////////////////////////////////////
 // Constructor
@@ -17,6 +39,35 @@ CJoystick::CJoystick()
 	// Init number of buttons to 0
 	m_iNumberOfButtons = 0;
 
+	// No event device, no state yet
+	m_bEventDriven = false;
+	m_iEventDevice = -1;
+	m_iVendorId = 0;
+	m_iProductId = 0;
+	for(int i=0; i<iJoystickAxes; i++)
+	{
+		m_aiAxisMin[i] = 0;
+		m_aiAxisMax[i] = 0;
+		m_aiAxisCode[i] = -1;
+		m_aiAxes[i] = 0;
+	}
+	for(int i=0; i<64; i++)
+	{
+		m_aiAbsSlot[i] = -1;
+	}
+	for(int i=0; i<iJoystickButtons; i++)
+	{
+		m_aiButtonCode[i] = -1;
+	}
+	for(int i=0; i<768; i++)
+	{
+		m_aiKeyButton[i] = -1;
+	}
+	m_uiSequence = 0;
+	m_uiButtons = 0;
+	m_llTime = 0;
+	m_ulReports = 0;
+
 	// Initialize joystick
 	if( (wxJoystick::GetNumberJoysticks() > 0) && (this->IsOk()) )
 	{		
@@ -27,33 +78,66 @@ CJoystick::CJoystick()
 		if(HasRudder())
 		{
 			m_usAvailableJoystickAxis|=AXIS_RUDDER;
-			DoLog("Joystick has rudder");
+			DoLogDebug("Joystick has rudder");
 		}
 		
 		if(HasU())
 		{
 			m_usAvailableJoystickAxis|=AXIS_U;
-			DoLog("Joystick has axe U");
+			DoLogDebug("Joystick has axe U");
 		}
 
 		if(HasV())
 		{
 			m_usAvailableJoystickAxis|=AXIS_V;
-			DoLog("Joystick has axe V");
+			DoLogDebug("Joystick has axe V");
 		}
 
 		if(HasZ())
 		{
 			m_usAvailableJoystickAxis|=AXIS_Z;
-			DoLog("Joystick has axe Z");
+			DoLogDebug("Joystick has axe Z");
 		}
 
 		// Get number of buttons
 		m_iNumberOfButtons = this->GetNumberButtons();
-		DoLog(wxString::Format("Joystick has %d available buttons", m_iNumberOfButtons));
+		DoLogDebug(wxString::Format("Joystick has %d available buttons", m_iNumberOfButtons));
 
 		// Create the joystick configuration file name to use
 		m_strConfigFileName = wxString::Format("Joystick-%d-%d.ini", this->GetManufacturerId(), this->GetProductId());
+
+		// Ranges of wxJoystick
+		m_aiAxisMin[GetAxisSlot(AXIS_X)] = GetXMin();
+		m_aiAxisMax[GetAxisSlot(AXIS_X)] = GetXMax();
+		m_aiAxisMin[GetAxisSlot(AXIS_Y)] = GetYMin();
+		m_aiAxisMax[GetAxisSlot(AXIS_Y)] = GetYMax();
+		m_aiAxisMin[GetAxisSlot(AXIS_RUDDER)] = GetRudderMin();
+		m_aiAxisMax[GetAxisSlot(AXIS_RUDDER)] = GetRudderMax();
+		m_aiAxisMin[GetAxisSlot(AXIS_U)] = GetUMin();
+		m_aiAxisMax[GetAxisSlot(AXIS_U)] = GetUMax();
+		m_aiAxisMin[GetAxisSlot(AXIS_V)] = GetVMin();
+		m_aiAxisMax[GetAxisSlot(AXIS_V)] = GetVMax();
+		m_aiAxisMin[GetAxisSlot(AXIS_Z)] = GetZMin();
+		m_aiAxisMax[GetAxisSlot(AXIS_Z)] = GetZMax();
+
+		// Prefer the events of the joystick to the polling
+		if(OpenEventDevice())
+		{
+			sJoystickState State;
+			ReadEventDevice(State);
+			Publish(State);
+
+			m_bEventDriven = true;
+			if( (CreateThread(wxTHREAD_JOINABLE) != wxTHREAD_NO_ERROR) || (GetThread()->Run() != wxTHREAD_NO_ERROR) )
+			{
+				DoLog("Failed to start the joystick thread, the joystick will be polled", MSG_ERROR);
+#ifdef __LINUX__
+				close(m_iEventDevice);
+#endif
+				m_iEventDevice = -1;
+				m_bEventDriven = false;
+			}
+		}
 	}
 	else
 	{
@@ -67,74 +151,110 @@ CJoystick::CJoystick()
 /////////////////////////////////////////////////////////////////////////////
 CJoystick::~CJoystick()
 {
+	if( (NULL != GetThread()) && GetThread()->IsRunning() )
+	{
+		GetThread()->Delete();
+	}
+
+#ifdef __LINUX__
+	if(m_iEventDevice >= 0)
+	{
+		close(m_iEventDevice);
+		m_iEventDevice = -1;
+	}
+#endif
 }
 
 
 /////////////////////////////////////////////////////////////////////////////
-// Get current value of a specific axe
+// Get all axes and buttons at once, without lock
 /////////////////////////////////////////////////////////////////////////////
-int CJoystick::GetRawValue(eJoystickAxis Axe)
+void CJoystick::GetState(sJoystickState& State)
 {
-	int		iValue = 0;
-	wxPoint Point(0,0);
+	if(!m_bEventDriven)
+	{
+		Poll(State);
+		return;
+	}
 
-	if((m_usAvailableJoystickAxis & Axe) == Axe)
+	unsigned int uiSequence = 0;
+	do
 	{
-		switch(Axe)
+		uiSequence = m_uiSequence.load(std::memory_order_acquire);
+		for(int i=0; i<iJoystickAxes; i++)
 		{
-			case AXIS_X:
-			{
-				Point = this->GetPosition();
-				iValue = Point.x;
-			}
-			break;
+			State.aiAxes[i] = m_aiAxes[i].load(std::memory_order_relaxed);
+		}
+		State.uiButtons = m_uiButtons.load(std::memory_order_relaxed);
+		State.llTime = m_llTime.load(std::memory_order_relaxed);
+		State.ulReports = m_ulReports.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	}
+	while( (uiSequence & 1) || (uiSequence != m_uiSequence.load(std::memory_order_relaxed)) );
+}
 
-			case AXIS_Y:
-			{
-				Point = this->GetPosition();
-				iValue = Point.y;
-			}
-			break;
 
-			case AXIS_RUDDER:
-			{
-				iValue = this->GetRudderPosition();
-			}
-			break;
+/////////////////////////////////////////////////////////////////////////////
+// Check presence of axis
+/////////////////////////////////////////////////////////////////////////////
+bool CJoystick::HasAxis(eJoystickAxis Axe)
+{
+	return ((m_usAvailableJoystickAxis & Axe) == Axe);
+}
 
-			case AXIS_V:
-			{
-				iValue = this->GetVPosition();
-			}
-			break;
 
-			case AXIS_U:
-			{
-				iValue = this->GetUPosition();
-			}
-			break;
+/////////////////////////////////////////////////////////////////////////////
+// Get the range of an axis
+/////////////////////////////////////////////////////////////////////////////
+void CJoystick::GetAxisRange(eJoystickAxis Axe, int& iMin, int& iMax)
+{
+	int iSlot = GetAxisSlot(Axe);
 
-			case AXIS_Z:
-			{
-				iValue = this->GetZPosition();
-			}
-			break;
+	iMin = (iSlot < 0) ? 0 : m_aiAxisMin[iSlot];
+	iMax = (iSlot < 0) ? 0 : m_aiAxisMax[iSlot];
+}
 
-			default:
-				break;
-		}
-	}
 
-	return iValue;	
+/////////////////////////////////////////////////////////////////////////////
+// Number of buttons
+/////////////////////////////////////////////////////////////////////////////
+int CJoystick::GetButtonCount()
+{
+	return m_iNumberOfButtons;
 }
 
 
 /////////////////////////////////////////////////////////////////////////////
-// Check presence of axis
+// Index of an axis in sJoystickState::aiAxes (-1 for none)
+// Note: Static function
 /////////////////////////////////////////////////////////////////////////////
-bool CJoystick::HasAxis(eJoystickAxis Axe)
+int CJoystick::GetAxisSlot(eJoystickAxis Axe)
 {
-	return ((m_usAvailableJoystickAxis & Axe) == Axe);
+	switch(Axe)
+	{
+		case AXIS_X:		return 0;
+		case AXIS_Y:		return 1;
+		case AXIS_RUDDER:	return 2;
+		case AXIS_U:		return 3;
+		case AXIS_V:		return 4;
+		case AXIS_Z:		return 5;
+		default:			return -1;
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Is a button pressed in a state
+// Note: Static function
+/////////////////////////////////////////////////////////////////////////////
+bool CJoystick::IsPressed(const sJoystickState& State, int iButton)
+{
+	if( (iButton < 0) || (iButton >= iJoystickButtons) )
+	{
+		return false;
+	}
+
+	return (0 != (State.uiButtons & (1U << iButton)));
 }
 
 
@@ -238,4 +358,355 @@ eJoystickAxis CJoystick::GetAxisIndex(const wxString& strAxisName)
 wxString& CJoystick::GetConfigFileName()
 {
 	return m_strConfigFileName;
-}
\ No newline at end of file
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Find and open the event device of the joystick
+// The axes and buttons are numbered as by wxJoystick (joydev driver) so the
+// joystick configuration files stay valid
+/////////////////////////////////////////////////////////////////////////////
+bool CJoystick::OpenEventDevice()
+{
+#ifdef __LINUX__
+	// The device of wxJoystick, by its ids if known, by its name otherwise
+	m_iVendorId = GetManufacturerId();
+	m_iProductId = GetProductId();
+	m_strDeviceName = GetProductName();
+
+	int iDevice = 0;
+	int iDescriptor = FindEventDevice(iDevice);
+	if(iDescriptor >= 0)
+	{
+		unsigned char aucAbs[ABS_CNT/8 + 1];
+		unsigned char aucKey[KEY_CNT/8 + 1];
+		memset(aucAbs, 0, sizeof(aucAbs));
+		memset(aucKey, 0, sizeof(aucKey));
+		ioctl(iDescriptor, EVIOCGBIT(EV_ABS, sizeof(aucAbs)), aucAbs);
+		ioctl(iDescriptor, EVIOCGBIT(EV_KEY, sizeof(aucKey)), aucKey);
+
+		// Axes, in the order of their codes
+		m_usAvailableJoystickAxis = AXIS_NONE;
+		int iAxis = 0;
+		for(int iCode=0; (iCode<ABS_CNT) && (iAxis<iJoystickAxes); iCode++)
+		{
+			struct input_absinfo AbsInfo;
+			if( !EVDEV_BIT(aucAbs, iCode) || (ioctl(iDescriptor, EVIOCGABS(iCode), &AbsInfo) < 0) )
+			{
+				continue;
+			}
+
+			int iSlot = GetAxisSlot(aWxAxes[iAxis]);
+			m_aiAxisCode[iSlot] = iCode;
+			m_aiAbsSlot[iCode] = iSlot;
+			m_aiAxisMin[iSlot] = AbsInfo.minimum;
+			m_aiAxisMax[iSlot] = AbsInfo.maximum;
+			m_usAvailableJoystickAxis |= aWxAxes[iAxis];
+			iAxis++;
+		}
+
+		// Buttons, as joydev: from BTN_JOYSTICK to KEY_MAX, then from BTN_MISC to BTN_JOYSTICK, never the keys below BTN_MISC
+		m_iNumberOfButtons = 0;
+		for(int i=0; (i<=KEY_MAX-BTN_MISC) && (m_iNumberOfButtons<iJoystickButtons); i++)
+		{
+			int iCode = BTN_JOYSTICK + i;
+			if(iCode > KEY_MAX)
+			{
+				iCode -= KEY_MAX + 1 - BTN_MISC;
+			}
+			if(EVDEV_BIT(aucKey, iCode))
+			{
+				m_aiButtonCode[m_iNumberOfButtons] = iCode;
+				m_aiKeyButton[iCode] = m_iNumberOfButtons;
+				m_iNumberOfButtons++;
+			}
+		}
+
+		DoLog(wxString::Format("Joystick \"%s\" read from /dev/input/event%d (%d axes, %d buttons)", m_strDeviceName, iDevice, iAxis, m_iNumberOfButtons));
+
+		m_iEventDevice = iDescriptor;
+		return true;
+	}
+
+	DoLog("No readable joystick event device, the joystick will be polled");
+#endif
+
+	return false;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Open the first event device of a joystick with the ids (if known) or the name of the device
+// The ids and the name are then the ones of the event device
+/////////////////////////////////////////////////////////////////////////////
+// [OUT] : Number of the device
+// [RETURN] : Descriptor, -1 if none
+/////////////////////////////////////////////////////////////////////////////
+int CJoystick::FindEventDevice(int& iDevice)
+{
+#ifdef __LINUX__
+	for(iDevice=0; iDevice<32; iDevice++)
+	{
+		int iDescriptor = open(wxString::Format("/dev/input/event%d", iDevice).c_str(), O_RDONLY | O_NONBLOCK);
+		if(iDescriptor < 0)
+		{
+			continue;
+		}
+
+		// A joystick has at least an X axis and a joystick or gamepad button
+		unsigned char aucAbs[ABS_CNT/8 + 1];
+		unsigned char aucKey[KEY_CNT/8 + 1];
+		memset(aucAbs, 0, sizeof(aucAbs));
+		memset(aucKey, 0, sizeof(aucKey));
+		if( (ioctl(iDescriptor, EVIOCGBIT(EV_ABS, sizeof(aucAbs)), aucAbs) < 0) ||
+			(ioctl(iDescriptor, EVIOCGBIT(EV_KEY, sizeof(aucKey)), aucKey) < 0) ||
+			!EVDEV_BIT(aucAbs, ABS_X) ||
+			!(EVDEV_BIT(aucKey, BTN_JOYSTICK) || EVDEV_BIT(aucKey, BTN_GAMEPAD)) )
+		{
+			close(iDescriptor);
+			continue;
+		}
+
+		// The same joystick as wxJoystick (or as before the disconnection)
+		struct input_id Id;
+		char szName[128];
+		memset(&Id, 0, sizeof(Id));
+		memset(szName, 0, sizeof(szName));
+		ioctl(iDescriptor, EVIOCGID, &Id);
+		ioctl(iDescriptor, EVIOCGNAME(sizeof(szName) - 1), szName);
+		bool bSame = ( (0 != m_iVendorId) || (0 != m_iProductId) ) ?
+					 ( (Id.vendor == m_iVendorId) && (Id.product == m_iProductId) ) :
+					 ( m_strDeviceName.IsEmpty() || (m_strDeviceName == wxString(szName)) );
+		if(!bSame)
+		{
+			close(iDescriptor);
+			continue;
+		}
+
+		m_iVendorId = Id.vendor;
+		m_iProductId = Id.product;
+		m_strDeviceName = szName;
+		return iDescriptor;
+	}
+#endif
+
+	return -1;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Read the current state of the event device (start, or events lost)
+/////////////////////////////////////////////////////////////////////////////
+void CJoystick::ReadEventDevice(sJoystickState& State)
+{
+	for(int i=0; i<iJoystickAxes; i++)
+	{
+		State.aiAxes[i] = (m_aiAxisMin[i] + m_aiAxisMax[i]) / 2;
+	}
+	State.uiButtons = 0;
+	State.llTime = wxGetUTCTimeUSec().GetValue();
+	State.ulReports = m_ulReports.load(std::memory_order_relaxed);
+
+#ifdef __LINUX__
+	for(int i=0; i<iJoystickAxes; i++)
+	{
+		struct input_absinfo AbsInfo;
+		if( (m_aiAxisCode[i] >= 0) && (ioctl(m_iEventDevice, EVIOCGABS(m_aiAxisCode[i]), &AbsInfo) >= 0) )
+		{
+			State.aiAxes[i] = AbsInfo.value;
+		}
+	}
+
+	unsigned char aucKey[KEY_CNT/8 + 1];
+	memset(aucKey, 0, sizeof(aucKey));
+	if(ioctl(m_iEventDevice, EVIOCGKEY(sizeof(aucKey)), aucKey) >= 0)
+	{
+		for(int i=0; i<m_iNumberOfButtons; i++)
+		{
+			if(EVDEV_BIT(aucKey, m_aiButtonCode[i]))
+			{
+				State.uiButtons |= (1U << i);
+			}
+		}
+	}
+#endif
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Publish a new state for the readers
+// Note: only called by the reader thread (and the constructor, before it runs)
+/////////////////////////////////////////////////////////////////////////////
+void CJoystick::Publish(const sJoystickState& State)
+{
+	m_uiSequence.fetch_add(1, std::memory_order_acq_rel);
+	for(int i=0; i<iJoystickAxes; i++)
+	{
+		m_aiAxes[i].store(State.aiAxes[i], std::memory_order_relaxed);
+	}
+	m_uiButtons.store(State.uiButtons, std::memory_order_relaxed);
+	m_llTime.store(State.llTime, std::memory_order_relaxed);
+	m_ulReports.store(State.ulReports, std::memory_order_relaxed);
+	m_uiSequence.fetch_add(1, std::memory_order_release);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Read the state from wxJoystick
+// Note: no report is counted, the time is the time of the call
+/////////////////////////////////////////////////////////////////////////////
+void CJoystick::Poll(sJoystickState& State)
+{
+	for(int i=0; i<iJoystickAxes; i++)
+	{
+		State.aiAxes[i] = 0;
+	}
+	State.uiButtons = 0;
+	State.llTime = wxGetUTCTimeUSec().GetValue();
+	State.ulReports = 0;
+
+	if(!IsOk())
+	{
+		return;
+	}
+
+	wxPoint Point = GetPosition();
+	State.aiAxes[GetAxisSlot(AXIS_X)] = Point.x;
+	State.aiAxes[GetAxisSlot(AXIS_Y)] = Point.y;
+	if(HasAxis(AXIS_RUDDER))
+	{
+		State.aiAxes[GetAxisSlot(AXIS_RUDDER)] = GetRudderPosition();
+	}
+	if(HasAxis(AXIS_U))
+	{
+		State.aiAxes[GetAxisSlot(AXIS_U)] = GetUPosition();
+	}
+	if(HasAxis(AXIS_V))
+	{
+		State.aiAxes[GetAxisSlot(AXIS_V)] = GetVPosition();
+	}
+	if(HasAxis(AXIS_Z))
+	{
+		State.aiAxes[GetAxisSlot(AXIS_Z)] = GetZPosition();
+	}
+	State.uiButtons = (unsigned int)wxJoystick::GetButtonState();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// The code executed by the reader thread
+// A state is published at each report of the joystick, with its time
+/////////////////////////////////////////////////////////////////////////////
+wxThread::ExitCode CJoystick::Entry()
+{
+#ifdef __LINUX__
+	sJoystickState State;
+	GetState(State);
+
+	// Events lost by the kernel : ignore the next ones up to a report, then read the whole state
+	bool bDropped = false;
+	struct input_event aEvents[64];
+
+	while(!GetThread()->TestDestroy())
+	{
+		// Disconnected : look for the joystick again
+		if(m_iEventDevice < 0)
+		{
+			int iDevice = 0;
+			m_iEventDevice = FindEventDevice(iDevice);
+			if(m_iEventDevice < 0)
+			{
+				wxThread::Sleep(250);
+				continue;
+			}
+
+			DoLog(wxString::Format("Joystick back on /dev/input/event%d", iDevice));
+			ReadEventDevice(State);
+			State.ulReports++;
+			Publish(State);
+			bDropped = false;
+		}
+
+		struct pollfd PollDescriptor;
+		PollDescriptor.fd = m_iEventDevice;
+		PollDescriptor.events = POLLIN;
+		PollDescriptor.revents = 0;
+
+		int iReady = poll(&PollDescriptor, 1, 100);
+		if( (0 == iReady) || ((iReady < 0) && (EINTR == errno)) )
+		{
+			continue;
+		}
+
+		ssize_t iRead = (iReady < 0) ? -1 : read(m_iEventDevice, aEvents, sizeof(aEvents));
+		if( (iRead < 0) && ((EAGAIN == errno) || (EINTR == errno)) )
+		{
+			continue;
+		}
+
+		if(iRead < (ssize_t)sizeof(struct input_event))
+		{
+			// Disconnected : release the sticks and the buttons until it is back
+			DoLog(wxString::Format("Joystick lost (%s), waiting for it", (iRead < 0) ? strerror(errno) : "end of file"), MSG_ERROR);
+			for(int i=0; i<iJoystickAxes; i++)
+			{
+				State.aiAxes[i] = (m_aiAxisMin[i] + m_aiAxisMax[i]) / 2;
+			}
+			State.uiButtons = 0;
+			State.llTime = wxGetUTCTimeUSec().GetValue();
+			State.ulReports++;
+			Publish(State);
+
+			close(m_iEventDevice);
+			m_iEventDevice = -1;
+			continue;
+		}
+
+		int iEvents = (int)(iRead / sizeof(struct input_event));
+		for(int i=0; i<iEvents; i++)
+		{
+			const struct input_event& Event = aEvents[i];
+
+			if(EV_SYN == Event.type)
+			{
+				if(SYN_DROPPED == Event.code)
+				{
+					bDropped = true;
+				}
+				else if(SYN_REPORT == Event.code)
+				{
+					if(bDropped)
+					{
+						ReadEventDevice(State);
+						bDropped = false;
+					}
+					State.llTime = (long long)Event.input_event_sec * 1000000LL + (long long)Event.input_event_usec;
+					State.ulReports++;
+					Publish(State);
+				}
+			}
+			else if(bDropped)
+			{
+				continue;
+			}
+			else if( (EV_ABS == Event.type) && (Event.code < 64) && (m_aiAbsSlot[Event.code] >= 0) )
+			{
+				State.aiAxes[m_aiAbsSlot[Event.code]] = Event.value;
+			}
+			else if( (EV_KEY == Event.type) && (Event.code < 768) && (m_aiKeyButton[Event.code] >= 0) )
+			{
+				if(0 != Event.value)
+				{
+					State.uiButtons |= (1U << m_aiKeyButton[Event.code]);
+				}
+				else
+				{
+					State.uiButtons &= ~(1U << m_aiKeyButton[Event.code]);
+				}
+			}
+		}
+	}
+#endif
+
+	return (wxThread::ExitCode)0;
+}
@@ -7,6 +7,8 @@
 
 #include <wx/wx.h>
 #include <wx/joystick.h>
+#include <wx/thread.h>
+#include <atomic>
 #include "Ressources.h"
 
 
@@ -22,18 +24,44 @@ enum eJoystickAxis
 	AXIS_Z				= 32
 };
 
+// Number of axes and buttons of a joystick state
+const int iJoystickAxes		= 6;
+const int iJoystickButtons	= 32;
 
-class CJoystick : public wxJoystick
+// State of all axes and buttons, as sent together by the joystick
+struct sJoystickState
+{
+	int				aiAxes[iJoystickAxes];	// Raw values, see CJoystick::GetAxisSlot()
+	unsigned int	uiButtons;				// One bit per button
+	long long		llTime;					// Time of the last report (us, same clock as wxGetUTCTimeUSec, 0 = none)
+	unsigned long	ulReports;				// Number of reports received
+};
+
+
+// On Linux the joystick is read from its event device (/dev/input/event*) by
+// a dedicated thread, the state is published without lock at each report.
+// Once disconnected, the sticks are centered until the device is back.
+// Otherwise, or without access to the event device, wxJoystick is polled.
+class CJoystick : public wxJoystick, public wxThreadHelper
 {
 public:
 	// Construction/Destruction
 	CJoystick();
 	~CJoystick();
 
-	// Get current value of a specific axe
-	int GetRawValue(eJoystickAxis Axe);
+	// Get all axes and buttons at once
+	void GetState(sJoystickState& State);
 	// Check presence of an axis
 	bool HasAxis(eJoystickAxis Axe);
+	// Get the range of an axis
+	void GetAxisRange(eJoystickAxis Axe, int& iMin, int& iMax);
+	// Number of buttons
+	int GetButtonCount();
+
+	// Index of an axis in sJoystickState::aiAxes
+	static int GetAxisSlot(eJoystickAxis Axe);
+	// Is a button pressed in a state
+	static bool IsPressed(const sJoystickState& State, int iButton);
 
 	// Get the name of an axis from his index
 	static wxString GetAxisName(eJoystickAxis AxisIndex);
@@ -44,10 +72,48 @@ public:
 	wxString& GetConfigFileName();
 
 private:
+	// Find and open the event device of the joystick
+	bool OpenEventDevice();
+	// Open the first event device matching m_iVendorId and m_iProductId, or m_strDeviceName when the ids are 0 (-1 if none)
+	int FindEventDevice(int& iDevice);
+	// Read the current state of the event device (start, or events lost)
+	void ReadEventDevice(sJoystickState& State);
+	// Publish a new state for the readers
+	void Publish(const sJoystickState& State);
+	// Read the state from wxJoystick
+	void Poll(sJoystickState& State);
+
+	// The code executed by the reader thread
+	wxThread::ExitCode Entry();
+
 	// Cache : available axis
 	unsigned short		m_usAvailableJoystickAxis;
 	// Number of buttons
 	int					m_iNumberOfButtons;
+	// Range of the axes
+	int					m_aiAxisMin[iJoystickAxes];
+	int					m_aiAxisMax[iJoystickAxes];
+
+	// The state is read from the event device (false = wxJoystick is polled)
+	bool				m_bEventDriven;
+	// Event device (-1 = disconnected), only used by the reader thread once it runs
+	int					m_iEventDevice;
+	// Ids (0 = unknown) and name of the device, to find it again
+	int					m_iVendorId;
+	int					m_iProductId;
+	wxString			m_strDeviceName;
+	// Event codes of the axes and buttons, and their index in the state (-1 = not used)
+	int					m_aiAxisCode[iJoystickAxes];
+	int					m_aiAbsSlot[64];
+	int					m_aiButtonCode[iJoystickButtons];
+	int					m_aiKeyButton[768];
+
+	// Published state (one writer, lock free readers), odd while the reader thread writes it
+	std::atomic<unsigned int>	m_uiSequence;
+	std::atomic<int>			m_aiAxes[iJoystickAxes];
+	std::atomic<unsigned int>	m_uiButtons;
+	std::atomic<long long>		m_llTime;
+	std::atomic<unsigned long>	m_ulReports;
 
 	// The name of the Joystick configuration file depends on Manufacturer and model
 	wxString			m_strConfigFileName;
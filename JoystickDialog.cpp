@@ -225,7 +225,7 @@ CJoystickDialog::CJoystickDialog(wxWindow *parent, CInput* pInput): wxDialog(par
 	wxStaticBoxSizer * ButtonBoxSizer = new wxStaticBoxSizer (ButtonBox, wxVERTICAL);	
 
 	// Get number of buttons
-	m_iButtons = pJoystick->GetNumberButtons();
+	m_iButtons = pJoystick->GetButtonCount();
 	//m_ppButtonLabels = new wxStaticText*[m_iButtons];
 	m_ppButtonLabels = new wxTextCtrl*[m_iButtons];
 
@@ -416,36 +416,40 @@ void CJoystickDialog::OnTimerUpdate(wxTimerEvent& WXUNUSED(event))
 		return;
 	}
 	
+	// All axes and buttons at once
+	sJoystickState State;
+	pJoystick->GetState(State);
+
 	// Refresh axis values
 	if(pJoystick->HasAxis(AXIS_X))
 	{
-		m_pAxeLabels[6]->SetValue(ToString(pJoystick->GetRawValue(AXIS_X)));
+		m_pAxeLabels[6]->SetValue(ToString(State.aiAxes[CJoystick::GetAxisSlot(AXIS_X)]));
 	}
 	if(pJoystick->HasAxis(AXIS_Y))
 	{
-		m_pAxeLabels[7]->SetValue(ToString(pJoystick->GetRawValue(AXIS_Y)));
+		m_pAxeLabels[7]->SetValue(ToString(State.aiAxes[CJoystick::GetAxisSlot(AXIS_Y)]));
 	}
 	if(pJoystick->HasAxis(AXIS_RUDDER))
 	{
-		m_pAxeLabels[8]->SetValue(ToString(pJoystick->GetRawValue(AXIS_RUDDER)));
+		m_pAxeLabels[8]->SetValue(ToString(State.aiAxes[CJoystick::GetAxisSlot(AXIS_RUDDER)]));
 	}
 	if(pJoystick->HasAxis(AXIS_U))
 	{
-		m_pAxeLabels[9]->SetValue(ToString(pJoystick->GetRawValue(AXIS_U)));
+		m_pAxeLabels[9]->SetValue(ToString(State.aiAxes[CJoystick::GetAxisSlot(AXIS_U)]));
 	}
 	if(pJoystick->HasAxis(AXIS_V))
 	{
-		m_pAxeLabels[10]->SetValue(ToString(pJoystick->GetRawValue(AXIS_V)));
+		m_pAxeLabels[10]->SetValue(ToString(State.aiAxes[CJoystick::GetAxisSlot(AXIS_V)]));
 	}
 	if(pJoystick->HasAxis(AXIS_Z))
 	{
-		m_pAxeLabels[11]->SetValue(ToString(pJoystick->GetRawValue(AXIS_Z)));
+		m_pAxeLabels[11]->SetValue(ToString(State.aiAxes[CJoystick::GetAxisSlot(AXIS_Z)]));
 	}
 
 	// Refresh button states
 	for(int i = 0; i<m_iButtons; i++)
 	{
-		if(pJoystick->GetButtonState(i))
+		if(CJoystick::IsPressed(State, i))
 		{			
 			m_ppButtonLabels[i]->SetValue(wxString::Format(" B %d ", i+1));
 			m_ppButtonLabels[i]->SetBackgroundColour(ColorGreenLite);
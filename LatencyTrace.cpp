@@ -0,0 +1,306 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CLatencyTrace
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+#include <wx/textfile.h>
+#include "Utils.h"
+#include "LatencyTrace.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Constructor
+//////////////////////////////////////////////////////////////////////////////
+CLatencyTrace::CLatencyTrace()
+{
+	m_State			= TRACE_NONE;
+	m_llStimulus	= 0;
+	m_llUpdate		= 0;
+	m_llSent		= 0;
+	m_iAxis			= 0;
+	m_dDirection	= 0.0;
+	m_ulTimeouts	= 0;
+
+	for(int i=0; i<2; i++)
+	{
+		m_afCommand[i] = 0.0f;
+		m_adAttitude[i] = 0.0;
+		m_adReference[i] = 0.0;
+	}
+
+	memset(m_aaulHistogram, 0, sizeof(m_aaulHistogram));
+	memset(m_aulCount, 0, sizeof(m_aulCount));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor
+//////////////////////////////////////////////////////////////////////////////
+CLatencyTrace::~CLatencyTrace()
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Time used by all the stages
+// Note: Static function
+//////////////////////////////////////////////////////////////////////////////
+long long CLatencyTrace::Now()
+{
+	return wxGetUTCTimeUSec().GetValue();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// A change of the input has been published
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Time of the stimulus and of the update publishing it (us)
+//////////////////////////////////////////////////////////////////////////////
+void CLatencyTrace::Start(long long llStimulus, long long llUpdate)
+{
+	wxCriticalSectionLocker Lock(m_CSTrace);
+
+	// One trace at a time, the drone may still be responding to the previous change
+	if(TRACE_RESPONSE == m_State)
+	{
+		return;
+	}
+
+	m_llStimulus = llStimulus;
+	m_llUpdate = llUpdate;
+	m_State = TRACE_INPUT;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// A move has been sent
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Roll and pitch as sent in AT*PCMD (the attitude follows their signs)
+//////////////////////////////////////////////////////////////////////////////
+void CLatencyTrace::CommandSent(float fRoll, float fPitch)
+{
+	long long llSent = Now();
+
+	wxCriticalSectionLocker Lock(m_CSTrace);
+
+	float afDelta[2] = { fRoll - m_afCommand[0], fPitch - m_afCommand[1] };
+	m_afCommand[0] = fRoll;
+	m_afCommand[1] = fPitch;
+
+	if(TRACE_INPUT != m_State)
+	{
+		return;
+	}
+
+	Add(LATENCY_INPUT, m_llUpdate - m_llStimulus);
+	Add(LATENCY_COMMAND, llSent - m_llUpdate);
+
+	// Only the roll and the pitch show up in the navdata
+	m_iAxis = (fabs(afDelta[1]) > fabs(afDelta[0])) ? 1 : 0;
+	if(fabs(afDelta[m_iAxis]) < dLatencyMinCommand)
+	{
+		m_State = TRACE_NONE;
+		return;
+	}
+
+	m_dDirection = (afDelta[m_iAxis] > 0.0f) ? 1.0 : -1.0;
+	m_adReference[0] = m_adAttitude[0];
+	m_adReference[1] = m_adAttitude[1];
+	m_llSent = llSent;
+	m_State = TRACE_RESPONSE;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// A navdata has been received
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Roll and pitch of the drone (degrees)
+//////////////////////////////////////////////////////////////////////////////
+void CLatencyTrace::NavdataArrived(double dRoll, double dPitch)
+{
+	long long llNow = Now();
+
+	wxCriticalSectionLocker Lock(m_CSTrace);
+
+	m_adAttitude[0] = dRoll;
+	m_adAttitude[1] = dPitch;
+
+	if(TRACE_RESPONSE != m_State)
+	{
+		return;
+	}
+
+	if((m_adAttitude[m_iAxis] - m_adReference[m_iAxis]) * m_dDirection >= dLatencyAttitude)
+	{
+		Add(LATENCY_RESPONSE, llNow - m_llSent);
+		Add(LATENCY_TOTAL, llNow - m_llStimulus);
+		m_State = TRACE_NONE;
+	}
+	else if(llNow - m_llSent > lLatencyTimeout)
+	{
+		// On ground, or against the wind...
+		m_ulTimeouts++;
+		m_State = TRACE_NONE;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Percentiles
+//////////////////////////////////////////////////////////////////////////////
+void CLatencyTrace::GetStats(sLatencyStats& Stats)
+{
+	wxCriticalSectionLocker Lock(m_CSTrace);
+
+	for(int i=0; i<LATENCY_STAGES; i++)
+	{
+		Stats.aulCount[i] = m_aulCount[i];
+		Stats.alP50[i] = GetPercentile((eLatencyStage)i, 50.0);
+		Stats.alP95[i] = GetPercentile((eLatencyStage)i, 95.0);
+		Stats.alP99[i] = GetPercentile((eLatencyStage)i, 99.0);
+	}
+	Stats.ulTimeouts = m_ulTimeouts;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Write the percentiles and the histograms
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : File to write (replaced, kept while nothing has been traced)
+// [RETURN] : true if the file has been written
+//////////////////////////////////////////////////////////////////////////////
+bool CLatencyTrace::Export(const wxString& strFile)
+{
+	static const char* aszStages[LATENCY_STAGES] = { "input", "command", "response", "total" };
+
+	sLatencyStats Stats;
+	GetStats(Stats);
+	if(0 == Stats.aulCount[LATENCY_COMMAND])
+	{
+		return false;
+	}
+
+	wxTextFile File(strFile);
+	if(File.Exists() ? !File.Open() : !File.Create())
+	{
+		DoLog(wxString::Format("Failed to open %s", strFile), MSG_ERROR);
+		return false;
+	}
+	File.Clear();
+
+	// Percentiles
+	File.AddLine("stage;count;p50_us;p95_us;p99_us");
+	for(int i=0; i<LATENCY_STAGES; i++)
+	{
+		File.AddLine(wxString::Format("%s;%lu;%ld;%ld;%ld", aszStages[i], Stats.aulCount[i], Stats.alP50[i], Stats.alP95[i], Stats.alP99[i]));
+	}
+	File.AddLine(wxString::Format("timeouts;%lu", Stats.ulTimeouts));
+	File.AddLine("");
+
+	// Histograms, non empty buckets only
+	File.AddLine("bucket_min_us;input;command;response;total");
+	{
+		wxCriticalSectionLocker Lock(m_CSTrace);
+
+		for(int iBucket=0; iBucket<iLatencyBuckets; iBucket++)
+		{
+			if( (0 == m_aaulHistogram[LATENCY_INPUT][iBucket]) && (0 == m_aaulHistogram[LATENCY_COMMAND][iBucket]) &&
+				(0 == m_aaulHistogram[LATENCY_RESPONSE][iBucket]) && (0 == m_aaulHistogram[LATENCY_TOTAL][iBucket]) )
+			{
+				continue;
+			}
+
+			File.AddLine(wxString::Format("%ld;%lu;%lu;%lu;%lu", GetBucketMin(iBucket), m_aaulHistogram[LATENCY_INPUT][iBucket],
+				m_aaulHistogram[LATENCY_COMMAND][iBucket], m_aaulHistogram[LATENCY_RESPONSE][iBucket], m_aaulHistogram[LATENCY_TOTAL][iBucket]));
+		}
+	}
+
+	bool bSuccess = File.Write();
+	File.Close();
+
+	DoLog(wxString::Format("Input latency (us, p50/p95/p99): input %ld/%ld/%ld, command %ld/%ld/%ld, attitude %ld/%ld/%ld, total %ld/%ld/%ld (%lu traces, %lu timeouts), written to %s",
+		Stats.alP50[LATENCY_INPUT], Stats.alP95[LATENCY_INPUT], Stats.alP99[LATENCY_INPUT],
+		Stats.alP50[LATENCY_COMMAND], Stats.alP95[LATENCY_COMMAND], Stats.alP99[LATENCY_COMMAND],
+		Stats.alP50[LATENCY_RESPONSE], Stats.alP95[LATENCY_RESPONSE], Stats.alP99[LATENCY_RESPONSE],
+		Stats.alP50[LATENCY_TOTAL], Stats.alP95[LATENCY_TOTAL], Stats.alP99[LATENCY_TOTAL], Stats.aulCount[LATENCY_COMMAND], Stats.ulTimeouts, strFile));
+
+	return bSuccess;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Add a delay to a histogram
+//////////////////////////////////////////////////////////////////////////////
+void CLatencyTrace::Add(eLatencyStage Stage, long long llDelay)
+{
+	m_aaulHistogram[Stage][GetBucket(llDelay)]++;
+	m_aulCount[Stage]++;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Bucket of a delay
+// Note: Static function
+//////////////////////////////////////////////////////////////////////////////
+int CLatencyTrace::GetBucket(long long llDelay)
+{
+	if(llDelay < 16)
+	{
+		return (llDelay < 0) ? 0 : (int)llDelay;
+	}
+
+	// Highest bit, then the 4 bits below it
+	int iBit = 4;
+	while( (iBit < 62) && ((llDelay >> (iBit + 1)) != 0) )
+	{
+		iBit++;
+	}
+
+	int iBucket = 16 * (iBit - 3) + (int)((llDelay >> (iBit - 4)) - 16);
+
+	return (iBucket < iLatencyBuckets) ? iBucket : (iLatencyBuckets - 1);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Lowest delay of a bucket
+// Note: Static function
+//////////////////////////////////////////////////////////////////////////////
+long CLatencyTrace::GetBucketMin(int iBucket)
+{
+	if(iBucket < 16)
+	{
+		return iBucket;
+	}
+
+	return (long)(16 + iBucket % 16) << (iBucket / 16 - 1);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Percentile of a histogram
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Stage and percentile (0..100)
+// [RETURN] : Middle of the bucket holding the percentile (us), 0 without data
+//////////////////////////////////////////////////////////////////////////////
+long CLatencyTrace::GetPercentile(eLatencyStage Stage, double dPercent)
+{
+	if(0 == m_aulCount[Stage])
+	{
+		return 0;
+	}
+
+	unsigned long ulRank = (unsigned long)ceil(m_aulCount[Stage] * dPercent / 100.0);
+	unsigned long ulSum = 0;
+	for(int iBucket=0; iBucket<iLatencyBuckets; iBucket++)
+	{
+		ulSum += m_aaulHistogram[Stage][iBucket];
+		if(ulSum >= ulRank)
+		{
+			return (iBucket + 1 < iLatencyBuckets) ? (GetBucketMin(iBucket) + GetBucketMin(iBucket + 1)) / 2 : GetBucketMin(iBucket);
+		}
+	}
+
+	return GetBucketMin(iLatencyBuckets - 1);
+}
@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CLatencyTrace
+//////////////////////////////////////////////////////////////////////////////
+// Follows a change of the pilot input up to the drone: the stick report or
+// key (stimulus), CInput::Update() publishing it, the AT*PCMD leaving the
+// socket in CustomMove(), then the first navdata whose roll or pitch moved
+// in the commanded direction. The delays of each stage are kept in
+// histograms with a relative resolution of about 6%, from which the
+// percentiles are read for the debug overlay and the export.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_LATENCYTRACE__
+#define __HEADER_LATENCYTRACE__
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+
+// File of the export
+#define LATENCY_FILE				"Data/Log/Latency.csv"
+
+// Buckets of the histograms: exact under 16 us, then 16 per power of 2 (up to 16 s)
+const int iLatencyBuckets			= 352;
+
+// A command changing roll or pitch by less than this is not followed to the navdata
+const double dLatencyMinCommand		= 0.05;
+// Move of the attitude showing the response (degrees)
+const double dLatencyAttitude		= 1.0;
+// Time given to the drone to respond (us)
+const long lLatencyTimeout			= 1000000L;
+
+// Stages of a trace
+enum eLatencyStage
+{
+	LATENCY_INPUT = 0,		// Stimulus to CInput::Update()
+	LATENCY_COMMAND,		// CInput::Update() to the command sent
+	LATENCY_RESPONSE,		// Command sent to the first navdata showing it
+	LATENCY_TOTAL,			// Stimulus to the first navdata showing it
+	LATENCY_STAGES
+};
+
+// Percentiles of all the traces (us)
+struct sLatencyStats
+{
+	unsigned long	aulCount[LATENCY_STAGES];
+	long			alP50[LATENCY_STAGES];
+	long			alP95[LATENCY_STAGES];
+	long			alP99[LATENCY_STAGES];
+	unsigned long	ulTimeouts;		// Commands without response
+};
+
+// Describe the latency trace class
+class CLatencyTrace
+{
+public:
+	// Constructor
+	CLatencyTrace();
+	// Destructor
+	~CLatencyTrace();
+
+	// Time used by all the stages (us, same clock as the joystick events)
+	static long long Now();
+
+	// A change of the input has been published (called by the control thread, before the move)
+	void Start(long long llStimulus, long long llUpdate);
+	// A move has been sent (roll and pitch as sent in AT*PCMD)
+	void CommandSent(float fRoll, float fPitch);
+	// A navdata has been received (attitude in degrees, called by the navdata thread)
+	void NavdataArrived(double dRoll, double dPitch);
+
+	// Percentiles
+	void GetStats(sLatencyStats& Stats);
+	// Write the percentiles and the histograms (csv)
+	bool Export(const wxString& strFile);
+
+private:
+	// State of the current trace
+	enum eTraceState
+	{
+		TRACE_NONE = 0,			// Waiting for a change
+		TRACE_INPUT,			// Waiting for the command
+		TRACE_RESPONSE			// Waiting for the navdata
+	};
+
+	// Add a delay to a histogram
+	void Add(eLatencyStage Stage, long long llDelay);
+	// Bucket of a delay and lowest delay of a bucket
+	static int GetBucket(long long llDelay);
+	static long GetBucketMin(int iBucket);
+	// Percentile of a histogram (middle of the bucket)
+	long GetPercentile(eLatencyStage Stage, double dPercent);
+
+private:
+	// Protects everything, the navdata thread ends the traces started by the control thread
+	wxCriticalSection		m_CSTrace;
+
+	eTraceState				m_State;
+	long long				m_llStimulus;
+	long long				m_llUpdate;
+	long long				m_llSent;
+
+	// Last command and attitude, response expected along one axis (0 = roll, 1 = pitch) in one direction
+	float					m_afCommand[2];
+	double					m_adAttitude[2];
+	double					m_adReference[2];
+	int						m_iAxis;
+	double					m_dDirection;
+
+	unsigned long			m_aaulHistogram[LATENCY_STAGES][iLatencyBuckets];
+	unsigned long			m_aulCount[LATENCY_STAGES];
+	unsigned long			m_ulTimeouts;
+};
+
+#endif
@@ -0,0 +1,241 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CLog
+//////////////////////////////////////////////////////////////////////////////
+
+#include "Log.h"
+
+// Initialize the log singleton to NULL
+std::atomic<CLog*> CLog::msp_LogSingleton(NULL);
+std::atomic<int> CLog::ms_iUsers(0);
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default constructor of CLog
+//////////////////////////////////////////////////////////////////////////////
+CLog::CLog()
+{
+	// The queue starts with an empty node
+	m_Stub.pNext = NULL;
+	m_pHead = &m_Stub;
+	m_pTail = &m_Stub;
+
+	m_iMinLevel = MSG_INFO;
+	m_FileTime = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default destructor of CLog
+//////////////////////////////////////////////////////////////////////////////
+CLog::~CLog()
+{
+	// Write what is left
+	Flush();
+
+	if(m_pTail != &m_Stub)
+	{
+		delete m_pTail;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Create the singleton object and start the writer thread
+// Note: called by the main thread (CMainApp::OnInit) before any other thread exists
+//////////////////////////////////////////////////////////////////////////////
+// [RETURN] : Pointer to the singleton
+//////////////////////////////////////////////////////////////////////////////
+/*static*/ CLog* CLog::CreateSingleton()
+{
+	if (NULL == msp_LogSingleton)
+	{
+		CLog* pLog = new CLog();
+		pLog->Rotate();
+
+		if(pLog->CreateThread(wxTHREAD_JOINABLE) == wxTHREAD_NO_ERROR)
+		{
+			pLog->GetThread()->Run();
+		}
+
+		msp_LogSingleton = pLog;
+	}
+
+	// Return the pointer
+	return msp_LogSingleton;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the singleton object
+//////////////////////////////////////////////////////////////////////////////
+// [RETURN] : Pointer to the singleton, NULL if not created or already killed
+//////////////////////////////////////////////////////////////////////////////
+/*static*/ CLog* CLog::GetSingleton()
+{
+	return msp_LogSingleton;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Stop the writer thread and destroy the singleton object
+//////////////////////////////////////////////////////////////////////////////
+/*static*/ void CLog::KillSingleton()
+{
+	// If the object exist, set the pointer to NULL (later messages are dropped) and delete it
+	CLog* pLog = msp_LogSingleton.exchange(NULL);
+	if(NULL != pLog)
+	{
+		// Wait for the threads which got the pointer before
+		while(0 != ms_iUsers.load())
+		{
+			wxThread::Yield();
+		}
+
+		if(NULL != pLog->GetThread() && pLog->GetThread()->IsRunning())
+		{
+			pLog->GetThread()->Delete();
+		}
+
+		delete pLog;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Queue a message
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : The message and its level
+//////////////////////////////////////////////////////////////////////////////
+void CLog::Push(const wxString& strMessage, eMsgLevel MsgLevel)
+{
+	sLogEntry* pEntry = new sLogEntry;
+	pEntry->pNext.store(NULL, std::memory_order_relaxed);
+	pEntry->MsgLevel = MsgLevel;
+	pEntry->llTime = wxGetLocalTimeMillis();
+	pEntry->strMessage = strMessage;
+
+	// Take the head, then link the previous one to us
+	sLogEntry* pPrev = m_pHead.exchange(pEntry, std::memory_order_acq_rel);
+	pPrev->pNext.store(pEntry, std::memory_order_release);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Queue a message in the singleton
+// Note: the user count is raised before reading the pointer (both sequentially
+//       consistent), so KillSingleton() either sees the user or the user sees NULL
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : The message and its level
+//////////////////////////////////////////////////////////////////////////////
+/*static*/ void CLog::Log(const wxString& strMessage, eMsgLevel MsgLevel)
+{
+	ms_iUsers.fetch_add(1);
+
+	CLog* pLog = msp_LogSingleton.load();
+	if( (NULL != pLog) && pLog->IsLogged(MsgLevel) )
+	{
+		pLog->Push(strMessage, MsgLevel);
+	}
+
+	ms_iUsers.fetch_sub(1);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Open a new log file, older ones are renamed
+//////////////////////////////////////////////////////////////////////////////
+void CLog::Rotate()
+{
+	if(m_File.IsOpened())
+	{
+		m_File.Close();
+	}
+
+	// Keep up to LOG_FILE_COUNT files
+	for(int i = LOG_FILE_COUNT-1; i > 0; i--)
+	{
+		wxString strOld = (i == 1) ? wxString(LOG_FILE_NAME ".log") : wxString::Format(LOG_FILE_NAME "%d.log", i-1);
+		wxString strNew = wxString::Format(LOG_FILE_NAME "%d.log", i);
+
+		if(wxFileExists(strOld))
+		{
+			if(wxFileExists(strNew))
+			{
+				wxRemoveFile(strNew);
+			}
+			wxRenameFile(strOld, strNew);
+		}
+	}
+
+	m_File.Open(LOG_FILE_NAME ".log", wxFile::write_append);
+	m_FileTime = time(NULL);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Write all queued messages to the file
+//////////////////////////////////////////////////////////////////////////////
+void CLog::Flush()
+{
+	wxString strBuffer;
+
+	// Pop the messages, the node of the last one stays as the tail
+	sLogEntry* pNext = m_pTail->pNext.load(std::memory_order_acquire);
+	while(NULL != pNext)
+	{
+		wxString strType;
+		switch(pNext->MsgLevel)
+		{
+			case MSG_DEBUG		: strType = "[DBG]"; break;
+			case MSG_INFO		: strType = "[NFO]"; break;
+			case MSG_WARNING	: strType = "[WRN]"; break;
+			default				: strType = "[ERR]"; break;
+		}
+
+		wxDateTime Time((time_t)(pNext->llTime / 1000).ToLong());
+		strBuffer += wxString::Format("%s [%s.%03ld] %s\n", strType, Time.Format("%a %b %d %H:%M:%S %Y"), (long)(pNext->llTime % 1000).ToLong(), pNext->strMessage);
+
+		if(m_pTail != &m_Stub)
+		{
+			delete m_pTail;
+		}
+		m_pTail = pNext;
+		pNext = m_pTail->pNext.load(std::memory_order_acquire);
+	}
+
+	if(strBuffer.IsEmpty())
+	{
+		return;
+	}
+
+	// Rotate when the file is too big or too old
+	if(m_File.IsOpened() && (m_File.Length() > LOG_MAX_SIZE || time(NULL) - m_FileTime > LOG_MAX_AGE))
+	{
+		Rotate();
+	}
+
+	// One write for the whole batch
+	if(m_File.IsOpened())
+	{
+		m_File.Write(strBuffer);
+		m_File.Flush();
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// The code executed by the writer thread
+//////////////////////////////////////////////////////////////////////////////
+wxThread::ExitCode CLog::Entry()
+{
+	while(!GetThread()->TestDestroy())
+	{
+		Flush();
+		wxMilliSleep(LOG_WRITE_PERIOD);
+	}
+
+	// Messages logged while stopping
+	Flush();
+
+	return (wxThread::ExitCode)0;
+}
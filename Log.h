@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CLog
+//////////////////////////////////////////////////////////////////////////////
+// Asynchronous log: any thread queues its messages without locking, a
+// background thread appends them to the log file and rotates it
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_LOG__
+#define __HEADER_LOG__
+
+// Includes
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <wx/file.h>
+#include <atomic>
+
+#include "Utils.h"
+
+// Log file and number of files kept (Errors.log, Errors1.log, Errors2.log)
+#define LOG_FILE_NAME		"Data/Log/Errors"
+#define LOG_FILE_COUNT		3
+// Rotate the log file when it becomes bigger (bytes) or older (seconds) than this
+#define LOG_MAX_SIZE		(1024L * 1024L)
+#define LOG_MAX_AGE			(24L * 3600L)
+// Period of the writer thread (ms)
+#define LOG_WRITE_PERIOD	100
+
+// A message waiting to be written
+struct sLogEntry
+{
+	std::atomic<sLogEntry*>	pNext;
+	eMsgLevel				MsgLevel;
+	wxLongLong				llTime;		// Local time in ms
+	wxString				strMessage;
+};
+
+// Describe the log class
+class CLog : public wxThreadHelper
+{
+private:
+	// The one and only singleton object
+	static std::atomic<CLog*> msp_LogSingleton;
+	// Threads using the singleton in Log(), it is not deleted before they are done
+	static std::atomic<int> ms_iUsers;
+
+	// Constructor and destructor are private
+	// -> Don't allow multiple instances
+	CLog();
+	~CLog();
+
+	// Queue of messages (multiple producers, single consumer)
+	// Producers push at the head, the writer thread pops at the tail
+	std::atomic<sLogEntry*>	m_pHead;
+	sLogEntry*				m_pTail;
+	sLogEntry				m_Stub;
+
+	// Minimum level of the messages to log
+	std::atomic<int>		m_iMinLevel;
+
+	// Log file, only used by the writer thread
+	wxFile					m_File;
+	time_t					m_FileTime;
+
+	// Open a new log file, older ones are renamed
+	void Rotate();
+	// Write all queued messages to the file
+	void Flush();
+
+	// The code executed by the writer thread
+	wxThread::ExitCode Entry();
+
+public:
+	// Create the singleton object and start the writer thread (main thread, at start)
+	static CLog* CreateSingleton();
+	// Get the singleton object (NULL before CreateSingleton() or after KillSingleton())
+	static CLog* GetSingleton();
+	// Stop the writer thread and destroy the singleton object
+	static void KillSingleton();
+
+	// Queue a message (can be called from any thread)
+	void Push(const wxString& strMessage, eMsgLevel MsgLevel);
+	// Queue a message in the singleton if it exists and the level is logged (any thread, even while it is killed)
+	static void Log(const wxString& strMessage, eMsgLevel MsgLevel);
+
+	// Minimum level of the messages to log
+	void SetMinLevel(eMsgLevel MsgLevel) { m_iMinLevel = MsgLevel; }
+	bool IsLogged(eMsgLevel MsgLevel) { return MsgLevel >= m_iMinLevel; }
+};
+
+#endif
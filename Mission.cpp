@@ -0,0 +1,461 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CMission
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+#include <wx/filename.h>
+#include "Utils.h"
+#include "Mission.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Constructor
+//////////////////////////////////////////////////////////////////////////////
+CMission::CMission()
+{
+	m_State = MISSION_EMPTY;
+	m_iWaypoint = 0;
+	m_bSegmentStart = true;
+	m_dStartX = 0.0f;
+	m_dStartY = 0.0f;
+	m_dHoldTime = -1.0f;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor
+//////////////////////////////////////////////////////////////////////////////
+CMission::~CMission()
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Load a mission file
+// One waypoint per line: x y altitude [speed] [heading] [tolerance] [hold time]
+// x is east and y north of home in meters, heading < 0 follows the path
+// Lines beginning with "//", "#" or ";" are comments
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : File, defaults for the tolerance and the hold time, maximum distance from home and altitude
+// [RETURN] : true if the mission has been loaded
+//////////////////////////////////////////////////////////////////////////////
+bool CMission::Load(const wxString& strFile, double dDefaultTolerance, double dDefaultHoldTime, double dMaxDistance, double dMaxAltitude)
+{
+	wxTextFile MissionFile(strFile);
+
+	if(!MissionFile.Exists() || !MissionFile.Open())
+	{
+		DoLog(wxString("Failed to open mission file ") + strFile, MSG_ERROR);
+		return false;
+	}
+
+	std::vector<sWaypoint> Waypoints;
+
+	for(size_t lPos = 0; lPos < MissionFile.GetLineCount(); lPos++)
+	{
+		wxString strTmp = MissionFile.GetLine(lPos);
+		strTmp.Trim(false);
+		strTmp.Trim(true);
+
+		// Ignore empty strings or commented strings
+		if( strTmp.IsEmpty() || (strTmp.Left(1) == ";") || (strTmp.Left(1) == "#") || (strTmp.Left(2) == "//") )
+		{
+			continue;
+		}
+
+		// Read the values, missing ones are the defaults
+		double adValues[7] = { 0.0, 0.0, 0.0, dMissionSpeed, -1.0, dDefaultTolerance, dDefaultHoldTime };
+		int iCount = 0;
+		wxStringTokenizer Tokenizer(strTmp, " \t,");
+		while(Tokenizer.HasMoreTokens())
+		{
+			wxString strValue = Tokenizer.GetNextToken();
+			if( (iCount >= 7) || !strValue.ToCDouble(&adValues[iCount]) )
+			{
+				iCount = -1;
+				break;
+			}
+			iCount++;
+		}
+
+		if(iCount < 3)
+		{
+			DoLog(wxString::Format("Mission file %s, line %d: invalid waypoint", strFile, (int)lPos+1), MSG_ERROR);
+			return false;
+		}
+
+		sWaypoint Waypoint;
+		Waypoint.dX = adValues[0];
+		Waypoint.dY = adValues[1];
+		Waypoint.dAltitude = adValues[2];
+		Waypoint.dSpeed = adValues[3];
+		Waypoint.dHeading = adValues[4];
+		Waypoint.dTolerance = adValues[5];
+		Waypoint.dHoldTime = adValues[6];
+
+		if( (Waypoint.dSpeed <= 0.0) || (Waypoint.dTolerance <= 0.0) || (Waypoint.dHoldTime < 0.0) || (Waypoint.dAltitude < 0.0) )
+		{
+			DoLog(wxString::Format("Mission file %s, line %d: speed and tolerance must be positive", strFile, (int)lPos+1), MSG_ERROR);
+			return false;
+		}
+
+		// Keep the limit of the flight plan
+		if( (dMaxDistance > 0.0) && (sqrt(Waypoint.dX*Waypoint.dX + Waypoint.dY*Waypoint.dY) > dMaxDistance) )
+		{
+			DoLog(wxString::Format("Mission file %s, line %d: waypoint further than %.0f m from home", strFile, (int)lPos+1, dMaxDistance), MSG_ERROR);
+			return false;
+		}
+
+		// Keep the altitude limit, the control loop would bring the drone down before the waypoint
+		if( (dMaxAltitude > 0.0) && (Waypoint.dAltitude > dMaxAltitude) )
+		{
+			DoLog(wxString::Format("Mission file %s, line %d: waypoint higher than the altitude limit (%.1f m)", strFile, (int)lPos+1, dMaxAltitude), MSG_ERROR);
+			return false;
+		}
+
+		if((int)Waypoints.size() >= iMissionMaxWaypoints)
+		{
+			DoLog(wxString::Format("Mission file %s: more than %d waypoints", strFile, iMissionMaxWaypoints), MSG_ERROR);
+			return false;
+		}
+
+		Waypoints.push_back(Waypoint);
+	}
+
+	if(Waypoints.empty())
+	{
+		DoLog(wxString("Mission file without waypoint ") + strFile, MSG_ERROR);
+		return false;
+	}
+
+	wxCriticalSectionLocker Lock(m_CSMission);
+
+	m_Waypoints.swap(Waypoints);
+	m_strName = wxFileName(strFile).GetName();
+	m_State = MISSION_READY;
+	m_iWaypoint = 0;
+
+	DoLog(wxString::Format("Mission %s loaded, %d waypoints", m_strName, (int)m_Waypoints.size()));
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Start the mission from the first waypoint
+//////////////////////////////////////////////////////////////////////////////
+bool CMission::Start()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+
+	if( (MISSION_EMPTY == m_State) || (MISSION_RUNNING == m_State) || (MISSION_PAUSED == m_State) )
+	{
+		return false;
+	}
+
+	m_State = MISSION_RUNNING;
+	m_iWaypoint = 0;
+	m_bSegmentStart = true;
+	m_dHoldTime = -1.0f;
+
+	DoLog(wxString::Format("Mission %s started", m_strName));
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Pause the mission, the drone hovers
+//////////////////////////////////////////////////////////////////////////////
+bool CMission::Pause()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+
+	if(MISSION_RUNNING != m_State)
+	{
+		return false;
+	}
+
+	m_State = MISSION_PAUSED;
+	DoLog(wxString::Format("Mission %s paused at waypoint %d", m_strName, m_iWaypoint+1));
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Resume a paused mission, from where the drone is to the current waypoint
+//////////////////////////////////////////////////////////////////////////////
+bool CMission::Resume()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+
+	if(MISSION_PAUSED != m_State)
+	{
+		return false;
+	}
+
+	m_State = MISSION_RUNNING;
+	m_bSegmentStart = true;
+	DoLog(wxString::Format("Mission %s resumed at waypoint %d", m_strName, m_iWaypoint+1));
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Abort the mission
+//////////////////////////////////////////////////////////////////////////////
+void CMission::Abort()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+
+	if( (MISSION_RUNNING == m_State) || (MISSION_PAUSED == m_State) )
+	{
+		m_State = MISSION_ABORTED;
+		DoLog(wxString::Format("Mission %s aborted at waypoint %d", m_strName, m_iWaypoint+1), MSG_WARNING);
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Compute the move of one control step
+// Note: the drone follows a point dMissionLookAhead further on the segment
+//       from the previous waypoint, and slows down before the waypoint
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Estimated state of the drone, duration of the step in seconds
+// [OUT] : Move to send to the drone
+// [RETURN] : false if the mission is not running
+//////////////////////////////////////////////////////////////////////////////
+bool CMission::Step(const sMissionInput& Input, double dTime, sMissionMove& Move)
+{
+	Move.fSide = Move.fForward = Move.fVertical = Move.fRotation = 0.0f;
+
+	wxCriticalSectionLocker Lock(m_CSMission);
+
+	if(MISSION_RUNNING != m_State)
+	{
+		return false;
+	}
+
+	const sWaypoint& Waypoint = m_Waypoints[m_iWaypoint];
+
+	// The segment begins where the drone is
+	if(m_bSegmentStart)
+	{
+		m_dStartX = Input.dX;
+		m_dStartY = Input.dY;
+		m_bSegmentStart = false;
+	}
+
+	double dToX = Waypoint.dX - Input.dX;
+	double dToY = Waypoint.dY - Input.dY;
+	double dDistance = sqrt(dToX*dToX + dToY*dToY);
+	double dAltError = Waypoint.dAltitude - Input.dAltitude;
+
+	// Arrived, stay there during the hold time
+	if( (m_dHoldTime < 0.0) && (dDistance <= Waypoint.dTolerance) && (fabs(dAltError) <= dMissionAltTolerance) )
+	{
+		m_dHoldTime = 0.0f;
+		DoLog(wxString::Format("Mission %s: waypoint %d/%d reached", m_strName, m_iWaypoint+1, (int)m_Waypoints.size()));
+	}
+	if(m_dHoldTime >= 0.0)
+	{
+		m_dHoldTime += dTime;
+		if(m_dHoldTime >= Waypoint.dHoldTime)
+		{
+			// Next segment starts at this waypoint
+			m_dStartX = Waypoint.dX;
+			m_dStartY = Waypoint.dY;
+			m_dHoldTime = -1.0f;
+			m_iWaypoint++;
+
+			if(m_iWaypoint >= (int)m_Waypoints.size())
+			{
+				m_iWaypoint = (int)m_Waypoints.size() - 1;
+				m_State = MISSION_DONE;
+				DoLog(wxString::Format("Mission %s done", m_strName));
+			}
+
+			// Hover for this step, the next one goes on
+			return (MISSION_RUNNING == m_State);
+		}
+	}
+
+	// Followed point: projection of the drone on the segment plus the look ahead, never past the waypoint
+	double dTargetX = Waypoint.dX;
+	double dTargetY = Waypoint.dY;
+	double dSegX = Waypoint.dX - m_dStartX;
+	double dSegY = Waypoint.dY - m_dStartY;
+	double dSegLength = sqrt(dSegX*dSegX + dSegY*dSegY);
+	if(dSegLength > 0.01)
+	{
+		double dUnitX = dSegX/dSegLength;
+		double dUnitY = dSegY/dSegLength;
+		double dAlong = (Input.dX - m_dStartX)*dUnitX + (Input.dY - m_dStartY)*dUnitY + dMissionLookAhead;
+		if(dAlong < 0.0)
+		{
+			dAlong = 0.0;
+		}
+		if(dAlong < dSegLength)
+		{
+			dTargetX = m_dStartX + dUnitX*dAlong;
+			dTargetY = m_dStartY + dUnitY*dAlong;
+		}
+	}
+
+	// Speed toward the followed point, slower when getting close to the waypoint
+	double dSpeed = sqrt(2.0*dMissionDeceleration*dDistance);
+	if(dSpeed > Waypoint.dSpeed)
+	{
+		dSpeed = Waypoint.dSpeed;
+	}
+	double dVelX = dTargetX - Input.dX;
+	double dVelY = dTargetY - Input.dY;
+	double dTargetDistance = sqrt(dVelX*dVelX + dVelY*dVelY);
+	if(dTargetDistance > 0.001)
+	{
+		dVelX *= dSpeed/dTargetDistance;
+		dVelY *= dSpeed/dTargetDistance;
+	}
+	else
+	{
+		dVelX = dVelY = 0.0f;
+	}
+
+	// Heading of the waypoint, or the one of the path while far from the waypoint
+	double dHeading = Input.dHeading;
+	if(Waypoint.dHeading >= 0.0)
+	{
+		dHeading = Waypoint.dHeading;
+	}
+	else if(dDistance > Waypoint.dTolerance)
+	{
+		dHeading = atan2(dToX, dToY)*d180overPI;
+	}
+	double dRotation = GetAngle180(dHeading - Input.dHeading);
+
+	// Following the path, turn before moving if the angle is high (like the return to home)
+	if( (Waypoint.dHeading < 0.0) && (fabs(dRotation) > 25.0f) )
+	{
+		dVelX = dVelY = 0.0f;
+	}
+
+	dRotation /= 100.0f;
+	if(dRotation > dMissionMaxRotation)
+	{
+		dRotation = dMissionMaxRotation;
+	}
+	else if(dRotation < -dMissionMaxRotation)
+	{
+		dRotation = -dMissionMaxRotation;
+	}
+
+	// Velocity in the frame of the drone
+	double dAngle = Input.dHeading*dPIover180;
+	double dForward = (sin(dAngle)*dVelX + cos(dAngle)*dVelY)/dMissionFullSpeed;
+	double dSide = (cos(dAngle)*dVelX - sin(dAngle)*dVelY)/dMissionFullSpeed;
+
+	double dVertical = dAltError*dMissionClimbGain;
+	if(dVertical > dMissionMaxClimb)
+	{
+		dVertical = dMissionMaxClimb;
+	}
+	else if(dVertical < -dMissionMaxClimb)
+	{
+		dVertical = -dMissionMaxClimb;
+	}
+
+	Move.fSide = (float)wxMax(-1.0, wxMin(1.0, dSide));
+	Move.fForward = (float)wxMax(-1.0, wxMin(1.0, dForward));
+	Move.fVertical = (float)dVertical;
+	Move.fRotation = (float)dRotation;
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// State of the mission
+//////////////////////////////////////////////////////////////////////////////
+eMissionState CMission::GetState()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+	return m_State;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Is the mission running or paused
+//////////////////////////////////////////////////////////////////////////////
+bool CMission::IsActive()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+	return (MISSION_RUNNING == m_State) || (MISSION_PAUSED == m_State);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Index of the current waypoint
+//////////////////////////////////////////////////////////////////////////////
+int CMission::GetWaypoint()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+	return m_iWaypoint;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Number of waypoints
+//////////////////////////////////////////////////////////////////////////////
+int CMission::GetWaypointCount()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+	return (int)m_Waypoints.size();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Values of a waypoint
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Index of the waypoint
+// [OUT] : Waypoint
+// [RETURN] : false if there is no such waypoint
+//////////////////////////////////////////////////////////////////////////////
+bool CMission::GetWaypointData(int iWaypoint, sWaypoint& Waypoint)
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+
+	if( (iWaypoint < 0) || (iWaypoint >= (int)m_Waypoints.size()) )
+	{
+		return false;
+	}
+	Waypoint = m_Waypoints[iWaypoint];
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Name of the mission (name of the file)
+//////////////////////////////////////////////////////////////////////////////
+wxString CMission::GetName()
+{
+	wxCriticalSectionLocker Lock(m_CSMission);
+	return m_strName;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get an angle between -180 end 180
+//////////////////////////////////////////////////////////////////////////////
+double CMission::GetAngle180(double dAngle)
+{
+	dAngle = fmod(dAngle + 180.0, 360.0);
+	if(dAngle < 0.0)
+	{
+		dAngle += 360.0;
+	}
+	return dAngle - 180.0;
+}
@@ -0,0 +1,130 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CMission
+//////////////////////////////////////////////////////////////////////////////
+// Flies a list of 3D waypoints (meters from home). Each step of the control
+// loop gives the estimated position and returns the move to send to the drone,
+// so the mission can also be run headless against a simulator.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_MISSION__
+#define __HEADER_MISSION__
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <vector>
+
+// Directory of the mission files
+#define MISSION_DIR					"Data/Missions"
+
+// Maximum number of waypoints of a mission
+const int iMissionMaxWaypoints		= 256;
+
+// Default values of the waypoints
+const double dMissionSpeed			= 1.0;		// m/s
+const double dMissionTolerance		= 1.0;		// m, unless set by the flight plan of the drone
+const double dMissionAltTolerance	= 0.5;		// m
+
+// Trajectory follower
+const double dMissionFullSpeed		= 5.0;		// m/s reached with a full move command
+const double dMissionLookAhead		= 2.0;		// m, distance of the followed point on the path
+const double dMissionDeceleration	= 0.5;		// m/s2, slows down before each waypoint
+const double dMissionClimbGain		= 0.5;		// Vertical command per meter of altitude error
+const double dMissionMaxClimb		= 0.5;		// Maximum vertical command
+const double dMissionMaxRotation	= 0.5;		// Maximum rotation command
+
+// State of the mission
+enum eMissionState
+{
+	MISSION_EMPTY		= 0,	// No waypoint loaded
+	MISSION_READY,				// Loaded, not started
+	MISSION_RUNNING,
+	MISSION_PAUSED,				// Hovering, can be resumed
+	MISSION_DONE,				// Last waypoint reached
+	MISSION_ABORTED
+};
+
+// One waypoint
+struct sWaypoint
+{
+	double	dX;				// m east of home
+	double	dY;				// m north of home
+	double	dAltitude;		// m
+	double	dSpeed;			// Maximum horizontal speed (m/s)
+	double	dHeading;		// Heading to keep (degrees), < 0 = along the path
+	double	dTolerance;		// Arrival radius (m)
+	double	dHoldTime;		// Time to stay once arrived (s)
+};
+
+// Estimated state of the drone given to each step
+struct sMissionInput
+{
+	double	dX;				// m east of home
+	double	dY;				// m north of home
+	double	dAltitude;		// m
+	double	dHeading;		// True heading (degrees)
+};
+
+// Move computed by each step (same meaning as the parameters of CustomMove)
+struct sMissionMove
+{
+	float	fSide;
+	float	fForward;
+	float	fVertical;
+	float	fRotation;
+};
+
+// Describe the mission class
+class CMission
+{
+public:
+	// Constructor
+	CMission();
+	// Destructor
+	~CMission();
+
+	// Load a mission file
+	// Tolerance and hold time are used when the file does not give them,
+	// waypoints further than dMaxDistance from home or higher than dMaxAltitude (if > 0) are refused
+	bool Load(const wxString& strFile, double dDefaultTolerance, double dDefaultHoldTime, double dMaxDistance, double dMaxAltitude);
+
+	// Control of the mission (pause and resume only apply to a running/paused mission)
+	bool Start();
+	bool Pause();
+	bool Resume();
+	void Abort();
+
+	// Compute the move of one control step of dTime seconds
+	// Returns false if the mission is not running (the move is then a hover)
+	bool Step(const sMissionInput& Input, double dTime, sMissionMove& Move);
+
+	// Status
+	eMissionState GetState();
+	bool IsActive();			// Running or paused
+	int GetWaypoint();			// Index of the current waypoint
+	int GetWaypointCount();
+	bool GetWaypointData(int iWaypoint, sWaypoint& Waypoint);
+	wxString GetName();
+
+private:
+	// Get an angle between -180 end 180
+	static double GetAngle180(double dAngle);
+
+private:
+	// Protects everything, the control thread steps while the GUI controls
+	wxCriticalSection		m_CSMission;
+
+	wxString				m_strName;
+	std::vector<sWaypoint>	m_Waypoints;
+	eMissionState			m_State;
+
+	// Current waypoint and start of the current segment
+	int						m_iWaypoint;
+	bool					m_bSegmentStart;
+	double					m_dStartX;
+	double					m_dStartY;
+
+	// Time spent at the current waypoint (< 0 = not arrived yet)
+	double					m_dHoldTime;
+};
+
+#endif
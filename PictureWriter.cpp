@@ -0,0 +1,150 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CPictureWriter
+//////////////////////////////////////////////////////////////////////////////
+
+#include "PictureWriter.h"
+#include "FrameScaler.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default constructor of CPictureWriter
+//////////////////////////////////////////////////////////////////////////////
+CPictureWriter::CPictureWriter()
+{
+	m_iPending = 0;
+	m_ulWritten = 0;
+	m_ulDropped = 0;
+	m_ulFailed = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default destructor of CPictureWriter
+//////////////////////////////////////////////////////////////////////////////
+CPictureWriter::~CPictureWriter()
+{
+	Stop();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Start the worker thread
+//////////////////////////////////////////////////////////////////////////////
+// [RETURN] : true if the thread runs
+//////////////////////////////////////////////////////////////////////////////
+bool CPictureWriter::Start()
+{
+	if( (CreateThread(wxTHREAD_JOINABLE) != wxTHREAD_NO_ERROR) || (GetThread()->Run() != wxTHREAD_NO_ERROR) )
+	{
+		DoLog("Failed to start the picture thread !", MSG_ERROR);
+		return false;
+	}
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Stop the worker thread, the waiting pictures are written before
+//////////////////////////////////////////////////////////////////////////////
+void CPictureWriter::Stop()
+{
+	if( (NULL != GetThread()) && GetThread()->IsRunning() )
+	{
+		GetThread()->Delete();
+
+		DoLog(wxString::Format("Pictures: %lu written, %lu dropped, %lu failed",
+								(unsigned long)m_ulWritten, (unsigned long)m_ulDropped, (unsigned long)m_ulFailed));
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Queue a BGR image of the drone
+//////////////////////////////////////////////////////////////////////////////
+// [IN]     : The image, its size and line step, the file format
+// [RETURN] : false if the picture was dropped
+//////////////////////////////////////////////////////////////////////////////
+bool CPictureWriter::Push(const unsigned char* pucData, int iWidth, int iHeight, int iStep, bool bJpeg)
+{
+	// The worker is late (slow disk), don't keep more images
+	if(m_iPending >= PICTURE_MAX_PENDING)
+	{
+		m_ulDropped++;
+		return false;
+	}
+
+	// The only copy made on this thread: BGR (drone) to RGB (wxWidgets), compression is left to the worker
+	// Note: a wxImage is not given to the worker, its reference count is not thread safe
+	sPictureJob Job;
+	Job.pucData = (unsigned char*)malloc(iWidth * iHeight * 3);
+	if(NULL == Job.pucData)
+	{
+		m_ulDropped++;
+		return false;
+	}
+	Job.iWidth = iWidth;
+	Job.iHeight = iHeight;
+	CFrameScaler::ToRGB(pucData, iWidth, iHeight, iStep, Job.pucData);
+	Job.strFile = wxString(PICTURE_DIR "Pic_") + GetTimeStampName() + (bJpeg ? ".jpg" : ".png");
+	Job.Type = bJpeg ? wxBITMAP_TYPE_JPEG : wxBITMAP_TYPE_PNG;
+
+	m_iPending++;
+	if(m_Queue.Post(Job) != wxMSGQUEUE_NO_ERROR)
+	{
+		free(Job.pucData);
+		m_iPending--;
+		m_ulDropped++;
+		return false;
+	}
+
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Write one picture
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : The picture
+//////////////////////////////////////////////////////////////////////////////
+void CPictureWriter::Write(sPictureJob& Job)
+{
+	// The image takes the data and frees it
+	wxImage Image(Job.iWidth, Job.iHeight, Job.pucData, false);
+	if(Image.SaveFile(Job.strFile, Job.Type))
+	{
+		m_ulWritten++;
+	}
+	else
+	{
+		m_ulFailed++;
+		DoLog("Failed to take screenshot " + Job.strFile, MSG_ERROR);
+	}
+
+	m_iPending--;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// The code executed by the worker thread
+//////////////////////////////////////////////////////////////////////////////
+wxThread::ExitCode CPictureWriter::Entry()
+{
+	sPictureJob Job;
+
+	while(!GetThread()->TestDestroy())
+	{
+		if(m_Queue.ReceiveTimeout(100, Job) == wxMSGQUEUE_NO_ERROR)
+		{
+			Write(Job);
+		}
+	}
+
+	// Pictures taken before the stop
+	while(m_Queue.ReceiveTimeout(0, Job) == wxMSGQUEUE_NO_ERROR)
+	{
+		Write(Job);
+	}
+
+	return (wxThread::ExitCode)0;
+}
@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CPictureWriter
+//////////////////////////////////////////////////////////////////////////////
+// Saves the screenshots. The render thread only copies the image, a worker
+// thread compresses it (PNG or JPEG) and writes the file
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_PICTUREWRITER__
+#define __HEADER_PICTUREWRITER__
+
+// Includes
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+#include <atomic>
+
+#include "Utils.h"
+
+// Directory of the pictures
+#define PICTURE_DIR				"Media/Pictures/"
+// Number of pictures that can wait for the worker
+#define PICTURE_MAX_PENDING		32
+
+// A picture waiting to be written
+struct sPictureJob
+{
+	unsigned char*	pucData;	// RGB, allocated with malloc(), owned by the worker
+	int				iWidth;
+	int				iHeight;
+	wxString		strFile;
+	wxBitmapType	Type;
+};
+
+// Describe the picture writer class
+class CPictureWriter : public wxThreadHelper
+{
+private:
+	wxMessageQueue<sPictureJob>	m_Queue;
+	std::atomic<int>			m_iPending;
+
+	// Counters
+	std::atomic<unsigned long>	m_ulWritten;
+	std::atomic<unsigned long>	m_ulDropped;
+	std::atomic<unsigned long>	m_ulFailed;
+
+	// Write one picture
+	void Write(sPictureJob& Job);
+
+	// The code executed by the worker thread
+	wxThread::ExitCode Entry();
+
+public:
+	CPictureWriter();
+	~CPictureWriter();
+
+	// Start and stop the worker thread, the waiting pictures are written before it stops
+	bool Start();
+	void Stop();
+
+	// Queue a BGR image of the drone (render thread)
+	// [IN] bJpeg: JPEG instead of PNG
+	bool Push(const unsigned char* pucData, int iWidth, int iHeight, int iStep, bool bJpeg);
+
+	// Counters
+	unsigned long GetWritten() { return m_ulWritten; }
+	unsigned long GetDropped() { return m_ulDropped; }
+	int GetPending() { return m_iPending; }
+};
+
+#endif
@@ -0,0 +1,382 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CPid
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <wx/textfile.h>
+#include <wx/tokenzr.h>
+#include "Utils.h"
+#include "Pid.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Load the gains of an axis
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Name of the axis
+// [OUT] : Gains read from the file, unchanged if the line is missing or wrong
+// [RETURN] : true if the gains have been read
+//////////////////////////////////////////////////////////////////////////////
+bool LoadPidGains(const wxString& strAxis, sPidGains& Gains)
+{
+	wxTextFile GainsFile(PID_GAINS_FILE);
+
+	if(!GainsFile.Exists() || !GainsFile.Open())
+	{
+		return false;
+	}
+
+	for(size_t lPos = 0; lPos < GainsFile.GetLineCount(); lPos++)
+	{
+		wxString strTmp = GainsFile.GetLine(lPos);
+		strTmp.Trim(false);
+
+		// Ignore commented strings and other axes
+		if( (strTmp.Left(1) == ";") || (strTmp.Left(2) == "//") || (strTmp.BeforeFirst('=').Trim() != strAxis) )
+		{
+			continue;
+		}
+
+		double adValues[9];
+		int iCount = 0;
+		wxStringTokenizer Tokenizer(strTmp.AfterFirst('='), " \t");
+		while( Tokenizer.HasMoreTokens() && (iCount < 9) )
+		{
+			if(!Tokenizer.GetNextToken().ToCDouble(&adValues[iCount]))
+			{
+				break;
+			}
+			iCount++;
+		}
+
+		if( (iCount != 9) || (adValues[5] >= adValues[6]) )
+		{
+			DoLog(wxString::Format("Invalid gains for %s in %s, line %d", strAxis, PID_GAINS_FILE, (int)lPos+1), MSG_ERROR);
+			return false;
+		}
+
+		Gains.dKp = adValues[0];
+		Gains.dKi = adValues[1];
+		Gains.dKd = adValues[2];
+		Gains.dKff = adValues[3];
+		Gains.dTau = adValues[4];
+		Gains.dMin = adValues[5];
+		Gains.dMax = adValues[6];
+		Gains.dIntegralMax = adValues[7];
+		Gains.dStepMin = adValues[8];
+		return true;
+	}
+
+	return false;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Write the gains of an axis
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Name of the axis and its gains
+// [RETURN] : true if the file has been written
+//////////////////////////////////////////////////////////////////////////////
+bool SavePidGains(const wxString& strAxis, const sPidGains& Gains)
+{
+	wxTextFile GainsFile(PID_GAINS_FILE);
+
+	if(GainsFile.Exists())
+	{
+		if(!GainsFile.Open())
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if(!GainsFile.Create())
+		{
+			return false;
+		}
+		GainsFile.AddLine("// Gains of the controllers of the return to home");
+		GainsFile.AddLine("// Axis=kp ki kd kff tau min max integralmax stepmin");
+		GainsFile.AddLine("// Step responses with a setpoint jump of at least stepmin are logged (0 = never)");
+	}
+
+	wxString strLine = wxString::Format("%s=%g %g %g %g %g %g %g %g %g", strAxis, Gains.dKp, Gains.dKi, Gains.dKd, Gains.dKff,
+		Gains.dTau, Gains.dMin, Gains.dMax, Gains.dIntegralMax, Gains.dStepMin);
+
+	// Replace the line of the axis, or add it
+	size_t lPos = 0;
+	for(lPos = 0; lPos < GainsFile.GetLineCount(); lPos++)
+	{
+		wxString strTmp = GainsFile.GetLine(lPos);
+		if(strTmp.Trim(false).BeforeFirst('=').Trim() == strAxis)
+		{
+			break;
+		}
+	}
+	if(lPos < GainsFile.GetLineCount())
+	{
+		GainsFile.RemoveLine(lPos);
+		GainsFile.InsertLine(strLine, lPos);
+	}
+	else
+	{
+		GainsFile.AddLine(strLine);
+	}
+
+	return GainsFile.Write();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Constructor
+//////////////////////////////////////////////////////////////////////////////
+CPid::CPid(const wxString& strName, const sPidGains& Gains)
+{
+	m_strName = strName;
+	m_Gains = Gains;
+	Reset();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor
+//////////////////////////////////////////////////////////////////////////////
+CPid::~CPid()
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Change the gains
+//////////////////////////////////////////////////////////////////////////////
+void CPid::SetGains(const sPidGains& Gains)
+{
+	m_Gains = Gains;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Get the gains
+//////////////////////////////////////////////////////////////////////////////
+const sPidGains& CPid::GetGains() const
+{
+	return m_Gains;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Forget the state
+//////////////////////////////////////////////////////////////////////////////
+void CPid::Reset()
+{
+	m_bStarted = false;
+	m_dIntegral = 0.0f;
+	m_dDerivative = 0.0f;
+	m_dSetpointRate = 0.0f;
+	m_dLastMeasure = 0.0f;
+	m_dLastSetpoint = 0.0f;
+	m_dOutput = 0.0f;
+	m_dError = 0.0f;
+	m_bStep = false;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Compute the output of one step
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Setpoint, measure, duration of the step in seconds (fixed period)
+// [RETURN] : Output, within the limits of the gains
+//////////////////////////////////////////////////////////////////////////////
+double CPid::Update(double dSetpoint, double dMeasure, double dTime)
+{
+	if(dTime <= 0.0)
+	{
+		return m_dOutput;
+	}
+
+	m_dError = Difference(dSetpoint, dMeasure);
+
+	if(!m_bStarted)
+	{
+		// No rate on the first step
+		m_bStarted = true;
+		m_dLastMeasure = dMeasure;
+		m_dLastSetpoint = dSetpoint;
+		StartStep(dSetpoint, dMeasure);
+	}
+	else if( (m_Gains.dStepMin > 0.0) && (fabs(Difference(dSetpoint, m_dLastSetpoint)) >= m_Gains.dStepMin) )
+	{
+		// The setpoint jumped, measure the response
+		StartStep(dSetpoint, dMeasure);
+	}
+
+	// Rates filtered with the same time constant
+	double dAlpha = m_Gains.dTau / (m_Gains.dTau + dTime);
+	m_dDerivative = dAlpha*m_dDerivative + (1.0 - dAlpha)*Difference(dMeasure, m_dLastMeasure)/dTime;
+	m_dSetpointRate = dAlpha*m_dSetpointRate + (1.0 - dAlpha)*Difference(dSetpoint, m_dLastSetpoint)/dTime;
+	m_dLastMeasure = dMeasure;
+	m_dLastSetpoint = dSetpoint;
+
+	// Derivative on the measure: no kick when the setpoint jumps
+	double dOutput = m_Gains.dKp*m_dError + m_dIntegral - m_Gains.dKd*m_dDerivative + m_Gains.dKff*m_dSetpointRate;
+
+	// Anti-windup: only integrate while the output is not saturated in the same direction
+	bool bHigh = (dOutput >= m_Gains.dMax) && (m_dError > 0.0);
+	bool bLow = (dOutput <= m_Gains.dMin) && (m_dError < 0.0);
+	if(!bHigh && !bLow)
+	{
+		m_dIntegral += m_Gains.dKi*m_dError*dTime;
+		if(m_dIntegral > m_Gains.dIntegralMax)
+		{
+			m_dIntegral = m_Gains.dIntegralMax;
+		}
+		else if(m_dIntegral < -m_Gains.dIntegralMax)
+		{
+			m_dIntegral = -m_Gains.dIntegralMax;
+		}
+	}
+
+	if(dOutput > m_Gains.dMax)
+	{
+		dOutput = m_Gains.dMax;
+	}
+	else if(dOutput < m_Gains.dMin)
+	{
+		dOutput = m_Gains.dMin;
+	}
+	m_dOutput = dOutput;
+
+	UpdateStep(dMeasure, dTime);
+
+	return m_dOutput;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Last output
+//////////////////////////////////////////////////////////////////////////////
+double CPid::GetOutput() const
+{
+	return m_dOutput;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Last error (setpoint - measure)
+//////////////////////////////////////////////////////////////////////////////
+double CPid::GetError() const
+{
+	return m_dError;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Difference of two values, between -180 and 180 for the angles
+//////////////////////////////////////////////////////////////////////////////
+double CPid::Difference(double dA, double dB) const
+{
+	double dDiff = dA - dB;
+	if(m_Gains.bAngle)
+	{
+		dDiff = fmod(dDiff + 180.0, 360.0);
+		if(dDiff < 0.0)
+		{
+			dDiff += 360.0;
+		}
+		dDiff -= 180.0;
+	}
+	return dDiff;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Begin to measure a step response
+//////////////////////////////////////////////////////////////////////////////
+void CPid::StartStep(double dSetpoint, double dMeasure)
+{
+	// A step still being measured is reported as it is
+	if(m_bStep)
+	{
+		EndStep(false);
+	}
+
+	// Too small to say anything
+	if( (m_Gains.dStepMin <= 0.0) || (fabs(Difference(dSetpoint, dMeasure)) < m_Gains.dStepMin) )
+	{
+		m_bStep = false;
+		return;
+	}
+
+	m_bStep = true;
+	m_dStepStart = dMeasure;
+	m_dStepTarget = dSetpoint;
+	m_dStepTime = 0.0f;
+	m_dStepRise10 = -1.0f;
+	m_dStepRise90 = -1.0f;
+	m_dStepPeak = 0.0f;
+	m_dStepLastOut = 0.0f;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Follow the step response
+//////////////////////////////////////////////////////////////////////////////
+void CPid::UpdateStep(double dMeasure, double dTime)
+{
+	if(!m_bStep)
+	{
+		return;
+	}
+
+	m_dStepTime += dTime;
+
+	// Progress from the start (0) to the target (1)
+	double dProgress = Difference(dMeasure, m_dStepStart) / Difference(m_dStepTarget, m_dStepStart);
+
+	if( (m_dStepRise10 < 0.0) && (dProgress >= 0.1) )
+	{
+		m_dStepRise10 = m_dStepTime;
+	}
+	if( (m_dStepRise90 < 0.0) && (dProgress >= 0.9) )
+	{
+		m_dStepRise90 = m_dStepTime;
+	}
+	if(dProgress > m_dStepPeak)
+	{
+		m_dStepPeak = dProgress;
+	}
+	if(fabs(1.0 - dProgress) > dPidSettleBand)
+	{
+		m_dStepLastOut = m_dStepTime;
+	}
+
+	if(m_dStepTime - m_dStepLastOut >= dPidSettleHold)
+	{
+		EndStep(true);
+	}
+	else if(m_dStepTime >= dPidStepTimeout)
+	{
+		EndStep(false);
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Log the metrics of the step response
+//////////////////////////////////////////////////////////////////////////////
+void CPid::EndStep(bool bSettled)
+{
+	m_bStep = false;
+
+	double dRise = ( (m_dStepRise10 >= 0.0) && (m_dStepRise90 >= 0.0) ) ? m_dStepRise90 - m_dStepRise10 : -1.0;
+	double dOvershoot = (m_dStepPeak > 1.0) ? (m_dStepPeak - 1.0)*100.0 : 0.0;
+
+	if(bSettled)
+	{
+		DoLog(wxString::Format("Pid %s step %.2f: rise %.2f s, overshoot %.0f %%, settling %.2f s, error %.3f",
+			m_strName, Difference(m_dStepTarget, m_dStepStart), dRise, dOvershoot, m_dStepLastOut, m_dError));
+	}
+	else
+	{
+		DoLog(wxString::Format("Pid %s step %.2f: not settled after %.2f s, rise %.2f s, overshoot %.0f %%, error %.3f",
+			m_strName, Difference(m_dStepTarget, m_dStepStart), m_dStepTime, dRise, dOvershoot, m_dError));
+	}
+}
@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CPid
+//////////////////////////////////////////////////////////////////////////////
+// One axis controller: PID with feed-forward of the setpoint rate,
+// integral anti-windup and low-pass filtered derivative (on the measurement).
+// Runs at the fixed period of the control loop, and logs the metrics of the
+// step responses (rise time, overshoot, settling time) to tune the gains.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_PID__
+#define __HEADER_PID__
+
+#include <wx/wx.h>
+
+// File of the gains
+#define PID_GAINS_FILE				"Data/Config/Controller.ini"
+
+// Step responses: band of the settling and time to stay in it, longest measure (s)
+const double dPidSettleBand			= 0.05;
+const double dPidSettleHold			= 1.0;
+const double dPidStepTimeout		= 30.0;
+
+// Gains of one axis
+struct sPidGains
+{
+	double	dKp;
+	double	dKi;
+	double	dKd;
+	double	dKff;			// Feed-forward of the setpoint rate
+	double	dTau;			// Time constant of the derivative filter (s)
+	double	dMin;			// Output limits
+	double	dMax;
+	double	dIntegralMax;	// Limit of the integral term (absolute)
+	double	dStepMin;		// Setpoint jump starting a step response measure (0 = none)
+	bool	bAngle;			// Errors in degrees, wrapped to -180..180
+};
+
+// Load the gains of an axis from PID_GAINS_FILE, the given gains are kept if missing
+// Format of a line: Axis=kp ki kd kff tau min max integralmax stepmin
+bool LoadPidGains(const wxString& strAxis, sPidGains& Gains);
+// Write the gains of an axis to PID_GAINS_FILE (created if needed)
+bool SavePidGains(const wxString& strAxis, const sPidGains& Gains);
+
+// Describe the PID class
+class CPid
+{
+public:
+	// Constructor
+	CPid(const wxString& strName, const sPidGains& Gains);
+	// Destructor
+	~CPid();
+
+	// Change the gains (the state is kept)
+	void SetGains(const sPidGains& Gains);
+	const sPidGains& GetGains() const;
+
+	// Forget the state (next update starts a step response)
+	void Reset();
+
+	// Compute the output of one step of dTime seconds
+	double Update(double dSetpoint, double dMeasure, double dTime);
+
+	// Last output and error
+	double GetOutput() const;
+	double GetError() const;
+
+private:
+	// Setpoint - measure, wrapped for the angles
+	double Difference(double dA, double dB) const;
+
+	// Measure of the step responses
+	void StartStep(double dSetpoint, double dMeasure);
+	void UpdateStep(double dMeasure, double dTime);
+	void EndStep(bool bSettled);
+
+private:
+	wxString	m_strName;
+	sPidGains	m_Gains;
+
+	// State
+	bool		m_bStarted;
+	double		m_dIntegral;
+	double		m_dDerivative;		// Filtered rate of the measure
+	double		m_dSetpointRate;	// Filtered rate of the setpoint
+	double		m_dLastMeasure;
+	double		m_dLastSetpoint;
+	double		m_dOutput;
+	double		m_dError;
+
+	// Step response being measured
+	bool		m_bStep;
+	double		m_dStepStart;		// Measure when the step began
+	double		m_dStepTarget;
+	double		m_dStepTime;
+	double		m_dStepRise10;		// Time to reach 10% and 90% (< 0 = not yet)
+	double		m_dStepRise90;
+	double		m_dStepPeak;		// Highest progress (1 = target)
+	double		m_dStepLastOut;		// Last time out of the settling band
+};
+
+#endif
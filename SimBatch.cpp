@@ -0,0 +1,535 @@
+//////////////////////////////////////////////////////////////////////////////
+// Batch of return to home scenarios on the simulator
+//////////////////////////////////////////////////////////////////////////////
+// Usage: simBatch.run [scenarios [seed [minimum success rate [forward max [wind max]]]]]
+// Each scenario takes off, flies away with random moves under the altitude
+// limit, in random wind and with noisy sensors, then returns home with
+// CAutoPilot as the control loop of CDroneController does. Fails (exit
+// code 1) under the minimum success rate (0 to 1, dBatchSuccessMin by
+// default), to be used as a regression check. The forward move of the
+// return is capped at the Max of HomeDistanceGains, or at forward max (0 to
+// 1) to check a cap raised in PID_GAINS_FILE, e.g. "1000 1 0.99 1.0 3".
+// Then BATCH_MISSION_FILE is flown headless by CMission in light winds, each
+// waypoint must be reached and the drone must hover on the last one, any
+// failed mission fails the batch.
+// Note: the moves of the pilot are sent as they are, without the ramps of
+// CInputDirection.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <wx/init.h>
+#include "Utils.h"
+#include "Log.h"
+#include "AutoPilot.h"
+#include "Estimator.h"
+#include "Simulator.h"
+#include "Mission.h"
+#include "ardrone/ardrone.h"
+
+// Periods of the navdata and of the control loop (s), as on the drone and in CDroneController
+const double dBatchNavdataPeriod	= 0.005;
+const double dBatchControlPeriod	= 0.01;
+// Time of the random flight and longest return to home (s)
+const double dBatchFlightMin		= 10.0;
+const double dBatchFlightMax		= 40.0;
+const double dBatchReturnMax		= 600.0;	// At the default cap, the return is slower than the flight away
+// The drone is home when the autopilot stops closer than this to the true home (m)
+const double dBatchHomeDistance		= 2.0;
+// Home of the gps scenarios
+const double dBatchHomeLatitude		= 45.1885;
+const double dBatchHomeLongitude	= 5.7245;
+// Default strongest mean wind (m/s), the default cap comes back against it, the results are given by steps of 1 m/s
+const int iBatchWindMax				= 1;
+// Altitude limit of the pilot (m), from the lowest allowed by the options to the default
+const double dBatchAltitudeMin		= 3.0;
+const double dBatchAltitudeMax		= 10.0;
+// Default minimum success rate
+const double dBatchSuccessMin		= 0.99;
+
+// Mission flown after the return to home scenarios
+#define BATCH_MISSION_FILE			MISSION_DIR "/Square.txt"
+// Missions flown and their strongest mean wind (m/s), the follower slows down to 1 m/s at 1 m of the waypoints
+const int iBatchMissions			= 10;
+const double dBatchMissionWind		= 0.5;
+// Time to take off before the start, longest mission and hover checked after the last waypoint (s)
+const double dBatchMissionTakeoff	= 5.0;
+const double dBatchMissionMax		= 300.0;
+const double dBatchMissionHover		= 10.0;
+// The mission flies on the estimated position, the true one can be this much further than the tolerances (m)
+const double dBatchMissionMargin	= 1.0;
+
+// Result of one scenario
+struct sBatchResult
+{
+	bool	bHome;				// Autopilot stopped close to home
+	double	dWind;				// Mean wind (m/s)
+	double	dReturnTime;		// s
+	double	dHomeError;			// True distance to home when the autopilot stopped (m)
+	double	dEstimatorError;	// Largest error of the estimated position (m)
+	double	dSimTime;			// Simulated time (s)
+};
+
+// Result of one mission
+struct sMissionResult
+{
+	bool	bSuccess;			// Loaded, all waypoints reached and hover kept
+	int		iReached;			// Waypoints left close enough to their true position
+	int		iWaypoints;
+	double	dArrivalError;		// Largest true distance to a waypoint when leaving it (m)
+	double	dHoverError;		// Largest true distance to the last waypoint during the hover (m)
+	double	dTime;				// Time from the start to the last waypoint (s)
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Random number between 0 and 1, for the scenarios (xorshift64*)
+//////////////////////////////////////////////////////////////////////////////
+// [IN/OUT] : State of the generator
+//////////////////////////////////////////////////////////////////////////////
+static double Random(unsigned long long& ullState)
+{
+	ullState ^= ullState >> 12;
+	ullState ^= ullState << 25;
+	ullState ^= ullState >> 27;
+	return ((ullState * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Random number between dMin and dMax
+//////////////////////////////////////////////////////////////////////////////
+static double Random(unsigned long long& ullState, double dMin, double dMax)
+{
+	return dMin + (dMax - dMin) * Random(ullState);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Run one scenario
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Seed of the scenario, cap of the forward move and strongest mean wind (m/s)
+// [OUT] : Result
+//////////////////////////////////////////////////////////////////////////////
+static void RunScenario(unsigned long long ullSeed, double dForwardMax, int iWindMax, sBatchResult& Result)
+{
+	unsigned long long ullRandom = ullSeed * 0x9E3779B97F4A7C15ULL + 1;
+
+	// Weather and sensors of this scenario
+	sSimConfig Config;
+	CSimulator::GetDefaultConfig(Config);
+	Config.ullSeed			= ullSeed;
+	double dWind			= Random(ullRandom, 0.0, iWindMax);
+	double dWindAngle		= Random(ullRandom, 0.0, 360.0) * dPIover180;
+	Config.dWindX			= dWind * sin(dWindAngle);
+	Config.dWindY			= dWind * cos(dWindAngle);
+	Config.dGust			= Random(ullRandom, 0.0, 1.0);
+	Config.dHeadingBias		= Random(ullRandom, -20.0, 20.0);
+	Config.dNoiseVelocity	= 0.05;
+	Config.dNoiseAltitude	= 0.02;
+	Config.dNoiseHeading	= 2.0;
+	Config.dNoiseGps		= 1.5;
+	Config.bGps				= (Random(ullRandom) < 0.5);
+	Config.dHomeLatitude	= dBatchHomeLatitude;
+	Config.dHomeLongitude	= dBatchHomeLongitude;
+
+	CSimulator Simulator;
+	Simulator.Reset(Config);
+	CAutoPilot AutoPilot;
+	AutoPilot.ResetAutoPilot(Config.bGps, Config.dHomeLatitude, Config.dHomeLongitude);
+	sPidGains DistanceGains = HomeDistanceGains;
+	DistanceGains.dMax = dForwardMax;
+	AutoPilot.SetGains(HomeHeadingGains, DistanceGains, HomeAltitudeGains);
+
+	Result.bHome = false;
+	Result.dWind = dWind;
+	Result.dReturnTime = 0.0;
+	Result.dHomeError = 0.0;
+	Result.dEstimatorError = 0.0;
+	Result.dSimTime = 0.0;
+
+	// Fly away, then come back
+	double dFlightTime = Random(ullRandom, dBatchFlightMin, dBatchFlightMax);
+	double dClimbTime = Random(ullRandom, 2.0, 20.0);
+	double dMaxAltitude = Random(ullRandom, dBatchAltitudeMin, dBatchAltitudeMax);
+	double dNextMove = 0.0;
+	float afMove[3] = { 0.0f, 0.0f, 0.0f };
+	bool bReturning = false;
+	double dReturnStart = 0.0;
+	double dNextControl = 0.0;
+	ARDRONE_NAVDATA Navdata;
+
+	Simulator.Takeoff();
+	while(Simulator.GetTime() < dFlightTime + dBatchReturnMax)
+	{
+		Simulator.Step(dBatchNavdataPeriod);
+
+		// Navdata thread
+		Simulator.GetNavdata(Navdata);
+		sEstimatorInput Input;
+		NavdataToEstimatorInput(Navdata, Config.bGps, Input);
+		AutoPilot.Integrate(Navdata.time.time, Input);
+
+		double dX, dY, dZ;
+		Simulator.GetPosition(dX, dY, dZ);
+		sPose Pose;
+		AutoPilot.GetPose(Pose);
+		double dError = sqrt((Pose.dX - dX) * (Pose.dX - dX) + (Pose.dY - dY) * (Pose.dY - dY));
+		if(dError > Result.dEstimatorError)
+		{
+			Result.dEstimatorError = dError;
+		}
+
+		// Control loop
+		if(Simulator.GetTime() < dNextControl)
+		{
+			continue;
+		}
+		dNextControl += dBatchControlPeriod;
+
+		double dYaw = Navdata.demo.psi * 0.001;
+		if(dYaw < 0.0)
+		{
+			dYaw += 360.0;
+		}
+		if(!bReturning && (Simulator.GetTime() >= dFlightTime))
+		{
+			bReturning = true;
+			dReturnStart = Simulator.GetTime();
+			AutoPilot.ResetWayToHome();
+		}
+		AutoPilot.Update(dYaw, Navdata.demo.altitude * 0.001, bReturning);
+
+		if(!bReturning)
+		{
+			// The pilot: climb, then random moves for a few seconds each
+			if(Simulator.GetTime() >= dNextMove)
+			{
+				dNextMove = Simulator.GetTime() + Random(ullRandom, 1.0, 5.0);
+				afMove[0] = (float)Random(ullRandom, -0.5, 0.5);
+				afMove[1] = (float)Random(ullRandom, -1.0, 0.5);
+				afMove[2] = (float)Random(ullRandom, -0.3, 0.3);
+			}
+			// Climb, kept under the altitude limit as CDroneController::ControlStep() does
+			float fGaz = (Simulator.GetTime() < dClimbTime) ? 1.0f : 0.0f;
+			fGaz = (float)LimitAltitudeMove(Navdata.demo.altitude * 0.001, dMaxAltitude, fGaz);
+			Simulator.Pcmd(1, afMove[0], afMove[1], fGaz, afMove[2]);
+		}
+		else
+		{
+			// The return to home, as CDroneController::ControlStep() and CCustomDrone::CustomMove()
+			double dRotation = 0.0;
+			double dSpeed = 0.0;
+			double dAltitude = 0.0;
+			AutoPilot.ComputeWayToHome(dBatchControlPeriod, dRotation, dSpeed, dAltitude);
+			Simulator.Pcmd((0.0 != dSpeed) ? 1 : 0, 0.0f, (float)-dSpeed, (float)dAltitude, (float)dRotation);
+
+			// The autopilot thinks it is home
+			if(AutoPilot.GetDistance() < 1.0)
+			{
+				Result.dReturnTime = Simulator.GetTime() - dReturnStart;
+				Result.dHomeError = sqrt(dX * dX + dY * dY);
+				Result.bHome = (Result.dHomeError < dBatchHomeDistance);
+				Result.dSimTime = Simulator.GetTime();
+				return;
+			}
+		}
+	}
+
+	// Never came back
+	double dX, dY, dZ;
+	Simulator.GetPosition(dX, dY, dZ);
+	Result.dReturnTime = dBatchReturnMax;
+	Result.dHomeError = sqrt(dX * dX + dY * dY);
+	Result.dSimTime = Simulator.GetTime();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Fly BATCH_MISSION_FILE headless, as CDroneController::ControlStep() does
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Seed of the mission
+// [OUT] : Result
+//////////////////////////////////////////////////////////////////////////////
+static void RunMission(unsigned long long ullSeed, sMissionResult& Result)
+{
+	unsigned long long ullRandom = ullSeed * 0x9E3779B97F4A7C15ULL + 1;
+
+	Result.bSuccess = false;
+	Result.iReached = 0;
+	Result.iWaypoints = 0;
+	Result.dArrivalError = 0.0;
+	Result.dHoverError = 0.0;
+	Result.dTime = 0.0;
+
+	// No flight plan, as when the mission is loaded without drone
+	CMission Mission;
+	if(!Mission.Load(BATCH_MISSION_FILE, dMissionTolerance, 0.0, 0.0, dBatchAltitudeMax))
+	{
+		return;
+	}
+	Result.iWaypoints = Mission.GetWaypointCount();
+
+	// Light weather, same sensors as the return to home scenarios
+	sSimConfig Config;
+	CSimulator::GetDefaultConfig(Config);
+	Config.ullSeed			= ullSeed;
+	double dWind			= Random(ullRandom, 0.0, dBatchMissionWind);
+	double dWindAngle		= Random(ullRandom, 0.0, 360.0) * dPIover180;
+	Config.dWindX			= dWind * sin(dWindAngle);
+	Config.dWindY			= dWind * cos(dWindAngle);
+	Config.dGust			= Random(ullRandom, 0.0, 0.2);
+	Config.dHeadingBias		= Random(ullRandom, -20.0, 20.0);
+	Config.dNoiseVelocity	= 0.05;
+	Config.dNoiseAltitude	= 0.02;
+	Config.dNoiseHeading	= 2.0;
+	Config.dNoiseGps		= 1.5;
+	Config.bGps				= (Random(ullRandom) < 0.5);
+	Config.dHomeLatitude	= dBatchHomeLatitude;
+	Config.dHomeLongitude	= dBatchHomeLongitude;
+
+	CSimulator Simulator;
+	Simulator.Reset(Config);
+	CAutoPilot AutoPilot;
+	AutoPilot.ResetAutoPilot(Config.bGps, Config.dHomeLatitude, Config.dHomeLongitude);
+
+	double dNextControl = 0.0;
+	double dDoneTime = -1.0;
+	sWaypoint Last;
+	Mission.GetWaypointData(Result.iWaypoints - 1, Last);
+	ARDRONE_NAVDATA Navdata;
+
+	Simulator.Takeoff();
+	while(Simulator.GetTime() < dBatchMissionTakeoff + dBatchMissionMax)
+	{
+		Simulator.Step(dBatchNavdataPeriod);
+
+		// Navdata thread
+		Simulator.GetNavdata(Navdata);
+		sEstimatorInput Input;
+		NavdataToEstimatorInput(Navdata, Config.bGps, Input);
+		AutoPilot.Integrate(Navdata.time.time, Input);
+
+		// Control loop
+		if(Simulator.GetTime() < dNextControl)
+		{
+			continue;
+		}
+		dNextControl += dBatchControlPeriod;
+
+		double dYaw = Navdata.demo.psi * 0.001;
+		double dAlt = Navdata.demo.altitude * 0.001;
+		AutoPilot.Update((dYaw < 0.0) ? dYaw + 360.0 : dYaw, dAlt, false);
+
+		// Hover during the take off, then start
+		if(Simulator.GetTime() < dBatchMissionTakeoff)
+		{
+			Simulator.Pcmd(0, 0.0f, 0.0f, 0.0f, 0.0f);
+			continue;
+		}
+		if(MISSION_READY == Mission.GetState())
+		{
+			Mission.Start();
+		}
+
+		if(Mission.IsActive())
+		{
+			// Position of the estimator, heading corrected by its bias
+			sPose Pose;
+			AutoPilot.GetPose(Pose);
+
+			sMissionInput MissionInput;
+			MissionInput.dX = Pose.dX;
+			MissionInput.dY = Pose.dY;
+			MissionInput.dAltitude = dAlt;
+			MissionInput.dHeading = dYaw - Pose.dHeadingBias;
+
+			sMissionMove Move;
+			Mission.Step(MissionInput, dBatchControlPeriod, Move);
+			Move.fVertical = (float)LimitAltitudeMove(dAlt, dBatchAltitudeMax, Move.fVertical);
+
+			// As CCustomDrone::CustomMove()
+			int iMode = ( (0.0f != Move.fSide) || (0.0f != Move.fForward) ) ? 1 : 0;
+			Simulator.Pcmd(iMode, Move.fSide, -Move.fForward, Move.fVertical, Move.fRotation);
+		}
+		else
+		{
+			// Done, the pilot does not move
+			Simulator.Pcmd(0, 0.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+		double dX, dY, dZ;
+		Simulator.GetPosition(dX, dY, dZ);
+
+		// A waypoint is left after its hold time, the drone must still be on it
+		int iLeft = (MISSION_DONE == Mission.GetState()) ? Result.iWaypoints : Mission.GetWaypoint();
+		for(; Result.iReached < iLeft; Result.iReached++)
+		{
+			sWaypoint Waypoint;
+			Mission.GetWaypointData(Result.iReached, Waypoint);
+			double dError = sqrt((Waypoint.dX - dX) * (Waypoint.dX - dX) + (Waypoint.dY - dY) * (Waypoint.dY - dY));
+			Result.dArrivalError = wxMax(Result.dArrivalError, dError);
+			if( (dError > Waypoint.dTolerance + dBatchMissionMargin) || (fabs(Waypoint.dAltitude - dZ) > dMissionAltTolerance + dBatchMissionMargin) )
+			{
+				printf("Mission %llu: waypoint %d left %.1f m away, %.1f m high\n", ullSeed, Result.iReached+1, dError, dZ);
+				return;
+			}
+		}
+		if(MISSION_DONE != Mission.GetState())
+		{
+			if(MISSION_RUNNING != Mission.GetState())
+			{
+				return;
+			}
+			continue;
+		}
+
+		// Hovering on the last waypoint
+		if(dDoneTime < 0.0)
+		{
+			dDoneTime = Simulator.GetTime();
+			Result.dTime = dDoneTime - dBatchMissionTakeoff;
+		}
+		double dDrift = sqrt((Last.dX - dX) * (Last.dX - dX) + (Last.dY - dY) * (Last.dY - dY));
+		Result.dHoverError = wxMax(Result.dHoverError, dDrift);
+		if(dDrift > Last.dTolerance + dBatchMissionMargin)
+		{
+			printf("Mission %llu: drifted %.1f m from the last waypoint\n", ullSeed, dDrift);
+			return;
+		}
+		if(Simulator.GetTime() >= dDoneTime + dBatchMissionHover)
+		{
+			Result.bSuccess = true;
+			return;
+		}
+	}
+
+	printf("Mission %llu: %d/%d waypoints after %.0f s\n", ullSeed, Result.iReached, Result.iWaypoints, dBatchMissionMax);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Entry point
+//////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+	wxInitializer Initializer;
+	if(!Initializer.IsOk())
+	{
+		fprintf(stderr, "Failed to initialize wxWidgets\n");
+		return 2;
+	}
+
+	long lScenarios = (argc > 1) ? strtol(argv[1], NULL, 10) : 1000;
+	unsigned long long ullSeed = (argc > 2) ? strtoull(argv[2], NULL, 10) : 1;
+	double dSuccessMin = (argc > 3) ? strtod(argv[3], NULL) : dBatchSuccessMin;
+	double dForwardMax = (argc > 4) ? strtod(argv[4], NULL) : HomeDistanceGains.dMax;
+	int iWindMax = (argc > 5) ? (int)strtol(argv[5], NULL, 10) : iBatchWindMax;
+	if((dForwardMax <= 0.0) || (dForwardMax > 1.0) || (iWindMax < 1))
+	{
+		fprintf(stderr, "Invalid forward max (0 to 1) or wind max (1 m/s or more)\n");
+		return 2;
+	}
+
+	// The autopilot logs each return, only keep the problems
+	CLog::CreateSingleton()->SetMinLevel(MSG_WARNING);
+
+	long lHome = 0;
+	double dReturnTimeSum = 0.0;
+	double dHomeErrorSum = 0.0;
+	double dEstimatorErrorSum = 0.0;
+	double dEstimatorErrorMax = 0.0;
+	double dSimTime = 0.0;
+	std::vector<long> WindScenarios(iWindMax, 0);
+	std::vector<long> WindHome(iWindMax, 0);
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+	for(long l=0; l<lScenarios; l++)
+	{
+		sBatchResult Result;
+		RunScenario(ullSeed + l, dForwardMax, iWindMax, Result);
+
+		int iWind = (int)Result.dWind;
+		if(iWind >= iWindMax)
+		{
+			iWind = iWindMax - 1;
+		}
+		WindScenarios[iWind]++;
+		if(Result.bHome)
+		{
+			lHome++;
+			WindHome[iWind]++;
+			dReturnTimeSum += Result.dReturnTime;
+		}
+		else
+		{
+			printf("Scenario %llu failed: %.1f m from home after %.1f s\n", ullSeed + l, Result.dHomeError, Result.dReturnTime);
+		}
+		dHomeErrorSum += Result.dHomeError;
+		dEstimatorErrorSum += Result.dEstimatorError;
+		if(Result.dEstimatorError > dEstimatorErrorMax)
+		{
+			dEstimatorErrorMax = Result.dEstimatorError;
+		}
+		dSimTime += Result.dSimTime;
+	}
+
+	double dWallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	double dSuccess = (lScenarios > 0) ? (double)lHome / lScenarios : 0.0;
+	printf("Scenarios:       %ld (seed %llu, forward max %.2f)\n", lScenarios, ullSeed, dForwardMax);
+	printf("Home:            %ld (%.1f %%)\n", lHome, dSuccess * 100.0);
+	if(lHome > 0)
+	{
+		printf("Return time:     %.1f s average\n", dReturnTimeSum / lHome);
+	}
+	for(int i=0; i<iWindMax; i++)
+	{
+		if(WindScenarios[i] > 0)
+		{
+			printf("Wind %d-%d m/s:    %ld/%ld home (%.1f %%)\n", i, i+1, WindHome[i], WindScenarios[i], WindHome[i] * 100.0 / WindScenarios[i]);
+		}
+	}
+	if(lScenarios > 0)
+	{
+		printf("Home error:      %.2f m average\n", dHomeErrorSum / lScenarios);
+		printf("Estimator error: %.2f m average, %.2f m max\n", dEstimatorErrorSum / lScenarios, dEstimatorErrorMax);
+	}
+	printf("Wall time:       %.2f s (%.0fx faster than real time)\n", dWallTime, (dWallTime > 0.0) ? dSimTime / dWallTime : 0.0);
+
+	// Missions
+	int iMissionsDone = 0;
+	double dMissionTimeSum = 0.0;
+	double dArrivalErrorMax = 0.0;
+	double dHoverErrorMax = 0.0;
+	for(int i=0; i<iBatchMissions; i++)
+	{
+		sMissionResult Mission;
+		RunMission(ullSeed + i, Mission);
+		if(0 == Mission.iWaypoints)
+		{
+			printf("Failed to load the mission %s\n", BATCH_MISSION_FILE);
+			break;
+		}
+		if(Mission.bSuccess)
+		{
+			iMissionsDone++;
+			dMissionTimeSum += Mission.dTime;
+		}
+		dArrivalErrorMax = wxMax(dArrivalErrorMax, Mission.dArrivalError);
+		dHoverErrorMax = wxMax(dHoverErrorMax, Mission.dHoverError);
+	}
+	printf("Missions:        %d/%d flown", iMissionsDone, iBatchMissions);
+	if(iMissionsDone > 0)
+	{
+		printf(", %.1f s average", dMissionTimeSum / iMissionsDone);
+	}
+	printf("\n");
+	printf("Waypoint error:  %.2f m max, %.2f m max in hover\n", dArrivalErrorMax, dHoverErrorMax);
+
+	CLog::KillSingleton();
+
+	return ( (dSuccess >= dSuccessMin) && (iBatchMissions == iMissionsDone) ) ? 0 : 1;
+}
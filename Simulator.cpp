@@ -0,0 +1,438 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CSimulator
+//////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+#include "Utils.h"
+#include "AutoPilot.h"	// Radius of the earth
+#include "Simulator.h"
+
+// States of the drone in ctrl_state (high 16 bits)
+enum eSIMSTATE
+{
+	SIM_LANDED = 2,
+	SIM_FLYING = 3,
+	SIM_HOVERING = 4,
+	SIM_TAKEOFF = 6,
+	SIM_LANDING = 8,
+};
+
+const double dSimTwoPi = 360.0 * dPIover180;
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Limit a move between -1 and 1
+//////////////////////////////////////////////////////////////////////////////
+static double Clamp(double dValue)
+{
+	if(dValue > 1.0)
+	{
+		return 1.0;
+	}
+	if(dValue < -1.0)
+	{
+		return -1.0;
+	}
+	return dValue;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Constructor
+//////////////////////////////////////////////////////////////////////////////
+CSimulator::CSimulator()
+{
+	sSimConfig Config;
+	GetDefaultConfig(Config);
+	Reset(Config);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Destructor
+//////////////////////////////////////////////////////////////////////////////
+CSimulator::~CSimulator()
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default settings: limits of the drone by default, no wind, no noise
+//////////////////////////////////////////////////////////////////////////////
+// [OUT] : Settings
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::GetDefaultConfig(sSimConfig& Config)
+{
+	Config.ullSeed			= 1;
+	Config.dEulerMax		= 0.21;
+	Config.dVzMax			= 0.7;
+	Config.dYawMax			= 1.75;
+	Config.dDrag			= 0.42;
+	Config.dWindX			= 0.0;
+	Config.dWindY			= 0.0;
+	Config.dGust			= 0.0;
+	Config.dGustTau			= 2.0;
+	Config.dHeadingBias		= 0.0;
+	Config.dNoiseVelocity	= 0.0;
+	Config.dNoiseAltitude	= 0.0;
+	Config.dNoiseHeading	= 0.0;
+	Config.dNoiseGps		= 0.0;
+	Config.bGps				= false;
+	Config.dHomeLatitude	= 0.0;
+	Config.dHomeLongitude	= 0.0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Start again on the ground at home
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Settings
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::Reset(const sSimConfig& Config)
+{
+	m_Config = Config;
+	m_ullRandom = (0 != Config.ullSeed) ? Config.ullSeed : 0x9E3779B97F4A7C15ULL;
+
+	m_dTime			= 0.0;
+	m_bFlying		= false;
+	m_bTakingOff	= false;
+	m_bLanding		= false;
+
+	m_iMode			= 0;
+	m_dRollCmd		= 0.0;
+	m_dPitchCmd		= 0.0;
+	m_dGazCmd		= 0.0;
+	m_dYawCmd		= 0.0;
+
+	m_dX			= 0.0;
+	m_dY			= 0.0;
+	m_dZ			= 0.0;
+	m_dVx			= 0.0;
+	m_dVy			= 0.0;
+	m_dVz			= 0.0;
+	m_dRoll			= 0.0;
+	m_dPitch		= 0.0;
+	m_dHeading		= 0.0;
+
+	m_dGustX		= 0.0;
+	m_dGustY		= 0.0;
+
+	m_uiSequence	= 0;
+	m_uiGpsFrame	= 0;
+	m_dNextGps		= 0.0;
+	m_dGpsX			= 0.0;
+	m_dGpsY			= 0.0;
+
+	// The pressure sensor has its own zero
+	m_dBaroOffset	= 100.0 * Uniform();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Take off: the drone climbs alone to dSimTakeoffAltitude
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::Takeoff()
+{
+	if(!m_bFlying)
+	{
+		m_bFlying = true;
+		m_bTakingOff = true;
+		m_bLanding = false;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Land: the drone comes down alone, the moves are ignored
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::Land()
+{
+	if(m_bFlying)
+	{
+		m_bTakingOff = false;
+		m_bLanding = true;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Move, as AT*PCMD
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Mode (0 = hovering), roll (right), pitch (nose up = backward),
+//        vertical speed, yaw rate (clockwise), all from -1 to 1
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::Pcmd(int iMode, float fRoll, float fPitch, float fGaz, float fYaw)
+{
+	m_iMode = iMode;
+	m_dRollCmd = Clamp(fRoll);
+	m_dPitchCmd = Clamp(fPitch);
+	m_dGazCmd = Clamp(fGaz);
+	m_dYawCmd = Clamp(fYaw);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Move the simulation forward
+//////////////////////////////////////////////////////////////////////////////
+// [IN] : Time in seconds (a few milliseconds, the integration is explicit)
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::Step(double dTime)
+{
+	m_dTime += dTime;
+	if(!m_bFlying)
+	{
+		return;
+	}
+
+	// Gusts: Gauss-Markov process around the mean wind
+	if(m_Config.dGust > 0.0)
+	{
+		double dDecay = dTime / m_Config.dGustTau;
+		double dSigma = m_Config.dGust * sqrt(2.0 * dDecay);
+		m_dGustX += -m_dGustX * dDecay + dSigma * Gauss();
+		m_dGustY += -m_dGustY * dDecay + dSigma * Gauss();
+	}
+
+	// Velocity in the frame of the drone
+	double dSin = sin(m_dHeading);
+	double dCos = cos(m_dHeading);
+	double dForward = dSin * m_dVx + dCos * m_dVy;
+	double dSide = dCos * m_dVx - dSin * m_dVy;
+
+	// Attitude wanted: the moves, the drone brakes by itself when hovering, nothing while taking off or landing
+	double dRollTarget = 0.0;
+	double dPitchTarget = 0.0;
+	double dYawRate = 0.0;
+	double dVzTarget = 0.0;
+	if(m_bTakingOff)
+	{
+		dVzTarget = 0.5 * m_Config.dVzMax;
+	}
+	else if(m_bLanding)
+	{
+		dVzTarget = -0.5 * m_Config.dVzMax;
+	}
+	else
+	{
+		if(0 != m_iMode)
+		{
+			dRollTarget = m_dRollCmd * m_Config.dEulerMax;
+			dPitchTarget = m_dPitchCmd * m_Config.dEulerMax;
+		}
+		dYawRate = m_dYawCmd * m_Config.dYawMax;
+		dVzTarget = m_dGazCmd * m_Config.dVzMax;
+	}
+	if(m_bTakingOff || m_bLanding || (0 == m_iMode))
+	{
+		dRollTarget = Clamp(-dSimHoverGain * dSide / m_Config.dEulerMax) * m_Config.dEulerMax;
+		dPitchTarget = Clamp(dSimHoverGain * dForward / m_Config.dEulerMax) * m_Config.dEulerMax;
+	}
+
+	// First order answer of the attitude and of the vertical speed
+	m_dRoll += (dRollTarget - m_dRoll) * dTime / dSimTiltTau;
+	m_dPitch += (dPitchTarget - m_dPitch) * dTime / dSimTiltTau;
+	m_dVz += (dVzTarget - m_dVz) * dTime / dSimClimbTau;
+	m_dHeading = fmod(m_dHeading + dYawRate * dTime, dSimTwoPi);
+	if(m_dHeading < 0.0)
+	{
+		m_dHeading += dSimTwoPi;
+	}
+
+	// Tilts accelerate the drone, the air brakes it
+	double dAccForward = -dSimGravity * tan(m_dPitch);
+	double dAccSide = dSimGravity * tan(m_dRoll);
+	double dAccX = dSin * dAccForward + dCos * dAccSide - m_Config.dDrag * (m_dVx - m_Config.dWindX - m_dGustX);
+	double dAccY = dCos * dAccForward - dSin * dAccSide - m_Config.dDrag * (m_dVy - m_Config.dWindY - m_dGustY);
+	m_dVx += dAccX * dTime;
+	m_dVy += dAccY * dTime;
+	m_dX += m_dVx * dTime;
+	m_dY += m_dVy * dTime;
+	m_dZ += m_dVz * dTime;
+
+	// End of the take off and of the landing
+	if(m_bTakingOff && (m_dZ >= dSimTakeoffAltitude))
+	{
+		m_bTakingOff = false;
+	}
+	if(m_dZ <= 0.0)
+	{
+		m_dZ = 0.0;
+		if(m_bLanding)
+		{
+			m_bFlying = false;
+			m_bLanding = false;
+			m_dVx = m_dVy = m_dVz = 0.0;
+			m_dRoll = m_dPitch = 0.0;
+		}
+		else if(m_dVz < 0.0)
+		{
+			m_dVz = 0.0;
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Navdata of the current state, as decoded by ARDrone::getNavdata()
+//////////////////////////////////////////////////////////////////////////////
+// [OUT] : Navdata
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::GetNavdata(ARDRONE_NAVDATA& Navdata)
+{
+	memset(&Navdata, 0, sizeof(Navdata));
+
+	Navdata.header = 0x55667788;
+	Navdata.sequence = ++m_uiSequence;
+	Navdata.ardrone_state = m_bFlying ? ARDRONE_FLY_MASK : 0;
+
+	// Time of the drone: 11 bits of seconds, 21 bits of microseconds (the drone is powered 1 s before the start)
+	double dDroneTime = m_dTime + 1.0;
+	unsigned int uiSeconds = (unsigned int)dDroneTime;
+	Navdata.time.tag = ARDRONE_NAVDATA_TIME_TAG;
+	Navdata.time.time = (uiSeconds << 21) | (unsigned int)((dDroneTime - uiSeconds) * 1000000.0);
+
+	// Demo: angles in millidegrees, velocities in the frame of the drone in mm/s, altitude in mm
+	int iState = SIM_LANDED;
+	if(m_bTakingOff)
+	{
+		iState = SIM_TAKEOFF;
+	}
+	else if(m_bLanding)
+	{
+		iState = SIM_LANDING;
+	}
+	else if(m_bFlying)
+	{
+		iState = (0 == m_iMode) ? SIM_HOVERING : SIM_FLYING;
+	}
+	double dSin = sin(m_dHeading);
+	double dCos = cos(m_dHeading);
+	double dForward = dSin * m_dVx + dCos * m_dVy + m_Config.dNoiseVelocity * Gauss();
+	double dSide = dCos * m_dVx - dSin * m_dVy + m_Config.dNoiseVelocity * Gauss();
+	double dPsi = fmod(m_dHeading * d180overPI + m_Config.dHeadingBias, 360.0);
+	if(dPsi > 180.0)
+	{
+		dPsi -= 360.0;
+	}
+	else if(dPsi < -180.0)
+	{
+		dPsi += 360.0;
+	}
+	Navdata.demo.tag = ARDRONE_NAVDATA_DEMO_TAG;
+	Navdata.demo.ctrl_state = iState << 16;
+	Navdata.demo.vbat_flying_percentage = 100;
+	Navdata.demo.theta = (float)(m_dPitch * d180overPI * 1000.0);
+	Navdata.demo.phi = (float)(m_dRoll * d180overPI * 1000.0);
+	Navdata.demo.psi = (float)(dPsi * 1000.0);
+	Navdata.demo.altitude = (int)(m_dZ * 1000.0);
+	Navdata.demo.vx = (float)(dForward * 1000.0);
+	Navdata.demo.vy = (float)(dSide * 1000.0);
+	Navdata.demo.vz = (float)(m_dVz * 1000.0);
+
+	// Ultrasound, out of range above dSimSonarRange
+	double dSonar = m_dZ + m_Config.dNoiseAltitude * Gauss();
+	Navdata.altitude.tag = ARDRONE_NAVDATA_ALTITUDE_TAG;
+	Navdata.altitude.altitude_raw = (int)(dSonar * 1000.0);
+	Navdata.altitude.altitude_vision = Navdata.demo.altitude;
+
+	// Pressure
+	Navdata.kalman_pressure.tag = ARDRONE_NAVDATA_KALMAN_PRESSURE_TAG;
+	Navdata.kalman_pressure.est_z = (float)(m_dZ + m_dBaroOffset + m_Config.dNoiseAltitude * Gauss());
+	Navdata.kalman_pressure.flag_rejet_US = (m_dZ > dSimSonarRange);
+
+	// Magnetometer: true heading
+	Navdata.magneto.tag = ARDRONE_NAVDATA_MAGNETO_TAG;
+	Navdata.magneto.magneto_calibration_ok = 1;
+	Navdata.magneto.heading_unwrapped = (float)(m_dHeading * d180overPI + m_Config.dNoiseHeading * Gauss());
+
+	// Gps: a new fix every dSimGpsPeriod
+	if(m_Config.bGps)
+	{
+		if(m_dTime >= m_dNextGps)
+		{
+			m_dNextGps = m_dTime + dSimGpsPeriod;
+			m_uiGpsFrame++;
+			m_dGpsX = m_dX + m_Config.dNoiseGps * Gauss();
+			m_dGpsY = m_dY + m_Config.dNoiseGps * Gauss();
+		}
+		double dAccuracy = (m_Config.dNoiseGps > 0.1) ? m_Config.dNoiseGps : 0.1;
+		Navdata.gps.tag = ARDRONE_NAVDATA_GPS_TAG;
+		Navdata.gps.gps_plugged = 1;
+		Navdata.gps.data_available = 1;
+		Navdata.gps.lat = m_Config.dHomeLatitude + m_dGpsY / dEarthRadius * d180overPI;
+		Navdata.gps.lon = m_Config.dHomeLongitude + m_dGpsX / (dEarthRadius * cos(m_Config.dHomeLatitude * dPIover180)) * d180overPI;
+		Navdata.gps.hdop = 1.0;
+		Navdata.gps.pos_accur_c0 = dAccuracy;
+		Navdata.gps.pos_accur_c1 = dAccuracy;
+		Navdata.gps.last_frame_timestamp = m_uiGpsFrame;
+		Navdata.gps.gps_fix = 1;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// True time (s)
+//////////////////////////////////////////////////////////////////////////////
+double CSimulator::GetTime() const
+{
+	return m_dTime;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// True flying state
+//////////////////////////////////////////////////////////////////////////////
+bool CSimulator::IsFlying() const
+{
+	return m_bFlying;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// True position
+//////////////////////////////////////////////////////////////////////////////
+// [OUT] : Meters east and north of home, altitude
+//////////////////////////////////////////////////////////////////////////////
+void CSimulator::GetPosition(double& dX, double& dY, double& dAltitude) const
+{
+	dX = m_dX;
+	dY = m_dY;
+	dAltitude = m_dZ;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// True heading (degrees, clockwise from north)
+//////////////////////////////////////////////////////////////////////////////
+double CSimulator::GetHeading() const
+{
+	return m_dHeading * d180overPI;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Random number between 0 and 1 (xorshift64*)
+//////////////////////////////////////////////////////////////////////////////
+double CSimulator::Uniform()
+{
+	m_ullRandom ^= m_ullRandom >> 12;
+	m_ullRandom ^= m_ullRandom << 25;
+	m_ullRandom ^= m_ullRandom >> 27;
+	return ((m_ullRandom * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Random number of a normal law (Box-Muller)
+//////////////////////////////////////////////////////////////////////////////
+double CSimulator::Gauss()
+{
+	double dU1 = Uniform();
+	double dU2 = Uniform();
+	if(dU1 < 1e-300)
+	{
+		dU1 = 1e-300;
+	}
+	return sqrt(-2.0 * log(dU1)) * cos(dSimTwoPi * dU2);
+}
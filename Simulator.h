@@ -0,0 +1,134 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CSimulator
+//////////////////////////////////////////////////////////////////////////////
+// Deterministic kinematics of the AR.Drone, to test the autopilot without
+// drone. It takes the moves of AT*PCMD (tilts, vertical speed and yaw rate
+// as fractions of euler_angle_max, control_vz_max and control_yaw) and gives
+// navdata as the drone sends them, with wind and sensor noises.
+// Nothing depends on the clock: it runs as fast as the computer can.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_SIMULATOR__
+#define __HEADER_SIMULATOR__
+
+#include "ardrone/ardrone.h"
+
+// Gravity (m/s2)
+const double dSimGravity			= 9.81;
+// Time constants of the attitude and of the vertical speed (s)
+const double dSimTiltTau			= 0.1;
+const double dSimClimbTau			= 0.3;
+// Tilt (rad) per m/s of the hover mode (the drone holds its position by itself)
+const double dSimHoverGain			= 0.5;
+// Altitude of the take off (m), range of the ultrasound (m)
+const double dSimTakeoffAltitude	= 1.0;
+const double dSimSonarRange			= 6.0;
+// Period of the gps fixes (s)
+const double dSimGpsPeriod			= 0.2;
+
+// Settings of a simulation
+struct sSimConfig
+{
+	unsigned long long	ullSeed;		// Same seed = same flight
+
+	// Limits of the drone (same meaning as the configuration of the drone)
+	double	dEulerMax;			// rad
+	double	dVzMax;				// m/s
+	double	dYawMax;			// rad/s
+	double	dDrag;				// 1/s, gives the maximum speed: g.tan(dEulerMax)/dDrag
+
+	// Wind (m/s, toward east and north) and its gusts (standard deviation, time constant)
+	double	dWindX;
+	double	dWindY;
+	double	dGust;
+	double	dGustTau;
+
+	// Sensors
+	double	dHeadingBias;		// Degrees, added to the heading given by the drone
+	double	dNoiseVelocity;		// m/s
+	double	dNoiseAltitude;		// m
+	double	dNoiseHeading;		// Degrees (magnetometer)
+	double	dNoiseGps;			// m
+	bool	bGps;
+	double	dHomeLatitude;
+	double	dHomeLongitude;
+};
+
+// Describe the simulator class
+class CSimulator
+{
+public:
+	// Constructor
+	CSimulator();
+	// Destructor
+	~CSimulator();
+
+	// Default settings: drone at home, no wind, no noise
+	static void GetDefaultConfig(sSimConfig& Config);
+
+	// Start again on the ground at home
+	void Reset(const sSimConfig& Config);
+
+	// Commands of the drone
+	void Takeoff();
+	void Land();
+	void Pcmd(int iMode, float fRoll, float fPitch, float fGaz, float fYaw);
+
+	// Move the simulation forward of dTime seconds
+	void Step(double dTime);
+
+	// Navdata of the current state (new sequence number on each call)
+	void GetNavdata(ARDRONE_NAVDATA& Navdata);
+
+	// True state
+	double GetTime() const;
+	bool IsFlying() const;
+	void GetPosition(double& dX, double& dY, double& dAltitude) const;
+	double GetHeading() const;
+
+private:
+	// Random numbers (same on every platform)
+	double Uniform();
+	double Gauss();
+
+private:
+	sSimConfig			m_Config;
+	unsigned long long	m_ullRandom;
+
+	double		m_dTime;
+	bool		m_bFlying;
+	bool		m_bTakingOff;
+	bool		m_bLanding;
+
+	// Command
+	int			m_iMode;
+	double		m_dRollCmd;
+	double		m_dPitchCmd;
+	double		m_dGazCmd;
+	double		m_dYawCmd;
+
+	// State: position east/north/up (m), velocities (m/s), angles (rad)
+	double		m_dX;
+	double		m_dY;
+	double		m_dZ;
+	double		m_dVx;
+	double		m_dVy;
+	double		m_dVz;
+	double		m_dRoll;
+	double		m_dPitch;
+	double		m_dHeading;
+
+	// Gust (m/s)
+	double		m_dGustX;
+	double		m_dGustY;
+
+	// Navdata
+	unsigned int	m_uiSequence;
+	unsigned int	m_uiGpsFrame;
+	double			m_dNextGps;
+	double			m_dGpsX;
+	double			m_dGpsY;
+	double			m_dBaroOffset;
+};
+
+#endif
@@ -3,12 +3,12 @@
 /////////////////////////////////////////////////////////////////////////////
 
 #include <wx/mstream.h>
+#include <wx/datetime.h>
+#include <atomic>
 
 #include "Utils.h"
 #include "AppConfig.h"
-
-// A global critical section nedded for logging
-wxCriticalSection CSLock;
+#include "Log.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // Load a png file from ressources
@@ -82,56 +82,12 @@ void DoMessage(wxString strMessage, eMsgLevel MsgLevel)
 
 /////////////////////////////////////////////////////////////////////////////
 // Log to file
-// Note: Lock is needed, as the function may be called from multiple threads
+// Note: No lock needed, the message is queued and written by the log thread
+//       Nothing is logged before the log is created or after it is killed
 /////////////////////////////////////////////////////////////////////////////
 void DoLog(wxString strMessage, eMsgLevel MsgLevel)
 {
-	wxCriticalSectionLocker Lock(CSLock);	
-
-	// Type of message (info, warning, error)
-	wxString strType;
-	
-	// Text file containing the device config
-	wxTextFile LogFile("Data/Log/Errors.log");
-	
-    // Verify if the file exist
-	if(LogFile.Exists())
-	{
-		// If the file exist, open it
-		if(!LogFile.Open())
-		{	
-			return;
-		}
-	}
-	else
-	{
-		// Create the file
-		if(!LogFile.Create())
-		{
-			return;	
-		}
-	}
-
-	time_t rawtime;
-    struct tm * timeinfo;
-	time ( &rawtime );
-    timeinfo = localtime ( &rawtime );
-    char *asct = asctime (timeinfo);
-    strip(asct);
-
-	switch(MsgLevel)
-	{
-		case MSG_INFO		: strType = wxString::Format("[NFO] [%s] ", asct); break;
-		case MSG_WARNING	: strType = wxString::Format("[WRN] [%s] ", asct); break;
-		default				: strType = wxString::Format("[ERR] [%s] ", asct); break;
-	}
-
-	LogFile.AddLine(strType + strMessage);
-
-	// Save the changes
-	LogFile.Write();
-    // Close the file
-    LogFile.Close();
+	CLog::Log(strMessage, MsgLevel);
 }
 
 void strip(char *s) {
@@ -175,4 +131,17 @@ long ToLong(wxString strValue)
 wxString ToString(long lValue)
 {
 	return wxString::Format("%d", lValue);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Unique name for a media file, sortable by time
+// The counter keeps the names different within the same millisecond
+/////////////////////////////////////////////////////////////////////////////
+wxString GetTimeStampName()
+{
+	static std::atomic<unsigned long> s_ulCounter(0);
+
+	unsigned long ulCount = ++s_ulCounter;
+	return wxDateTime::UNow().Format("%Y%m%d_%H%M%S_%l") + wxString::Format("_%04lu", ulCount % 10000);
 }
\ No newline at end of file
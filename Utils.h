@@ -53,7 +53,8 @@ const double dMetertoFeet = 3.2808399f;
 // Possible message and log levels
 enum eMsgLevel
 {
-	MSG_INFO = 1,
+	MSG_DEBUG = 0,	// Only logged in debug mode
+	MSG_INFO,
 	MSG_WARNING,
 	MSG_ERROR
 };
@@ -67,6 +68,14 @@ void DoMessage(wxString strMessage, eMsgLevel MsgLevel);
 // Log to file
 void DoLog(wxString strMessage, eMsgLevel MsgLevel = MSG_INFO);
 
+// Log a debug message, the call and its arguments are removed unless LOG_DEBUG is defined
+// (then it is logged when debug.txt exists)
+#ifdef LOG_DEBUG
+#define DoLogDebug(strMessage)	DoLog(strMessage, MSG_DEBUG)
+#else
+#define DoLogDebug(strMessage)	((void)0)
+#endif
+
 // Stripe \n
 void strip(char* s);
 
@@ -79,4 +88,7 @@ long ToLong(wxString strValue);
 // Convert long to string
 wxString ToString(long lValue);
 
+// Unique name for a media file, sortable by time (20161231_235959_999_0001)
+wxString GetTimeStampName();
+
 #endif
\ No newline at end of file
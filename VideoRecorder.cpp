@@ -0,0 +1,315 @@
+//////////////////////////////////////////////////////////////////////////////
+// Implementation of CVideoRecorder
+//////////////////////////////////////////////////////////////////////////////
+
+#include "VideoRecorder.h"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default constructor of CVideoRecorder
+//////////////////////////////////////////////////////////////////////////////
+CVideoRecorder::CVideoRecorder()
+{
+	for(int i = 0; i < REC_QUEUE_SIZE; i++)
+	{
+		m_Queue[i].pImage = NULL;
+		m_Queue[i].llTime = 0;
+	}
+	m_uiWrite = 0;
+	m_uiRead = 0;
+
+	m_bRecording = false;
+	m_iPushing = 0;
+	m_llLastTime = 0;
+	m_pWriter = NULL;
+	m_llStartTime = 0;
+
+	m_ulQueued = 0;
+	m_ulDropped = 0;
+	m_ulWritten = 0;
+	m_ulRepeated = 0;
+	m_ulSkipped = 0;
+	m_iQueueMax = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Default destructor of CVideoRecorder
+//////////////////////////////////////////////////////////////////////////////
+CVideoRecorder::~CVideoRecorder()
+{
+	Stop();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Open the file and start the encoder thread
+//////////////////////////////////////////////////////////////////////////////
+// [IN]     : Name of the file and size of the images
+// [RETURN] : true if the recording is started
+//////////////////////////////////////////////////////////////////////////////
+bool CVideoRecorder::Start(const char* pcFileName, CvSize Size)
+{
+	wxCriticalSectionLocker Lock(m_CSState);
+
+	if(m_bRecording)
+	{
+		return false;
+	}
+
+	// Try different codecs for video writer
+	static const int aiCodecs[] = {	CV_FOURCC('H','2','6','4'), CV_FOURCC('X','V','I','D'), CV_FOURCC('M','P','4','2'), CV_FOURCC('D','X','5','0'),
+									CV_FOURCC('D','I','V','X'), CV_FOURCC('U','2','6','3'), CV_FOURCC('D','I','B',' ') };
+	static const char* apcNames[] = { "H264", "Xvid", "MP4.2", "Divx 5", "DivX", "H263", "RGB avi file mode (Hard disk consuming)" };
+
+	for(int i = 0; (NULL == m_pWriter) && (i < (int)(sizeof(aiCodecs)/sizeof(aiCodecs[0]))); i++)
+	{
+		DoLogDebug(wxString::Format("Try to load %s codec", apcNames[i]));
+		m_pWriter = cvCreateVideoWriter(pcFileName, aiCodecs[i], REC_FPS, Size);
+	}
+
+	if(NULL == m_pWriter)
+	{
+		DoLog("Could not enable codec, recording on pc aborted !", MSG_ERROR);
+		return false;
+	}
+
+	// The images of the queue, no allocation while recording
+	for(int i = 0; i < REC_QUEUE_SIZE; i++)
+	{
+		m_Queue[i].pImage = cvCreateImage(Size, IPL_DEPTH_8U, 3);
+	}
+	m_uiWrite = 0;
+	m_uiRead = 0;
+	while(m_Pending.TryWait() == wxSEMA_NO_ERROR);
+
+	m_llLastTime = 0;
+	m_llStartTime = 0;
+	m_ulQueued = 0;
+	m_ulDropped = 0;
+	m_ulWritten = 0;
+	m_ulRepeated = 0;
+	m_ulSkipped = 0;
+	m_iQueueMax = 0;
+
+	if( (CreateThread(wxTHREAD_JOINABLE) != wxTHREAD_NO_ERROR) || (GetThread()->Run() != wxTHREAD_NO_ERROR) )
+	{
+		DoLog("Could not start the encoder thread, recording on pc aborted !", MSG_ERROR);
+		cvReleaseVideoWriter(&m_pWriter);
+		m_pWriter = NULL;
+		Release();
+		return false;
+	}
+
+	// The render thread sees the queue and the counters ready
+	m_bRecording.store(true, std::memory_order_release);
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Write the waiting frames and close the file
+//////////////////////////////////////////////////////////////////////////////
+void CVideoRecorder::Stop()
+{
+	// No more frames from now
+	{
+		wxCriticalSectionLocker Lock(m_CSState);
+		if(!m_bRecording.exchange(false))
+		{
+			return;
+		}
+	}
+
+	// A push which has seen the recording running is copying into the queue
+	while(0 != m_iPushing.load())
+	{
+		wxThread::Yield();
+	}
+
+	// The thread writes what is left before returning
+	if(NULL != GetThread())
+	{
+		m_Pending.Post();
+		GetThread()->Delete();
+	}
+
+	cvReleaseVideoWriter(&m_pWriter);
+	m_pWriter = NULL;
+	Release();
+
+	DoLog(wxString::Format("Recording on pc: %lu frames queued, %lu dropped, %lu written (%lu repeated, %lu skipped), queue max %d",
+							(unsigned long)m_ulQueued, (unsigned long)m_ulDropped, (unsigned long)m_ulWritten,
+							(unsigned long)m_ulRepeated, (unsigned long)m_ulSkipped, (int)m_iQueueMax));
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Check if a recording is running
+//////////////////////////////////////////////////////////////////////////////
+bool CVideoRecorder::IsRecording()
+{
+	return m_bRecording.load(std::memory_order_acquire);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Queue a frame, without lock
+// Note: the push is counted before reading the state (both sequentially
+//       consistent), so Stop() either waits for it or it sees the stop
+//////////////////////////////////////////////////////////////////////////////
+// [IN]     : The image and its arrival time (us)
+// [RETURN] : false if the frame was not queued
+//////////////////////////////////////////////////////////////////////////////
+bool CVideoRecorder::Push(const IplImage* pImg, long long llTime)
+{
+	m_iPushing.fetch_add(1);
+	bool bQueued = m_bRecording.load() && Queue(pImg, llTime);
+	m_iPushing.fetch_sub(1);
+
+	return bQueued;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Copy a frame in a free slot of the queue
+//////////////////////////////////////////////////////////////////////////////
+// [IN]     : The image and its arrival time (us)
+// [RETURN] : false if the frame was not queued
+//////////////////////////////////////////////////////////////////////////////
+bool CVideoRecorder::Queue(const IplImage* pImg, long long llTime)
+{
+	// Only new frames of the size of the file
+	if(llTime <= m_llLastTime)
+	{
+		return false;
+	}
+	m_llLastTime = llTime;
+
+	unsigned int uiWrite = m_uiWrite.load(std::memory_order_relaxed);
+	unsigned int uiRead = m_uiRead.load(std::memory_order_acquire);
+
+	// Queue full: the encoder is late, drop the new frame, the gap is filled by a repeat
+	if(uiWrite - uiRead >= REC_QUEUE_SIZE)
+	{
+		m_ulDropped++;
+		return false;
+	}
+
+	sRecordFrame& Frame = m_Queue[uiWrite % REC_QUEUE_SIZE];
+	if( (pImg->width != Frame.pImage->width) || (pImg->height != Frame.pImage->height) )
+	{
+		m_ulDropped++;
+		return false;
+	}
+	cvCopy(pImg, Frame.pImage);
+	Frame.llTime = llTime;
+
+	m_uiWrite.store(uiWrite + 1, std::memory_order_release);
+	m_ulQueued++;
+	if((int)(uiWrite + 1 - uiRead) > m_iQueueMax)
+	{
+		m_iQueueMax = (int)(uiWrite + 1 - uiRead);
+	}
+
+	m_Pending.Post();
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Counters of the current (or last) recording
+//////////////////////////////////////////////////////////////////////////////
+// [OUT] : The counters
+//////////////////////////////////////////////////////////////////////////////
+void CVideoRecorder::GetStats(sRecordStats& Stats)
+{
+	Stats.ulQueued = m_ulQueued;
+	Stats.ulDropped = m_ulDropped;
+	Stats.ulWritten = m_ulWritten;
+	Stats.ulRepeated = m_ulRepeated;
+	Stats.ulSkipped = m_ulSkipped;
+	Stats.iQueueMax = m_iQueueMax;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Write the waiting frames to the file
+//////////////////////////////////////////////////////////////////////////////
+void CVideoRecorder::Encode()
+{
+	unsigned int uiRead = m_uiRead.load(std::memory_order_relaxed);
+	while(uiRead != m_uiWrite.load(std::memory_order_acquire))
+	{
+		sRecordFrame& Frame = m_Queue[uiRead % REC_QUEUE_SIZE];
+
+		// The file has a fixed frame rate, place the frame by its arrival time
+		if(0 == m_ulWritten)
+		{
+			m_llStartTime = Frame.llTime;
+		}
+		long long llIndex = (Frame.llTime - m_llStartTime) / REC_FRAME_TIME;
+
+		if(llIndex < (long long)m_ulWritten)
+		{
+			// Faster than the file, this slot already has an image
+			m_ulSkipped++;
+		}
+		else
+		{
+			// Slower than the file, repeat the frame to keep the timing
+			long long llCount = llIndex - (long long)m_ulWritten + 1;
+			if(llCount > REC_MAX_REPEAT)
+			{
+				// Long interruption, don't fill it, continue from here
+				m_llStartTime += (llCount - 1) * REC_FRAME_TIME;
+				llCount = 1;
+			}
+
+			for(long long i = 0; i < llCount; i++)
+			{
+				cvWriteFrame(m_pWriter, Frame.pImage);
+			}
+			m_ulWritten += (unsigned long)llCount;
+			m_ulRepeated += (unsigned long)(llCount - 1);
+		}
+
+		uiRead++;
+		m_uiRead.store(uiRead, std::memory_order_release);
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Free the images of the queue
+//////////////////////////////////////////////////////////////////////////////
+void CVideoRecorder::Release()
+{
+	for(int i = 0; i < REC_QUEUE_SIZE; i++)
+	{
+		if(NULL != m_Queue[i].pImage)
+		{
+			cvReleaseImage(&m_Queue[i].pImage);
+			m_Queue[i].pImage = NULL;
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// The code executed by the encoder thread
+//////////////////////////////////////////////////////////////////////////////
+wxThread::ExitCode CVideoRecorder::Entry()
+{
+	while(!GetThread()->TestDestroy())
+	{
+		// Woken up by a new frame or by the stop
+		m_Pending.WaitTimeout(100);
+		Encode();
+	}
+
+	// Frames queued before the stop
+	Encode();
+
+	return (wxThread::ExitCode)0;
+}
@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////
+// Description of CVideoRecorder
+//////////////////////////////////////////////////////////////////////////////
+// Records the images of the drone on the pc. The render thread queues the
+// frames, an encoder thread writes them so a slow codec never blocks it
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HEADER_VIDEORECORDER__
+#define __HEADER_VIDEORECORDER__
+
+// Includes
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <atomic>
+
+#include "ardrone/ardrone.h"
+#include "Utils.h"
+
+// Number of frames that can wait for the encoder (power of 2)
+#define REC_QUEUE_SIZE		8
+// Frame rate of the file and duration of a frame (us)
+#define REC_FPS				25
+#define REC_FRAME_TIME		(1000000L / REC_FPS)
+// Longest gap filled by repeating the previous frame (frames)
+#define REC_MAX_REPEAT		REC_FPS
+
+// A frame waiting to be encoded
+struct sRecordFrame
+{
+	IplImage*	pImage;
+	long long	llTime;		// Arrival time (us)
+};
+
+// Counters of a recording
+struct sRecordStats
+{
+	unsigned long	ulQueued;		// Frames put in the queue
+	unsigned long	ulDropped;		// Frames dropped because the queue was full
+	unsigned long	ulWritten;		// Frames written to the file (repeats included)
+	unsigned long	ulRepeated;		// Frames written again to fill a gap
+	unsigned long	ulSkipped;		// Frames arrived twice in the same file frame
+	int				iQueueMax;		// Highest number of waiting frames
+};
+
+// Describe the recorder class
+class CVideoRecorder : public wxThreadHelper
+{
+private:
+	// Queue of frames (one producer, one consumer)
+	// The images are allocated at start, a new frame is copied in a free slot
+	sRecordFrame				m_Queue[REC_QUEUE_SIZE];
+	std::atomic<unsigned int>	m_uiWrite;
+	std::atomic<unsigned int>	m_uiRead;
+	wxSemaphore					m_Pending;
+
+	// Start and stop are serialized, push and the encoder do not lock
+	// Stop() waits for the pushes which have seen the recording running
+	wxCriticalSection			m_CSState;
+	std::atomic<bool>			m_bRecording;
+	std::atomic<int>			m_iPushing;
+	long long					m_llLastTime;		// Only used by the render thread
+
+	// Only used by the encoder thread
+	CvVideoWriter*				m_pWriter;
+	long long					m_llStartTime;
+
+	// Counters, written by one thread and read by the others
+	std::atomic<unsigned long>	m_ulQueued;
+	std::atomic<unsigned long>	m_ulDropped;
+	std::atomic<unsigned long>	m_ulWritten;
+	std::atomic<unsigned long>	m_ulRepeated;
+	std::atomic<unsigned long>	m_ulSkipped;
+	std::atomic<int>			m_iQueueMax;
+
+	// Copy a frame in a free slot of the queue
+	bool Queue(const IplImage* pImg, long long llTime);
+	// Write the waiting frames to the file
+	void Encode();
+	// Free the images of the queue
+	void Release();
+
+	// The code executed by the encoder thread
+	wxThread::ExitCode Entry();
+
+public:
+	CVideoRecorder();
+	~CVideoRecorder();
+
+	// Open the file and start the encoder thread
+	bool Start(const char* pcFileName, CvSize Size);
+	// Write the waiting frames and close the file
+	void Stop();
+	bool IsRecording();
+
+	// Queue a frame (render thread), false if it was dropped
+	bool Push(const IplImage* pImg, long long llTime);
+
+	// Counters of the current (or last) recording
+	void GetStats(sRecordStats& Stats);
+};
+
+#endif
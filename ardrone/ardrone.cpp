@@ -45,12 +45,17 @@ ARDrone::ARDrone(const char *ardrone_addr)
 
     // Version information
     memset(&version, 0, sizeof(version));
+    memset(mac, 0, sizeof(mac));
 
     // Navdata
     memset(&navdata, 0, sizeof(navdata));
 
     // Configurations
     memset(&config, 0, sizeof(config));
+    memset(configDesired, 0, sizeof(configDesired));
+    numConfigDesired = 0;
+    configCacheDir[0] = '\0';
+    mutexConfig = NULL;
 
     // Video
     pFormatCtx  = NULL;
@@ -59,19 +64,55 @@ ARDrone::ARDrone(const char *ardrone_addr)
     pFrameBGR   = NULL;
     bufferBGR   = NULL;
     pConvertCtx = NULL;
+    newImage    = false;
+    frameCount  = 0;
+    frameTime   = 0;
 
     // Thread for AT command
     threadCommand = NULL;
+    stopCommand   = false;
     mutexCommand  = NULL;
 
     // Thread for Navdata
     threadNavdata = NULL;
+    stopNavdata   = false;
     mutexNavdata  = NULL;
 
     // Thread for Video
     threadVideo = NULL;
+    stopVideo   = false;
     mutexVideo  = NULL;
 
+    // Link supervision
+    mutexLink = NULL;
+    memset(linkLastTime, 0, sizeof(linkLastTime));
+    memset(linkLostTime, 0, sizeof(linkLostTime));
+    memset(&linkStats, 0, sizeof(linkStats));
+    videoActivity = 0;
+
+    // Recording of the H.264 stream
+    mutexRecord     = NULL;
+    pRecordCtx      = NULL;
+    pRecordStream   = NULL;
+    recordHeader    = false;
+    recordStartTime = 0;
+    recordStartPts  = 0;
+    recordLastDts   = 0;
+    recordLastTime  = 0;
+    recordNavFile   = NULL;
+    preBuffer       = NULL;
+    preBufferSize   = 0;
+    preHead         = 0;
+    prePackets      = NULL;
+    preFirst        = 0;
+    preCount        = 0;
+    preSeq          = 0;
+    preWindow       = 0;
+    recordPreNext   = -1;
+
+    // Thread to refresh the cache
+    threadRefresh = NULL;
+
     // Open if the IP address was specified
     if (ardrone_addr != NULL) {
         open(ardrone_addr);
@@ -105,8 +146,33 @@ int ARDrone::open(const char *ardrone_addr)
     // Save IP address
     strncpy(ip, ardrone_addr, 16);
 
+    // Link supervision
+    if (!mutexLink) {
+        mutexLink = new pthread_mutex_t;
+        pthread_mutex_init(mutexLink, NULL);
+    }
+    memset(linkLostTime, 0, sizeof(linkLostTime));
+    memset(&linkStats, 0, sizeof(linkStats));
+    linkLastTime[LINK_NAVDATA] = linkLastTime[LINK_VIDEO] = usclock();
+
+    // Recording of the H.264 stream
+    if (!mutexRecord) {
+        mutexRecord = new pthread_mutex_t;
+        pthread_mutex_init(mutexRecord, NULL);
+    }
+
+    // Exchanges of configurations
+    if (!mutexConfig) {
+        mutexConfig = new pthread_mutex_t;
+        pthread_mutex_init(mutexConfig, NULL);
+    }
+
+    // Known drone ? (version and configurations from the cache)
+    memset(mac, 0, sizeof(mac));
+    int cached = loadCache();
+
     // Get version information
-    if (!getVersionInfo()) return 0;
+    if (!cached && !getVersionInfo()) return 0;
     std::cout << "AR.Drone Ver. " << version.major << "." << version.minor << "." << version.revision << "." << std::endl;
 
     // Initialize AT command
@@ -118,14 +184,14 @@ int ARDrone::open(const char *ardrone_addr)
     // Initialize Navdata
     if (!initNavdata()) return 0;
 
-    // Initialize Video
-    if (!initVideo()) return 0;
+    // Get configurations
+    if (!cached && !getConfig()) return 0;
 
-    // Wait for updating the status
-    //msleep(500);
+    // Send the configurations that differ from the desired ones
+    applyConfig();
 
-    // Get configurations
-    if (!getConfig()) return 0;
+    // Initialize Video
+    if (!initVideo()) return 0;
 
     // Stop LED animation
     setLED(ARDRONE_LED_ANIM_STANDARD);
@@ -134,6 +200,17 @@ int ARDrone::open(const char *ardrone_addr)
     resetWatchDog();
     resetEmergency();
 
+    // Check the cached values in the background, or remember this drone
+    if (cached) {
+        threadRefresh = new pthread_t;
+        if (pthread_create(threadRefresh, NULL, runRefresh, this) != 0) {
+            CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            delete threadRefresh;
+            threadRefresh = NULL;
+        }
+    }
+    else saveCache();
+
     return 1;
 }
 
@@ -154,13 +231,21 @@ int ARDrone::update(void)
 // --------------------------------------------------------------------------
 void ARDrone::close(void)
 {
+    // Wait for the cache refresh
+    if (threadRefresh) {
+        pthread_join(*threadRefresh, NULL);
+        delete threadRefresh;
+        threadRefresh = NULL;
+    }
+
     // Stop AR.Drone
     if (!onGround()) landing();
 
     // Stop LED animation
     setLED(ARDRONE_LED_ANIM_STANDARD);
 
-    // Finalize video
+    // Close the recording, then the video
+    stopStreamRecord();
     finalizeVideo();
 
     // Finalize Navdata
@@ -168,4 +253,33 @@ void ARDrone::close(void)
 
     // Finalize AT command
     finalizeCommand();
+
+    // Release the image
+    if (img) {
+        cvReleaseImage(&img);
+        img = NULL;
+    }
+
+    // Delete the mutexes
+    if (mutexVideo) {
+        pthread_mutex_destroy(mutexVideo);
+        delete mutexVideo;
+        mutexVideo = NULL;
+    }
+    if (mutexConfig) {
+        pthread_mutex_destroy(mutexConfig);
+        delete mutexConfig;
+        mutexConfig = NULL;
+    }
+    if (mutexLink) {
+        pthread_mutex_destroy(mutexLink);
+        delete mutexLink;
+        mutexLink = NULL;
+    }
+    setPreRecord(0.0, 0);
+    if (mutexRecord) {
+        pthread_mutex_destroy(mutexRecord);
+        delete mutexRecord;
+        mutexRecord = NULL;
+    }
 }
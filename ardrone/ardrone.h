@@ -67,12 +67,21 @@ extern "C" {
 // POSIX threads
 #include <pthread.h>
 
+// Atomic flags
+#include <atomic>
+
 // Win32 <-> GCC
 #ifdef _WIN32
 #include <windows.h>
 #include <winsock.h>
 #define socklen_t int
 #define msleep(ms) Sleep((DWORD)ms)
+inline long long usclock(void) {
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (long long)(count.QuadPart * 1000000.0 / freq.QuadPart);
+}
 #else
 #include <errno.h>
 #include <fcntl.h>
@@ -81,12 +90,18 @@ extern "C" {
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <time.h>
 typedef int SOCKET;
 #define INVALID_SOCKET (-1)
 #define SOCKET_ERROR   (-1)
 inline void msleep(unsigned long ms) {
     while (ms--) usleep(1000);
 }
+inline long long usclock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 #endif
 
 // Macro definitions
@@ -106,6 +121,10 @@ inline void msleep(unsigned long ms) {
 #define ARDRONE_CONTROL_PORT        (5559)          // Port for configuration
 #define ARDRONE_DEFAULT_ADDR        "192.168.1.1"   // Default IP address of AR.Drone
 #define ARDRONE_NAVDATA_HEADER      (0x55667788)    // Header of Navdata
+#define ARDRONE_LINK_DEGRADED_TIME  (300)           // No data since [ms] -> link degraded
+#define ARDRONE_LINK_LOST_TIME      (1000)          // No data since [ms] -> link lost, reconnect
+#define ARDRONE_IMAGE_MAX_WIDTH     (1280)          // Largest image of the camera [px]
+#define ARDRONE_IMAGE_MAX_HEIGHT    (720)
 
 // Math definitions
 #ifndef NULL
@@ -299,6 +318,7 @@ public:
     int  send2(void *data, size_t size);    // Send data
     int  sendf(const char *str, ...);       // Send with format
     int  receive(void *data, size_t size);  // Receive data
+    int  receiveSome(void *data, size_t size, int timeout); // Receive available data
     void close(void);                       // Finalize
 private:
     SOCKET sock;                            // Socket
@@ -314,6 +334,7 @@ public:
     int  send2(void *data, size_t size);    // Send data
     int  sendf(const char *str, ...);       // Send with format
     int  receive(void *data, size_t size);  // Receive data
+    int  receiveSome(void *data, size_t size, int timeout); // Receive data with timeout
     void close(void);                       // Finalize
 private:
     SOCKET sock;                            // Socket
@@ -1016,6 +1037,64 @@ struct ARDRONE_VERSION {
     int revision;
 };
 
+// Link states
+enum ARDRONE_LINK_STATE {
+    ARDRONE_LINK_OK       = 0,  // Navdata and video arrive
+    ARDRONE_LINK_DEGRADED = 1,  // Navdata or video are late
+    ARDRONE_LINK_LOST     = 2   // Navdata or video are lost
+};
+
+// Link statistics
+struct ARDRONE_LINK_STATS {
+    int    navdataLosses;       // Number of navdata dropouts
+    int    videoLosses;         // Number of video reconnections
+    double navdataAge;          // Time since the last navdata [s]
+    double videoAge;            // Time since the last frame [s]
+    double lastReconnectTime;   // Duration of the last dropout [s]
+    double maxReconnectTime;    // Duration of the longest dropout [s]
+};
+
+// Navdata sample written next to a stream recording (<file>.nav)
+// The file starts with ARDRONE_RECORD_NAV_MAGIC, the size of a sample and the time base (num, den) as 32 bit integers
+#define ARDRONE_RECORD_NAV_MAGIC    "ARNAVPTS"
+struct ARDRONE_RECORD_NAV {
+    int64_t  pts;               // Timestamp in the time base of the video stream
+    int64_t  time;              // Arrival time of the navdata [us]
+    double   latitude;          // GPS latitude [deg] (0 without GPS)
+    double   longitude;         // GPS longitude [deg]
+    double   elevation;         // GPS elevation [m]
+    uint32_t sequence;          // Sequence number of the navdata
+    uint32_t state;             // ardrone_state
+    uint32_t battery;           // Battery [%]
+    uint32_t linkQuality;       // Wifi link quality
+    float    roll;              // Roll angle  [deg]
+    float    pitch;             // Pitch angle [deg]
+    float    yaw;               // Yaw angle   [deg]
+    float    altitude;          // Altitude    [m]
+    float    vx;                // Velocity    [m/s]
+    float    vy;
+    float    vz;
+    uint32_t reserved;
+};
+
+// Packet kept before a recording starts (internal)
+#define ARDRONE_PRERECORD_MAX_PACKETS   (2048)      // Number of packets in the pre-recording buffer
+#define ARDRONE_PRERECORD_DRAIN         (8)         // Packets of the buffer written per live packet when a recording starts
+struct ARDRONE_PRE_PACKET {
+    size_t    offset;           // Position in the buffer
+    int       size;
+    int       flags;            // AV_PKT_FLAG_KEY
+    int64_t   pts;              // Timestamp of the demuxer
+    long long time;             // Arrival time [us]
+};
+
+// Desired configuration
+#define ARDRONE_MAX_CONFIG_ENTRIES  (32)            // Number of desired configurations
+struct ARDRONE_CONFIG_ENTRY {
+    char key[64];       // "category:key"
+    char value[64];     // Value as sent with AT*CONFIG
+};
+
 // IplImage* <-> cv::Mat converter
 class ARDRONE_IMAGE {
 public:
@@ -1054,6 +1133,7 @@ public:
     virtual ARDRONE_IMAGE getImage(void);
     virtual ARDrone& operator >> (cv::Mat &image);
     virtual bool willGetNewImage(void);
+    virtual unsigned long getFrameCount(long long *time = NULL);
 
     // Get AR.Drone's firmware version
     virtual int getVersion(int *major = NULL, int *minor = NULL, int *revision = NULL);
@@ -1092,8 +1172,23 @@ public:
     // Others
     virtual int  onGround(void);                    // Check on ground
     virtual void setVideoRecord(bool activate);     // Video recording (only for AR.Drone 2.0)
+    virtual int  startStreamRecord(const char *filename); // Copy the H.264 stream to MP4/MKV (only for AR.Drone 2.0)
+    virtual void stopStreamRecord(void);
+    virtual int  isStreamRecording(void);
+    virtual int  setPreRecord(double seconds, size_t bytes); // Last seconds of the stream written when recording starts
     virtual void setOutdoorMode(bool activate);     // Outdoor mode (experimental)
 
+    // Link supervision
+    virtual int  getLinkState(void);                             // ARDRONE_LINK_STATE
+    virtual void getLinkStats(ARDRONE_LINK_STATS *stats);        // Dropouts and reconnection times
+
+    // Configurations
+    virtual void setConfig(const char *key, const char *value); // Desired value of a configuration
+    virtual int  applyConfig(void);                              // Send the desired values that differ
+    virtual void setConfigCache(const char *dir);                // Directory of the configuration cache
+    virtual int  saveConfig(const char *filename);               // Save configurations
+    virtual int  loadConfig(const char *filename);               // Load configurations
+
 protected:
     // IP address
     char ip[16];
@@ -1112,12 +1207,21 @@ protected:
     // Version information
     ARDRONE_VERSION version;
 
+    // MAC address
+    char mac[18];
+
     // Navigation data
     ARDRONE_NAVDATA navdata;
 
     // Configurations
     ARDRONE_CONFIG config;
 
+    // Desired configurations
+    ARDRONE_CONFIG_ENTRY configDesired[ARDRONE_MAX_CONFIG_ENTRIES];
+    int numConfigDesired;
+    char configCacheDir[256];
+    pthread_mutex_t *mutexConfig;               // One exchange of configurations (or video restart) at a time
+
     // Video
     AVFormatContext *pFormatCtx;
     AVCodecContext  *pCodecCtx;
@@ -1125,10 +1229,13 @@ protected:
     uint8_t         *bufferBGR;
     SwsContext      *pConvertCtx;
     bool            newImage;
+    unsigned long   frameCount;                 // Number of decoded frames
+    long long       frameTime;                  // Arrival time of the last frame [us]
 
     // Thread for AT command
     pthread_t *threadCommand;
     pthread_mutex_t *mutexCommand;
+    std::atomic<bool> stopCommand;              // Asks the thread to return
     virtual void loopCommand(void);
     static void *runCommand(void *args) {
         reinterpret_cast<ARDrone*>(args)->loopCommand();
@@ -1138,7 +1245,9 @@ protected:
     // Thread for Navdata
     pthread_t *threadNavdata;
     pthread_mutex_t *mutexNavdata;
+    std::atomic<bool> stopNavdata;              // Asks the thread to return
     virtual void loopNavdata(void);
+    virtual void navdataArrived(void);          // Called for each navdata, by the navdata thread
     static void *runNavdata(void *args) {
         reinterpret_cast<ARDrone*>(args)->loopNavdata();
         return NULL;
@@ -1147,16 +1256,75 @@ protected:
     // Thread for Video
     pthread_t *threadVideo;
     pthread_mutex_t *mutexVideo;
+    std::atomic<bool> stopVideo;                // Asks the thread to return
     virtual void loopVideo(void);
     static void *runVideo(void *args) {
         reinterpret_cast<ARDrone*>(args)->loopVideo();
         return NULL;
     }
 
+    // Link supervision
+    enum { LINK_NAVDATA = 0, LINK_VIDEO = 1 };
+    pthread_mutex_t *mutexLink;
+    long long linkLastTime[2];                  // Arrival time of the last packet / frame [us]
+    long long linkLostTime[2];                  // Beginning of the current dropout [us] (0 = none)
+    long long videoActivity;                    // Time of the last progress of the stream [us]
+    ARDRONE_LINK_STATS linkStats;
+    virtual void linkArrived(int channel);
+    virtual void linkLost(int channel);
+    virtual int  openVideo(AVFormatContext **format, AVCodecContext **codec);
+    virtual int  reconnectVideo(void);
+    static int interruptVideo(void *args) {
+        ARDrone *ardrone = reinterpret_cast<ARDrone*>(args);
+        return ardrone->stopVideo || (usclock() - ardrone->videoActivity) > ARDRONE_LINK_LOST_TIME * 1000LL;
+    }
+
+    // Recording of the H.264 stream
+    pthread_mutex_t *mutexRecord;
+    AVFormatContext *pRecordCtx;
+    AVStream        *pRecordStream;
+    bool            recordHeader;               // Header written, the file has started with a key frame
+    long long       recordStartTime;            // Arrival time of the first packet [us]
+    int64_t         recordStartPts;             // Timestamp of the first packet (input time base)
+    int64_t         recordLastDts;              // Last written timestamp (output time base)
+    long long       recordLastTime;             // Arrival time of the last written packet [us]
+    FILE            *recordNavFile;             // Navdata samples keyed by the timestamps of the video
+    virtual int writeStreamRecord(AVPacket *packet, long long time);
+    virtual void writeStreamRecordNav(ARDRONE_RECORD_NAV *sample);
+    virtual int writeRecordPacket(AVPacket *packet, long long time);
+
+    // Packets kept before a recording starts
+    uint8_t         *preBuffer;                 // Data of the packets (circular)
+    size_t          preBufferSize;
+    size_t          preHead;                    // End of the newest packet
+    ARDRONE_PRE_PACKET *prePackets;             // Circular list of the packets in preBuffer
+    int             preFirst;                   // Oldest packet, always a key frame
+    int             preCount;
+    long long       preSeq;                     // Number of the oldest packet since the start (counts the dropped ones)
+    long long       preWindow;                  // Length of the window [us]
+    long long       recordPreNext;              // Number of the next packet of the buffer to write (-1 = live packets)
+    virtual void pushPreRecord(AVPacket *packet, long long time);
+    virtual void dropPreRecord(bool aligned);
+    virtual void clearPreRecord(void);
+    virtual int  drainPreRecord(void);
+
+    // Thread to refresh the cache
+    pthread_t *threadRefresh;
+    virtual void loopRefresh(void);
+    static void *runRefresh(void *args) {
+        reinterpret_cast<ARDrone*>(args)->loopRefresh();
+        return NULL;
+    }
+
+    // Cache of known drones (internal)
+    virtual int loadCache(void);
+    virtual int saveCache(void);
+
     // Initialize (internal)
     virtual int initCommand(void);
     virtual int initNavdata(void);
     virtual int initVideo(void);
+    virtual int restartVideo(void);
 
     // Get informations (internal)
     virtual int getVersionInfo(void);
@@ -1167,6 +1335,9 @@ protected:
     // Send commands (internal)
     virtual void resetWatchDog(void);
     virtual void resetEmergency(void);
+    virtual void storeConfig(const char *key, const char *value, bool overwrite = true);
+    virtual int  waitConfigAck(bool set, int timeout);
+    virtual int  sendConfigEntries(const ARDRONE_CONFIG_ENTRY *entries, int num);
 
     // Finalize (internal)
     virtual void finalizeCommand(void);
@@ -63,60 +63,22 @@ int ARDrone::initCommand(void)
         sockCommand.sendf("AT*CONFIG=%d,\"custom:application_id\",\"%s\"\r", ++seq, ARDRONE_APPLOCATION_ID);
         msleep(500);
 
-        // Set maximum velocity in Z-axis [mm/s]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_vz_max\",\"%d\"\r", ++seq, 700);
-        msleep(100);
-
-        // Set maximum yaw [rad/s]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_yaw\",\"%f\"\r", ++seq, 99.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum euler angle [rad]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:euler_angle_max\",\"%f\"\r", ++seq, 12.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum altitude [mm]
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"control:altitude_max\",\"%d\"\r", ++seq, 3000);
-        msleep(100);
-
-        // Bitrate control mode
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 0);     // VBC_MODE_DISABLED
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 1);   // VBC_MODE_DYNAMIC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 2);   // VBC_MANUAL
-        msleep(100);
-
-        // Bitrate
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate\",\"%d\"\r", ++seq, 1000);
-        msleep(100);
-
-        // Max bitrate
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:max_bitrate\",\"%d\"\r", ++seq, 4000);
-        msleep(100);
-
-        // Set video codec
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x81);   // H264_360P_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x82); // MP4_360P_H264_720P_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x83); // H264_720P_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x88); // MP4_360P_H264_360P_CODEC
-        msleep(100);
-
-        // Set video channel to default
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_channel\",\"0\"\r", ++seq);
-        msleep(100);
-
-        // Disable USB recording
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_on_usb\",\"FALSE\"\r", ++seq);
-        msleep(100);
+        // Default configurations, sent by applyConfig() only if they differ
+        char val[64];
+        sprintf(val, "%d", 700);
+        storeConfig("control:control_vz_max", val, false);              // Maximum velocity in Z-axis [mm/s]
+        sprintf(val, "%f", 99.0 * DEG_TO_RAD);
+        storeConfig("control:control_yaw", val, false);                 // Maximum yaw [rad/s]
+        sprintf(val, "%f", 12.0 * DEG_TO_RAD);
+        storeConfig("control:euler_angle_max", val, false);             // Maximum euler angle [rad]
+        storeConfig("control:altitude_max", "3000", false);             // Maximum altitude [mm]
+        storeConfig("video:bitrate_ctrl_mode", "0", false);             // VBC_MODE_DISABLED
+        storeConfig("video:bitrate", "1000", false);                    // Bitrate
+        storeConfig("video:max_bitrate", "4000", false);                // Max bitrate
+        sprintf(val, "%d", 0x81);
+        storeConfig("video:video_codec", val, false);                   // H264_360P_CODEC
+        storeConfig("video:video_channel", "0", false);                 // Video channel to default
+        storeConfig("video:video_on_usb", "FALSE", false);              // Disable USB recording
     }
     // AR.Drone 1.0
     else {
@@ -129,44 +91,19 @@ int ARDrone::initCommand(void)
         // Send flat trim
         sockCommand.sendf("AT*FTRIM=%d,\r", ++seq);
 
-        // Set maximum velocity in Z-axis [mm/s]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_vz_max\",\"%d\"\r", ++seq, 700);
-        msleep(100);
-
-        // Set maximum yaw [rad/s]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:control_yaw\",\"%f\"\r", ++seq, 99.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum euler angle [rad]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:euler_angle_max\",\"%f\"\r", ++seq, 12.0 * DEG_TO_RAD);
-        msleep(100);
-
-        // Set maximum altitude [mm]
-        sockCommand.sendf("AT*CONFIG=%d,\"control:altitude_max\",\"%d\"\r", ++seq, 3000);
-        msleep(100);
-
-        // Bitrate control mode
-        sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 0);     // VBC_MODE_DISABLED
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 1);   // VBC_MODE_DYNAMIC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate_ctrl_mode\",\"%d\"\r", ++seq, 2);   // VBC_MANUAL
-        msleep(100);
-
-        // Bitrate
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:bitrate\",\"%d\"\r", ++seq, 1000);
-        //msleep(100);
-
-        // Max bitrate
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:max_bitrate\",\"%d\"\r", ++seq, 4000);
-        //msleep(100);
-
-        // Set video codec
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x20);   // UVLC_CODEC
-        //sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x40); // P264_CODEC (not supported)
-        msleep(100);
-        
-        // Set video channel to default
-        sockCommand.sendf("AT*CONFIG=%d,\"video:video_channel\",\"0\"\r", ++seq);
-        msleep(100);
+        // Default configurations, sent by applyConfig() only if they differ
+        char val[64];
+        sprintf(val, "%d", 700);
+        storeConfig("control:control_vz_max", val, false);              // Maximum velocity in Z-axis [mm/s]
+        sprintf(val, "%f", 99.0 * DEG_TO_RAD);
+        storeConfig("control:control_yaw", val, false);                 // Maximum yaw [rad/s]
+        sprintf(val, "%f", 12.0 * DEG_TO_RAD);
+        storeConfig("control:euler_angle_max", val, false);             // Maximum euler angle [rad]
+        storeConfig("control:altitude_max", "3000", false);             // Maximum altitude [mm]
+        storeConfig("video:bitrate_ctrl_mode", "0", false);             // VBC_MODE_DISABLED
+        sprintf(val, "%d", 0x20);
+        storeConfig("video:video_codec", val);                          // UVLC_CODEC (the only one supported)
+        storeConfig("video:video_channel", "0", false);                 // Video channel to default
     }
 
     // Disable outdoor mode
@@ -177,6 +114,7 @@ int ARDrone::initCommand(void)
     pthread_mutex_init(mutexCommand, NULL);
 
     // Create a thread
+    stopCommand = false;
     threadCommand = new pthread_t;
     if (pthread_create(threadCommand, NULL, runCommand, this) != 0) {
         CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
@@ -192,12 +130,11 @@ int ARDrone::initCommand(void)
 // --------------------------------------------------------------------------
 void ARDrone::loopCommand(void)
 {
-    while (1) {
+    while (!stopCommand) {
         // Reset Watch-Dog every 100ms
         if (mutexCommand) pthread_mutex_lock(mutexCommand);
         sockCommand.sendf("AT*COMWDG=%d\r", ++seq);
         if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        pthread_testcancel();
         msleep(100);
     }
 }
@@ -418,27 +355,16 @@ void ARDrone::setVideoRecord(bool activate)
 {
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
-        // Finalize video
-        finalizeVideo();
-
         // Enable/Disable video recording
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"video:video_on_usb\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"video:video_on_usb\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
-
         // Output video with MP4_360P_H264_720P_CODEC / H264_360P_CODEC
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x82);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"video:video_codec\",\"%d\"\r", ++seq, 0x81);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
-
-        // Initialize video
-        initVideo();
+        char val[64];
+        sprintf(val, "%d", activate ? 0x82 : 0x81);
+        storeConfig("video:video_on_usb", activate ? "TRUE" : "FALSE");
+        storeConfig("video:video_codec", val);
+        applyConfig();
+
+        // Reopen the stream with the new codec
+        restartVideo();
     }
 }
 
@@ -449,40 +375,14 @@ void ARDrone::setVideoRecord(bool activate)
 // --------------------------------------------------------------------------
 void ARDrone::setOutdoorMode(bool activate)
 {
-    // AR.Drone 2.0
-    if (version.major == ARDRONE_VERSION_2) {
-        // Enable/Disable outdoor mode
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+    // Enable/Disable outdoor mode
+    storeConfig("control:outdoor", activate ? "TRUE" : "FALSE");
 
-        // Without/With shell
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
-    }
-    // AR.Drone 1.0
-    else {
-        // Enable/Disable outdoor mode
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:outdoor\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
+    // Without/With shell
+    storeConfig("control:flight_without_shell", activate ? "TRUE" : "FALSE");
 
-        // Without/With shell
-        if (mutexCommand) pthread_mutex_lock(mutexCommand);
-        if (activate) sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"TRUE\"\r",  ++seq);
-        else          sockCommand.sendf("AT*CONFIG=%d,\"control:flight_without_shell\",\"FALSE\"\r", ++seq);
-        if (mutexCommand) pthread_mutex_unlock(mutexCommand);
-        msleep(100);
-    }
+    // Send them if connected
+    if (mutexCommand) applyConfig();
 }
 
 // --------------------------------------------------------------------------
@@ -529,9 +429,9 @@ void ARDrone::resetEmergency(void)
 // --------------------------------------------------------------------------
 void ARDrone::finalizeCommand(void)
 {
-    // Destroy the thread
+    // Stop the thread (returns within 100ms)
     if (threadCommand) {
-        pthread_cancel(*threadCommand);
+        stopCommand = true;
         pthread_join(*threadCommand, NULL);
         delete threadCommand;
         threadCommand = NULL;
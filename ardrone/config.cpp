@@ -26,191 +26,314 @@
 // -------------------------------------------------------------------------
 
 #include "ardrone.h"
+#include <stddef.h>
+
+// Value types of configuration keys
+enum CONFIG_TYPE {
+    CONFIG_INT,     // int or array of int    (ex. "1", "1,2,3")
+    CONFIG_FLOAT,   // float or array of float (ex. "0.5", "{ 1 2 3 }")
+    CONFIG_BOOL,    // bool                    (ex. "TRUE", "FALSE")
+    CONFIG_STRING   // char array
+};
+
+// A field of ARDRONE_CONFIG
+struct CONFIG_FIELD_INFO {
+    const char *name;   // "category:key"
+    int         type;   // CONFIG_TYPE
+    size_t      offset; // Offset in ARDRONE_CONFIG
+    size_t      size;   // Size of the field [byte]
+};
+
+// Make a field entry from category and key
+#define CONFIG_FIELD(category, key, type) \
+    { #category ":" #key, type, offsetof(ARDRONE_CONFIG, category.key), sizeof(((ARDRONE_CONFIG*)0)->category.key) }
+
+// Configuration keys sent by AR.Drone
+static const CONFIG_FIELD_INFO configFields[] = {
+    CONFIG_FIELD(general, num_version_config,                   CONFIG_INT),
+    CONFIG_FIELD(general, num_version_mb,                       CONFIG_INT),
+    CONFIG_FIELD(general, num_version_soft,                     CONFIG_STRING),
+    CONFIG_FIELD(general, drone_serial,                         CONFIG_STRING),
+    CONFIG_FIELD(general, soft_build_date,                      CONFIG_STRING),
+    CONFIG_FIELD(general, motor1_soft,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor1_hard,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor1_supplier,                      CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor2_soft,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor2_hard,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor2_supplier,                      CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor3_soft,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor3_hard,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor3_supplier,                      CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor4_soft,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor4_hard,                          CONFIG_FLOAT),
+    CONFIG_FIELD(general, motor4_supplier,                      CONFIG_FLOAT),
+    CONFIG_FIELD(general, ardrone_name,                         CONFIG_STRING),
+    CONFIG_FIELD(general, flying_time,                          CONFIG_INT),
+    CONFIG_FIELD(general, navdata_demo,                         CONFIG_BOOL),
+    CONFIG_FIELD(general, com_watchdog,                         CONFIG_INT),
+    CONFIG_FIELD(general, video_enable,                         CONFIG_BOOL),
+    CONFIG_FIELD(general, vision_enable,                        CONFIG_BOOL),
+    CONFIG_FIELD(general, vbat_min,                             CONFIG_INT),
+    CONFIG_FIELD(general, localtime,                            CONFIG_INT),
+    CONFIG_FIELD(general, navdata_options,                      CONFIG_INT),
+    CONFIG_FIELD(general, gps_soft,                             CONFIG_FLOAT),
+    CONFIG_FIELD(general, gps_hard,                             CONFIG_FLOAT),
+    CONFIG_FIELD(general, localtime_zone,                       CONFIG_STRING),
+    CONFIG_FIELD(general, timezone,                             CONFIG_STRING),
+    CONFIG_FIELD(general, battery_type,                         CONFIG_INT),
+
+    CONFIG_FIELD(control, accs_offset,                          CONFIG_FLOAT),
+    CONFIG_FIELD(control, accs_gains,                           CONFIG_FLOAT),
+    CONFIG_FIELD(control, gyros_offset,                         CONFIG_FLOAT),
+    CONFIG_FIELD(control, gyros_gains,                          CONFIG_FLOAT),
+    CONFIG_FIELD(control, gyros110_offset,                      CONFIG_FLOAT),
+    CONFIG_FIELD(control, gyros110_gains,                       CONFIG_FLOAT),
+    CONFIG_FIELD(control, magneto_offset,                       CONFIG_FLOAT),
+    CONFIG_FIELD(control, magneto_radius,                       CONFIG_FLOAT),
+    CONFIG_FIELD(control, gyro_offset_thr_x,                    CONFIG_FLOAT),
+    CONFIG_FIELD(control, gyro_offset_thr_y,                    CONFIG_FLOAT),
+    CONFIG_FIELD(control, gyro_offset_thr_z,                    CONFIG_FLOAT),
+    CONFIG_FIELD(control, pwm_ref_gyros,                        CONFIG_INT),
+    CONFIG_FIELD(control, osctun_value,                         CONFIG_INT),
+    CONFIG_FIELD(control, osctun_test,                          CONFIG_BOOL),
+    CONFIG_FIELD(control, altitude_max,                         CONFIG_INT),
+    CONFIG_FIELD(control, altitude_min,                         CONFIG_INT),
+    CONFIG_FIELD(control, outdoor,                              CONFIG_BOOL),
+    CONFIG_FIELD(control, flight_without_shell,                 CONFIG_BOOL),
+    CONFIG_FIELD(control, autonomous_flight,                    CONFIG_BOOL),
+    CONFIG_FIELD(control, flight_anim,                          CONFIG_INT),
+    CONFIG_FIELD(control, control_level,                        CONFIG_INT),
+    CONFIG_FIELD(control, euler_angle_max,                      CONFIG_FLOAT),
+    CONFIG_FIELD(control, control_iphone_tilt,                  CONFIG_FLOAT),
+    CONFIG_FIELD(control, control_vz_max,                       CONFIG_FLOAT),
+    CONFIG_FIELD(control, control_yaw,                          CONFIG_FLOAT),
+    CONFIG_FIELD(control, manual_trim,                          CONFIG_BOOL),
+    CONFIG_FIELD(control, indoor_euler_angle_max,               CONFIG_FLOAT),
+    CONFIG_FIELD(control, indoor_control_vz_max,                CONFIG_FLOAT),
+    CONFIG_FIELD(control, indoor_control_yaw,                   CONFIG_FLOAT),
+    CONFIG_FIELD(control, outdoor_euler_angle_max,              CONFIG_FLOAT),
+    CONFIG_FIELD(control, outdoor_control_vz_max,               CONFIG_FLOAT),
+    CONFIG_FIELD(control, outdoor_control_yaw,                  CONFIG_FLOAT),
+    CONFIG_FIELD(control, flying_mode,                          CONFIG_INT),
+    CONFIG_FIELD(control, hovering_range,                       CONFIG_INT),
+    CONFIG_FIELD(control, flying_camera_mode,                   CONFIG_INT),
+    CONFIG_FIELD(control, flying_camera_enable,                 CONFIG_BOOL),
+
+    CONFIG_FIELD(network, ssid_single_player,                   CONFIG_STRING),
+    CONFIG_FIELD(network, ssid_multi_player,                    CONFIG_STRING),
+    CONFIG_FIELD(network, wifi_mode,                            CONFIG_INT),
+    CONFIG_FIELD(network, wifi_rate,                            CONFIG_INT),
+    CONFIG_FIELD(network, owner_mac,                            CONFIG_STRING),
+
+    CONFIG_FIELD(pic, ultrasound_freq,                          CONFIG_INT),
+    CONFIG_FIELD(pic, ultrasound_watchdog,                      CONFIG_INT),
+    CONFIG_FIELD(pic, pic_version,                              CONFIG_INT),
+
+    CONFIG_FIELD(video, camif_fps,                              CONFIG_INT),
+    CONFIG_FIELD(video, camif_buffers,                          CONFIG_INT),
+    CONFIG_FIELD(video, num_trackers,                           CONFIG_INT),
+    CONFIG_FIELD(video, video_storage_space,                    CONFIG_INT),
+    CONFIG_FIELD(video, video_on_usb,                           CONFIG_BOOL),
+    CONFIG_FIELD(video, video_file_index,                       CONFIG_INT),
+    CONFIG_FIELD(video, bitrate,                                CONFIG_INT),
+    CONFIG_FIELD(video, bitrate_ctrl_mode,                      CONFIG_INT),
+    CONFIG_FIELD(video, bitrate_storage,                        CONFIG_INT),
+    CONFIG_FIELD(video, codec_fps,                              CONFIG_INT),
+    CONFIG_FIELD(video, video_codec,                            CONFIG_INT),
+    CONFIG_FIELD(video, video_slices,                           CONFIG_INT),
+    CONFIG_FIELD(video, video_live_socket,                      CONFIG_INT),
+    CONFIG_FIELD(video, max_bitrate,                            CONFIG_INT),
+    CONFIG_FIELD(video, video_channel,                          CONFIG_INT),
+    CONFIG_FIELD(video, exposure_mode,                          CONFIG_INT),
+    CONFIG_FIELD(video, saturation_mode,                        CONFIG_INT),
+    CONFIG_FIELD(video, whitebalance_mode,                      CONFIG_INT),
+
+    CONFIG_FIELD(leds, leds_anim,                               CONFIG_INT),
+
+    CONFIG_FIELD(detect, enemy_colors,                          CONFIG_INT),
+    CONFIG_FIELD(detect, enemy_without_shell,                   CONFIG_INT),
+    CONFIG_FIELD(detect, groundstripe_colors,                   CONFIG_INT),
+    CONFIG_FIELD(detect, detect_type,                           CONFIG_INT),
+    CONFIG_FIELD(detect, detections_select_h,                   CONFIG_INT),
+    CONFIG_FIELD(detect, detections_select_v_hsync,             CONFIG_INT),
+    CONFIG_FIELD(detect, detections_select_v,                   CONFIG_INT),
+
+    CONFIG_FIELD(syslog, output,                                CONFIG_INT),
+    CONFIG_FIELD(syslog, max_size,                              CONFIG_INT),
+    CONFIG_FIELD(syslog, nb_files,                              CONFIG_INT),
+
+    CONFIG_FIELD(custom, application_desc,                      CONFIG_STRING),
+    CONFIG_FIELD(custom, profile_desc,                          CONFIG_STRING),
+    CONFIG_FIELD(custom, session_desc,                          CONFIG_STRING),
+    CONFIG_FIELD(custom, application_id,                        CONFIG_STRING),
+    CONFIG_FIELD(custom, profile_id,                            CONFIG_STRING),
+    CONFIG_FIELD(custom, session_id,                            CONFIG_STRING),
+
+    CONFIG_FIELD(userbox, userbox_cmd,                          CONFIG_INT),
+
+    CONFIG_FIELD(gps, latitude,                                 CONFIG_FLOAT),
+    CONFIG_FIELD(gps, longitude,                                CONFIG_FLOAT),
+    CONFIG_FIELD(gps, altitude,                                 CONFIG_FLOAT),
+    CONFIG_FIELD(gps, accuracy,                                 CONFIG_FLOAT),
+
+    CONFIG_FIELD(flightplan, default_validation_radius,         CONFIG_FLOAT),
+    CONFIG_FIELD(flightplan, default_validation_time,           CONFIG_FLOAT),
+    CONFIG_FIELD(flightplan, max_distance_from_takeoff,         CONFIG_INT),
+    CONFIG_FIELD(flightplan, gcs_ip,                            CONFIG_INT),
+    CONFIG_FIELD(flightplan, video_stop_delay,                  CONFIG_INT),
+    CONFIG_FIELD(flightplan, low_battery_go_home,               CONFIG_BOOL),
+    CONFIG_FIELD(flightplan, automatic_heading,                 CONFIG_BOOL),
+    CONFIG_FIELD(flightplan, com_lost_action_delay,             CONFIG_INT),
+    CONFIG_FIELD(flightplan, altitude_go_home,                  CONFIG_INT),
+    CONFIG_FIELD(flightplan, mavlink_js_roll_left,              CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_roll_right,             CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_pitch_front,            CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_pitch_back,             CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_yaw_left,               CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_yaw_right,              CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_go_up,                  CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_go_down,                CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_inc_gains,              CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_dec_gains,              CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_select,                 CONFIG_STRING),
+    CONFIG_FIELD(flightplan, mavlink_js_start,                  CONFIG_STRING),
+
+    CONFIG_FIELD(rescue, rescue,                                CONFIG_INT),   // Last key of the dump, see getConfig()
+};
+
+// Number of configuration keys
+#define CONFIG_NUM_FIELDS   (int)(sizeof(configFields) / sizeof(configFields[0]))
+
+// Hash table (open addressing) of the configuration keys
+#define CONFIG_HASH_SIZE    (512)
+static short configHash[CONFIG_HASH_SIZE];
+static pthread_once_t configHashOnce = PTHREAD_ONCE_INIT;
+
+// Timeouts for the configuration dump [ms]
+#define CONFIG_FIRST_TIMEOUT (2000)     // Until the first byte arrives
+#define CONFIG_IDLE_TIMEOUT  (200)      // Silence that ends a dump without its end (fallback)
 
 // --------------------------------------------------------------------------
-//! @brief   Parse a configuration string.
-//! @param   str Configuration string
-//! @param   config Configuration struct
-//! @return  None
+//! @brief   Hash a key name (FNV-1a).
+//! @param   str Key name
+//! @param   len Length of the key name
+//! @return  Hash value
 // --------------------------------------------------------------------------
-void parse(const char *str, ARDRONE_CONFIG *config)
+static unsigned int hashConfigKey(const char *str, size_t len)
 {
-    // Split key and value
-    char category[256] = {'\0'}, key[256] = {'\0'}, val[256] = {'\0'};
-    sscanf(str, "%[^:]:%s = %[^\n]", category, key, val);
-    //printf("category = %s, key = %s, val = %s\n", category, key, val);
-
-    // Parse the values
-    if (!(strcmp(category, "general"))) {
-        if      (!strcmp(key, "num_version_config")) sscanf(val, "%d", &(config->general.num_version_config));
-        else if (!strcmp(key, "num_version_mb"))     sscanf(val, "%d", &(config->general.num_version_mb));
-        else if (!strcmp(key, "num_version_soft"))   strncpy(config->general.num_version_soft, val, 32);
-        else if (!strcmp(key, "drone_serial"))       strncpy(config->general.drone_serial, val, 32);
-        else if (!strcmp(key, "soft_build_date"))    strncpy(config->general.soft_build_date, val, 32);
-        else if (!strcmp(key, "motor1_soft"))        sscanf(val, "%f", &(config->general.motor1_soft));
-        else if (!strcmp(key, "motor1_hard"))        sscanf(val, "%f", &(config->general.motor1_hard));
-        else if (!strcmp(key, "motor1_supplier"))    sscanf(val, "%f", &(config->general.motor1_supplier));
-        else if (!strcmp(key, "motor2_soft"))        sscanf(val, "%f", &(config->general.motor2_soft));
-        else if (!strcmp(key, "motor2_hard"))        sscanf(val, "%f", &(config->general.motor2_hard));
-        else if (!strcmp(key, "motor2_supplier"))    sscanf(val, "%f", &(config->general.motor2_supplier));
-        else if (!strcmp(key, "motor3_soft"))        sscanf(val, "%f", &(config->general.motor3_soft));
-        else if (!strcmp(key, "motor3_hard"))        sscanf(val, "%f", &(config->general.motor3_hard));
-        else if (!strcmp(key, "motor3_supplier"))    sscanf(val, "%f", &(config->general.motor3_supplier));
-        else if (!strcmp(key, "motor4_soft"))        sscanf(val, "%f", &(config->general.motor4_soft));
-        else if (!strcmp(key, "motor4_hard"))        sscanf(val, "%f", &(config->general.motor4_hard));
-        else if (!strcmp(key, "motor4_supplier"))    sscanf(val, "%f", &(config->general.motor4_supplier));
-        else if (!strcmp(key, "ardrone_name"))       strncpy(config->general.ardrone_name, val, 32);
-        else if (!strcmp(key, "flying_time"))        sscanf(val, "%d", &(config->general.flying_time));
-        else if (!strcmp(key, "navdata_demo"))       config->general.navdata_demo = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "com_watchdog"))       sscanf(val, "%d", &(config->general.com_watchdog));
-        else if (!strcmp(key, "video_enable"))       config->general.video_enable = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "vision_enable"))      config->general.vision_enable = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "vbat_min"))           sscanf(val, "%d", &(config->general.vbat_min));
-        else if (!strcmp(key, "localtime"))          sscanf(val, "%d", &(config->general.localtime));
-        else if (!strcmp(key, "navdata_options"))    sscanf(val, "%d", &(config->general.navdata_options));
-        else if (!strcmp(key, "gps_soft"))           sscanf(val, "%f", &(config->general.motor1_soft));
-        else if (!strcmp(key, "gps_hard"))           sscanf(val, "%f", &(config->general.motor1_hard));
-        else if (!strcmp(key, "localtime_zone"))     strncpy(config->general.localtime_zone, val, 32);
-        else if (!strcmp(key, "timezone"))           strncpy(config->general.timezone, val, 32);
-        else if (!strcmp(key, "battery_type"))       sscanf(val, "%d", &(config->general.battery_type));
-    }
-    else if (!(strcmp(category, "control"))) {
-        if      (!strcmp(key, "accs_offset"))             sscanf(val, "{ %f %f %f }", &(config->control.accs_offset[0]), &(config->control.accs_offset[1]), &(config->control.accs_offset[2]));
-        else if (!strcmp(key, "accs_gains"))              sscanf(val, "{ %f %f %f %f %f %f %f %f %f }", &(config->control.accs_gains[0]), &(config->control.accs_gains[1]), &(config->control.accs_gains[2]), &(config->control.accs_gains[3]), &(config->control.accs_gains[4]), &(config->control.accs_gains[5]), &(config->control.accs_gains[6]), &(config->control.accs_gains[7]), &(config->control.accs_gains[8]));
-        else if (!strcmp(key, "gyros_offset"))            sscanf(val, "{ %f %f %f }", &(config->control.gyros_offset[0]), &(config->control.gyros_offset[1]), &(config->control.gyros_offset[2]));
-        else if (!strcmp(key, "gyros_gains"))             sscanf(val, "{ %f %f %f }", &(config->control.gyros_gains[0]), &(config->control.gyros_gains[1]), &(config->control.gyros_gains[2]));
-        else if (!strcmp(key, "gyros110_offset"))         sscanf(val, "{ %f %f }", &(config->control.gyros110_offset[0]), &(config->control.gyros110_offset[1]));
-        else if (!strcmp(key, "gyros110_gains"))          sscanf(val, "{ %f %f }", &(config->control.gyros110_gains[0]), &(config->control.gyros110_gains[1]));
-        else if (!strcmp(key, "magneto_offset"))          sscanf(val, "{ %f %f %f }", &(config->control.magneto_offset[0]), &(config->control.magneto_offset[1]), &(config->control.magneto_offset[2]));
-        else if (!strcmp(key, "magneto_radius"))          sscanf(val, "%f", &(config->control.magneto_radius));
-        else if (!strcmp(key, "gyro_offset_thr_x"))       sscanf(val, "%f", &(config->control.gyro_offset_thr_x));
-        else if (!strcmp(key, "gyro_offset_thr_y"))       sscanf(val, "%f", &(config->control.gyro_offset_thr_y));
-        else if (!strcmp(key, "gyro_offset_thr_z"))       sscanf(val, "%f", &(config->control.gyro_offset_thr_z));
-        else if (!strcmp(key, "pwm_ref_gyros"))           sscanf(val, "%d", &(config->control.pwm_ref_gyros));
-        else if (!strcmp(key, "osctun_value"))            sscanf(val, "%d", &(config->control.osctun_value));
-        else if (!strcmp(key, "osctun_test"))             config->control.osctun_test = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "altitude_max"))            sscanf(val, "%d", &(config->control.altitude_max));
-        else if (!strcmp(key, "altitude_min"))            sscanf(val, "%d", &(config->control.altitude_min));
-        else if (!strcmp(key, "outdoor"))                 config->control.outdoor = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "flight_without_shell"))    config->control.flight_without_shell = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "autonomous_flight"))       config->control.autonomous_flight = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "flight_anim"))             sscanf(val, "%d,%d", &(config->control.flight_anim[0]), &(config->control.flight_anim[1]));
-        else if (!strcmp(key, "control_level"))           sscanf(val, "%d", &(config->control.control_level));
-        else if (!strcmp(key, "euler_angle_max"))         sscanf(val, "%f", &(config->control.euler_angle_max));
-        else if (!strcmp(key, "control_iphone_tilt"))     sscanf(val, "%f", &(config->control.control_iphone_tilt));
-        else if (!strcmp(key, "control_vz_max"))          sscanf(val, "%f", &(config->control.control_vz_max));
-        else if (!strcmp(key, "control_yaw"))             sscanf(val, "%f", &(config->control.control_yaw));
-        else if (!strcmp(key, "manual_trim"))             config->control.manual_trim = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "indoor_euler_angle_max"))  sscanf(val, "%f", &(config->control.indoor_euler_angle_max));
-        else if (!strcmp(key, "indoor_control_vz_max"))   sscanf(val, "%f", &(config->control.indoor_control_vz_max));
-        else if (!strcmp(key, "indoor_control_yaw"))      sscanf(val, "%f", &(config->control.indoor_control_yaw));
-        else if (!strcmp(key, "outdoor_euler_angle_max")) sscanf(val, "%f", &(config->control.outdoor_euler_angle_max));
-        else if (!strcmp(key, "outdoor_control_vz_max"))  sscanf(val, "%f", &(config->control.outdoor_control_vz_max));
-        else if (!strcmp(key, "outdoor_control_yaw"))     sscanf(val, "%f", &(config->control.outdoor_control_yaw));
-        else if (!strcmp(key, "flying_mode"))             sscanf(val, "%d", &(config->control.flying_mode));
-        else if (!strcmp(key, "hovering_range"))          sscanf(val, "%d", &(config->control.hovering_range));
-        else if (!strcmp(key, "flying_camera_mode"))      sscanf(val, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d", &(config->control.flying_camera_mode[0]), &(config->control.flying_camera_mode[1]), &(config->control.flying_camera_mode[2]), &(config->control.flying_camera_mode[3]), &(config->control.flying_camera_mode[4]), &(config->control.flying_camera_mode[5]), &(config->control.flying_camera_mode[6]), &(config->control.flying_camera_mode[7]), &(config->control.flying_camera_mode[8]), &(config->control.flying_camera_mode[9]));
-        else if (!strcmp(key, "flying_camera_enable"))    config->control.flying_camera_enable = (!strcmp(val, "TRUE")) ? true : false;
-    }
-    else if (!(strcmp(category, "network"))) {
-        if      (!strcmp(key, "ssid_single_player")) strncpy(config->network.ssid_single_player, val, 32);
-        else if (!strcmp(key, "ssid_multi_player"))  strncpy(config->network.ssid_multi_player, val, 32);
-        else if (!strcmp(key, "wifi_mode"))          sscanf(val, "%d", &(config->network.wifi_mode));
-        else if (!strcmp(key, "wifi_rate"))          sscanf(val, "%d", &(config->network.wifi_rate));
-        else if (!strcmp(key, "owner_mac"))          strncpy(config->network.owner_mac, val, 18);
+    unsigned int hash = 2166136261U;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619U;
     }
-    else if (!(strcmp(category, "pic"))) {
-        if      (!strcmp(key, "ultrasound_freq"))     sscanf(val, "%d", &(config->pic.ultrasound_freq));
-        else if (!strcmp(key, "ultrasound_watchdog")) sscanf(val, "%d", &(config->pic.ultrasound_watchdog));
-        else if (!strcmp(key, "pic_version"))         sscanf(val, "%d", &(config->pic.pic_version));
-    }
-    else if (!(strcmp(category, "video"))) {
-        if      (!strcmp(key, "camif_fps"))           sscanf(val, "%d", &(config->video.camif_fps));
-        else if (!strcmp(key, "camif_buffers"))       sscanf(val, "%d", &(config->video.camif_buffers));
-        else if (!strcmp(key, "num_trackers"))        sscanf(val, "%d", &(config->video.num_trackers));
-        else if (!strcmp(key, "video_storage_space")) sscanf(val, "%d", &(config->video.video_storage_space));
-        else if (!strcmp(key, "video_on_usb"))        config->video.video_on_usb = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "video_file_index"))    sscanf(val, "%d", &(config->video.video_file_index));
-        else if (!strcmp(key, "bitrate"))             sscanf(val, "%d", &(config->video.bitrate));
-        else if (!strcmp(key, "bitrate_ctrl_mode"))   sscanf(val, "%d", &(config->video.bitrate_ctrl_mode));
-        else if (!strcmp(key, "bitrate_storage"))     sscanf(val, "%d", &(config->video.bitrate_storage));
-        else if (!strcmp(key, "codec_fps"))           sscanf(val, "%d", &(config->video.codec_fps));
-        else if (!strcmp(key, "video_codec"))         sscanf(val, "%d", &(config->video.video_codec));
-        else if (!strcmp(key, "video_slices"))        sscanf(val, "%d", &(config->video.video_slices));
-        else if (!strcmp(key, "video_live_socket"))   sscanf(val, "%d", &(config->video.video_live_socket));
-        else if (!strcmp(key, "max_bitrate"))         sscanf(val, "%d", &(config->video.max_bitrate));
-        else if (!strcmp(key, "video_channel"))       sscanf(val, "%d", &(config->video.video_channel));
-        else if (!strcmp(key, "exposure_mode"))       sscanf(val, "%d,%d,%d,%d", &(config->video.exposure_mode[0]), &(config->video.exposure_mode[1]), &(config->video.exposure_mode[2]), &(config->video.exposure_mode[3]));
-        else if (!strcmp(key, "saturation_mode"))     sscanf(val, "%d", &(config->video.saturation_mode));
-        else if (!strcmp(key, "whitebalance_mode"))   sscanf(val, "%d,%d", &(config->video.whitebalance_mode[0]), &(config->video.whitebalance_mode[1]));
-    }
-    else if (!(strcmp(category, "leds"))) {
-        if (!strcmp(key, "leds_anim")) sscanf(val, "%d,%d,%d", &(config->leds.leds_anim[0]), &(config->leds.leds_anim[1]), &(config->leds.leds_anim[2]));
-    }
-    else if (!(strcmp(category, "detect"))) {
-        if      (!strcmp(key, "enemy_colors"))              sscanf(val, "%d", &(config->detect.enemy_colors));
-        else if (!strcmp(key, "enemy_without_shell"))       sscanf(val, "%d", &(config->detect.enemy_without_shell));
-        else if (!strcmp(key, "groundstripe_colors"))       sscanf(val, "%d", &(config->detect.groundstripe_colors));
-        else if (!strcmp(key, "detect_type"))               sscanf(val, "%d", &(config->detect.detect_type));
-        else if (!strcmp(key, "detections_select_h"))       sscanf(val, "%d", &(config->detect.detections_select_h));
-        else if (!strcmp(key, "detections_select_v_hsync")) sscanf(val, "%d", &(config->detect.detections_select_v_hsync));
-        else if (!strcmp(key, "detections_select_v"))       sscanf(val, "%d", &(config->detect.detections_select_v));
-    }
-    else if (!(strcmp(category, "syslog"))) {
-        if      (!strcmp(key, "output"))   sscanf(val, "%d", &(config->syslog.output));
-        else if (!strcmp(key, "max_size")) sscanf(val, "%d", &(config->syslog.max_size));
-        else if (!strcmp(key, "nb_files")) sscanf(val, "%d", &(config->syslog.nb_files));
-    }
-    else if (!(strcmp(category, "custom"))) {
-        if      (!strcmp(key, "application_desc")) strncpy(config->custom.application_desc, val, 64);
-        else if (!strcmp(key, "profile_desc"))     strncpy(config->custom.profile_desc, val, 64);
-        else if (!strcmp(key, "session_desc"))     strncpy(config->custom.session_desc, val, 64);
-        else if (!strcmp(key, "application_id"))   strncpy(config->custom.application_id, val, 8);
-        else if (!strcmp(key, "profile_id"))       strncpy(config->custom.profile_id, val, 8);
-        else if (!strcmp(key, "session_id"))       strncpy(config->custom.session_id, val, 8);
-    }
-    else if (!(strcmp(category, "userbox"))) {
-        if (!strcmp(key, "userbox_cmd")) sscanf(val, "%d", &(config->userbox.userbox_cmd));
-    }
-    else if (!(strcmp(category, "gps"))) {
-        if      (!strcmp(key, "latitude"))  sscanf(val, "%f", &(config->gps.latitude));
-        else if (!strcmp(key, "longitude")) sscanf(val, "%f", &(config->gps.longitude));
-        else if (!strcmp(key, "altitude"))  sscanf(val, "%f", &(config->gps.altitude));
-        else if (!strcmp(key, "accuracy"))  sscanf(val, "%f", &(config->gps.accuracy));
+    return hash;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Build the hash table of the configuration keys.
+//! @return  None
+// --------------------------------------------------------------------------
+static void buildConfigHash(void)
+{
+    for (int i = 0; i < CONFIG_HASH_SIZE; i++) configHash[i] = -1;
+
+    for (int i = 0; i < CONFIG_NUM_FIELDS; i++) {
+        unsigned int slot = hashConfigKey(configFields[i].name, strlen(configFields[i].name)) & (CONFIG_HASH_SIZE - 1);
+        while (configHash[slot] >= 0) slot = (slot + 1) & (CONFIG_HASH_SIZE - 1);
+        configHash[slot] = (short)i;
     }
-    else if (!(strcmp(category, "flightplan"))) {
-        if      (!strcmp(key, "default_validation_radius")) sscanf(val, "%f", &(config->flightplan.default_validation_radius));
-        else if (!strcmp(key, "default_validation_time"))   sscanf(val, "%f", &(config->flightplan.default_validation_time));
-        else if (!strcmp(key, "max_distance_from_takeoff")) sscanf(val, "%d", &(config->flightplan.max_distance_from_takeoff));
-        else if (!strcmp(key, "gcs_ip"))                    sscanf(val, "%d", &(config->flightplan.gcs_ip));
-        else if (!strcmp(key, "video_stop_delay"))          sscanf(val, "%d", &(config->flightplan.video_stop_delay));
-        else if (!strcmp(key, "low_battery_go_home"))       config->flightplan.low_battery_go_home = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "automatic_heading"))         config->flightplan.automatic_heading = (!strcmp(val, "TRUE")) ? true : false;
-        else if (!strcmp(key, "com_lost_action_delay"))     sscanf(val, "%d", &(config->flightplan.com_lost_action_delay));
-        else if (!strcmp(key, "altitude_go_home"))          sscanf(val, "%d", &(config->flightplan.altitude_go_home));
-        else if (!strcmp(key, "mavlink_js_roll_left"))      strncpy(config->flightplan.mavlink_js_roll_left, val, 3);
-        else if (!strcmp(key, "mavlink_js_roll_right"))     strncpy(config->flightplan.mavlink_js_roll_right, val, 3);
-        else if (!strcmp(key, "mavlink_js_pitch_front"))    strncpy(config->flightplan.mavlink_js_pitch_front, val, 3);
-        else if (!strcmp(key, "mavlink_js_pitch_back"))     strncpy(config->flightplan.mavlink_js_pitch_back, val, 3);
-        else if (!strcmp(key, "mavlink_js_yaw_left"))       strncpy(config->flightplan.mavlink_js_yaw_left, val, 3);
-        else if (!strcmp(key, "mavlink_js_yaw_right"))      strncpy(config->flightplan.mavlink_js_yaw_right, val, 3);
-        else if (!strcmp(key, "mavlink_js_go_up"))          strncpy(config->flightplan.mavlink_js_go_up, val, 3);
-        else if (!strcmp(key, "mavlink_js_go_down"))        strncpy(config->flightplan.mavlink_js_go_down, val, 3);
-        else if (!strcmp(key, "mavlink_js_inc_gains"))      strncpy(config->flightplan.mavlink_js_inc_gains, val, 3);
-        else if (!strcmp(key, "mavlink_js_dec_gains"))      strncpy(config->flightplan.mavlink_js_dec_gains, val, 3);
-        else if (!strcmp(key, "mavlink_js_select"))         strncpy(config->flightplan.mavlink_js_select, val, 3);
-        else if (!strcmp(key, "mavlink_js_start"))          strncpy(config->flightplan.mavlink_js_start, val, 3);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Find a field of ARDRONE_CONFIG by its key name.
+//! @param   name Key name ("category:key")
+//! @param   len Length of the key name
+//! @return  Field information (NULL if unknown)
+// --------------------------------------------------------------------------
+static const CONFIG_FIELD_INFO *findConfigField(const char *name, size_t len)
+{
+    pthread_once(&configHashOnce, buildConfigHash);
+
+    unsigned int slot = hashConfigKey(name, len) & (CONFIG_HASH_SIZE - 1);
+    while (configHash[slot] >= 0) {
+        const CONFIG_FIELD_INFO *field = &configFields[configHash[slot]];
+        if (!strncmp(field->name, name, len) && field->name[len] == '\0') return field;
+        slot = (slot + 1) & (CONFIG_HASH_SIZE - 1);
     }
-    else if (!(strcmp(category, "rescue"))) {
-        if (!strcmp(key, "rescue")) sscanf(val, "%d", &(config->rescue.rescue));
+
+    return NULL;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Store a value string into a field of ARDRONE_CONFIG.
+//! @param   field Field information
+//! @param   val Value string
+//! @param   config Configuration struct
+//! @return  None
+// --------------------------------------------------------------------------
+static void storeConfigValue(const CONFIG_FIELD_INFO *field, const char *val, ARDRONE_CONFIG *config)
+{
+    char *dst = (char*)config + field->offset;
+
+    switch (field->type) {
+        case CONFIG_INT:
+        case CONFIG_FLOAT: {
+            // Scalars and arrays ("1,2", "{ 1 2 3 }") share the same loop
+            size_t count = field->size / 4;
+            const char *p = val;
+            for (size_t i = 0; i < count; i++) {
+                while (*p && !strchr("+-.0123456789", *p)) p++;
+                if (!*p) break;
+                char *end;
+                if (field->type == CONFIG_INT) ((int*)dst)[i] = (int)strtol(p, &end, 10);
+                else                           ((float*)dst)[i] = (float)strtod(p, &end);
+                if (end == p) break;
+                p = end;
+            }
+            break;
+        }
+        case CONFIG_BOOL:
+            *(bool*)dst = (!strcmp(val, "TRUE")) ? true : false;
+            break;
+        case CONFIG_STRING:
+            strncpy(dst, val, field->size - 1);
+            dst[field->size - 1] = '\0';
+            break;
+        default:
+            break;
     }
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Parse a line of the configuration dump.
+//! @param   str Configuration string ("category:key = value")
+//! @param   config Configuration struct
+//! @return  Field information of the stored value (NULL if none)
+// --------------------------------------------------------------------------
+static const CONFIG_FIELD_INFO *parse(const char *str, ARDRONE_CONFIG *config)
+{
+    // Split key and value
+    const char *eq = strstr(str, " = ");
+    if (!eq) return NULL;
+
+    // Find the field
+    const CONFIG_FIELD_INFO *field = findConfigField(str, eq - str);
+    if (!field) return NULL;
+
+    // Store the value
+    storeConfigValue(field, eq + 3, config);
+
+    return field;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Get current configurations of AR.Drone.
+//! @note    Only the received keys are updated, a dump cut short keeps the others.
+//!          The dump ends at its terminating null byte, at its last key or
+//!          when AR.Drone closes the stream, the idle timeout is a fallback.
 //! @return  Result of this function
 //! @retval  1 Success
-//! @retval  0 Failure
+//! @retval  0 Failure (nothing was received)
 // --------------------------------------------------------------------------
 int ARDrone::getConfig(void)
 {
@@ -221,183 +344,399 @@ int ARDrone::getConfig(void)
         return 0;
     }
 
+    // No AT*CONFIG may be sent meanwhile
+    if (mutexConfig) pthread_mutex_lock(mutexConfig);
+
     // Send requests
     UDPSocket tmpCommand;
     tmpCommand.open(ip, ARDRONE_AT_PORT);
+    if (mutexCommand) pthread_mutex_lock(mutexCommand);
     tmpCommand.sendf("AT*CTRL=%d,5,0\r", ++seq);
     tmpCommand.sendf("AT*CTRL=%d,4,0\r", ++seq);
-    msleep(500);
+    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
     tmpCommand.close();
 
-    // Receive data
-    char buf[10000] = {'\0'};
-    int size = sockConfig.receive((void*)&buf, sizeof(buf));
-
-    // Received something
-    if (size > 0) {
-        #if 0
-        // Saving config.ini
-        FILE *file = fopen("config.ini", "w");
-        if (file) {
-            fprintf(file, buf);
-            fclose(file);
-        }
-        #endif
+    // Parse into a local struct, other threads may be reading the current one
+    ARDRONE_CONFIG received;
+    memset(&received, 0, sizeof(received));
+    bool parsed[CONFIG_NUM_FIELDS] = {false};
+    int numParsed = 0;
+
+    // Parse the dump line by line while it arrives
+    char buf[1024], line[512];
+    int length = 0, total = 0;
+    bool overflow = false;
+    bool end = false;
+    while (!end) {
+        // Wait long for the first byte, then until the end of the dump (0 if closed)
+        int size = sockConfig.receiveSome((void*)buf, sizeof(buf), (total > 0) ? CONFIG_IDLE_TIMEOUT : CONFIG_FIRST_TIMEOUT);
+        if (size < 1) break;
+        total += size;
 
-        // Clear config struct
-        memset(&config, 0, sizeof(config));
+        for (int i = 0; i < size && !end; i++) {
+            char c = buf[i];
+            if (c == '\n' || c == '\0') {
+                if (length > 0 && line[length - 1] == '\r') length--;
+                line[length] = '\0';
+                if (!overflow && length > 0) {
+                    const CONFIG_FIELD_INFO *field = parse(line, &received);
+                    if (field && !parsed[field - configFields]) {
+                        parsed[field - configFields] = true;
+                        numParsed++;
+                    }
 
-        // Parsing configurations
-        char *token = strtok(buf, "\n");
-        if (token != NULL) parse(token, &config);
-        while (token != NULL) {
-            token = strtok(NULL, "\n");
-            if (token != NULL) parse(token, &config);
+                    // The last key of the table is the last one of the dump
+                    if (field == &configFields[CONFIG_NUM_FIELDS - 1]) end = true;
+                }
+                length = 0;
+                overflow = false;
+
+                // The dump is terminated by a null byte
+                if (c == '\0' && numParsed > 0) end = true;
+            }
+            else if (length < (int)sizeof(line) - 1) line[length++] = c;
+            else overflow = true;
         }
     }
 
-    #if 0
-    // For debug
-    printf("general.num_version_config = %d\n", config.general.num_version_config);
-    printf("general.num_version_mb = %d\n", config.general.num_version_mb);
-    printf("general.num_version_soft = %s\n", config.general.num_version_soft);
-    printf("general.drone_serial = %s\n", config.general.drone_serial);
-    printf("general.soft_build_date = %s\n", config.general.soft_build_date);
-    printf("general.motor1_soft = %f\n", config.general.motor1_soft);
-    printf("general.motor1_hard = %f\n", config.general.motor1_hard);
-    printf("general.motor1_supplier = %f\n", config.general.motor1_supplier);
-    printf("general.motor2_soft = %f\n", config.general.motor2_soft);
-    printf("general.motor2_hard = %f\n", config.general.motor2_hard);
-    printf("general.motor2_supplier = %f\n", config.general.motor2_supplier);
-    printf("general.motor3_soft = %f\n", config.general.motor3_soft);
-    printf("general.motor3_hard = %f\n", config.general.motor3_hard);
-    printf("general.motor3_supplier = %f\n", config.general.motor3_supplier);
-    printf("general.motor4_soft = %f\n", config.general.motor4_soft);
-    printf("general.motor4_hard = %f\n", config.general.motor4_hard);
-    printf("general.motor4_supplier = %f\n", config.general.motor4_supplier);
-    printf("general.ardrone_name = %s\n", config.general.ardrone_name);
-    printf("general.flying_time = %d\n", config.general.flying_time);
-    printf("general.navdata_demo = %s\n", config.general.navdata_demo ? "true" : "false");
-    printf("general.com_watchdog = %d\n", config.general.com_watchdog);
-    printf("general.video_enable = %s\n", config.general.video_enable ? "true" : "false");
-    printf("general.vision_enable = %s\n", config.general.vision_enable ? "true" : "false");
-    printf("general.vbat_min = %d\n", config.general.vbat_min);
-    printf("general.localtime = %d\n", config.general.localtime);
-    printf("general.navdata_options = %d\n", config.general.navdata_options);
-    printf("general.gps_soft = %f\n", config.general.gps_soft);
-    printf("general.gps_hard = %f\n", config.general.gps_hard);
-    printf("general.localtime_zone = %s\n", config.general.localtime_zone);
-    printf("general.battery_type = %d\n", config.general.battery_type);
-    printf("control.accs_offset = {%f, %f, %f}\n", config.control.accs_offset[0], config.control.accs_offset[1], config.control.accs_offset[2]);
-    printf("control.accs_gains = { %f %f %f %f %f %f %f %f %f }\n", config.control.accs_gains[0], config.control.accs_gains[1], config.control.accs_gains[2], config.control.accs_gains[3], config.control.accs_gains[4], config.control.accs_gains[5], config.control.accs_gains[6], config.control.accs_gains[7], config.control.accs_gains[8]);
-    printf("control.gyros_offset = { %f %f %f }\n", config.control.gyros_offset[0], config.control.gyros_offset[1], config.control.gyros_offset[2]);
-    printf("control.gyros_gains = { %f %f %f }\n", config.control.gyros_gains[0], config.control.gyros_gains[1], config.control.gyros_gains[2]);
-    printf("control.gyros110_offset = { %f %f }\n", config.control.gyros110_offset[0], config.control.gyros110_offset[1]);
-    printf("control.gyros110_gains = { %f %f }\n", config.control.gyros110_gains[0], config.control.gyros110_gains[1]);
-    printf("control.magneto_offset = { %f %f %f }\n", config.control.magneto_offset[0], config.control.magneto_offset[1], config.control.magneto_offset[2]);
-    printf("control.magneto_radius = %f\n", config.control.magneto_radius);
-    printf("control.gyro_offset_thr_x = %f\n", config.control.gyro_offset_thr_x);
-    printf("control.gyro_offset_thr_y = %f\n", config.control.gyro_offset_thr_y);
-    printf("control.gyro_offset_thr_z = %f\n", config.control.gyro_offset_thr_z);
-    printf("control.pwm_ref_gyros = %d\n", config.control.pwm_ref_gyros);
-    printf("control.osctun_value = %d\n", config.control.osctun_value);
-    printf("control.osctun_test = %s\n", config.control.osctun_test ? "true" : "false");
-    printf("control.altitude_max = %d\n", config.control.altitude_max);
-    printf("control.altitude_min = %d\n", config.control.altitude_min);
-    printf("control.outdoor = %s\n", config.control.outdoor ? "true" : "false");
-    printf("control.flight_without_shell = %s\n", config.control.flight_without_shell ? "true" : "false");
-    printf("control.autonomous_flight = %s\n", config.control.autonomous_flight ? "true" : "false");
-    printf("control.flight_anim = %d,%d\n", config.control.flight_anim[0], config.control.flight_anim[1]);
-    printf("control.control_level = %d\n", config.control.control_level);
-    printf("control.euler_angle_max = %f\n", config.control.euler_angle_max);
-    printf("control.control_iphone_tilt = %f\n", config.control.control_iphone_tilt);
-    printf("control.control_vz_max = %f\n", config.control.control_vz_max);
-    printf("control.control_yaw = %f\n", config.control.control_yaw);
-    printf("control.manual_trim = %s\n", config.control.manual_trim ? "true" : "false");
-    printf("control.indoor_euler_angle_max = %f\n", config.control.indoor_euler_angle_max);
-    printf("control.indoor_control_vz_max = %f\n", config.control.indoor_control_vz_max);
-    printf("control.indoor_control_yaw = %f\n", config.control.indoor_control_yaw);
-    printf("control.outdoor_euler_angle_max = %f\n", config.control.outdoor_euler_angle_max);
-    printf("control.outdoor_control_vz_max = %f\n", config.control.outdoor_control_vz_max);
-    printf("control.outdoor_control_yaw = %f\n", config.control.outdoor_control_yaw);
-    printf("control.flying_mode = %d\n", config.control.flying_mode);
-    printf("control.hovering_range = %d\n", config.control.hovering_range);
-    printf("control.flying_camera_mode = %d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", config.control.flying_camera_mode[0], config.control.flying_camera_mode[1], config.control.flying_camera_mode[2], config.control.flying_camera_mode[3], config.control.flying_camera_mode[4], config.control.flying_camera_mode[5], config.control.flying_camera_mode[6], config.control.flying_camera_mode[7], config.control.flying_camera_mode[8], config.control.flying_camera_mode[9]);
-    printf("control.flying_camera_enable = %s\n", config.control.flying_camera_enable ? "true" : "false");
-    printf("network.ssid_single_player = %s\n", config.network.ssid_single_player);
-    printf("network.ssid_multi_player = %s\n", config.network.ssid_multi_player);
-    printf("network.wifi_mode = %d\n", config.network.wifi_mode);
-    printf("network.wifi_rate = %d\n", config.network.wifi_rate);
-    printf("network.owner_mac = %s\n", config.network.owner_mac);
-    printf("pic.ultrasound_freq = %d\n", config.pic.ultrasound_freq);
-    printf("pic.ultrasound_watchdog = %d\n", config.pic.ultrasound_watchdog);
-    printf("pic.pic_version = %d\n", config.pic.pic_version);
-    printf("video.camif_fps = %d\n", config.video.camif_fps);
-    printf("video.camif_buffers = %d\n", config.video.camif_buffers);
-    printf("video.num_trackers = %d\n", config.video.num_trackers);
-    printf("video.video_storage_space = %d\n", config.video.video_storage_space);
-    printf("video.video_on_usb = %s\n", config.video.video_on_usb ? "true" : "false");
-    printf("video.video_file_index = %d\n", config.video.video_file_index);
-    printf("video.bitrate = %d\n", config.video.bitrate);
-    printf("video.bitrate_ctrl_mode = %d\n", config.video.bitrate_ctrl_mode);
-    printf("video.bitrate_storage = %d\n", config.video.bitrate_storage);
-    printf("video.codec_fps = %d\n", config.video.codec_fps);
-    printf("video.video_codec = %d\n", config.video.video_codec);
-    printf("video.video_slices = %d\n", config.video.video_slices);
-    printf("video.video_live_socket = %d\n", config.video.video_live_socket);
-    printf("video.max_bitrate = %d\n", config.video.max_bitrate);
-    printf("video.video_channel = %d\n", config.video.video_channel);
-    printf("video.exposure_mode = %d,%d,%d,%d\n", config.video.exposure_mode[0], config.video.exposure_mode[1], config.video.exposure_mode[2], config.video.exposure_mode[3]);
-    printf("video.saturation_mode = %d\n", config.video.saturation_mode);
-    printf("video.whitebalance_mode = %d,%d\n", config.video.whitebalance_mode[0], config.video.whitebalance_mode[1]);
-    printf("leds.leds_anim = %d,%d,%d\n", config.leds.leds_anim[0], config.leds.leds_anim[1], config.leds.leds_anim[2]);
-    printf("detect.enemy_colors = %d\n", config.detect.enemy_colors);
-    printf("detect.enemy_without_shell = %d\n", config.detect.enemy_without_shell);
-    printf("detect.groundstripe_colors = %d\n", config.detect.groundstripe_colors);
-    printf("detect.detect_type = %d\n", config.detect.detect_type);
-    printf("detect.detections_select_h = %d\n", config.detect.detections_select_h);
-    printf("detect.detections_select_v_hsync = %d\n", config.detect.detections_select_v_hsync);
-    printf("detect.detections_select_v = %d\n", config.detect.detections_select_v);
-    printf("syslog.output = %d\n", config.syslog.output);
-    printf("syslog.max_size = %d\n", config.syslog.max_size);
-    printf("syslog.nb_files = %d\n", config.syslog.nb_files);
-    printf("custom.application_desc = %s\n", config.custom.application_desc);
-    printf("custom.profile_desc = %s\n", config.custom.profile_desc);
-    printf("custom.session_desc = %s\n", config.custom.session_desc);
-    printf("custom.application_id = %s\n", config.custom.application_id);
-    printf("custom.profile_id = %s\n", config.custom.profile_id);
-    printf("custom.session_id = %s\n", config.custom.session_id);
-    printf("userbox.userbox_cmd = %d\n", config.userbox.userbox_cmd);
-    printf("gps.latitude = %f\n", config.gps.latitude);
-    printf("gps.longitude = %f\n", config.gps.longitude);
-    printf("gps.altitude = %f\n", config.gps.altitude);
-    printf("gps.accuracy = %f\n", config.gps.accuracy);
-    printf("flightplan.default_validation_radius = %f\n", config.flightplan.default_validation_radius);
-    printf("flightplan.default_validation_time = %f\n", config.flightplan.default_validation_time);
-    printf("flightplan.max_distance_from_takeoff = %d\n", config.flightplan.max_distance_from_takeoff);
-    printf("flightplan.gcs_ip = %d\n", config.flightplan.gcs_ip);
-    printf("flightplan.video_stop_delay = %d\n", config.flightplan.video_stop_delay);
-    printf("flightplan.low_battery_go_home = %s\n", config.flightplan.low_battery_go_home ? "true" : "false");
-    printf("flightplan.automatic_heading = %s\n", config.flightplan.automatic_heading ? "true" : "false");
-    printf("flightplan.com_lost_action_delay = %d\n", config.flightplan.com_lost_action_delay);
-    printf("flightplan.altitude_go_home = %d\n", config.flightplan.altitude_go_home);
-    printf("flightplan.mavlink_js_roll_left = %s\n", config.flightplan.mavlink_js_roll_left);
-    printf("flightplan.mavlink_js_roll_right = %s\n", config.flightplan.mavlink_js_roll_right);
-    printf("flightplan.mavlink_js_pitch_front = %s\n", config.flightplan.mavlink_js_pitch_front);
-    printf("flightplan.mavlink_js_pitch_back = %s\n", config.flightplan.mavlink_js_pitch_back);
-    printf("flightplan.mavlink_js_yaw_left = %s\n", config.flightplan.mavlink_js_yaw_left);
-    printf("flightplan.mavlink_js_yaw_right = %s\n", config.flightplan.mavlink_js_yaw_right);
-    printf("flightplan.mavlink_js_go_up = %s\n", config.flightplan.mavlink_js_go_up);
-    printf("flightplan.mavlink_js_go_down = %s\n", config.flightplan.mavlink_js_go_down);
-    printf("flightplan.mavlink_js_inc_gains = %s\n", config.flightplan.mavlink_js_inc_gains);
-    printf("flightplan.mavlink_js_dec_gains = %s\n", config.flightplan.mavlink_js_dec_gains);
-    printf("flightplan.mavlink_js_select = %s\n", config.flightplan.mavlink_js_select);
-    printf("flightplan.mavlink_js_start = %s\n", config.flightplan.mavlink_js_start);
-    printf("rescue.rescue = %d\n", config.rescue.rescue);
-    #endif
+    // The last line may not be terminated
+    if (length > 0 && !overflow) {
+        line[length] = '\0';
+        const CONFIG_FIELD_INFO *field = parse(line, &received);
+        if (field && !parsed[field - configFields]) {
+            parsed[field - configFields] = true;
+            numParsed++;
+        }
+    }
 
     // Finalize
     sockConfig.close();
+    if (mutexConfig) pthread_mutex_unlock(mutexConfig);
+
+    // Nothing received, keep the current values
+    if (numParsed == 0) {
+        CVDRONE_ERROR("No configuration was received (%d bytes). (%s, %d)\n", total, __FILE__, __LINE__);
+        return 0;
+    }
+
+    // Update the received keys only
+    if (mutexCommand) pthread_mutex_lock(mutexCommand);
+    for (int i = 0; i < CONFIG_NUM_FIELDS; i++) {
+        if (parsed[i]) memcpy((char*)&config + configFields[i].offset, (const char*)&received + configFields[i].offset, configFields[i].size);
+    }
+    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
 
     return 1;
-}
\ No newline at end of file
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Compare a field of two configuration structs.
+//! @param   field Field information
+//! @param   a Configuration struct
+//! @param   b Configuration struct
+//! @return  Result of comparison
+//! @retval  1 Same value
+//! @retval  0 Different value
+// --------------------------------------------------------------------------
+static int equalConfigValue(const CONFIG_FIELD_INFO *field, const ARDRONE_CONFIG *a, const ARDRONE_CONFIG *b)
+{
+    const char *pa = (const char*)a + field->offset;
+    const char *pb = (const char*)b + field->offset;
+
+    switch (field->type) {
+        case CONFIG_FLOAT:
+            // The drone prints floats with its own precision
+            for (size_t i = 0; i < field->size / 4; i++) {
+                float fa = ((const float*)pa)[i], fb = ((const float*)pb)[i];
+                if (fabs(fa - fb) > 1e-5 * MAX(1.0, fabs(fa))) return 0;
+            }
+            return 1;
+        case CONFIG_STRING:
+            return !strncmp(pa, pb, field->size);
+        default:
+            return !memcmp(pa, pb, field->size);
+    }
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Store a desired configuration without sending it.
+//! @param   key Key name ("category:key")
+//! @param   value Value string
+//! @param   overwrite Replace the value if the key is already desired
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::storeConfig(const char *key, const char *value, bool overwrite)
+{
+    // Enable mutex lock
+    if (mutexCommand) pthread_mutex_lock(mutexCommand);
+
+    // Already desired
+    int i;
+    for (i = 0; i < numConfigDesired; i++) {
+        if (!strcmp(configDesired[i].key, key)) break;
+    }
+
+    // New key
+    if (i == numConfigDesired) {
+        if (numConfigDesired < ARDRONE_MAX_CONFIG_ENTRIES) {
+            strncpy(configDesired[i].key, key, sizeof(configDesired[i].key) - 1);
+            strncpy(configDesired[i].value, value, sizeof(configDesired[i].value) - 1);
+            numConfigDesired++;
+        }
+        else CVDRONE_ERROR("Too many configurations (%s). (%s, %d)\n", key, __FILE__, __LINE__);
+    }
+    else if (overwrite) {
+        strncpy(configDesired[i].value, value, sizeof(configDesired[i].value) - 1);
+    }
+
+    // Disable mutex lock
+    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Set a desired configuration.
+//! @param   key Key name ("category:key")
+//! @param   value Value string
+//! @note    The value is sent only if it differs from the one of AR.Drone.
+//!          When not connected, it is sent on open().
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::setConfig(const char *key, const char *value)
+{
+    // Keep it
+    storeConfig(key, value);
+
+    // Send it if connected
+    if (mutexCommand) applyConfig();
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Wait for the acknowledge flag of AT*CONFIG.
+//! @param   set Flag state to wait for
+//! @param   timeout Timeout [ms]
+//! @return  Result of this function
+//! @retval  1 The flag has the state
+//! @retval  0 Timeout
+// --------------------------------------------------------------------------
+int ARDrone::waitConfigAck(bool set, int timeout)
+{
+    // No navdata yet, assume it was received
+    if (!mutexNavdata) {
+        if (set) msleep(100);
+        return 1;
+    }
+
+    for (int t = 0; t < timeout; t += 5) {
+        pthread_mutex_lock(mutexNavdata);
+        int state = navdata.ardrone_state;
+        pthread_mutex_unlock(mutexNavdata);
+        if (((state & ARDRONE_COMMAND_MASK) != 0) == set) return 1;
+        msleep(5);
+    }
+
+    return 0;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Send configurations and wait for a single acknowledgement.
+//! @param   entries Configurations
+//! @param   num Number of configurations
+//! @note    The caller holds mutexConfig.
+//! @return  Result of this function
+//! @retval  1 Acknowledged
+//! @retval  0 Timeout
+// --------------------------------------------------------------------------
+int ARDrone::sendConfigEntries(const ARDRONE_CONFIG_ENTRY *entries, int num)
+{
+    // Clear the acknowledge flag
+    pthread_mutex_lock(mutexCommand);
+    sockCommand.sendf("AT*CTRL=%d,5,0\r", ++seq);
+    pthread_mutex_unlock(mutexCommand);
+    waitConfigAck(false, 100);
+
+    // Send them back to back
+    pthread_mutex_lock(mutexCommand);
+    for (int i = 0; i < num; i++) {
+        if (version.major == ARDRONE_VERSION_2) sockCommand.sendf("AT*CONFIG_IDS=%d,\"%s\",\"%s\",\"%s\"\r", ++seq, ARDRONE_SESSION_ID, ARDRONE_PROFILE_ID, ARDRONE_APPLOCATION_ID);
+        sockCommand.sendf("AT*CONFIG=%d,\"%s\",\"%s\"\r", ++seq, entries[i].key, entries[i].value);
+    }
+    pthread_mutex_unlock(mutexCommand);
+
+    // Wait for the acknowledgement
+    return waitConfigAck(true, 1000);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Send the desired configurations that differ from AR.Drone's.
+//! @note    They are sent in one batch with a single acknowledgement. If the
+//!          batch is not acknowledged, they are sent again one at a time and
+//!          only the acknowledged ones are kept as AR.Drone's values.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::applyConfig(void)
+{
+    // Not connected
+    if (!mutexCommand) return 0;
+
+    // The acknowledge flag is shared, one exchange at a time
+    if (mutexConfig) pthread_mutex_lock(mutexConfig);
+
+    // Find the differences
+    ARDRONE_CONFIG_ENTRY changed[ARDRONE_MAX_CONFIG_ENTRIES];
+    int numChanged = 0;
+    pthread_mutex_lock(mutexCommand);
+    ARDRONE_CONFIG desired = config;
+    for (int i = 0; i < numConfigDesired; i++) {
+        const CONFIG_FIELD_INFO *field = findConfigField(configDesired[i].key, strlen(configDesired[i].key));
+        if (field) {
+            storeConfigValue(field, configDesired[i].value, &desired);
+            if (equalConfigValue(field, &desired, &config)) continue;
+        }
+        changed[numChanged++] = configDesired[i];
+    }
+    pthread_mutex_unlock(mutexCommand);
+
+    // Nothing to do
+    if (numChanged == 0) {
+        if (mutexConfig) pthread_mutex_unlock(mutexConfig);
+        return 1;
+    }
+
+    // All of them at once, or one by one if the batch is not acknowledged
+    int numApplied = 0;
+    bool batch = (sendConfigEntries(changed, numChanged) != 0);
+    if (!batch) CVDRONE_ERROR("AT*CONFIG (%d keys) was not acknowledged, sending them one by one. (%s, %d)\n", numChanged, __FILE__, __LINE__);
+    for (int i = 0; i < numChanged; i++) {
+        ARDRONE_CONFIG_ENTRY *entry = &changed[i];
+
+        // Wait for the acknowledgement of each one
+        if (!batch && !sendConfigEntries(entry, 1)) {
+            CVDRONE_ERROR("AT*CONFIG (%s) was not acknowledged. (%s, %d)\n", entry->key, __FILE__, __LINE__);
+            break;
+        }
+
+        // AR.Drone has this value now
+        const CONFIG_FIELD_INFO *field = findConfigField(entry->key, strlen(entry->key));
+        if (field) {
+            pthread_mutex_lock(mutexCommand);
+            storeConfigValue(field, entry->value, &config);
+            pthread_mutex_unlock(mutexCommand);
+        }
+        numApplied++;
+    }
+
+    // Clear the acknowledge flag
+    pthread_mutex_lock(mutexCommand);
+    sockCommand.sendf("AT*CTRL=%d,5,0\r", ++seq);
+    char serial[sizeof(config.general.drone_serial)];
+    strcpy(serial, config.general.drone_serial);
+    pthread_mutex_unlock(mutexCommand);
+    if (mutexConfig) pthread_mutex_unlock(mutexConfig);
+
+    // Keep the acknowledged ones for the next connection
+    if (numApplied > 0 && configCacheDir[0] != '\0' && serial[0] != '\0') {
+        char filename[512];
+        snprintf(filename, sizeof(filename), "%s/drone_%s.ini", configCacheDir, serial);
+        saveConfig(filename);
+    }
+
+    return (numApplied == numChanged) ? 1 : 0;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Set the directory of the configuration cache.
+//! @param   dir Directory (The cache is disabled if NULL or empty)
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::setConfigCache(const char *dir)
+{
+    if (dir) {
+        strncpy(configCacheDir, dir, sizeof(configCacheDir) - 1);
+        configCacheDir[sizeof(configCacheDir) - 1] = '\0';
+    }
+    else configCacheDir[0] = '\0';
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Save current configurations in the format of the dump.
+//! @param   filename File name
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::saveConfig(const char *filename)
+{
+    // Current values
+    if (mutexCommand) pthread_mutex_lock(mutexCommand);
+    ARDRONE_CONFIG current = config;
+    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        CVDRONE_ERROR("fopen(%s) failed. (%s, %d)\n", filename, __FILE__, __LINE__);
+        return 0;
+    }
+
+    for (int i = 0; i < CONFIG_NUM_FIELDS; i++) {
+        const CONFIG_FIELD_INFO *field = &configFields[i];
+        const char *src = (const char*)&current + field->offset;
+        size_t count = field->size / 4;
+
+        fprintf(file, "%s = ", field->name);
+        switch (field->type) {
+            case CONFIG_INT:
+                for (size_t j = 0; j < count; j++) fprintf(file, (j > 0) ? ",%d" : "%d", ((const int*)src)[j]);
+                break;
+            case CONFIG_FLOAT:
+                if (count > 1) fprintf(file, "{ ");
+                for (size_t j = 0; j < count; j++) fprintf(file, (count > 1) ? "%.7e " : "%.7e", ((const float*)src)[j]);
+                if (count > 1) fprintf(file, "}");
+                break;
+            case CONFIG_BOOL:
+                fprintf(file, "%s", *(const bool*)src ? "TRUE" : "FALSE");
+                break;
+            case CONFIG_STRING:
+                fprintf(file, "%.*s", (int)field->size, src);
+                break;
+            default:
+                break;
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Load configurations saved by saveConfig().
+//! @param   filename File name
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::loadConfig(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (!file) return 0;
+
+    // Parse the lines
+    ARDRONE_CONFIG loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        parse(line, &loaded);
+    }
+    fclose(file);
+
+    // Update
+    if (mutexCommand) pthread_mutex_lock(mutexCommand);
+    config = loaded;
+    if (mutexCommand) pthread_mutex_unlock(mutexCommand);
+
+    return 1;
+}
@@ -0,0 +1,113 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   link.cpp
+//! @brief  Supervision of the link with AR.Drone
+//
+// -------------------------------------------------------------------------
+
+#include "ardrone.h"
+
+// --------------------------------------------------------------------------
+//! @brief   Record the arrival of a navdata packet or a video frame.
+//! @param   channel LINK_NAVDATA or LINK_VIDEO
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::linkArrived(int channel)
+{
+    long long now = usclock();
+
+    if (mutexLink) pthread_mutex_lock(mutexLink);
+
+    // Back after a dropout
+    if (linkLostTime[channel]) {
+        linkStats.lastReconnectTime = (now - linkLostTime[channel]) * 1e-6;
+        if (linkStats.lastReconnectTime > linkStats.maxReconnectTime) linkStats.maxReconnectTime = linkStats.lastReconnectTime;
+        linkLostTime[channel] = 0;
+    }
+    linkLastTime[channel] = now;
+
+    if (mutexLink) pthread_mutex_unlock(mutexLink);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Record a dropout of navdata or video.
+//! @param   channel LINK_NAVDATA or LINK_VIDEO
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::linkLost(int channel)
+{
+    if (mutexLink) pthread_mutex_lock(mutexLink);
+
+    // The dropout began with the last arrival
+    if (!linkLostTime[channel]) {
+        linkLostTime[channel] = linkLastTime[channel] ? linkLastTime[channel] : usclock();
+        if (channel == LINK_NAVDATA) linkStats.navdataLosses++;
+        else                         linkStats.videoLosses++;
+    }
+
+    if (mutexLink) pthread_mutex_unlock(mutexLink);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the state of the link with AR.Drone.
+//! @return  State of the link
+//! @retval  ARDRONE_LINK_OK Navdata and video arrive
+//! @retval  ARDRONE_LINK_DEGRADED Navdata or video are late
+//! @retval  ARDRONE_LINK_LOST Navdata or video are lost (or not connected)
+// --------------------------------------------------------------------------
+int ARDrone::getLinkState(void)
+{
+    // Not connected
+    if (!mutexLink) return ARDRONE_LINK_LOST;
+
+    long long now = usclock();
+    int state = ARDRONE_LINK_OK;
+
+    pthread_mutex_lock(mutexLink);
+    for (int i = LINK_NAVDATA; i <= LINK_VIDEO; i++) {
+        long long age = now - linkLastTime[i];
+        if (linkLostTime[i] || age > ARDRONE_LINK_LOST_TIME * 1000LL) state = ARDRONE_LINK_LOST;
+        else if (age > ARDRONE_LINK_DEGRADED_TIME * 1000LL && state == ARDRONE_LINK_OK) state = ARDRONE_LINK_DEGRADED;
+    }
+    pthread_mutex_unlock(mutexLink);
+
+    return state;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the statistics of the link with AR.Drone.
+//! @param   stats Statistics
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::getLinkStats(ARDRONE_LINK_STATS *stats)
+{
+    if (!stats) return;
+
+    long long now = usclock();
+
+    if (mutexLink) pthread_mutex_lock(mutexLink);
+    *stats = linkStats;
+    stats->navdataAge = linkLastTime[LINK_NAVDATA] ? (now - linkLastTime[LINK_NAVDATA]) * 1e-6 : 0.0;
+    stats->videoAge   = linkLastTime[LINK_VIDEO]   ? (now - linkLastTime[LINK_VIDEO])   * 1e-6 : 0.0;
+    if (mutexLink) pthread_mutex_unlock(mutexLink);
+}
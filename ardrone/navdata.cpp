@@ -77,6 +77,7 @@ int ARDrone::initNavdata(void)
     pthread_mutex_init(mutexNavdata, NULL);
 
     // Create a thread
+    stopNavdata = false;
     threadNavdata = new pthread_t;
     if (pthread_create(threadNavdata, NULL, runNavdata, this) != 0) {
         CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
@@ -92,10 +93,9 @@ int ARDrone::initNavdata(void)
 // --------------------------------------------------------------------------
 void ARDrone::loopNavdata(void)
 {
-    while (1) {
+    while (!stopNavdata) {
         // Get Navdata
         if (!getNavdata()) break;
-        pthread_testcancel();
         msleep(10);
     }
 }
@@ -111,12 +111,22 @@ int ARDrone::getNavdata(void)
     // Send a request
     sockNavdata.sendf("\x01\x00\x00\x00");
 
-    // Receive data
+    // Receive data, the request above is repeated until the drone answers again
     char buf[4096] = {'\0'};
-    int size = sockNavdata.receive((void*)&buf, sizeof(buf));
+    int size = sockNavdata.receiveSome((void*)&buf, sizeof(buf), 100);
+
+    // Nothing since a while
+    if (size < 1) {
+        if (mutexLink) pthread_mutex_lock(mutexLink);
+        long long age = usclock() - linkLastTime[LINK_NAVDATA];
+        if (mutexLink) pthread_mutex_unlock(mutexLink);
+        if (age > ARDRONE_LINK_LOST_TIME * 1000LL) linkLost(LINK_NAVDATA);
+    }
 
     // Received something
     if (size > 0) {
+        linkArrived(LINK_NAVDATA);
+
         // Enable mutex lock
         if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
 
@@ -233,13 +243,50 @@ int ARDrone::getNavdata(void)
             index += tmp_size;
         }
 
+        // Sample for the recording, the values are the ones of the getters
+        ARDRONE_RECORD_NAV sample;
+        memset(&sample, 0, sizeof(sample));
+        sample.time        = usclock();
+        sample.sequence    = navdata.sequence;
+        sample.state       = navdata.ardrone_state;
+        sample.battery     = navdata.demo.vbat_flying_percentage;
+        sample.linkQuality = navdata.wifi.link_quality;
+        sample.roll        =  navdata.demo.phi   * 0.001f;
+        sample.pitch       = -navdata.demo.theta * 0.001f;
+        sample.yaw         = -navdata.demo.psi   * 0.001f;
+        sample.altitude    =  navdata.demo.altitude * 0.001f;
+        sample.vx          =  navdata.demo.vx * 0.001f;
+        sample.vy          = -navdata.demo.vy * 0.001f;
+        sample.vz          = -navdata.altitude.altitude_vz * 0.001f;
+        if (navdata.gps.data_available) {
+            sample.latitude  = navdata.gps.lat;
+            sample.longitude = navdata.gps.lon;
+            sample.elevation = navdata.gps.elevation;
+        }
+
         // Disable mutex lock
         if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
+
+        // Navdata next to the recorded video
+        writeStreamRecordNav(&sample);
+
+        // Let the derived classes use every navdata
+        navdataArrived();
     }
 
     return 1;
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Called by the navdata thread after each received navdata.
+//! @return  None
+//! @note    The navdata thread is the only one writing navdata,
+//!          it can be read here without locking mutexNavdata.
+// --------------------------------------------------------------------------
+void ARDrone::navdataArrived(void)
+{
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Get current role angle of AR.Drone.
 //! @return  Role angle [rad]
@@ -387,9 +434,9 @@ int ARDrone::onGround(void)
 // --------------------------------------------------------------------------
 void ARDrone::finalizeNavdata(void)
 {
-    // Destroy the thread
+    // Stop the thread (the receive times out after 100ms)
     if (threadNavdata) {
-        pthread_cancel(*threadNavdata);
+        stopNavdata = true;
         pthread_join(*threadNavdata, NULL);
         delete threadNavdata;
         threadNavdata = NULL;
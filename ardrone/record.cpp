@@ -0,0 +1,458 @@
+// -------------------------------------------------------------------------
+// CV Drone (= OpenCV + AR.Drone)
+// Copyright(C) 2016 puku0x
+// https://github.com/puku0x/cvdrone
+//
+// This source file is part of CV Drone library.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of EITHER:
+// (1) The GNU Lesser General Public License as published by the Free
+//     Software Foundation; either version 2.1 of the License, or (at
+//     your option) any later version. The text of the GNU Lesser
+//     General Public License is included with this library in the
+//     file cvdrone-license-LGPL.txt.
+// (2) The BSD-style license that is included with this library in
+//     the file cvdrone-license-BSD.txt.
+// 
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files
+// cvdrone-license-LGPL.txt and cvdrone-license-BSD.txt for more details.
+//
+//! @file   record.cpp
+//! @brief  Recording of the H.264 stream without decoding
+//
+// -------------------------------------------------------------------------
+
+#include "ardrone.h"
+
+// Time base of the recorded stream
+static const AVRational RECORD_TIME_BASE = {1, 90000};
+static const AVRational USCLOCK_TIME_BASE = {1, 1000000};
+
+// --------------------------------------------------------------------------
+//! @brief   Check whether a packet can start a recording.
+//! @param   packet H.264 packet
+//! @return  1 if it is a key frame or carries a SPS, 0 otherwise
+// --------------------------------------------------------------------------
+static int isKeyPacket(const AVPacket *packet)
+{
+    if (packet->flags & AV_PKT_FLAG_KEY) return 1;
+
+    // Look for a sequence parameter set (NAL type 7)
+    for (int i = 0; i + 3 < packet->size; i++) {
+        if (packet->data[i] == 0 && packet->data[i + 1] == 0 && packet->data[i + 2] == 1 && (packet->data[i + 3] & 0x1f) == 7) return 1;
+    }
+
+    return 0;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Start to copy the H.264 stream into a file.
+//! @param   filename Name of the file, the container is chosen by the extension (.mp4, .mkv)
+//! @note    This is only for AR.Drone 2.0.
+//!          Packets are written as they arrive, nothing is decoded or encoded.
+//!          The file begins with the pre-recording buffer (setPreRecord()),
+//!          or with the next key frame without it. The buffer is written by
+//!          the video thread, a few packets with each live one, so that the
+//!          navdata and video threads are not blocked meanwhile.
+//!          The navdata are written to <filename>.nav (ARDRONE_RECORD_NAV).
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::startStreamRecord(const char *filename)
+{
+    // AR.Drone 1.0 does not send H.264
+    if (version.major != ARDRONE_VERSION_2 || !pFormatCtx) return 0;
+
+    // Already recording
+    if (isStreamRecording()) return 0;
+
+    // Output with the container of the extension
+    AVFormatContext *pNewRecordCtx = NULL;
+    if (avformat_alloc_output_context2(&pNewRecordCtx, NULL, NULL, filename) < 0 || !pNewRecordCtx) {
+        CVDRONE_ERROR("avformat_alloc_output_context2() was failed. (%s, %d)\n", __FILE__, __LINE__);
+        return 0;
+    }
+
+    // Same stream as the drone's one
+    AVStream *pNewStream = avformat_new_stream(pNewRecordCtx, NULL);
+    if (!pNewStream) {
+        avformat_free_context(pNewRecordCtx);
+        return 0;
+    }
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
+    int copied = pFormatCtx ? avcodec_copy_context(pNewStream->codec, pFormatCtx->streams[0]->codec) : -1;
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+    if (copied < 0) {
+        avformat_free_context(pNewRecordCtx);
+        return 0;
+    }
+    pNewStream->codec->codec_tag = 0;
+    pNewStream->time_base = RECORD_TIME_BASE;
+    if (pNewRecordCtx->oformat->flags & AVFMT_GLOBALHEADER) pNewStream->codec->flags |= CODEC_FLAG_GLOBAL_HEADER;
+
+    // Open the file
+    if (!(pNewRecordCtx->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&pNewRecordCtx->pb, filename, AVIO_FLAG_WRITE) < 0) {
+            CVDRONE_ERROR("avio_open(%s) was failed. (%s, %d)\n", filename, __FILE__, __LINE__);
+            avformat_free_context(pNewRecordCtx);
+            return 0;
+        }
+    }
+
+    // Navdata next to the video
+    char navname[256];
+    snprintf(navname, sizeof(navname), "%s.nav", filename);
+    FILE *pNavFile = fopen(navname, "wb");
+    if (pNavFile) {
+        uint32_t info[3] = {sizeof(ARDRONE_RECORD_NAV), (uint32_t)RECORD_TIME_BASE.num, (uint32_t)RECORD_TIME_BASE.den};
+        fwrite(ARDRONE_RECORD_NAV_MAGIC, 1, 8, pNavFile);
+        fwrite(info, sizeof(info), 1, pNavFile);
+    }
+    else CVDRONE_ERROR("fopen(%s) was failed. (%s, %d)\n", navname, __FILE__, __LINE__);
+
+    // The video thread writes the header with the first key frame
+    if (mutexRecord) pthread_mutex_lock(mutexRecord);
+    pRecordCtx      = pNewRecordCtx;
+    pRecordStream   = pNewStream;
+    recordHeader    = false;
+    recordStartTime = 0;
+    recordStartPts  = AV_NOPTS_VALUE;
+    recordLastDts   = AV_NOPTS_VALUE;
+    recordLastTime  = 0;
+    recordNavFile   = pNavFile;
+
+    // What happened before, live packets follow
+    recordPreNext   = (preCount > 0) ? preSeq : -1;
+    if (mutexRecord) pthread_mutex_unlock(mutexRecord);
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Stop to copy the H.264 stream and close the file.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::stopStreamRecord(void)
+{
+    if (mutexRecord) pthread_mutex_lock(mutexRecord);
+
+    if (pRecordCtx) {
+        // Finish the file (index of MP4)
+        if (recordHeader) av_write_trailer(pRecordCtx);
+        if (!(pRecordCtx->oformat->flags & AVFMT_NOFILE)) avio_close(pRecordCtx->pb);
+        avformat_free_context(pRecordCtx);
+        pRecordCtx    = NULL;
+        pRecordStream = NULL;
+    }
+    if (recordNavFile) {
+        fclose(recordNavFile);
+        recordNavFile = NULL;
+    }
+    recordPreNext = -1;
+
+    if (mutexRecord) pthread_mutex_unlock(mutexRecord);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Check whether the H.264 stream is being recorded.
+//! @return  1 if recording, 0 otherwise
+// --------------------------------------------------------------------------
+int ARDrone::isStreamRecording(void)
+{
+    if (mutexRecord) pthread_mutex_lock(mutexRecord);
+    int recording = (pRecordCtx != NULL);
+    if (mutexRecord) pthread_mutex_unlock(mutexRecord);
+
+    return recording;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Keep the last seconds of the stream, to be written when a recording starts.
+//! @param   seconds Length of the window [s] (0 to disable)
+//! @param   bytes   Memory budget of the buffer [bytes]
+//! @note    The buffer always begins with a key frame. The oldest group of
+//!          pictures is dropped when the window or the budget is exceeded.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::setPreRecord(double seconds, size_t bytes)
+{
+    if (mutexRecord) pthread_mutex_lock(mutexRecord);
+
+    // Free the previous buffer
+    if (preBuffer) av_free(preBuffer);
+    if (prePackets) av_free(prePackets);
+    preBuffer  = NULL;
+    prePackets = NULL;
+    preBufferSize = 0;
+    clearPreRecord();
+    preWindow = 0;
+
+    // Allocate the new one
+    int result = 1;
+    if (seconds > 0.0 && bytes > 0) {
+        preBuffer  = (uint8_t*)av_malloc(bytes);
+        prePackets = (ARDRONE_PRE_PACKET*)av_malloc(ARDRONE_PRERECORD_MAX_PACKETS * sizeof(ARDRONE_PRE_PACKET));
+        if (preBuffer && prePackets) {
+            preBufferSize = bytes;
+            preWindow = (long long)(seconds * 1000000.0);
+        }
+        else {
+            CVDRONE_ERROR("av_malloc() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            if (preBuffer) av_free(preBuffer);
+            if (prePackets) av_free(prePackets);
+            preBuffer  = NULL;
+            prePackets = NULL;
+            result = 0;
+        }
+    }
+
+    if (mutexRecord) pthread_mutex_unlock(mutexRecord);
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Drop the oldest packet of the pre-recording buffer.
+//! @param   aligned Also drop the packets up to the next key frame
+//! @note    mutexRecord must be locked.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::dropPreRecord(bool aligned)
+{
+    if (preCount > 0) {
+        preFirst = (preFirst + 1) % ARDRONE_PRERECORD_MAX_PACKETS;
+        preCount--;
+        preSeq++;
+    }
+
+    // A buffer that does not begin with a key frame cannot be decoded
+    while (aligned && preCount > 0 && !(prePackets[preFirst].flags & AV_PKT_FLAG_KEY)) {
+        preFirst = (preFirst + 1) % ARDRONE_PRERECORD_MAX_PACKETS;
+        preCount--;
+        preSeq++;
+    }
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Drop all the packets of the pre-recording buffer.
+//! @note    mutexRecord must be locked.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::clearPreRecord(void)
+{
+    preSeq += preCount;
+    preHead = preFirst = preCount = 0;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Add a packet to the pre-recording buffer.
+//! @param   packet Packet read by av_read_frame()
+//! @param   time   Arrival time of the packet [us]
+//! @note    mutexRecord must be locked.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::pushPreRecord(AVPacket *packet, long long time)
+{
+    if (!preBuffer || packet->size <= 0 || (size_t)packet->size > preBufferSize) return;
+
+    // Wait for a key frame to begin
+    int key = isKeyPacket(packet);
+    if (preCount == 0 && !key) return;
+
+    // No room at the end of the memory, continue at the beginning
+    size_t offset = preHead;
+    if (offset + packet->size > preBufferSize) {
+        // The packets after the head are the oldest ones
+        while (preCount > 0 && prePackets[preFirst].offset >= preHead) dropPreRecord(true);
+        offset = 0;
+    }
+
+    // Drop the oldest packets where the new one goes
+    while (preCount > 0) {
+        ARDRONE_PRE_PACKET *first = &prePackets[preFirst];
+        if (first->offset < offset + packet->size && first->offset + first->size > offset) dropPreRecord(true);
+        else break;
+    }
+
+    // List of packets full
+    if (preCount == ARDRONE_PRERECORD_MAX_PACKETS) dropPreRecord(true);
+
+    // Keep the window: drop a group of pictures when the next one is still old enough
+    while (preCount > 0 && time - prePackets[preFirst].time > preWindow) {
+        int next = 1;
+        while (next < preCount && !(prePackets[(preFirst + next) % ARDRONE_PRERECORD_MAX_PACKETS].flags & AV_PKT_FLAG_KEY)) next++;
+        if (next == preCount || time - prePackets[(preFirst + next) % ARDRONE_PRERECORD_MAX_PACKETS].time < preWindow) break;
+        dropPreRecord(true);
+    }
+
+    // Everything was dropped, begin again with a key frame
+    if (preCount == 0 && !key) return;
+
+    // Store the packet
+    memcpy(preBuffer + offset, packet->data, packet->size);
+    ARDRONE_PRE_PACKET *last = &prePackets[(preFirst + preCount) % ARDRONE_PRERECORD_MAX_PACKETS];
+    last->offset = offset;
+    last->size   = packet->size;
+    last->flags  = key ? AV_PKT_FLAG_KEY : 0;
+    last->pts    = packet->pts;
+    last->time   = time;
+    preCount++;
+    preHead = offset + packet->size;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Write a packet to the file.
+//! @param   packet H.264 packet
+//! @param   time   Arrival time of the packet [us]
+//! @note    mutexRecord must be locked and a recording started.
+//! @return  Result of this function
+//! @retval  1 Success (or waiting for a key frame)
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::writeRecordPacket(AVPacket *packet, long long time)
+{
+    // The file starts with a key frame
+    if (!recordHeader) {
+        if (!isKeyPacket(packet)) return 1;
+
+        // Without global header from the demuxer, the muxer takes SPS/PPS from the key frame
+        AVCodecContext *pRecordCodec = pRecordStream->codec;
+        if (pRecordCodec->extradata_size == 0) {
+            pRecordCodec->extradata = (uint8_t*)av_mallocz(packet->size + FF_INPUT_BUFFER_PADDING_SIZE);
+            memcpy(pRecordCodec->extradata, packet->data, packet->size);
+            pRecordCodec->extradata_size = packet->size;
+        }
+
+        // The recording stops, isStreamRecording() tells it to the application
+        if (avformat_write_header(pRecordCtx, NULL) < 0) {
+            CVDRONE_ERROR("avformat_write_header() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            if (!(pRecordCtx->oformat->flags & AVFMT_NOFILE)) avio_close(pRecordCtx->pb);
+            avformat_free_context(pRecordCtx);
+            pRecordCtx    = NULL;
+            pRecordStream = NULL;
+            if (recordNavFile) {
+                fclose(recordNavFile);
+                recordNavFile = NULL;
+            }
+            return 0;
+        }
+        recordHeader    = true;
+        recordStartTime = time;
+        recordStartPts  = packet->pts;
+    }
+
+    // Timestamps of the stream when the demuxer has real ones, otherwise the arrival time
+    // Note: raw H.264 over TCP has no timestamp, libavformat drops the PaVE headers
+    AVStream *pInStream = pFormatCtx->streams[0];
+    int64_t dts = AV_NOPTS_VALUE;
+    if (!(pFormatCtx->iformat->flags & AVFMT_NOTIMESTAMPS) && packet->pts != AV_NOPTS_VALUE && recordStartPts != AV_NOPTS_VALUE) {
+        dts = av_rescale_q(packet->pts - recordStartPts, pInStream->time_base, pRecordStream->time_base);
+    }
+    if (dts == AV_NOPTS_VALUE || (recordLastDts != AV_NOPTS_VALUE && dts <= recordLastDts)) {
+        dts = av_rescale_q(time - recordStartTime, USCLOCK_TIME_BASE, pRecordStream->time_base);
+    }
+
+    // Timestamps must grow (after a reconnection of the stream)
+    if (recordLastDts != AV_NOPTS_VALUE && dts <= recordLastDts) dts = recordLastDts + 1;
+    recordLastDts  = dts;
+    recordLastTime = time;
+
+    // The drone does not use B-frames, so pts = dts
+    AVPacket out = *packet;
+    out.stream_index = pRecordStream->index;
+    out.pts = out.dts = dts;
+    out.duration = 0;
+    out.pos = -1;
+
+    return (av_write_frame(pRecordCtx, &out) >= 0) ? 1 : 0;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Write the next packets of the pre-recording buffer to the file.
+//! @note    mutexRecord must be locked and a recording started.
+//!          Up to ARDRONE_PRERECORD_DRAIN packets are written per call. The
+//!          packets dropped from the buffer before being written are skipped,
+//!          the buffer always begins with a key frame.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::drainPreRecord(void)
+{
+    if (recordPreNext < preSeq) recordPreNext = preSeq;
+
+    int result = 1;
+    for (int i = 0; i < ARDRONE_PRERECORD_DRAIN && recordPreNext < preSeq + preCount && pRecordCtx; i++) {
+        ARDRONE_PRE_PACKET *pre = &prePackets[(preFirst + (int)(recordPreNext - preSeq)) % ARDRONE_PRERECORD_MAX_PACKETS];
+
+        AVPacket packet;
+        av_init_packet(&packet);
+        packet.data  = preBuffer + pre->offset;
+        packet.size  = pre->size;
+        packet.flags = pre->flags;
+        packet.pts   = packet.dts = pre->pts;
+        if (!writeRecordPacket(&packet, pre->time)) result = 0;
+        recordPreNext++;
+    }
+
+    // Up to date, the next packets are written as they arrive
+    if (recordPreNext >= preSeq + preCount) recordPreNext = -1;
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Write a packet of the H.264 stream to the file.
+//! @param   packet Packet read by av_read_frame()
+//! @param   time   Arrival time of the packet [us]
+//! @note    Called by the video thread. The packet stays owned by the caller.
+//!          It is also kept in the pre-recording buffer. While the buffer is
+//!          being written, the packet is written after it from the buffer.
+//! @return  Result of this function
+//! @retval  1 Success (or not recording)
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::writeStreamRecord(AVPacket *packet, long long time)
+{
+    if (mutexRecord) pthread_mutex_lock(mutexRecord);
+
+    int result = 1;
+    pushPreRecord(packet, time);
+    if (pRecordCtx) {
+        // While the buffer is written, the packet follows from it (one that
+        // could not be kept is lost, the decoder recovers at the next key frame)
+        if (recordPreNext >= 0) result = drainPreRecord();
+        else result = writeRecordPacket(packet, time);
+    }
+
+    if (mutexRecord) pthread_mutex_unlock(mutexRecord);
+
+    return result;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Write a navdata sample next to the recorded video.
+//! @param   sample Navdata, its arrival time must be set
+//! @note    Called by the navdata thread for each navdata.
+//!          The timestamp is the one of the last video packet, moved by
+//!          the time elapsed since it has arrived.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::writeStreamRecordNav(ARDRONE_RECORD_NAV *sample)
+{
+    if (mutexRecord) pthread_mutex_lock(mutexRecord);
+
+    // Samples begin with the video
+    if (recordNavFile && recordHeader) {
+        sample->pts = recordLastDts + av_rescale_q(sample->time - recordLastTime, USCLOCK_TIME_BASE, RECORD_TIME_BASE);
+        fwrite(sample, sizeof(ARDRONE_RECORD_NAV), 1, recordNavFile);
+    }
+
+    if (mutexRecord) pthread_mutex_unlock(mutexRecord);
+}
@@ -184,6 +184,32 @@ int TCPSocket::receive(void *data, size_t size)
     return received;
 }
 
+// --------------------------------------------------------------------------
+// TCPSocket::receiveSome(Receiving data, Size of data, Timeout [ms])
+// Description  : Receive the data that is available, waiting up to the timeout.
+// Return value : SUCCESS: Number of received bytes  FAILURE: 0
+// --------------------------------------------------------------------------
+int TCPSocket::receiveSome(void *data, size_t size, int timeout)
+{
+    // The socket is invalid
+    if (sock == INVALID_SOCKET) return 0;
+
+    // Wait for the data
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv;
+    tv.tv_sec  = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    if (select((int)sock + 1, &fds, NULL, NULL, &tv) < 1) return 0;
+
+    // Receive data
+    int n = (int)recv(sock, (char*)data, size, 0);
+    if (n < 1) return 0;
+
+    return n;
+}
+
 // --------------------------------------------------------------------------
 // TCPSocket::close()
 // Description  : Finalize the socket.
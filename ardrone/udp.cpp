@@ -173,6 +173,29 @@ int UDPSocket::receive(void *data, size_t size)
     return n;
 }
 
+// --------------------------------------------------------------------------
+// UDPSocket::receiveSome(Receiving data, Size of data, Timeout [ms])
+// Description  : Receive the data, waiting up to the timeout.
+// Return value : SUCCESS: Number of received bytes  FAILURE: 0
+// --------------------------------------------------------------------------
+int UDPSocket::receiveSome(void *data, size_t size, int timeout)
+{
+    // The socket is invalid.
+    if (sock == INVALID_SOCKET) return 0;
+
+    // Wait for the data
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv;
+    tv.tv_sec  = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    if (select((int)sock + 1, &fds, NULL, NULL, &tv) < 1) return 0;
+
+    // Receive data
+    return receive(data, size);
+}
+
 // --------------------------------------------------------------------------
 // UDPSocket::close()
 // Description  : Finalize the socket.
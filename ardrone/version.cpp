@@ -27,13 +27,18 @@
 
 #include "ardrone.h"
 
+// Index of the known drones in the cache directory
+#define ARDRONE_CACHE_FILE "drones.ini"
+
 // --------------------------------------------------------------------------
-//! @brief   Get the version information via FTP.
-//! @return  Result of initialization
+//! @brief   Read version.txt via FTP.
+//! @param   ip IP address of AR.Drone
+//! @param   ver Version information
+//! @return  Result of this function
 //! @retval  1 Success
 //! @retval  0 Failure
 // --------------------------------------------------------------------------
-int ARDrone::getVersionInfo(void)
+static int readVersionFile(const char *ip, ARDRONE_VERSION *ver)
 {
     TCPSocket socket1, socket2;
 
@@ -72,7 +77,7 @@ int ARDrone::getVersionInfo(void)
     socket2.receive(buf, len);
 
     // Get version information
-    sscanf(buf, "%d.%d.%d", &version.major, &version.minor, &version.revision);
+    sscanf(buf, "%d.%d.%d", &ver->major, &ver->minor, &ver->revision);
     //printf("AR.Drone Ver %d.%d.%d\n", major, minor, revision);
 
     // See you
@@ -82,6 +87,211 @@ int ARDrone::getVersionInfo(void)
     return 1;
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Get the version information via FTP.
+//! @return  Result of initialization
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::getVersionInfo(void)
+{
+    ARDRONE_VERSION tmp = {0, 0, 0};
+    if (!readVersionFile(ip, &tmp)) return 0;
+    version = tmp;
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Look up the MAC address of an IP address in the ARP table.
+//! @param   ip IP address
+//! @param   mac MAC address ("xx:xx:xx:xx:xx:xx")
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+static int getMacAddress(const char *ip, char *mac)
+{
+    #ifdef _WIN32
+    // Not supported, the cache is not used
+    return 0;
+    #else
+    FILE *file = fopen("/proc/net/arp", "r");
+    if (!file) return 0;
+
+    // IP address / HW type / Flags / HW address / Mask / Device
+    char line[256];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), file)) {
+        char addr[64], hw[32];
+        unsigned int type, flags;
+        if (sscanf(line, "%63s %x %x %31s", addr, &type, &flags, hw) != 4) continue;
+        if (strcmp(addr, ip) || !(flags & 0x2)) continue;
+        strncpy(mac, hw, 17);
+        mac[17] = '\0';
+        found = 1;
+    }
+    fclose(file);
+
+    return found;
+    #endif
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Check that an AR.Drone answers on the navdata port and get its MAC address.
+//! @param   ip IP address of AR.Drone
+//! @param   mac MAC address of AR.Drone
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+static int probeDrone(const char *ip, char *mac)
+{
+    UDPSocket sock;
+    if (!sock.open(ip, ARDRONE_NAVDATA_PORT)) return 0;
+
+    // Any navdata packet starts with the header
+    unsigned int buf[1024];
+    sock.sendf("\x01\x00\x00\x00");
+    int size = sock.receiveSome(buf, sizeof(buf), 500);
+    sock.close();
+    if (size < 4 || buf[0] != ARDRONE_NAVDATA_HEADER) return 0;
+
+    // The answer filled the ARP table
+    return getMacAddress(ip, mac);
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Get the version and configurations of a known AR.Drone from the cache.
+//! @return  Result of this function
+//! @retval  1 Success (the drone is known)
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::loadCache(void)
+{
+    // Cache disabled
+    if (configCacheDir[0] == '\0') return 0;
+
+    // Who is answering ?
+    if (!probeDrone(ip, mac)) return 0;
+
+    // Open the index
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/%s", configCacheDir, ARDRONE_CACHE_FILE);
+    FILE *file = fopen(filename, "r");
+    if (!file) return 0;
+
+    // IP address / MAC address / Version / Serial number
+    char line[256];
+    ARDRONE_VERSION cached = {0, 0, 0};
+    char serial[32] = {'\0'};
+    while (fgets(line, sizeof(line), file)) {
+        char addr[64], hw[32], tmp[32];
+        ARDRONE_VERSION ver;
+        if (sscanf(line, "%63s %31s %d.%d.%d %31s", addr, hw, &ver.major, &ver.minor, &ver.revision, tmp) != 6) continue;
+        if (strcmp(addr, ip) || strcmp(hw, mac)) continue;
+        cached = ver;
+        strcpy(serial, tmp);
+        break;
+    }
+    fclose(file);
+    if (serial[0] == '\0') return 0;
+
+    // Configurations of this drone
+    snprintf(filename, sizeof(filename), "%s/drone_%s.ini", configCacheDir, serial);
+    if (!loadConfig(filename) || strcmp(config.general.drone_serial, serial)) {
+        memset(&config, 0, sizeof(config));
+        return 0;
+    }
+
+    version = cached;
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Save the version and configurations of AR.Drone in the cache.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::saveCache(void)
+{
+    // Cache disabled or unknown drone
+    if (configCacheDir[0] == '\0') return 0;
+    if (mac[0] == '\0' && !getMacAddress(ip, mac)) return 0;
+    if (config.general.drone_serial[0] == '\0') return 0;
+
+    // Configurations of this drone
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/drone_%s.ini", configCacheDir, config.general.drone_serial);
+    if (!saveConfig(filename)) return 0;
+
+    // Keep the other drones of the index
+    snprintf(filename, sizeof(filename), "%s/%s", configCacheDir, ARDRONE_CACHE_FILE);
+    char others[4096] = {'\0'};
+    size_t length = 0;
+    FILE *file = fopen(filename, "r");
+    if (file) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            char addr[64], hw[32];
+            if (sscanf(line, "%63s %31s", addr, hw) != 2) continue;
+            if (!strcmp(addr, ip) && !strcmp(hw, mac)) continue;
+            if (length + strlen(line) >= sizeof(others)) break;
+            strcpy(others + length, line);
+            length += strlen(line);
+        }
+        fclose(file);
+    }
+
+    // Write the index
+    file = fopen(filename, "w");
+    if (!file) {
+        CVDRONE_ERROR("fopen(%s) failed. (%s, %d)\n", filename, __FILE__, __LINE__);
+        return 0;
+    }
+    fputs(others, file);
+    fprintf(file, "%s %s %d.%d.%d %s\n", ip, mac, version.major, version.minor, version.revision, config.general.drone_serial);
+    fclose(file);
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Thread function to refresh the cache after a cached connection.
+//! @return  None
+// --------------------------------------------------------------------------
+void ARDrone::loopRefresh(void)
+{
+    // Version (FTP)
+    ARDRONE_VERSION tmp = {0, 0, 0};
+    if (readVersionFile(ip, &tmp)) {
+        if (tmp.major != version.major || tmp.minor != version.minor || tmp.revision != version.revision) {
+            CVDRONE_ERROR("AR.Drone was updated to %d.%d.%d, reconnect to use it. (%s, %d)\n", tmp.major, tmp.minor, tmp.revision, __FILE__, __LINE__);
+            if (tmp.major == version.major) {
+                if (mutexNavdata) pthread_mutex_lock(mutexNavdata);
+                version = tmp;
+                if (mutexNavdata) pthread_mutex_unlock(mutexNavdata);
+            }
+        }
+    }
+
+    // Configurations, and the ones that still differ
+    pthread_mutex_lock(mutexCommand);
+    int codec = config.video.video_codec;
+    pthread_mutex_unlock(mutexCommand);
+    if (getConfig()) applyConfig();
+
+    // The stream was opened with the cached codec
+    pthread_mutex_lock(mutexCommand);
+    bool restart = (config.video.video_codec != codec);
+    pthread_mutex_unlock(mutexCommand);
+    if (restart) restartVideo();
+
+    // Save them
+    saveCache();
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Get the version and the revision number
 //! @param   major A pointer to the major version variable
@@ -34,41 +34,60 @@
 // - AR.Drone Development - 2.1.2 AR.Drone 2.0 Video Decording: FFMPEG + SDL2.0 -
 //   http://ardrone-ailab-u-tokyo.blogspot.jp/2012/07/212-ardrone-20-video-decording-ffmpeg.html
 
+// --------------------------------------------------------------------------
+//! @brief   Give an image the size of the video, within its allocated data.
+//! @param   image Image allocated with ARDRONE_IMAGE_MAX_WIDTH x ARDRONE_IMAGE_MAX_HEIGHT
+//! @param   width Width of the video
+//! @param   height Height of the video
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure (the video is larger than the image)
+// --------------------------------------------------------------------------
+static int resizeImage(IplImage *image, int width, int height)
+{
+    if (width > ARDRONE_IMAGE_MAX_WIDTH || height > ARDRONE_IMAGE_MAX_HEIGHT) return 0;
+
+    // Only the header changes, the data stay where they are
+    image->width     = width;
+    image->height    = height;
+    image->widthStep = (width * 3 + 3) & ~3;
+    image->imageSize = image->widthStep * height;
+
+    return 1;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Initialize video.
+//! @note    The image returned by getImage() is allocated once, and kept until close().
 //! @return  Result of initialization
 //! @retval  1 Success
 //! @retval  0 Failure
 // --------------------------------------------------------------------------
 int ARDrone::initVideo(void)
 {
-    // AR.Drone 2.0
-    if (version.major == ARDRONE_VERSION_2) {
-        // Open the IP address and port
-        char filename[256];
-        sprintf(filename, "tcp://%s:%d", ip, ARDRONE_VIDEO_PORT);
-        if (avformat_open_input(&pFormatCtx, filename, NULL, NULL) < 0) {
-            CVDRONE_ERROR("avformat_open_input() was failed. (%s, %d)\n", __FILE__, __LINE__);
-            return 0;
-        }
+    // The thread runs until finalizeVideo()
+    stopVideo = false;
 
-        // Retrive and dump stream information
-        avformat_find_stream_info(pFormatCtx, NULL);
-        av_dump_format(pFormatCtx, 0, filename, 0);
+    // Create a mutex
+    if (!mutexVideo) {
+        mutexVideo = new pthread_mutex_t;
+        pthread_mutex_init(mutexVideo, NULL);
+    }
 
-        // Find the decoder for the video stream
-        pCodecCtx = pFormatCtx->streams[0]->codec;
-        AVCodec *pCodec = avcodec_find_decoder(pCodecCtx->codec_id);
-        if (pCodec == NULL) {
-            CVDRONE_ERROR("avcodec_find_decoder() was failed. (%s, %d)\n", __FILE__, __LINE__);
+    // AR.Drone 2.0
+    if (version.major == ARDRONE_VERSION_2) {
+        // Open the stream and the decoder
+        AVFormatContext *pNewFormatCtx = NULL;
+        AVCodecContext *pNewCodecCtx = NULL;
+        if (!openVideo(&pNewFormatCtx, &pNewCodecCtx)) {
+            CVDRONE_ERROR("Failed to open the video stream. (%s, %d)\n", __FILE__, __LINE__);
             return 0;
         }
 
-        // Open codec
-        if (avcodec_open2(pCodecCtx, pCodec, NULL) < 0) {
-            CVDRONE_ERROR("avcodec_open2() was failed. (%s, %d)\n", __FILE__, __LINE__);
-            return 0;
-        }
+        // Enable mutex lock
+        pthread_mutex_lock(mutexVideo);
+        pFormatCtx = pNewFormatCtx;
+        pCodecCtx = pNewCodecCtx;
 
         // Allocate video frames and a buffer
         #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55,28,1)
@@ -94,6 +113,9 @@ int ARDrone::initVideo(void)
             return 0;
         }
 
+        // Enable mutex lock
+        pthread_mutex_lock(mutexVideo);
+
         // Set codec
         pCodecCtx = avcodec_alloc_context3(NULL);
         pCodecCtx->width = 320;
@@ -103,27 +125,75 @@ int ARDrone::initVideo(void)
         bufferBGR = (uint8_t*)av_mallocz(avpicture_get_size(PIX_FMT_BGR24, pCodecCtx->width, pCodecCtx->height));
     }
 
-    // Allocate an IplImage
-    img = cvCreateImage(cvSize(pCodecCtx->width, (pCodecCtx->height == 368) ? 360 : pCodecCtx->height), IPL_DEPTH_8U, 3);
+    // Allocate an IplImage for the largest video, it is only resized afterwards
     if (!img) {
-        CVDRONE_ERROR("cvCreateImage() was failed. (%s, %d)\n", __FILE__, __LINE__);
-        return 0;
+        img = cvCreateImage(cvSize(ARDRONE_IMAGE_MAX_WIDTH, ARDRONE_IMAGE_MAX_HEIGHT), IPL_DEPTH_8U, 3);
+        if (!img) {
+            pthread_mutex_unlock(mutexVideo);
+            CVDRONE_ERROR("cvCreateImage() was failed. (%s, %d)\n", __FILE__, __LINE__);
+            return 0;
+        }
+
+        // Clear the image
+        cvZero(img);
+        resizeImage(img, pCodecCtx->width, (pCodecCtx->height == 368) ? 360 : pCodecCtx->height);
     }
 
-    // Clear the image
-    cvZero(img);
+    // Disable mutex lock
+    pthread_mutex_unlock(mutexVideo);
 
-    // Create a mutex
-    mutexVideo = new pthread_mutex_t;
-    pthread_mutex_init(mutexVideo, NULL);
+    // Frames are expected from now
+    linkArrived(LINK_VIDEO);
 
     // Create a thread
     threadVideo = new pthread_t;
     if (pthread_create(threadVideo, NULL, runVideo, this) != 0) {
         CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
+        delete threadVideo;
+        threadVideo = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Open the H.264 stream and its decoder.
+//! @param   format Format context to be opened
+//! @param   codec  Codec context of the stream
+//! @note    This is only for AR.Drone 2.0.
+//!          Gives up silently after ARDRONE_LINK_LOST_TIME without data, or
+//!          as soon as the video thread is asked to stop.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::openVideo(AVFormatContext **format, AVCodecContext **codec)
+{
+    // Open the IP address and port
+    char filename[256];
+    sprintf(filename, "tcp://%s:%d", ip, ARDRONE_VIDEO_PORT);
+    AVFormatContext *pNewFormatCtx = avformat_alloc_context();
+    pNewFormatCtx->interrupt_callback.callback = interruptVideo;
+    pNewFormatCtx->interrupt_callback.opaque = this;
+    videoActivity = usclock();
+    if (avformat_open_input(&pNewFormatCtx, filename, NULL, NULL) < 0) return 0;
+
+    // Retrive and dump stream information
+    avformat_find_stream_info(pNewFormatCtx, NULL);
+    av_dump_format(pNewFormatCtx, 0, filename, 0);
+
+    // Find and open the decoder for the video stream
+    AVCodecContext *pNewCodecCtx = pNewFormatCtx->streams[0]->codec;
+    AVCodec *pCodec = avcodec_find_decoder(pNewCodecCtx->codec_id);
+    if (pCodec == NULL || avcodec_open2(pNewCodecCtx, pCodec, NULL) < 0) {
+        avformat_close_input(&pNewFormatCtx);
         return 0;
     }
 
+    *format = pNewFormatCtx;
+    *codec  = pNewCodecCtx;
+
     return 1;
 }
 
@@ -133,14 +203,126 @@ int ARDrone::initVideo(void)
 // --------------------------------------------------------------------------
 void ARDrone::loopVideo(void)
 {
-    while (1) {
+    while (!stopVideo) {
         // Get video stream
-        if (!getVideo()) break;
-        pthread_testcancel();
+        if (!getVideo()) {
+            // AR.Drone 1.0 does not stop on errors
+            if (version.major != ARDRONE_VERSION_2) break;
+
+            // Asked to stop, av_read_frame() was interrupted
+            if (stopVideo) break;
+
+            // The stream is broken, reconnect the video only
+            linkLost(LINK_VIDEO);
+            while (!stopVideo && !reconnectVideo()) msleep(100);
+        }
         msleep(1);
     }
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Open the video stream again.
+//! @note    The decoder is replaced, frame buffers are kept unless the size
+//!          of the video has changed. The image is resized by getImage().
+//!          This is only for AR.Drone 2.0.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::reconnectVideo(void)
+{
+    // Open a new stream
+    AVFormatContext *pNewFormatCtx = NULL;
+    AVCodecContext *pNewCodecCtx = NULL;
+    if (!openVideo(&pNewFormatCtx, &pNewCodecCtx)) return 0;
+
+    // Enable mutex lock
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
+
+    // The buffers are made for the previous size
+    if (pNewCodecCtx->width != pCodecCtx->width || pNewCodecCtx->height != pCodecCtx->height || pNewCodecCtx->pix_fmt != pCodecCtx->pix_fmt) {
+        // Reallocate the buffer
+        av_free(bufferBGR);
+        bufferBGR = (uint8_t*)av_mallocz(avpicture_get_size(PIX_FMT_BGR24, pNewCodecCtx->width, pNewCodecCtx->height) * sizeof(uint8_t));
+        avpicture_fill((AVPicture*)pFrameBGR, bufferBGR, PIX_FMT_BGR24, pNewCodecCtx->width, pNewCodecCtx->height);
+
+        // Converter for the new size
+        sws_freeContext(pConvertCtx);
+        pConvertCtx = sws_getContext(pNewCodecCtx->width, pNewCodecCtx->height, pNewCodecCtx->pix_fmt, pNewCodecCtx->width, pNewCodecCtx->height, PIX_FMT_BGR24, SWS_SPLINE, NULL, NULL, NULL);
+
+        // No frame of the new size yet
+        newImage = false;
+
+        // The packets kept for a recording have the previous size
+        if (mutexRecord) pthread_mutex_lock(mutexRecord);
+        clearPreRecord();
+        if (mutexRecord) pthread_mutex_unlock(mutexRecord);
+    }
+
+    // Replace the stream
+    avcodec_close(pCodecCtx);
+    avformat_close_input(&pFormatCtx);
+    pFormatCtx = pNewFormatCtx;
+    pCodecCtx = pNewCodecCtx;
+
+    // Disable mutex lock
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+
+    return 1;
+}
+
+// --------------------------------------------------------------------------
+//! @brief   Restart the video after a change of its configurations.
+//! @note    On AR.Drone 2.0, only the stream and the decoder are reopened.
+//!          Restarts are serialized with the exchanges of configurations.
+//! @return  Result of this function
+//! @retval  1 Success
+//! @retval  0 Failure
+// --------------------------------------------------------------------------
+int ARDrone::restartVideo(void)
+{
+    // The cache refresh may restart it too
+    if (mutexConfig) pthread_mutex_lock(mutexConfig);
+    int result = 1;
+
+    // Not started
+    if (!threadVideo) result = initVideo();
+    // AR.Drone 1.0 restarts quickly anyway
+    else if (version.major != ARDRONE_VERSION_2) {
+        finalizeVideo();
+        result = initVideo();
+    }
+    else {
+        // Stop the thread
+        stopVideo = true;
+        pthread_join(*threadVideo, NULL);
+        stopVideo = false;
+
+        // Reopen the stream
+        if (!reconnectVideo()) {
+            delete threadVideo;
+            threadVideo = NULL;
+            finalizeVideo();
+            result = initVideo();
+        }
+        else {
+            linkArrived(LINK_VIDEO);
+
+            // Restart the thread
+            if (pthread_create(threadVideo, NULL, runVideo, this) != 0) {
+                CVDRONE_ERROR("pthread_create() was failed. (%s, %d)\n", __FILE__, __LINE__);
+                delete threadVideo;
+                threadVideo = NULL;
+                result = 0;
+            }
+        }
+    }
+
+    if (mutexConfig) pthread_mutex_unlock(mutexConfig);
+
+    return result;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Get AR.Drone's video stream.
 //! @return  Result of this function
@@ -155,7 +337,14 @@ int ARDrone::getVideo(void)
         int frameFinished = 0;
 
         // Read all frames
+        videoActivity = usclock();
         while (av_read_frame(pFormatCtx, &packet) >= 0) {
+            // The stream is alive
+            videoActivity = usclock();
+
+            // Copy the packet to the file as it is
+            writeStreamRecord(&packet, videoActivity);
+
             // Decode the frame
             avcodec_decode_video2(pCodecCtx, pFrame, &frameFinished, &packet);
 
@@ -165,7 +354,10 @@ int ARDrone::getVideo(void)
                 if (mutexVideo) pthread_mutex_lock(mutexVideo);
                 sws_scale(pConvertCtx, (const uint8_t* const*)pFrame->data, pFrame->linesize, 0, pCodecCtx->height, pFrameBGR->data, pFrameBGR->linesize);
                 newImage = true;
+                frameCount++;
+                frameTime = videoActivity;
                 if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+                linkArrived(LINK_VIDEO);
 
                 // Free the packet and break immidiately
                 av_free_packet(&packet);
@@ -183,16 +375,26 @@ int ARDrone::getVideo(void)
         // Send request
         sockVideo.sendf("\x01\x00\x00\x00");
 
-        // Receive data
+        // Receive data, the request above is repeated until the drone answers again
         uint8_t buf[122880];
-        int size = sockVideo.receive((void*)&buf, sizeof(buf));
+        int size = sockVideo.receiveSome((void*)&buf, sizeof(buf), 100);
 
         // Received something
         if (size > 0) {
             // Decode UVLC video
             if (mutexVideo) pthread_mutex_lock(mutexVideo);
             UVLC::DecodeVideo(buf, size, bufferBGR, &pCodecCtx->width, &pCodecCtx->height);
+            newImage = true;
+            frameCount++;
+            frameTime = usclock();
             if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+            linkArrived(LINK_VIDEO);
+        }
+        else {
+            if (mutexLink) pthread_mutex_lock(mutexLink);
+            long long age = usclock() - linkLastTime[LINK_VIDEO];
+            if (mutexLink) pthread_mutex_unlock(mutexLink);
+            if (age > ARDRONE_LINK_LOST_TIME * 1000LL) linkLost(LINK_VIDEO);
         }
     }
 
@@ -212,10 +414,24 @@ ARDRONE_IMAGE ARDrone::getImage(void)
     // Enable mutex lock
     if (mutexVideo) pthread_mutex_lock(mutexVideo);
 
+    // The video is being restarted, keep the last image
+    if (!pCodecCtx || !bufferBGR) {
+        if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+        return ARDRONE_IMAGE(img);
+    }
+
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
+        // The size may have changed with the codec, the data of the image stay valid
+        int width = pCodecCtx->width, height = (pCodecCtx->height == 368) ? 360 : pCodecCtx->height;
+        if ((width != img->width || height != img->height) && resizeImage(img, width, height)) cvZero(img);
+
         // Copy current frame to an IplImage
-        memcpy(img->imageData, pFrameBGR->data[0], pCodecCtx->width * ((pCodecCtx->height == 368) ? 360 : pCodecCtx->height) * sizeof(uint8_t) * 3);
+        if (width == img->width && height == img->height) {
+            for (int y = 0; y < height; y++) {
+                memcpy(img->imageData + y * img->widthStep, pFrameBGR->data[0] + y * pFrameBGR->linesize[0], width * sizeof(uint8_t) * 3);
+            }
+        }
     }
     // AR.Drone 1.0
     else {
@@ -267,32 +483,41 @@ bool ARDrone::willGetNewImage(void)
     return answer;
 }
 
+// --------------------------------------------------------------------------
+//! @brief   Get the number of frames decoded since the beginning.
+//! @param   time Arrival time of the last frame [us] (usclock)
+//! @return  Number of frames, it changes each time a new image is available
+// --------------------------------------------------------------------------
+unsigned long ARDrone::getFrameCount(long long *time)
+{
+    // Enable mutex lock
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
+
+    unsigned long count = frameCount;
+    if (time) *time = frameTime;
+
+    // Disable mutex lock
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
+
+    return count;
+}
+
 // --------------------------------------------------------------------------
 //! @brief   Finalize video.
 //! @return  None
 // --------------------------------------------------------------------------
 void ARDrone::finalizeVideo(void)
 {
-    // Destroy the thread
+    // Stop the thread (av_read_frame() is interrupted, UDP waits 100ms at most)
     if (threadVideo) {
-        pthread_cancel(*threadVideo);
+        stopVideo = true;
         pthread_join(*threadVideo, NULL);
         delete threadVideo;
         threadVideo = NULL;
     }
 
-    // Delete the mutex
-    if (mutexVideo) {
-        pthread_mutex_destroy(mutexVideo);
-        delete mutexVideo;
-        mutexVideo = NULL;
-    }
-
-    // Release the IplImage
-    if (img) {
-        cvReleaseImage(&img);
-        img = NULL;
-    }
+    // The mutex and the image are kept for getImage(), they are released by close()
+    if (mutexVideo) pthread_mutex_lock(mutexVideo);
 
     // AR.Drone 2.0
     if (version.major == ARDRONE_VERSION_2) {
@@ -357,4 +582,6 @@ void ARDrone::finalizeVideo(void)
         // Close the socket
         sockVideo.close();
     }
+
+    if (mutexVideo) pthread_mutex_unlock(mutexVideo);
 }
\ No newline at end of file